@@ -0,0 +1,74 @@
+#ifndef COMPUTER_BRAIN_ALIGNED_H
+#define COMPUTER_BRAIN_ALIGNED_H
+
+#include <cstddef>
+#include <new>
+
+/*
+ * Alignment of the memory behind Vector, Matrix and the kernels' scratch buffers.
+ *
+ * Every buffer starts on a 64-byte boundary: a cache line on every x86 and ARM core we care about, and the width of an
+ * AVX-512 register, so that no SIMD load of the first elements straddles two cache lines. A Matrix can also pad its
+ * rows (MatrixLayout::padded) so that every row starts on such a boundary too, and so that the distance between rows
+ * is never a multiple of 512 bytes: with such a stride, the rows of a column all fall in a handful of L1 cache sets
+ * and evict each other, which is what makes power-of-two widths slow in column-wise and GEMM packing loops.
+ */
+
+/// Alignment, in bytes, of every buffer allocated by the library.
+inline constexpr size_t storage_alignment = 64;
+
+/// How the rows of a Matrix are laid out in its buffer.
+enum class MatrixLayout {
+    packed,  // rows follow each other with no gap: ld() == columns()
+    padded,  // every row starts on a 64-byte boundary, and ld() avoids cache-set aliasing (see padded_leading_dim)
+};
+
+/**
+ * @brief The leading dimension, in elements, of a padded Matrix with the given number of columns.
+ *
+ * The number of columns is rounded up to a whole number of cache lines; if the row length in bytes is then a multiple
+ * of 512, one more cache line is added. For element types whose size does not divide 64 there is no padding.
+ */
+template<typename U>
+constexpr size_t padded_leading_dim(size_t columns) {
+    if (storage_alignment % sizeof(U) != 0) return columns;
+    constexpr size_t per_line = storage_alignment / sizeof(U);
+    size_t ld = (columns + per_line - 1) / per_line * per_line;
+    if (ld != 0 && (ld * sizeof(U)) % 512 == 0) ld += per_line;
+    return ld;
+}
+
+/// The leading dimension of a Matrix with the given number of columns and layout.
+template<typename U>
+constexpr size_t leading_dim_for(size_t columns, MatrixLayout layout) {
+    return layout == MatrixLayout::padded ? padded_leading_dim<U>(columns) : columns;
+}
+
+
+namespace detail {
+
+inline void* aligned_allocate(size_t bytes) { return ::operator new(bytes, std::align_val_t(storage_alignment)); }
+
+inline void aligned_deallocate(void* pointer) noexcept {
+    ::operator delete(pointer, std::align_val_t(storage_alignment));
+}
+
+/// A std::allocator that returns storage_alignment-aligned memory, for scratch buffers held in std::vector.
+template<typename T>
+class AlignedAllocator {
+public:
+    using value_type = T;
+
+    AlignedAllocator() noexcept = default;
+    template<typename W> AlignedAllocator(const AlignedAllocator<W>&) noexcept { }
+
+    T* allocate(size_t n) { return static_cast<T*>(aligned_allocate(n * sizeof(T))); }
+    void deallocate(T* pointer, size_t) noexcept { aligned_deallocate(pointer); }
+
+    template<typename W> bool operator==(const AlignedAllocator<W>&) const { return true; }
+};
+
+}  // namespace detail
+
+
+#endif //COMPUTER_BRAIN_ALIGNED_H
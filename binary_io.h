@@ -0,0 +1,454 @@
+#ifndef COMPUTER_BRAIN_BINARY_IO_H
+#define COMPUTER_BRAIN_BINARY_IO_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "aligned.h"
+#include "expression.h"
+#include "half.h"
+#include "view.h"
+
+#if __has_include(<sys/mman.h>) && __has_include(<fcntl.h>) && __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define COMPUTER_BRAIN_HAS_MMAP 1
+#endif
+
+/*
+ * Binary on-disk format for Vector and Matrix.
+ *
+ * A file holds one array: a fixed 128-byte header followed, at header.data_offset, by the elements in the layout the
+ * header describes. Every field is little-endian.
+ *
+ *   offset  size  field
+ *        0     8  magic "CBRAINLA"
+ *        8     4  version (binary_format_version)
+ *       12     4  dtype (BinaryDtype)
+ *       16     4  element size in bytes
+ *       20     4  rank: 1 for a Vector, 2 for a Matrix
+ *       24     8  rows    (a Vector has 1 row)
+ *       32     8  columns (a Vector has size() columns)
+ *       40     8  row stride, in elements
+ *       48     8  column stride, in elements
+ *       56     8  alignment of the data, in bytes, relative to the start of the file
+ *       64     8  data offset, in bytes, from the start of the file
+ *       72     4  flags (bit 0: is_transposed)
+ *       76    52  reserved, zero
+ *
+ * A saved Matrix keeps its storage as it is in memory, padding included (row stride ld(), column stride 1), so a
+ * padded Matrix comes back padded and its rows stay 64-byte aligned in a mapped file. The data starts at offset 128,
+ * which is a multiple of storage_alignment; since a mapping starts on a page boundary, the elements of a MappedMatrix
+ * are aligned exactly as those of a Matrix.
+ *
+ * load_matrix() and load_vector() read a file into a new Matrix or Vector. MappedMatrix maps the file read-only and
+ * shared instead: opening it costs a few system calls whatever the size of the file, pages are read from disk only when
+ * they are first touched, and every process that maps the same file shares the same physical pages.
+ */
+
+/// Version written by save_binary(); load functions accept files of this version or older.
+inline constexpr std::uint32_t binary_format_version = 1;
+
+/// Element type of a binary file.
+enum class BinaryDtype : std::uint32_t {
+    float32 = 1, float64 = 2,
+    int8 = 3, int16 = 4, int32 = 5, int64 = 6,
+    uint8 = 7, uint16 = 8, uint32 = 9, uint64 = 10,
+    float16 = 11, bfloat16 = 12,
+};
+
+/// The BinaryDtype of U, for every arithmetic type the format can hold and for float16 and bfloat16.
+template<typename U>
+constexpr BinaryDtype binary_dtype_of() {
+    static_assert((std::is_arithmetic_v<U> && !std::is_same_v<U, bool> && !std::is_same_v<U, long double>) ||
+                  is_half_type<U>, "Only built-in integer and floating-point types, float16 and bfloat16 can be "
+                  "saved in the binary format");
+    if constexpr (std::is_same_v<U, float16>) return BinaryDtype::float16;
+    else if constexpr (std::is_same_v<U, bfloat16>) return BinaryDtype::bfloat16;
+    else if constexpr (std::is_same_v<U, float>) return BinaryDtype::float32;
+    else if constexpr (std::is_same_v<U, double>) return BinaryDtype::float64;
+    else if constexpr (std::is_signed_v<U>) {
+        return sizeof(U) == 1 ? BinaryDtype::int8 : sizeof(U) == 2 ? BinaryDtype::int16
+             : sizeof(U) == 4 ? BinaryDtype::int32 : BinaryDtype::int64;
+    } else {
+        return sizeof(U) == 1 ? BinaryDtype::uint8 : sizeof(U) == 2 ? BinaryDtype::uint16
+             : sizeof(U) == 4 ? BinaryDtype::uint32 : BinaryDtype::uint64;
+    }
+}
+
+/// The 128-byte header at the start of every binary file. See the table at the top of this file.
+struct BinaryHeader {
+    char magic[8];
+    std::uint32_t version;
+    BinaryDtype dtype;
+    std::uint32_t element_size;
+    std::uint32_t rank;
+    std::uint64_t rows;
+    std::uint64_t columns;
+    std::int64_t row_stride;
+    std::int64_t col_stride;
+    std::uint64_t alignment;
+    std::uint64_t data_offset;
+    std::uint32_t flags;
+    std::uint8_t reserved[52];
+
+    static constexpr char expected_magic[8] = {'C', 'B', 'R', 'A', 'I', 'N', 'L', 'A'};
+    static constexpr std::uint32_t transposed_flag = 1;
+};
+static_assert(sizeof(BinaryHeader) == 128 && std::is_trivially_copyable_v<BinaryHeader>);
+
+
+/* ------------------------------------------------ Header Handling ------------------------------------------------- */
+
+
+namespace detail {
+
+static_assert(std::endian::native == std::endian::little,
+              "The binary format is little-endian and is only implemented for little-endian hosts");
+
+template<typename U>
+BinaryHeader make_binary_header(std::uint32_t rank, size_t rows, size_t columns, ptrdiff_t row_stride,
+                                ptrdiff_t col_stride, bool transposed) {
+    BinaryHeader header{};
+    std::memcpy(header.magic, BinaryHeader::expected_magic, sizeof(header.magic));
+    header.version = binary_format_version;
+    header.dtype = binary_dtype_of<U>();
+    header.element_size = sizeof(U);
+    header.rank = rank;
+    header.rows = rows;
+    header.columns = columns;
+    header.row_stride = row_stride;
+    header.col_stride = col_stride;
+    header.alignment = storage_alignment;
+    header.data_offset = sizeof(BinaryHeader);
+    header.flags = transposed ? BinaryHeader::transposed_flag : 0;
+    return header;
+}
+
+/**
+ * Checks that a header describes an array of U of the given rank that fits in a file of file_bytes bytes, with strides
+ * that never store two elements in the same place, and returns the number of elements spanned by its strides. Throws
+ * std::runtime_error for a file that is not in the format, is truncated or is corrupt, and std::invalid_argument for
+ * one that holds another element type or rank.
+ */
+template<typename U>
+size_t check_binary_header(const BinaryHeader& header, std::uint32_t rank, size_t file_bytes,
+                           const std::string& path) {
+    if (std::memcmp(header.magic, BinaryHeader::expected_magic, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("\n" + path + " is not a computer_brain binary file\n");
+    }
+    if (header.version == 0 || header.version > binary_format_version) {
+        throw std::runtime_error("\n" + path + " has format version " + std::to_string(header.version) +
+                                 ", this library reads up to version " + std::to_string(binary_format_version) + "\n");
+    }
+    if (header.dtype != binary_dtype_of<U>() || header.element_size != sizeof(U)) {
+        throw std::invalid_argument("\n" + path + " holds elements of dtype " +
+                                    std::to_string((std::uint32_t)header.dtype) + ", not of the requested type\n");
+    }
+    if (header.rank != rank) {
+        throw std::invalid_argument("\n" + path + " holds an array of rank " + std::to_string(header.rank) +
+                                    ", not of rank " + std::to_string(rank) + "\n");
+    }
+    if (header.row_stride < 0 || header.col_stride < 0 || header.data_offset < sizeof(BinaryHeader) ||
+        header.data_offset % alignof(U) != 0 || (rank == 1 && header.rows != 1)) {
+        throw std::runtime_error("\n" + path + " has an invalid header\n");
+    }
+    // 128 bits from here on: a corrupt header must not wrap around to a small size
+    const unsigned __int128 rows = header.rows, columns = header.columns;
+    const unsigned __int128 row_stride = (std::uint64_t)header.row_stride;
+    const unsigned __int128 col_stride = (std::uint64_t)header.col_stride;
+    if (rows * columns > std::numeric_limits<size_t>::max() / sizeof(U) ||
+        (rank == 1 && header.columns > (std::uint64_t)std::numeric_limits<int>::max())) {
+        throw std::runtime_error("\n" + path + " holds a " + std::to_string(header.rows) + " x " +
+                                 std::to_string(header.columns) + " array, too large to load\n");
+    }
+    // a non-empty array stores its rows one after the other, or its columns: no element may be stored twice
+    if (rows != 0 && columns != 0 &&
+        ((rows > 1 && row_stride == 0) || (columns > 1 && col_stride == 0) ||
+         (rows > 1 && columns > 1 && row_stride < columns * col_stride && col_stride < rows * row_stride))) {
+        throw std::runtime_error("\n" + path + " has overlapping strides: row stride " +
+                                 std::to_string(header.row_stride) + ", column stride " +
+                                 std::to_string(header.col_stride) + "\n");
+    }
+    unsigned __int128 span = 0;
+    if (rows != 0 && columns != 0) {
+        span = (rows - 1) * row_stride + (columns - 1) * col_stride + 1;
+    }
+    if (header.data_offset > file_bytes || span > (file_bytes - header.data_offset) / sizeof(U)) {
+        throw std::runtime_error("\n" + path + " is truncated: its header describes more data than the file holds\n");
+    }
+    return (size_t)span;
+}
+
+/// Writes a header and rows x columns elements read through the given strides. Rows with col_stride == 1 are written
+/// in one call each; with row_stride == columns as well, the whole array is written in one call.
+template<typename U>
+void write_binary(const std::string& path, const BinaryHeader& header, const U* data, ptrdiff_t row_stride,
+                  ptrdiff_t col_stride) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("\nCannot open " + path + " for writing\n");
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const size_t rows = header.rows;
+    const size_t columns = header.columns;
+    const size_t file_row = (size_t)header.row_stride;  // elements per row in the file, padding included
+    if (col_stride == 1 && (size_t)row_stride == file_row) {
+        file.write(reinterpret_cast<const char*>(data), (std::streamsize)(rows * file_row * sizeof(U)));
+    } else {
+        std::vector<U> row(file_row, U(0));
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t j = 0; j < columns; ++j) row[j] = data[i * row_stride + j * col_stride];
+            file.write(reinterpret_cast<const char*>(row.data()), (std::streamsize)(file_row * sizeof(U)));
+        }
+    }
+    if (!file) {
+        throw std::runtime_error("\nCannot write " + path + "\n");
+    }
+}
+
+/// Opens a binary file, reads and checks its header, and leaves the stream at the first element.
+template<typename U>
+BinaryHeader read_binary_header(std::ifstream& file, std::uint32_t rank, const std::string& path) {
+    if (!file) {
+        throw std::runtime_error("\nCannot open " + path + " for reading\n");
+    }
+    file.seekg(0, std::ios::end);
+    const size_t file_bytes = (size_t)file.tellg();
+    file.seekg(0, std::ios::beg);
+    BinaryHeader header{};
+    if (file_bytes < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        throw std::runtime_error("\n" + path + " is too short to be a computer_brain binary file\n");
+    }
+    check_binary_header<U>(header, rank, file_bytes, path);
+    file.seekg((std::streamoff)header.data_offset, std::ios::beg);
+    return header;
+}
+
+/// Reads the elements described by header into out, stored row-major with leading dimension ld.
+template<typename U>
+void read_binary_data(std::ifstream& file, const BinaryHeader& header, U* out, size_t ld, const std::string& path) {
+    const size_t rows = header.rows;
+    const size_t columns = header.columns;
+    if (rows == 0 || columns == 0) return;
+    if (header.col_stride == 1 && (size_t)header.row_stride == ld) {  // if: the file has our layout, read it in one go
+        file.read(reinterpret_cast<char*>(out), (std::streamsize)((rows - 1) * ld + columns) * sizeof(U));
+    } else if (header.col_stride == 1) {  // else if: rows are contiguous, read one row at a time
+        for (size_t i = 0; i < rows && file; ++i) {
+            file.seekg((std::streamoff)(header.data_offset + i * header.row_stride * sizeof(U)), std::ios::beg);
+            file.read(reinterpret_cast<char*>(out + i * ld), (std::streamsize)(columns * sizeof(U)));
+        }
+    } else {  // else: any other layout, read the span it covers and gather it
+        std::vector<U> buffer((rows - 1) * header.row_stride + (columns - 1) * header.col_stride + 1);
+        file.read(reinterpret_cast<char*>(buffer.data()), (std::streamsize)(buffer.size() * sizeof(U)));
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t j = 0; j < columns; ++j) {
+                out[i * ld + j] = buffer[i * header.row_stride + j * header.col_stride];
+            }
+        }
+    }
+    if (!file) {
+        throw std::runtime_error("\nCannot read the elements of " + path + "\n");
+    }
+}
+
+}  // namespace detail
+
+
+/* ------------------------------------------------- Save and Load -------------------------------------------------- */
+
+
+/// Saves a Matrix with its storage layout and is_transposed flag.
+template<typename U>
+void save_binary(const std::string& path, const Matrix<U>& matrix) {
+    const BinaryHeader header = detail::make_binary_header<U>(2, matrix.rows(), matrix.columns(),
+                                                              (ptrdiff_t)matrix.ld(), 1, matrix.is_transposed);
+    detail::write_binary(path, header, matrix.data(), (ptrdiff_t)matrix.ld(), 1);
+}
+
+/// Saves the elements of a view as a packed, row-major Matrix that is not transposed.
+template<typename U>
+void save_binary(const std::string& path, const MatrixView<U>& view) {
+    const BinaryHeader header = detail::make_binary_header<std::remove_const_t<U>>(
+            2, view.rows(), view.columns(), (ptrdiff_t)view.columns(), 1, false);
+    detail::write_binary<std::remove_const_t<U>>(path, header, view.data(), view.row_stride(), view.col_stride());
+}
+
+/// Saves a Vector with its is_transposed flag.
+template<typename T>
+void save_binary(const std::string& path, const Vector<T>& vector) {
+    const BinaryHeader header = detail::make_binary_header<T>(1, 1, vector.size(), (ptrdiff_t)vector.size(), 1,
+                                                              vector.is_transposed);
+    detail::write_binary(path, header, vector.data(), (ptrdiff_t)vector.size(), 1);
+}
+
+/**
+ * @brief Reads a Matrix saved by save_binary().
+ *
+ * The Matrix is padded when the file's rows are padded as a padded Matrix would be, and packed otherwise; files written
+ * with any other strides are repacked while they are read.
+ */
+template<typename U>
+Matrix<U> load_matrix(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    const BinaryHeader header = detail::read_binary_header<U>(file, 2, path);
+    const bool padded = header.col_stride == 1 && header.row_stride != (std::int64_t)header.columns &&
+                        header.row_stride == (std::int64_t)padded_leading_dim<U>(header.columns);
+    Matrix<U> matrix(header.rows, header.columns, padded ? MatrixLayout::padded : MatrixLayout::packed);
+    detail::read_binary_data(file, header, matrix.data(), matrix.ld(), path);
+    matrix.is_transposed = (header.flags & BinaryHeader::transposed_flag) != 0;
+    return matrix;
+}
+
+/// Reads a Vector saved by save_binary().
+template<typename T>
+Vector<T> load_vector(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    const BinaryHeader header = detail::read_binary_header<T>(file, 1, path);
+    Vector<T> vector((int)header.columns, T(0));
+    detail::read_binary_data(file, header, vector.data(), header.columns, path);
+    vector.is_transposed = (header.flags & BinaryHeader::transposed_flag) != 0;
+    return vector;
+}
+
+
+/* ----------------------------------------------- Mapped Matrix Class ---------------------------------------------- */
+
+
+/**
+ * @brief A Matrix file mapped read-only into memory.
+ *
+ * view() exposes the elements in place, in the orientation the Matrix was saved in, without copying them; they can be
+ * used wherever a MatrixView<const U> is accepted (expressions, gemm(), operator*). The mapping is shared, so the page
+ * cache holds a single copy of the file however many processes map it. The view is valid for as long as the
+ * MappedMatrix is alive. On systems without mmap the file is read into memory instead.
+ */
+template<typename U>
+class MappedMatrix {
+public:
+    /* Constructors and Destructor */
+    explicit MappedMatrix(const std::string& path);
+    ~MappedMatrix();
+    MappedMatrix(MappedMatrix&& other) noexcept;
+    MappedMatrix& operator=(MappedMatrix&& other) noexcept;
+    MappedMatrix(const MappedMatrix& other) = delete;
+    MappedMatrix& operator=(const MappedMatrix& other) = delete;
+
+    /* Member Functions */
+    size_t rows() const { return view().rows(); }
+    size_t columns() const { return view().columns(); }
+    const U* data() const { return first; }
+    MatrixView<const U> view() const;
+    const BinaryHeader& header() const { return file_header; }
+    size_t mapped_bytes() const { return length; }
+
+private:
+    void unmap() noexcept;
+
+    void* base = nullptr;      // start of the mapping (or of the buffer the file was read into)
+    size_t length = 0;         // size of the mapping in bytes
+    BinaryHeader file_header{};
+    const U* first = nullptr;  // first element, data_offset bytes into the mapping
+};
+
+/// Maps the file at path. Throws as load_matrix() does for a file that is missing, malformed or of another type.
+template<typename U>
+MappedMatrix<U>::MappedMatrix(const std::string& path) {
+#ifdef COMPUTER_BRAIN_HAS_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("\nCannot open " + path + " for reading\n");
+    }
+    struct stat status{};
+    if (::fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(BinaryHeader)) {
+        ::close(fd);
+        throw std::runtime_error("\n" + path + " is too short to be a computer_brain binary file\n");
+    }
+    length = (size_t)status.st_size;
+    base = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // the mapping keeps the file alive
+    if (base == MAP_FAILED) {
+        base = nullptr;
+        throw std::runtime_error("\nCannot map " + path + " into memory\n");
+    }
+    std::memcpy(&file_header, base, sizeof(file_header));
+#else
+    std::ifstream file(path, std::ios::binary);
+    file_header = detail::read_binary_header<U>(file, 2, path);
+    file.seekg(0, std::ios::end);
+    length = (size_t)file.tellg();
+    base = detail::aligned_allocate(length);
+    file.seekg(0, std::ios::beg);
+    if (!file.read(static_cast<char*>(base), (std::streamsize)length)) {
+        unmap();
+        throw std::runtime_error("\nCannot read the elements of " + path + "\n");
+    }
+#endif
+    try {
+        detail::check_binary_header<U>(file_header, 2, length, path);
+    } catch (...) {
+        unmap();
+        throw;
+    }
+    first = reinterpret_cast<const U*>(static_cast<const std::byte*>(base) + file_header.data_offset);
+}
+
+/// MappedMatrix.view() returns the mapped elements, transposed if the Matrix was saved with is_transposed set.
+template<typename U>
+MatrixView<const U> MappedMatrix<U>::view() const {
+    const MatrixView<const U> stored(first, file_header.rows, file_header.columns, (ptrdiff_t)file_header.row_stride,
+                                     (ptrdiff_t)file_header.col_stride);
+    return file_header.flags & BinaryHeader::transposed_flag ? stored.t() : stored;
+}
+
+template<typename U>
+MappedMatrix<U>::~MappedMatrix() { unmap(); }
+
+template<typename U>
+MappedMatrix<U>::MappedMatrix(MappedMatrix&& other) noexcept
+    : base(other.base), length(other.length), file_header(other.file_header), first(other.first) {
+    other.base = nullptr;
+    other.length = 0;
+    other.file_header = BinaryHeader{};
+    other.first = nullptr;
+}
+
+template<typename U>
+MappedMatrix<U>& MappedMatrix<U>::operator=(MappedMatrix&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        base = other.base;
+        length = other.length;
+        file_header = other.file_header;
+        first = other.first;
+        other.base = nullptr;
+        other.length = 0;
+        other.file_header = BinaryHeader{};
+        other.first = nullptr;
+    }
+    return *this;
+}
+
+template<typename U>
+void MappedMatrix<U>::unmap() noexcept {
+    if (base == nullptr) return;
+#ifdef COMPUTER_BRAIN_HAS_MMAP
+    ::munmap(base, length);
+#else
+    detail::aligned_deallocate(base);
+#endif
+    base = nullptr;
+}
+
+
+#endif //COMPUTER_BRAIN_BINARY_IO_H
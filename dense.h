@@ -0,0 +1,409 @@
+#ifndef COMPUTER_BRAIN_DENSE_H
+#define COMPUTER_BRAIN_DENSE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "elementwise.h"
+#include "expression.h"
+#include "gemm.h"
+#include "instrument.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "view.h"
+
+/*
+ * Fused dense (fully connected) layers.
+ *
+ *   dense_forward()    Y = f(scale * X * W + b) in a single pass over Y
+ *   dense_backward()   the gradients with respect to X, W and b, given the gradient with respect to Y
+ *   DenseLayer         W and b together with the buffers of the two passes, reused from one call to the next
+ *
+ * X holds one sample per row (batch x inputs), W is inputs x outputs, b has one element per output and is added to
+ * every row, and f is one of the Activations below. Computed as Matrix * Matrix, then + b, then f, the layer would make
+ * three passes over Y. dense_forward() instead hands the bias and the activation to the packed GEMM as an epilogue
+ * (see gemm_blocked() in gemm.h): each block of Y gets them as soon as its last multiply-add is done, while the block
+ * is still in cache. Products too small for the packed GEMM are computed first and finished in a second pass, which
+ * at those sizes runs on data that is still in cache anyway. Sigmoid, tanh and GELU use the SIMD functions of
+ * elementwise.h, a vector register at a time.
+ *
+ * The backward pass computes the gradient with respect to the pre-activation, dZ = dY * f'(Z), and the bias gradient
+ * db (the column sums of dZ) in one pass, then dW = scale * X^T * dZ and dX = scale * dZ * W^T with gemm(). f'(Z) is
+ * recovered from the output Y for every activation except GELU, which needs the pre-activation Z itself:
+ * dense_forward() can save it on the way.
+ */
+
+/// The activation functions a dense layer can apply.
+enum class Activation {
+    identity,  // f(z) = z
+    relu,      // f(z) = max(z, 0)
+    gelu,      // f(z) = z * Phi(z), with the tanh approximation 0.5 * z * (1 + tanh(sqrt(2 / pi) * (z + 0.044715 z^3)))
+    sigmoid,   // f(z) = 1 / (1 + exp(-z))
+    tanh,      // f(z) = tanh(z)
+};
+
+
+/* -------------------------------------------------- Activations --------------------------------------------------- */
+
+
+namespace detail {
+
+/// out = f(z) for the activation F, on a single element or a whole vector register (see elementwise.h). The result
+/// is written through a reference, so that no vector register crosses a function boundary.
+template<Activation F, typename V>
+__attribute__((always_inline)) inline void activate(V& out, const V& z) {
+    using T = typename MathLane<V>::type;
+    if constexpr (F == Activation::identity) {
+        out = z;
+    } else if constexpr (F == Activation::relu) {
+        out = z > T(0) ? z : V{};
+    } else if constexpr (F == Activation::gelu) {
+        V t;
+        vector_tanh(t, T(0.7978845608028654) * (z + T(0.044715) * z * z * z));
+        out = T(0.5) * z * (T(1) + t);
+    } else if constexpr (F == Activation::sigmoid) {
+        vector_sigmoid(out, z);
+    } else {
+        vector_tanh(out, z);
+    }
+}
+
+/// f'(z) for the activation F, from `saved`: the pre-activation z for GELU, the output f(z) for the others.
+template<Activation F, typename T>
+__attribute__((always_inline)) inline T activation_derivative(T saved) {
+    if constexpr (F == Activation::identity) {
+        return T(1);
+    } else if constexpr (F == Activation::relu) {
+        return saved > T(0) ? T(1) : T(0);
+    } else if constexpr (F == Activation::gelu) {
+        const T z = saved;
+        T t;
+        vector_tanh(t, T(0.7978845608028654) * (z + T(0.044715) * z * z * z));
+        return T(0.5) * (T(1) + t) + T(0.5) * z * (T(1) - t * t) * T(0.7978845608028654) *
+               (T(1) + T(3 * 0.044715) * z * z);
+    } else if constexpr (F == Activation::sigmoid) {
+        return saved * (T(1) - saved);
+    } else {
+        return T(1) - saved * saved;
+    }
+}
+
+/// Calls body.template operator()<F>() with the Activation known at compile time, so that its loops are specialised.
+template<typename Body>
+void with_activation(Activation activation, Body&& body) {
+    switch (activation) {
+        case Activation::identity: body.template operator()<Activation::identity>(); break;
+        case Activation::relu: body.template operator()<Activation::relu>(); break;
+        case Activation::gelu: body.template operator()<Activation::gelu>(); break;
+        case Activation::sigmoid: body.template operator()<Activation::sigmoid>(); break;
+        case Activation::tanh: body.template operator()<Activation::tanh>(); break;
+    }
+}
+
+/// y[j] = f(y[j] + b[j]) for j in [0, n), saving y[j] + b[j] in z[j]; b and z may be null.
+template<typename T, Activation F>
+struct DenseFinishKernel {
+    template<int Bytes> __attribute__((always_inline)) static inline void run(T* y, const T* b, T* z, size_t n) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        size_t j = 0;
+        for (; j + W <= n; j += W) {
+            vec value, bias;
+            std::memcpy(&value, y + j, sizeof(vec));
+            if (b != nullptr) {
+                std::memcpy(&bias, b + j, sizeof(vec));
+                value += bias;
+            }
+            if (z != nullptr) std::memcpy(z + j, &value, sizeof(vec));
+            vec result;
+            activate<F>(result, value);
+            std::memcpy(y + j, &result, sizeof(vec));
+        }
+        for (; j < n; ++j) {
+            T value = y[j];
+            if (b != nullptr) value += b[j];
+            if (z != nullptr) z[j] = value;
+            activate<F>(y[j], value);
+        }
+    }
+};
+
+/**
+ * The epilogue of dense_forward(): on a block of Y that holds scale * X * W, adds the bias, saves the pre-activation
+ * if z is not null, and applies the activation. Usable as the epilogue of gemm_blocked().
+ */
+template<typename T>
+struct DenseEpilogue {
+    const T* bias;  // null for no bias
+    ptrdiff_t inc_bias;
+    Activation activation;
+    T* y;
+    ptrdiff_t rs_y, cs_y;
+    T* z;  // null when the pre-activation is not saved
+    ptrdiff_t rs_z, cs_z;
+
+    void operator()(size_t first_row, size_t first_column, size_t rows, size_t columns) const {
+        with_activation(activation, [&]<Activation F>() {
+            const bool contiguous = cs_y == 1 && (bias == nullptr || inc_bias == 1) && (z == nullptr || cs_z == 1);
+            for (size_t i = first_row; i < first_row + rows; ++i) {
+                T* y_row = y + i * rs_y + first_column * cs_y;
+                T* z_row = z == nullptr ? nullptr : z + i * rs_z + first_column * cs_z;
+                const T* b = bias == nullptr ? nullptr : bias + first_column * inc_bias;
+                if (contiguous) {  // if: everything is contiguous, keep the strides out of the loop so it vectorizes
+                    finish<F>(columns, y_row, 1, b, 1, z_row, 1);
+                } else {
+                    finish<F>(columns, y_row, cs_y, b, inc_bias, z_row, cs_z);
+                }
+            }
+        });
+    }
+
+    template<Activation F>
+    __attribute__((always_inline)) static inline void finish(size_t n, T* y, ptrdiff_t incy, const T* b,
+                                                             ptrdiff_t incb, T* z, ptrdiff_t incz) {
+        if (incy == 1 && incb == 1 && incz == 1) {  // if: contiguous, finish a vector register at a time
+            simd_dispatch<T, DenseFinishKernel<T, F>>(y, b, z, n);
+            return;
+        }
+        for (size_t j = 0; j < n; ++j) {
+            T value = y[j * incy];
+            if (b != nullptr) value += b[j * incb];
+            if (z != nullptr) z[j * incz] = value;
+            activate<F>(y[j * incy], value);
+        }
+    }
+};
+
+/// The shape checks of dense_forward() and dense_backward().
+template<typename U>
+void require_dense_shapes(const MatrixView<const U>& x, const MatrixView<const U>& w, size_t bias_size,
+                          size_t y_rows, size_t y_columns, const char* operand) {
+    if (x.columns() != w.rows() || (bias_size != 0 && bias_size != w.columns()) || y_rows != x.rows() ||
+        y_columns != w.columns()) {
+        throw std::invalid_argument("\nThe dense layer cannot be computed: X is " + std::to_string(x.rows()) + " x " +
+                                    std::to_string(x.columns()) + ", W is " + std::to_string(w.rows()) + " x " +
+                                    std::to_string(w.columns()) + ", b has " + std::to_string(bias_size) +
+                                    " elements and " + operand + " is " + std::to_string(y_rows) + " x " +
+                                    std::to_string(y_columns) + "\n");
+    }
+}
+
+/// dense_forward(), with the pre-activation saved through z unless it is null.
+template<typename U>
+void dense_forward(U scale, const MatrixView<const U>& x, const MatrixView<const U>& w, const VectorView<const U>& bias,
+                   Activation activation, const MatrixView<U>& y, U* z, ptrdiff_t rs_z, ptrdiff_t cs_z) {
+    static_assert(std::is_same_v<U, float> || std::is_same_v<U, double>, "Dense layers need float or double elements");
+    require_dense_shapes(x, w, bias.size(), y.rows(), y.columns(), "Y");
+    const size_t m = x.rows();
+    const size_t n = w.columns();
+    const size_t k = x.columns();
+    if (m == 0 || n == 0) {
+        return;
+    }
+    COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::gemm, (OpShape{{m, n, k}, 3}), 2 * m * n * k,
+                                 (m * k + k * n + (z == nullptr ? 1 : 2) * m * n) * sizeof(U));
+    const DenseEpilogue<U> epilogue{bias.size() == 0 ? nullptr : bias.data(), bias.stride(), activation,
+                                    y.data(), y.row_stride(), y.col_stride(), z, rs_z, cs_z};
+    // the products gemm() sends to the packed kernel get the epilogue fused into it
+    const bool packed = m > 1 && n > 1 && k > 0 &&
+                        !(m * n * k <= gemm_small_threshold && w.col_stride() == 1 && y.col_stride() == 1);
+    if (packed) {
+        gemm_blocked(m, n, k, scale, x.data(), x.row_stride(), x.col_stride(), w.data(), w.row_stride(),
+                     w.col_stride(), U(0), y.data(), y.row_stride(), y.col_stride(), epilogue);
+        return;
+    }
+    gemm<U>(m, n, k, scale, x.data(), x.row_stride(), x.col_stride(), w.data(), w.row_stride(), w.col_stride(), U(0),
+            y.data(), y.row_stride(), y.col_stride());
+    parallel_for(0, m, std::max<size_t>(1, elementwise_parallel_grain / n), [&](size_t first, size_t last) {
+        epilogue(first, 0, last - first, n);
+    });
+}
+
+}  // namespace detail
+
+
+/* -------------------------------------------------- Dense Layers -------------------------------------------------- */
+
+
+/**
+ * @brief Y = f(scale * X * W + b), with the bias and the activation applied in the epilogue of the product.
+ *
+ * X is batch x inputs, W inputs x outputs and Y batch x outputs; b has one element per output, or none for a layer
+ * without bias. Any views can be used, transposed ones included. Y must not overlap X or W.
+ */
+template<typename U>
+void dense_forward(U scale, const std::type_identity_t<MatrixView<const U>>& x,
+                   const std::type_identity_t<MatrixView<const U>>& w,
+                   const std::type_identity_t<VectorView<const U>>& bias, Activation activation,
+                   const std::type_identity_t<MatrixView<U>>& y) {
+    detail::dense_forward<U>(scale, x, w, bias, activation, y, nullptr, 0, 0);
+}
+
+/// dense_forward() that also writes the pre-activation scale * X * W + b into z, as dense_backward() needs for GELU.
+template<typename U>
+void dense_forward(U scale, const std::type_identity_t<MatrixView<const U>>& x,
+                   const std::type_identity_t<MatrixView<const U>>& w,
+                   const std::type_identity_t<VectorView<const U>>& bias, Activation activation,
+                   const std::type_identity_t<MatrixView<U>>& y, const std::type_identity_t<MatrixView<U>>& z) {
+    detail::require_dense_shapes<U>(x, w, bias.size(), z.rows(), z.columns(), "Z");
+    detail::dense_forward<U>(scale, x, w, bias, activation, y, z.data(), z.row_stride(), z.col_stride());
+}
+
+/**
+ * @brief The backward pass of dense_forward(): given dY, computes dX, dW and db.
+ *
+ * `saved` is what f'(Z) is recovered from: the output Y of dense_forward(), or for GELU the pre-activation Z it saved.
+ * dX, dW and db are overwritten; an empty dX (0 x 0) or db (no elements) is not computed, as for the first layer of a
+ * network or a layer without bias. dZ is kept in a per-thread buffer that is reused from one call to the next, so the
+ * backward pass does not allocate once it has run at a given size.
+ */
+template<typename U>
+void dense_backward(U scale, const std::type_identity_t<MatrixView<const U>>& x,
+                    const std::type_identity_t<MatrixView<const U>>& w, Activation activation,
+                    const std::type_identity_t<MatrixView<const U>>& saved,
+                    const std::type_identity_t<MatrixView<const U>>& dy,
+                    const std::type_identity_t<MatrixView<U>>& dx, const std::type_identity_t<MatrixView<U>>& dw,
+                    const std::type_identity_t<VectorView<U>>& db) {
+    static_assert(std::is_same_v<U, float> || std::is_same_v<U, double>, "Dense layers need float or double elements");
+    detail::require_dense_shapes<U>(x, w, db.size(), dy.rows(), dy.columns(), "dY");
+    detail::require_dense_shapes<U>(x, w, db.size(), saved.rows(), saved.columns(), "the saved output");
+    const bool input_gradient = dx.rows() != 0 || dx.columns() != 0;
+    if ((input_gradient && (dx.rows() != x.rows() || dx.columns() != x.columns())) || dw.rows() != w.rows() ||
+        dw.columns() != w.columns()) {
+        throw std::invalid_argument("\nThe gradients of a dense layer must have the shapes of X and W: dX is " +
+                                    std::to_string(dx.rows()) + " x " + std::to_string(dx.columns()) + " and dW " +
+                                    std::to_string(dw.rows()) + " x " + std::to_string(dw.columns()) + "\n");
+    }
+    const size_t m = dy.rows();
+    const size_t n = dy.columns();
+    detail::GemmScratch<U> delta_buffer(m * n);
+    U* delta = delta_buffer.data();
+    // dZ and db in one pass; each task owns whole columns, so db is summed in the same order on any number of threads
+    parallel_for(0, n, std::max<size_t>(16, elementwise_parallel_grain / std::max<size_t>(m, 1)),
+                 [&](size_t first, size_t last) {
+        detail::with_activation(activation, [&]<Activation F>() {
+            for (size_t j = first; j < last; ++j) {
+                if (db.size() != 0) db[j] = U(0);
+            }
+            for (size_t i = 0; i < m; ++i) {
+                U* delta_row = delta + i * n;
+                for (size_t j = first; j < last; ++j) {
+                    delta_row[j] = dy(i, j) * detail::activation_derivative<F>(saved(i, j));
+                }
+                if (db.size() != 0) {
+                    for (size_t j = first; j < last; ++j) db[j] += delta_row[j];
+                }
+            }
+        });
+    });
+    const MatrixView<const U> dz(delta, m, n, (ptrdiff_t)n, 1);
+    gemm<U>(scale, x.t(), dz, U(0), dw);
+    if (input_gradient) {
+        gemm<U>(scale, dz, w.t(), U(0), dx);
+    }
+}
+
+
+/* ------------------------------------------------ DenseLayer Class ------------------------------------------------ */
+
+
+namespace detail {
+
+/// Gives `buffer` the shape rows x columns, keeping its storage when it already has that shape.
+template<typename U>
+void dense_buffer(Matrix<U>& buffer, size_t rows, size_t columns) {
+    if (buffer.is_transposed || buffer.rows() != rows || buffer.columns() != columns) {
+        buffer = Matrix<U>(rows, columns);
+    }
+}
+
+}  // namespace detail
+
+/**
+ * @brief A dense layer Y = f(scale * X * W + b) that owns W and b, and the buffers of its forward and backward passes.
+ *
+ * forward() and backward() return references to buffers of the layer, which are reallocated only when the batch size
+ * changes: a training loop over batches of one size allocates nothing after its first step. forward() keeps a pointer
+ * to its input for backward(), so that input must stay alive (and unchanged) until backward() has run.
+ */
+template<typename U>
+class DenseLayer {
+public:
+    /* Constructors */
+    DenseLayer(Matrix<U> weights, Vector<U> bias, Activation activation = Activation::identity, U scale = U(1));
+
+    /* Member Variables */
+    Matrix<U> weights;          // inputs x outputs
+    Vector<U> bias;             // one element per output
+    Activation activation;
+    U scale;
+    Matrix<U> weight_gradient;  // dW of the last backward()
+    Vector<U> bias_gradient;    // db of the last backward()
+
+    /* Member Functions */
+    const Matrix<U>& forward(const Matrix<U>& input);
+    const Matrix<U>& backward(const Matrix<U>& output_gradient);
+
+private:
+    const Matrix<U>* last_input = nullptr;  // the input of the last forward()
+    Matrix<U> output;
+    Matrix<U> pre_activation;   // only kept for GELU
+    Matrix<U> input_gradient;
+};
+
+/// Builds a layer from its weights (inputs x outputs, in their current orientation) and bias (one element per output).
+template<typename U>
+DenseLayer<U>::DenseLayer(Matrix<U> weights, Vector<U> bias, Activation activation, U scale)
+    : weights(std::move(weights)), bias(std::move(bias)), activation(activation), scale(scale),
+      weight_gradient(0, 0), bias_gradient(0, U(0)), output(0, 0), pre_activation(0, 0), input_gradient(0, 0) {
+    if (this->bias.size() != this->weights.view().columns()) {
+        throw std::invalid_argument("\nThe bias of a dense layer needs one element per output: the weights have " +
+                                    std::to_string(this->weights.view().columns()) + " outputs and the bias " +
+                                    std::to_string(this->bias.size()) + " elements\n");
+    }
+}
+
+/// DenseLayer.forward() computes f(scale * input * weights + bias), one sample per row of input.
+template<typename U>
+const Matrix<U>& DenseLayer<U>::forward(const Matrix<U>& input) {
+    const MatrixView<const U> x = input.view();
+    const MatrixView<const U> w = weights.view();
+    detail::dense_buffer(output, x.rows(), w.columns());
+    if (activation == Activation::gelu) {
+        detail::dense_buffer(pre_activation, x.rows(), w.columns());
+        dense_forward<U>(scale, x, w, bias.view(), activation, output.view(), pre_activation.view());
+    } else {
+        dense_forward<U>(scale, x, w, bias.view(), activation, output.view());
+    }
+    last_input = &input;
+    return output;
+}
+
+/**
+ * DenseLayer.backward() takes the gradient of the loss with respect to the output of the last forward(), sets
+ * weight_gradient and bias_gradient, and returns the gradient with respect to the input of that forward().
+ */
+template<typename U>
+const Matrix<U>& DenseLayer<U>::backward(const Matrix<U>& output_gradient) {
+    if (last_input == nullptr) {
+        throw std::runtime_error("\nDenseLayer.backward() needs the results of a forward() first\n");
+    }
+    const MatrixView<const U> x = last_input->view();
+    const MatrixView<const U> w = weights.view();
+    detail::dense_buffer(weight_gradient, w.rows(), w.columns());
+    detail::dense_buffer(input_gradient, x.rows(), x.columns());
+    if (bias_gradient.size() != w.columns()) {
+        bias_gradient = Vector<U>((int)w.columns(), U(0));
+    }
+    const Matrix<U>& saved = activation == Activation::gelu ? pre_activation : output;
+    dense_backward<U>(scale, x, w, activation, saved.view(), output_gradient.view(), input_gradient.view(),
+                      weight_gradient.view(), bias_gradient.view());
+    return input_gradient;
+}
+
+
+#endif //COMPUTER_BRAIN_DENSE_H
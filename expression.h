@@ -0,0 +1,571 @@
+#ifndef COMPUTER_BRAIN_EXPRESSION_H
+#define COMPUTER_BRAIN_EXPRESSION_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "instrument.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+/*
+ * Expression templates for elementwise Vector and Matrix arithmetic.
+ *
+ * a + b, a - b, a * scalar, scalar * a and a / scalar do not compute anything. They return a small node that
+ * remembers its operands; a node can be the operand of another node, so `a + b - c * 2.0` builds a tree. The work is
+ * done when the tree is assigned to (or used to construct) a Vector or Matrix: one loop walks the output once and
+ * evaluates the whole tree per element, so no intermediate Vector or Matrix is ever allocated and every operand is
+ * read exactly once.
+ *
+ * That loop is run through the SIMD dispatch of simd.h: every node can also produce a whole vector register of
+ * results (load()), so the fused loop runs at the width of the widest instruction set of the CPU. Long loops are split
+ * across the thread pool.
+ *
+ * Vector and Matrix operands enter a node as views (view.h), so every kernel reads its operands through strides and a
+ * transposed Matrix is just a view whose strides are swapped. Nodes hold those views, which point into the operands:
+ * a node must therefore not outlive its operands. Assign it to a Vector or Matrix (or call eval()) in the statement
+ * that creates it, rather than keeping it in an `auto` variable.
+ */
+
+/// Extent of a Vector or Matrix whose size is only known at run time. Vector<T> and Matrix<U> have dynamic extents.
+inline constexpr size_t dynamic_size = size_t(-1);
+
+template<typename T, size_t N = dynamic_size> class Vector;
+template<typename U, size_t R = dynamic_size, size_t C = dynamic_size> class Matrix;
+template<typename T> class VectorView;
+template<typename U> class MatrixView;
+
+/// Elementwise operations on fewer elements than this run serially; larger ones are split across the thread pool.
+inline constexpr size_t elementwise_parallel_grain = size_t(1) << 15;
+
+
+/* ---------------------------------------- Elementwise Operation Functors ------------------------------------------ */
+
+
+namespace detail {
+
+/*
+ * apply() is used both on single elements and on whole vector registers (GCC vector extensions), so the same node
+ * code serves the scalar tail and the vectorised body of the fused loop. The result is written through a reference
+ * rather than returned, so that no vector register ever crosses a function boundary.
+ */
+struct AddOp {
+    static constexpr const char* verb = "add";
+    static constexpr OpKind kind = OpKind::add;
+    template<typename R, typename A, typename B> __attribute__((always_inline)) static void apply(R& out, const A& a,
+                                                                                    const B& b) {
+        out = a + b;
+    }
+};
+struct SubOp {
+    static constexpr const char* verb = "subtract";
+    static constexpr OpKind kind = OpKind::sub;
+    template<typename R, typename A, typename B> __attribute__((always_inline)) static void apply(R& out, const A& a,
+                                                                                    const B& b) {
+        out = a - b;
+    }
+};
+struct MulOp {
+    static constexpr OpKind kind = OpKind::scale;
+    template<typename R, typename A, typename B> __attribute__((always_inline)) static void apply(R& out, const A& a,
+                                                                                    const B& b) {
+        out = a * b;
+    }
+};
+struct DivOp {
+    static constexpr OpKind kind = OpKind::scale;
+    template<typename R, typename A, typename B> __attribute__((always_inline)) static void apply(R& out, const A& a,
+                                                                                    const B& b) {
+        out = a / b;
+    }
+};
+
+/// Vector and Matrix operands are held as views of their elements; views and expression nodes are held by value.
+template<typename E> struct expression_ref { using type = const E; };
+template<typename T> struct expression_ref<Vector<T>> { using type = const VectorView<const T>; };
+template<typename U> struct expression_ref<Matrix<U>> { using type = const MatrixView<const U>; };
+
+/// Turns an operand into what a node holds: a view for a Vector or a Matrix, the operand itself otherwise.
+template<typename E> const E& as_operand(const E& expr) { return expr; }
+template<typename T> VectorView<const T> as_operand(const Vector<T>& vector) { return vector.view(); }
+template<typename U> MatrixView<const U> as_operand(const Matrix<U>& matrix) { return matrix.view(); }
+
+}  // namespace detail
+
+
+/* ------------------------------------------- Vector Expression Nodes ---------------------------------------------- */
+
+
+/**
+ * @brief Base class of everything that can appear in an elementwise Vector expression, Vector itself included.
+ *
+ * A Vector expression E provides: value_type; size(); transposed() (its orientation); operator[](i) (element i);
+ * contiguous() (true when every operand is read with stride 1); load(i, v) (elements i .. i + lanes of v into the
+ * vector register v, only used when contiguous()); and aliases(lo, hi, data, stride) (whether it reads memory in
+ * [lo, hi) through any layout other than the output's own). A Vector is turned into a VectorView before any of these
+ * are called.
+ */
+template<typename E>
+class VectorExpression {
+public:
+    const E& self() const { return static_cast<const E&>(*this); }
+
+    /// Evaluates the expression into a new Vector.
+    auto eval() const { return Vector<typename E::value_type>(self()); }
+};
+
+/// Elementwise binary operation between two Vector expressions.
+template<typename L, typename R, typename Op>
+class VectorBinary : public VectorExpression<VectorBinary<L, R, Op>> {
+private:
+    typename detail::expression_ref<L>::type left;
+    typename detail::expression_ref<R>::type right;
+    bool orientation;
+public:
+    using value_type = typename L::value_type;
+
+    /**
+     * Two Vectors can be combined elementwise when they have the same size and orientation; the result has that
+     * orientation. Two Vectors of one element each can be combined whatever their orientation, and the result is not
+     * transposed. Any other pair throws std::invalid_argument.
+     */
+    VectorBinary(const L& left, const R& right) : left(detail::as_operand(left)), right(detail::as_operand(right)) {
+        if (this->left.transposed() == this->right.transposed() && this->left.size() == this->right.size()) {
+            orientation = this->left.transposed();
+        } else if (this->left.size() == 1 && this->right.size() == 1) {
+            orientation = false;
+        } else {
+            throw std::invalid_argument(std::string("\nEither: (a) The vectors you attempted to ") + Op::verb +
+                                        " have different orientation\n"
+                                        "        (b) The Vectors you attempted to " + Op::verb +
+                                        " have different sizes\n"
+                                        "        (c) Both\n");
+        }
+    }
+
+    size_t size() const { return left.size(); }
+    bool transposed() const { return orientation; }
+    value_type operator[](size_t i) const {
+        value_type out;
+        Op::apply(out, left[i], right[i]);
+        return out;
+    }
+    bool contiguous() const { return left.contiguous() && right.contiguous(); }
+    template<typename V> __attribute__((always_inline)) inline void load(size_t i, V& out) const {
+        V l, r;
+        left.load(i, l);
+        right.load(i, r);
+        Op::apply(out, l, r);
+    }
+    bool aliases(const void* lo, const void* hi, const void* data, ptrdiff_t stride) const {
+        return left.aliases(lo, hi, data, stride) || right.aliases(lo, hi, data, stride);
+    }
+};
+
+/// Elementwise operation between a Vector expression and a scalar (multiplication or division).
+template<typename E, typename Op>
+class VectorScalar : public VectorExpression<VectorScalar<E, Op>> {
+public:
+    using value_type = typename E::value_type;
+private:
+    typename detail::expression_ref<E>::type expr;
+    value_type scalar;
+public:
+    VectorScalar(const E& expr, const value_type& scalar) : expr(detail::as_operand(expr)), scalar(scalar) { }
+
+    size_t size() const { return expr.size(); }
+    bool transposed() const { return expr.transposed(); }
+    value_type operator[](size_t i) const {
+        value_type out;
+        Op::apply(out, expr[i], scalar);
+        return out;
+    }
+    bool contiguous() const { return expr.contiguous(); }
+    template<typename V> __attribute__((always_inline)) inline void load(size_t i, V& out) const {
+        V v;
+        expr.load(i, v);
+        Op::apply(out, v, scalar);
+    }
+    bool aliases(const void* lo, const void* hi, const void* data, ptrdiff_t stride) const {
+        return expr.aliases(lo, hi, data, stride);
+    }
+};
+
+/**
+ * @brief A function applied to every element of a Vector expression (exp(), tanh(), map() and the others of
+ * elementwise.h).
+ *
+ * Op is held by value, so it may carry parameters; its apply(out, x) is called on single elements and on whole vector
+ * registers, like the apply() of the binary operations.
+ */
+template<typename E, typename Op>
+class VectorUnary : public VectorExpression<VectorUnary<E, Op>> {
+public:
+    using value_type = typename E::value_type;
+private:
+    typename detail::expression_ref<E>::type expr;
+    Op op;
+public:
+    VectorUnary(const E& expr, const Op& op) : expr(detail::as_operand(expr)), op(op) { }
+
+    size_t size() const { return expr.size(); }
+    bool transposed() const { return expr.transposed(); }
+    value_type operator[](size_t i) const {
+        value_type out;
+        op.apply(out, expr[i]);
+        return out;
+    }
+    bool contiguous() const { return expr.contiguous(); }
+    template<typename V> __attribute__((always_inline)) inline void load(size_t i, V& out) const {
+        V v;
+        expr.load(i, v);
+        op.apply(out, v);
+    }
+    bool aliases(const void* lo, const void* hi, const void* data, ptrdiff_t stride) const {
+        return expr.aliases(lo, hi, data, stride);
+    }
+};
+
+
+/* ------------------------------------------- Matrix Expression Nodes ---------------------------------------------- */
+
+
+/**
+ * @brief Base class of everything that can appear in an elementwise Matrix expression, Matrix itself included.
+ *
+ * A Matrix expression E provides: value_type; logical_rows() and logical_columns() (its shape once orientation is
+ * taken into account); logical_at(i, j) (element (i, j) of that shape); contiguous() (true when row i of the result
+ * can be read straight from row i of every operand, i.e. every operand has a column stride of 1); load(i, j, v)
+ * (elements (i, j .. j + lanes) into the vector register v, only used when contiguous()); and
+ * aliases(lo, hi, data, row_stride, col_stride). A Matrix is turned into a MatrixView before any of these are called.
+ */
+template<typename E>
+class MatrixExpression {
+public:
+    const E& self() const { return static_cast<const E&>(*this); }
+
+    /// Evaluates the expression into a new Matrix.
+    auto eval() const { return Matrix<typename E::value_type>(self()); }
+};
+
+/// Elementwise binary operation between two Matrix expressions.
+template<typename L, typename R, typename Op>
+class MatrixBinary : public MatrixExpression<MatrixBinary<L, R, Op>> {
+private:
+    typename detail::expression_ref<L>::type left;
+    typename detail::expression_ref<R>::type right;
+public:
+    using value_type = typename L::value_type;
+
+    /**
+     * Both operands are read in their current orientation, so an MxN Matrix can be combined with an MxN Matrix, or
+     * with an NxM Matrix that is transposed. Any other pair throws std::invalid_argument.
+     */
+    MatrixBinary(const L& left, const R& right) : left(detail::as_operand(left)), right(detail::as_operand(right)) {
+        if (this->left.logical_rows() != this->right.logical_rows() ||
+            this->left.logical_columns() != this->right.logical_columns()) {
+            throw std::invalid_argument(std::string("\nEither: (a) The matrices you attempted to ") + Op::verb +
+                                        " have different orientation\n"
+                                        "        (b) The matrices you attempted to " + Op::verb +
+                                        " have different sizes\n"
+                                        "        (c) Both\n");
+        }
+    }
+
+    size_t logical_rows() const { return left.logical_rows(); }
+    size_t logical_columns() const { return left.logical_columns(); }
+    value_type logical_at(size_t i, size_t j) const {
+        value_type out;
+        Op::apply(out, left.logical_at(i, j), right.logical_at(i, j));
+        return out;
+    }
+    bool contiguous() const { return left.contiguous() && right.contiguous(); }
+    template<typename V> __attribute__((always_inline)) inline void load(size_t i, size_t j, V& out) const {
+        V l, r;
+        left.load(i, j, l);
+        right.load(i, j, r);
+        Op::apply(out, l, r);
+    }
+    bool aliases(const void* lo, const void* hi, const void* data, ptrdiff_t row_stride, ptrdiff_t col_stride) const {
+        return left.aliases(lo, hi, data, row_stride, col_stride) ||
+               right.aliases(lo, hi, data, row_stride, col_stride);
+    }
+};
+
+/// Elementwise operation between a Matrix expression and a scalar (multiplication or division).
+template<typename E, typename Op>
+class MatrixScalar : public MatrixExpression<MatrixScalar<E, Op>> {
+public:
+    using value_type = typename E::value_type;
+private:
+    typename detail::expression_ref<E>::type expr;
+    value_type scalar;
+public:
+    MatrixScalar(const E& expr, const value_type& scalar) : expr(detail::as_operand(expr)), scalar(scalar) { }
+
+    size_t logical_rows() const { return expr.logical_rows(); }
+    size_t logical_columns() const { return expr.logical_columns(); }
+    value_type logical_at(size_t i, size_t j) const {
+        value_type out;
+        Op::apply(out, expr.logical_at(i, j), scalar);
+        return out;
+    }
+    bool contiguous() const { return expr.contiguous(); }
+    template<typename V> __attribute__((always_inline)) inline void load(size_t i, size_t j, V& out) const {
+        V v;
+        expr.load(i, j, v);
+        Op::apply(out, v, scalar);
+    }
+    bool aliases(const void* lo, const void* hi, const void* data, ptrdiff_t row_stride, ptrdiff_t col_stride) const {
+        return expr.aliases(lo, hi, data, row_stride, col_stride);
+    }
+};
+
+/// A function applied to every element of a Matrix expression. See VectorUnary.
+template<typename E, typename Op>
+class MatrixUnary : public MatrixExpression<MatrixUnary<E, Op>> {
+public:
+    using value_type = typename E::value_type;
+private:
+    typename detail::expression_ref<E>::type expr;
+    Op op;
+public:
+    MatrixUnary(const E& expr, const Op& op) : expr(detail::as_operand(expr)), op(op) { }
+
+    size_t logical_rows() const { return expr.logical_rows(); }
+    size_t logical_columns() const { return expr.logical_columns(); }
+    value_type logical_at(size_t i, size_t j) const {
+        value_type out;
+        op.apply(out, expr.logical_at(i, j));
+        return out;
+    }
+    bool contiguous() const { return expr.contiguous(); }
+    template<typename V> __attribute__((always_inline)) inline void load(size_t i, size_t j, V& out) const {
+        V v;
+        expr.load(i, j, v);
+        op.apply(out, v);
+    }
+    bool aliases(const void* lo, const void* hi, const void* data, ptrdiff_t row_stride, ptrdiff_t col_stride) const {
+        return expr.aliases(lo, hi, data, row_stride, col_stride);
+    }
+};
+
+
+/* ------------------------------------------------ Fused Evaluation ------------------------------------------------ */
+
+
+namespace detail {
+
+/// The fused loop for a Vector expression: out[i] = expr[i] for i in [first, last), a vector register at a time.
+template<typename E>
+struct FusedVectorAssign {
+    using T = typename E::value_type;
+    template<int Bytes> __attribute__((always_inline)) static inline void run(const E* expr, T* out, size_t first,
+                                                                              size_t last) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        size_t i = first;
+        for (; i + W <= last; i += W) {
+            vec v;
+            expr->load(i, v);
+            std::memcpy(out + i, &v, sizeof(vec));
+        }
+        for (; i < last; ++i) out[i] = (*expr)[i];
+    }
+};
+
+/// The fused loop for a Matrix expression whose operands are all read along their rows.
+template<typename E>
+struct FusedMatrixAssign {
+    using T = typename E::value_type;
+    template<int Bytes> __attribute__((always_inline)) static inline void run(const E* expr, T* out, ptrdiff_t ld,
+                                                                              size_t first_row, size_t last_row,
+                                                                              size_t columns) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        for (size_t i = first_row; i < last_row; ++i) {
+            T* out_row = out + i * ld;
+            size_t j = 0;
+            for (; j + W <= columns; j += W) {
+                vec v;
+                expr->load(i, j, v);
+                std::memcpy(out_row + j, &v, sizeof(vec));
+            }
+            for (; j < columns; ++j) out_row[j] = expr->logical_at(i, j);
+        }
+    }
+};
+
+/**
+ * What one element of an expression costs, for the instrumentation (instrument.h): `operations` arithmetic operations
+ * on elements read from `operands` Vectors or Matrices. The expression is counted under the OpKind of its root node.
+ */
+template<typename E>
+struct ExpressionCost {
+    static constexpr size_t operations = 0;
+    static constexpr size_t operands = 1;
+    static constexpr OpKind kind = OpKind::copy;
+};
+template<typename L, typename R, typename Op>
+struct ExpressionCost<VectorBinary<L, R, Op>> {
+    static constexpr size_t operations = ExpressionCost<L>::operations + ExpressionCost<R>::operations + 1;
+    static constexpr size_t operands = ExpressionCost<L>::operands + ExpressionCost<R>::operands;
+    static constexpr OpKind kind = Op::kind;
+};
+template<typename E, typename Op>
+struct ExpressionCost<VectorScalar<E, Op>> {
+    static constexpr size_t operations = ExpressionCost<E>::operations + 1;
+    static constexpr size_t operands = ExpressionCost<E>::operands;
+    static constexpr OpKind kind = Op::kind;
+};
+template<typename E, typename Op>
+struct ExpressionCost<VectorUnary<E, Op>> {
+    static constexpr size_t operations = ExpressionCost<E>::operations + 1;
+    static constexpr size_t operands = ExpressionCost<E>::operands;
+    static constexpr OpKind kind = OpKind::map;
+};
+template<typename L, typename R, typename Op>
+struct ExpressionCost<MatrixBinary<L, R, Op>> : ExpressionCost<VectorBinary<L, R, Op>> { };
+template<typename E, typename Op>
+struct ExpressionCost<MatrixScalar<E, Op>> : ExpressionCost<VectorScalar<E, Op>> { };
+template<typename E, typename Op>
+struct ExpressionCost<MatrixUnary<E, Op>> : ExpressionCost<VectorUnary<E, Op>> { };
+
+/// Writes every element of a Vector expression into out[0], out[stride], ..., out[(expr.size() - 1) * stride].
+template<typename E>
+void evaluate(const VectorExpression<E>& expression, typename E::value_type* out, ptrdiff_t stride = 1) {
+    using T = typename E::value_type;
+    auto&& expr = as_operand(expression.self());
+    using Operand = std::remove_cvref_t<decltype(expr)>;
+    COMPUTER_BRAIN_INSTRUMENT_OP(ExpressionCost<E>::kind, (OpShape{{expr.size()}, 1}),
+                                 ExpressionCost<E>::operations * expr.size(),
+                                 (ExpressionCost<E>::operands + 1) * expr.size() * sizeof(T));
+    const bool contiguous = stride == 1 && expr.contiguous();
+    parallel_for(0, expr.size(), elementwise_parallel_grain, [&](size_t first, size_t last) {
+        if constexpr (is_simd_type<T>) {
+            if (contiguous) {
+                simd_dispatch<T, FusedVectorAssign<Operand>>(&expr, out, first, last);
+                return;
+            }
+        }
+        for (size_t i = first; i < last; ++i) out[i * stride] = expr[i];
+    });
+}
+
+/**
+ * Writes every element of a Matrix expression into out, where element (i, j) lives at out[i * rs + j * cs]. When the
+ * output or some operand is not read along its rows, the output is filled in square tiles so that the strided reads
+ * and writes stay in cache, each tile in the direction in which the output is contiguous.
+ */
+template<typename E>
+void evaluate(const MatrixExpression<E>& expression, typename E::value_type* out, ptrdiff_t rs, ptrdiff_t cs = 1) {
+    using T = typename E::value_type;
+    auto&& expr = as_operand(expression.self());
+    using Operand = std::remove_cvref_t<decltype(expr)>;
+    const size_t rows = expr.logical_rows();
+    const size_t columns = expr.logical_columns();
+    COMPUTER_BRAIN_INSTRUMENT_OP(ExpressionCost<E>::kind, (OpShape{{rows, columns}, 2}),
+                                 ExpressionCost<E>::operations * rows * columns,
+                                 (ExpressionCost<E>::operands + 1) * rows * columns * sizeof(T));
+    const bool contiguous = cs == 1 && expr.contiguous();
+    const size_t grain_rows = std::max<size_t>(1, elementwise_parallel_grain / std::max<size_t>(1, columns));
+    parallel_for(0, rows, grain_rows, [&](size_t first_row, size_t last_row) {
+        if constexpr (is_simd_type<T>) {
+            if (contiguous) {
+                simd_dispatch<T, FusedMatrixAssign<Operand>>(&expr, out, rs, first_row, last_row, columns);
+                return;
+            }
+        }
+        constexpr size_t tile = 64;
+        const bool down_columns = std::abs(rs) < std::abs(cs);  // the output is contiguous along its columns
+        for (size_t ii = first_row; ii < last_row; ii += tile) {
+            for (size_t jj = 0; jj < columns; jj += tile) {
+                const size_t i_end = std::min(last_row, ii + tile);
+                const size_t j_end = std::min(columns, jj + tile);
+                if (down_columns) {
+                    for (size_t j = jj; j < j_end; ++j) {
+                        for (size_t i = ii; i < i_end; ++i) out[i * rs + j * cs] = expr.logical_at(i, j);
+                    }
+                } else {
+                    for (size_t i = ii; i < i_end; ++i) {
+                        for (size_t j = jj; j < j_end; ++j) out[i * rs + j * cs] = expr.logical_at(i, j);
+                    }
+                }
+            }
+        }
+    });
+}
+
+}  // namespace detail
+
+
+/* -------------------------------------------- Expression Operators ------------------------------------------------ */
+
+
+/// Elementwise addition of two Vector expressions. See VectorBinary for the orientation rules.
+template<typename L, typename R>
+VectorBinary<L, R, detail::AddOp> operator+(const VectorExpression<L>& left, const VectorExpression<R>& right) {
+    return VectorBinary<L, R, detail::AddOp>(left.self(), right.self());
+}
+
+/// Elementwise subtraction of two Vector expressions. See VectorBinary for the orientation rules.
+template<typename L, typename R>
+VectorBinary<L, R, detail::SubOp> operator-(const VectorExpression<L>& left, const VectorExpression<R>& right) {
+    return VectorBinary<L, R, detail::SubOp>(left.self(), right.self());
+}
+
+/// Multiplies every element of a Vector expression by a scalar. The operand is not modified.
+template<typename E>
+VectorScalar<E, detail::MulOp> operator*(const VectorExpression<E>& expr, const typename E::value_type& scalar) {
+    return VectorScalar<E, detail::MulOp>(expr.self(), scalar);
+}
+
+/// Scalar multiplication is commutative, so scalar * Vector is the same as Vector * scalar.
+template<typename E>
+VectorScalar<E, detail::MulOp> operator*(const typename E::value_type& scalar, const VectorExpression<E>& expr) {
+    return VectorScalar<E, detail::MulOp>(expr.self(), scalar);
+}
+
+/// Divides every element of a Vector expression by a scalar. The operand is not modified.
+template<typename E>
+VectorScalar<E, detail::DivOp> operator/(const VectorExpression<E>& expr, const typename E::value_type& scalar) {
+    return VectorScalar<E, detail::DivOp>(expr.self(), scalar);
+}
+
+/// Elementwise addition of two Matrix expressions. See MatrixBinary for the orientation rules.
+template<typename L, typename R>
+MatrixBinary<L, R, detail::AddOp> operator+(const MatrixExpression<L>& left, const MatrixExpression<R>& right) {
+    return MatrixBinary<L, R, detail::AddOp>(left.self(), right.self());
+}
+
+/// Elementwise subtraction of two Matrix expressions. See MatrixBinary for the orientation rules.
+template<typename L, typename R>
+MatrixBinary<L, R, detail::SubOp> operator-(const MatrixExpression<L>& left, const MatrixExpression<R>& right) {
+    return MatrixBinary<L, R, detail::SubOp>(left.self(), right.self());
+}
+
+/// Multiplies every element of a Matrix expression by a scalar. The operand is not modified.
+template<typename E>
+MatrixScalar<E, detail::MulOp> operator*(const MatrixExpression<E>& expr, const typename E::value_type& scalar) {
+    return MatrixScalar<E, detail::MulOp>(expr.self(), scalar);
+}
+
+/// Scalar multiplication is commutative, so scalar * Matrix is the same as Matrix * scalar.
+template<typename E>
+MatrixScalar<E, detail::MulOp> operator*(const typename E::value_type& scalar, const MatrixExpression<E>& expr) {
+    return MatrixScalar<E, detail::MulOp>(expr.self(), scalar);
+}
+
+/// Divides every element of a Matrix expression by a scalar. The operand is not modified.
+template<typename E>
+MatrixScalar<E, detail::DivOp> operator/(const MatrixExpression<E>& expr, const typename E::value_type& scalar) {
+    return MatrixScalar<E, detail::DivOp>(expr.self(), scalar);
+}
+
+
+#endif //COMPUTER_BRAIN_EXPRESSION_H
@@ -0,0 +1,540 @@
+#ifndef COMPUTER_BRAIN_FACTORIZATION_H
+#define COMPUTER_BRAIN_FACTORIZATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "gemm.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "view.h"
+
+/*
+ * LU and Cholesky factorizations, triangular solves and linear systems.
+ *
+ *   solve_triangular()   B = T^-1 * B for a lower or upper triangular T, for any number of right-hand sides
+ *   lu_factor()          A = P * L * U with partial pivoting, in place
+ *   lu_solve()           B = A^-1 * B from the result of lu_factor()
+ *   cholesky_factor()    A = L * L^T for a symmetric positive definite A, in place
+ *   cholesky_solve()     B = A^-1 * B from the result of cholesky_factor()
+ *   lu(), cholesky()     the same on a Matrix, into an LUFactorization or CholeskyFactorization that can solve
+ *   solve()              A^-1 * B for a Matrix or Vector B, through lu()
+ *
+ * Every routine is blocked and right-looking, like LAPACK's getrf/potrf/trsm: the matrix is processed
+ * factorization_block columns at a time; each step factors (or solves) one narrow block with plain loops, and then
+ * applies it to everything to its right and below with a single gemm(). Nearly all of the O(n^3) work is in those
+ * gemm() calls, so the factorizations and the solves with many right-hand sides run on the packed, multithreaded GEMM
+ * of gemm.h.
+ *
+ * The view routines work in place on any MatrixView, whatever its strides: a transposed view is factored or solved in
+ * its transposed orientation without being copied. The trailing updates pass disjoint submatrices of the same matrix
+ * to gemm(), so no operand overlaps the output.
+ */
+
+/// Columns factored (or rows solved) by plain loops before the rest of the matrix is updated with gemm().
+inline constexpr size_t factorization_block = 128;
+
+/// Which triangle of a square matrix holds a triangular factor.
+enum class Triangle { lower, upper };
+
+/// Whether the diagonal of a triangular factor is stored, or is all ones and not read (the L of an LU factorization).
+enum class Diagonal { non_unit, unit };
+
+
+/* ----------------------------------------------- Triangular Solves ------------------------------------------------ */
+
+
+namespace detail {
+
+/// The square check shared by every factorization and solve.
+template<typename U>
+void require_square(const MatrixView<U>& a, const char* operation) {
+    if (a.rows() != a.columns()) {
+        throw std::invalid_argument("\nThe " + std::string(operation) + " needs a square Matrix, not a " +
+                                    std::to_string(a.rows()) + " x " + std::to_string(a.columns()) + " one\n");
+    }
+}
+
+/**
+ * The row-oriented solve of trsm_unblocked() on columns [first, last) of B: strips of four vector registers of each
+ * row of B stay in registers while every solved row above (lower) or below (upper) is subtracted from them, so each
+ * element of T is broadcast once per strip and each multiply-add needs a single load.
+ */
+template<typename T>
+struct TrsmRowsKernel {
+    template<int Bytes> __attribute__((always_inline)) static inline void run(const T* t, ptrdiff_t rs_t,
+                                                                              ptrdiff_t cs_t, size_t n, bool lower,
+                                                                              bool unit, T* b, ptrdiff_t rs_b,
+                                                                              size_t first, size_t last) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        size_t c = first;
+        for (; c + 4 * W <= last; c += 4 * W) {
+            for (size_t s = 0; s < n; ++s) {
+                const size_t i = lower ? s : n - 1 - s;
+                const size_t j_begin = lower ? 0 : i + 1;
+                const size_t j_end = lower ? i : n;
+                vec acc[4];
+#pragma GCC unroll 4
+                for (int u = 0; u < 4; ++u) std::memcpy(&acc[u], b + i * rs_b + c + u * W, sizeof(vec));
+                for (size_t j = j_begin; j < j_end; ++j) {
+                    const T t_ij = t[i * rs_t + j * cs_t];
+#pragma GCC unroll 4
+                    for (int u = 0; u < 4; ++u) {
+                        vec x;
+                        std::memcpy(&x, b + j * rs_b + c + u * W, sizeof(vec));
+                        acc[u] -= t_ij * x;
+                    }
+                }
+                if (!unit) {
+                    const T t_ii = t[i * rs_t + i * cs_t];
+#pragma GCC unroll 4
+                    for (int u = 0; u < 4; ++u) acc[u] /= t_ii;
+                }
+#pragma GCC unroll 4
+                for (int u = 0; u < 4; ++u) std::memcpy(b + i * rs_b + c + u * W, &acc[u], sizeof(vec));
+            }
+        }
+        for (; c < last; ++c) {
+            for (size_t s = 0; s < n; ++s) {
+                const size_t i = lower ? s : n - 1 - s;
+                const size_t j_begin = lower ? 0 : i + 1;
+                const size_t j_end = lower ? i : n;
+                T sum = b[i * rs_b + c];
+                for (size_t j = j_begin; j < j_end; ++j) sum -= t[i * rs_t + j * cs_t] * b[j * rs_b + c];
+                b[i * rs_b + c] = unit ? sum : sum / t[i * rs_t + i * cs_t];
+            }
+        }
+    }
+};
+
+/**
+ * Solves T * X = B for one diagonal block with plain loops, writing X over B. The rows of B are solved in strips of
+ * vector registers (TrsmRowsKernel), shared out over the thread pool; a B whose rows are not contiguous (such as a
+ * transposed view) is solved in a contiguous copy.
+ */
+template<typename U>
+void trsm_unblocked(Triangle triangle, Diagonal diagonal, const MatrixView<const U>& t, const MatrixView<U>& b) {
+    const size_t n = t.rows();
+    const size_t columns = b.columns();
+    const bool lower = triangle == Triangle::lower;
+    const bool unit = diagonal == Diagonal::unit;
+    if constexpr (is_simd_type<U>) {
+        if (b.col_stride() != 1 && columns > 1) {
+            GemmScratch<U> scratch(n * columns);
+            MatrixView<U> copy(scratch.data(), n, columns, (ptrdiff_t)columns, 1);
+            copy = b;
+            trsm_unblocked(triangle, diagonal, t, copy);
+            MatrixView<U> target = b;
+            target = copy;
+            return;
+        }
+        const size_t grain = std::max<size_t>(64, (size_t(1) << 15) / std::max<size_t>(1, n * n / 2));
+        parallel_for(0, columns, grain, [&](size_t first, size_t last) {
+            simd_dispatch<U, TrsmRowsKernel<U>>(t.data(), t.row_stride(), t.col_stride(), n, lower, unit, b.data(),
+                                                b.row_stride(), first, last);
+        });
+    } else {
+        for (size_t c = 0; c < columns; ++c) {
+            for (size_t s = 0; s < n; ++s) {
+                const size_t i = lower ? s : n - 1 - s;
+                U sum = b(i, c);
+                for (size_t j = lower ? 0 : i + 1; j < (lower ? i : n); ++j) sum -= t(i, j) * b(j, c);
+                b(i, c) = unit ? sum : sum / t(i, i);
+            }
+        }
+    }
+}
+
+}  // namespace detail
+
+/**
+ * @brief B = T^-1 * B: solves T * X = B and writes X over B.
+ *
+ * T is square and triangular; only its `triangle` (and its diagonal, unless `diagonal` is unit) is read. B has as many
+ * rows as T and any number of columns, one per right-hand side. To solve with T^T, pass T.t() and the opposite
+ * triangle. Forward substitution (lower) runs from the top block down, back substitution (upper) from the bottom up;
+ * after each diagonal block is solved, the rows of B still to be solved are updated with one gemm().
+ */
+template<typename U>
+void solve_triangular(const std::type_identity_t<MatrixView<const U>>& t, const std::type_identity_t<MatrixView<U>>& b,
+                      Triangle triangle, Diagonal diagonal = Diagonal::non_unit) {
+    detail::require_square(t, "triangular solve");
+    if (t.rows() != b.rows()) {
+        throw std::invalid_argument("\nA triangular system of " + std::to_string(t.rows()) + " equations cannot be "
+                                    "solved for a right-hand side of " + std::to_string(b.rows()) + " rows\n");
+    }
+    const size_t n = t.rows();
+    const size_t columns = b.columns();
+    if (n == 0 || columns == 0) {
+        return;
+    }
+    const size_t blocks = (n + factorization_block - 1) / factorization_block;
+    for (size_t step = 0; step < blocks; ++step) {
+        const size_t block = triangle == Triangle::lower ? step : blocks - 1 - step;
+        const size_t k0 = block * factorization_block;
+        const size_t kb = std::min(factorization_block, n - k0);
+        const MatrixView<U> x = b.submatrix(k0, 0, kb, columns);
+        detail::trsm_unblocked<U>(triangle, diagonal, t.submatrix(k0, k0, kb, kb), x);
+        if (triangle == Triangle::lower && k0 + kb < n) {  // rows below: B2 -= T21 * X1
+            gemm<U>(U(-1), t.submatrix(k0 + kb, k0, n - k0 - kb, kb), x, U(1),
+                    b.submatrix(k0 + kb, 0, n - k0 - kb, columns));
+        } else if (triangle == Triangle::upper && k0 > 0) {  // rows above: B0 -= T01 * X1
+            gemm<U>(U(-1), t.submatrix(0, k0, k0, kb), x, U(1), b.submatrix(0, 0, k0, columns));
+        }
+    }
+}
+
+
+/* ---------------------------------------------- LU Factorization -------------------------------------------------- */
+
+
+namespace detail {
+
+/// Exchanges rows i and p of a view.
+template<typename U>
+void swap_rows(const MatrixView<U>& a, size_t i, size_t p) {
+    if (i == p || a.columns() == 0) return;
+    if (a.col_stride() == 1) {
+        std::swap_ranges(&a(i, 0), &a(i, 0) + a.columns(), &a(p, 0));
+        return;
+    }
+    for (size_t j = 0; j < a.columns(); ++j) std::swap(a(i, j), a(p, j));
+}
+
+/// Panels at most this wide are factored with plain loops; wider ones are split in two (see lu_panel()).
+inline constexpr size_t lu_panel_leaf = 16;
+
+/**
+ * Factors the panel of columns [k0, k0 + kb) of rows [k0, n) with plain loops (LAPACK's getf2). A column without a
+ * non-zero pivot is left as it is, with a zero on the diagonal of U; lu_factor() reports it.
+ */
+template<typename U>
+void lu_panel_unblocked(const MatrixView<U>& a, size_t k0, size_t kb, std::vector<size_t>& pivots) {
+    const size_t n = a.rows();
+    for (size_t j = k0; j < k0 + kb; ++j) {
+        size_t p = j;
+        auto largest = std::abs(a(j, j));
+        for (size_t i = j + 1; i < n; ++i) {
+            if (std::abs(a(i, j)) > largest) {
+                largest = std::abs(a(i, j));
+                p = i;
+            }
+        }
+        pivots[j] = p;
+        if (a(p, j) == U(0)) {  // if: the column is zero from row j down, there is nothing to eliminate
+            continue;
+        }
+        swap_rows(a, j, p);
+        const U pivot = a(j, j);
+        for (size_t i = j + 1; i < n; ++i) {
+            const U l_ij = a(i, j) / pivot;
+            a(i, j) = l_ij;
+            for (size_t c = j + 1; c < k0 + kb; ++c) a(i, c) -= l_ij * a(j, c);
+        }
+    }
+}
+
+/**
+ * Factors the panel of columns [k0, k0 + kb) of rows [k0, n), recursively (LAPACK's getrf2): the left half is
+ * factored, the right half is updated with it by a triangular solve and a gemm(), and then factored. A panel is tall
+ * and narrow, so factoring it with plain loops alone would leave a large part of the work off the GEMM path.
+ *
+ * Rows are exchanged across the whole width of `a` as pivots are chosen; pivots[j] is the row exchanged with row j.
+ */
+template<typename U>
+void lu_panel(const MatrixView<U>& a, size_t k0, size_t kb, std::vector<size_t>& pivots) {
+    if (kb <= lu_panel_leaf) {
+        lu_panel_unblocked(a, k0, kb, pivots);
+        return;
+    }
+    const size_t left = kb / 2;
+    const size_t right = kb - left;
+    const size_t below = a.rows() - k0 - left;
+    lu_panel(a, k0, left, pivots);
+    const MatrixView<U> a12 = a.submatrix(k0, k0 + left, left, right);
+    solve_triangular<U>(a.submatrix(k0, k0, left, left), a12, Triangle::lower, Diagonal::unit);
+    gemm<U>(U(-1), a.submatrix(k0 + left, k0, below, left), a12, U(1), a.submatrix(k0 + left, k0 + left, below, right));
+    lu_panel(a, k0 + left, right, pivots);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Factors a square A as P * L * U in place, with partial pivoting.
+ *
+ * On return the strictly lower triangle of A holds L (whose diagonal is all ones and is not stored) and the upper
+ * triangle holds U. Row i of A was exchanged with row pivots[i], for i = 0, 1, ..., n - 1 in that order. Throws
+ * std::runtime_error when A is singular (a column has no non-zero pivot).
+ *
+ * Right-looking and blocked: each block of factorization_block columns is factored with plain loops, the block row of
+ * U to its right is solved with solve_triangular(), and the trailing submatrix is updated with one gemm().
+ */
+template<typename U>
+void lu_factor(const std::type_identity_t<MatrixView<U>>& a, std::vector<size_t>& pivots) {
+    static_assert(std::is_floating_point_v<U>, "LU factorization needs a floating-point element type");
+    detail::require_square(a, "LU factorization");
+    const size_t n = a.rows();
+    pivots.resize(n);
+    std::vector<size_t> panel_pivots(std::min(factorization_block, n));
+    for (size_t k0 = 0; k0 < n; k0 += factorization_block) {
+        const size_t kb = std::min(factorization_block, n - k0);
+        const size_t rest = n - k0 - kb;
+        // The panel is factored in a contiguous copy: rows of `a` are often a multiple of 4 KB apart, and a column
+        // walked through them would keep evicting itself from cache. Its row exchanges are applied to the columns
+        // left and right of it afterwards.
+        detail::GemmScratch<U> scratch((n - k0) * kb);
+        MatrixView<U> panel(scratch.data(), n - k0, kb, (ptrdiff_t)kb, 1);
+        panel = a.submatrix(k0, k0, n - k0, kb);
+        detail::lu_panel(panel, 0, kb, panel_pivots);
+        a.submatrix(k0, k0, n - k0, kb) = panel;
+        for (size_t j = 0; j < kb; ++j) {
+            if (panel(j, j) == U(0)) {
+                throw std::runtime_error("\nThe Matrix is singular: column " + std::to_string(k0 + j) +
+                                         " has no non-zero pivot\n");
+            }
+            pivots[k0 + j] = k0 + panel_pivots[j];
+            detail::swap_rows(a.submatrix(0, 0, n, k0), k0 + j, pivots[k0 + j]);
+            detail::swap_rows(a.submatrix(0, k0 + kb, n, rest), k0 + j, pivots[k0 + j]);
+        }
+        if (rest == 0) {
+            break;
+        }
+        const MatrixView<U> u12 = a.submatrix(k0, k0 + kb, kb, rest);
+        solve_triangular<U>(a.submatrix(k0, k0, kb, kb), u12, Triangle::lower, Diagonal::unit);
+        gemm<U>(U(-1), a.submatrix(k0 + kb, k0, rest, kb), u12, U(1), a.submatrix(k0 + kb, k0 + kb, rest, rest));
+    }
+}
+
+/**
+ * @brief B = A^-1 * B from the factors and pivots of lu_factor(): solves A * X = B and writes X over B.
+ *
+ * B has as many rows as A and one column per right-hand side.
+ */
+template<typename U>
+void lu_solve(const std::type_identity_t<MatrixView<const U>>& lu, const std::vector<size_t>& pivots,
+              const std::type_identity_t<MatrixView<U>>& b) {
+    detail::require_square(lu, "LU solve");
+    if (pivots.size() != lu.rows() || b.rows() != lu.rows()) {
+        throw std::invalid_argument("\nThe LU factors of a " + std::to_string(lu.rows()) + " x " +
+                                    std::to_string(lu.rows()) + " Matrix (with " + std::to_string(pivots.size()) +
+                                    " pivots) cannot solve for a right-hand side of " + std::to_string(b.rows()) +
+                                    " rows\n");
+    }
+    for (size_t i = 0; i < pivots.size(); ++i) detail::swap_rows(b, i, pivots[i]);
+    solve_triangular<U>(lu, b, Triangle::lower, Diagonal::unit);
+    solve_triangular<U>(lu, b, Triangle::upper, Diagonal::non_unit);
+}
+
+
+/* ------------------------------------------- Cholesky Factorization ----------------------------------------------- */
+
+
+namespace detail {
+
+/// The dot product of the first `count` elements of rows i and j of a view.
+template<typename U>
+U row_dot(const MatrixView<U>& a, size_t i, size_t j, size_t count) {
+    if (a.col_stride() == 1) {
+        return simd_dot(&a(i, 0), &a(j, 0), count);
+    }
+    U sum = U(0);
+    for (size_t p = 0; p < count; ++p) sum += a(i, p) * a(j, p);
+    return sum;
+}
+
+/// Factors one diagonal block with plain loops (LAPACK's potf2); k0 is only used in the error message.
+template<typename U>
+void cholesky_block(const MatrixView<U>& a, size_t k0) {
+    const size_t n = a.rows();
+    for (size_t j = 0; j < n; ++j) {
+        const U d = a(j, j) - row_dot(a, j, j, j);
+        if (!(d > U(0))) {
+            throw std::runtime_error("\nThe Matrix is not positive definite: the leading minor of order " +
+                                     std::to_string(k0 + j + 1) + " is not positive\n");
+        }
+        const U l_jj = std::sqrt(d);
+        a(j, j) = l_jj;
+        for (size_t i = j + 1; i < n; ++i) {
+            a(i, j) = (a(i, j) - row_dot(a, i, j, j)) / l_jj;
+        }
+    }
+}
+
+}  // namespace detail
+
+/**
+ * @brief Factors a symmetric positive definite A as L * L^T in place.
+ *
+ * Only the lower triangle of A is read, and on return it holds L; the strictly upper triangle is not touched. Throws
+ * std::runtime_error when A is not positive definite.
+ *
+ * Right-looking and blocked: each diagonal block is factored with plain loops, the block column below it is solved
+ * against it with solve_triangular(), and the lower triangle of the trailing submatrix is updated with gemm(), one
+ * block row of gemm_block_rows rows at a time so that only the blocks on and below the diagonal are computed. The
+ * blocks on the diagonal are computed into scratch memory and only their lower triangle is subtracted from A.
+ */
+template<typename U>
+void cholesky_factor(const std::type_identity_t<MatrixView<U>>& a) {
+    static_assert(std::is_floating_point_v<U>, "Cholesky factorization needs a floating-point element type");
+    detail::require_square(a, "Cholesky factorization");
+    constexpr size_t gemm_block_rows = 256;
+    const size_t n = a.rows();
+    for (size_t k0 = 0; k0 < n; k0 += factorization_block) {
+        const size_t kb = std::min(factorization_block, n - k0);
+        const size_t rest = n - k0 - kb;
+        const MatrixView<U> l11 = a.submatrix(k0, k0, kb, kb);
+        detail::cholesky_block(l11, k0);
+        if (rest == 0) {
+            break;
+        }
+        const MatrixView<U> l21 = a.submatrix(k0 + kb, k0, rest, kb);
+        solve_triangular<U>(l11, l21.t(), Triangle::lower);  // L21 * L11^T = A21, solved as L11 * L21^T = A21^T
+        for (size_t i0 = 0; i0 < rest; i0 += gemm_block_rows) {  // A22 -= L21 * L21^T, on and below the diagonal
+            const size_t ib = std::min(gemm_block_rows, rest - i0);
+            const MatrixView<const U> rows = l21.submatrix(i0, 0, ib, kb);
+            gemm<U>(U(-1), rows, l21.submatrix(0, 0, i0, kb).t(), U(1), a.submatrix(k0 + kb + i0, k0 + kb, ib, i0));
+            // the diagonal block goes through scratch, so that its strictly upper triangle is left as it was
+            detail::GemmScratch<U> scratch(ib * ib);
+            const MatrixView<U> product(scratch.data(), ib, ib, ptrdiff_t(ib), 1);
+            gemm<U>(U(1), rows, rows.t(), U(0), product);
+            const MatrixView<U> diagonal = a.submatrix(k0 + kb + i0, k0 + kb + i0, ib, ib);
+            for (size_t i = 0; i < ib; ++i) {
+                for (size_t j = 0; j <= i; ++j) diagonal(i, j) -= product(i, j);
+            }
+        }
+    }
+}
+
+/**
+ * @brief B = A^-1 * B from the factor L of cholesky_factor(): solves L * L^T * X = B and writes X over B.
+ *
+ * Only the lower triangle of `l` is read. B has as many rows as L and one column per right-hand side.
+ */
+template<typename U>
+void cholesky_solve(const std::type_identity_t<MatrixView<const U>>& l, const std::type_identity_t<MatrixView<U>>& b) {
+    solve_triangular<U>(l, b, Triangle::lower);
+    solve_triangular<U>(l.t(), b, Triangle::upper);
+}
+
+
+/* ---------------------------------------- Factorizations of a Matrix ---------------------------------------------- */
+
+
+namespace detail {
+
+/// A Vector as a single-column view, so that the Matrix solves serve it.
+template<typename U>
+MatrixView<U> column_view(Vector<U>& vector) {
+    return MatrixView<U>(vector.data(), vector.size(), 1, 1, 1);
+}
+
+/// A new Matrix, not transposed, with the elements of `a` in its current orientation.
+template<typename U>
+Matrix<U> factorization_copy(const Matrix<U>& a) {
+    const MatrixView<const U> source = a.view();
+    Matrix<U> copy(source.rows(), source.columns());
+    copy.view() = source;
+    return copy;
+}
+
+}  // namespace detail
+
+/**
+ * @brief The LU factorization of a square Matrix, as returned by lu(): A = P * L * U.
+ *
+ * `factors` holds L below the diagonal (with an implicit unit diagonal) and U on and above it; `pivots` the row
+ * exchanges, as in lu_factor(). solve() can be called any number of times, for any number of right-hand sides.
+ */
+template<typename U>
+struct LUFactorization {
+    Matrix<U> factors;
+    std::vector<size_t> pivots;
+
+    /// A^-1 * B, one column per right-hand side. B is used in its current orientation.
+    Matrix<U> solve(const Matrix<U>& b) const {
+        Matrix<U> x = detail::factorization_copy(b);
+        lu_solve<U>(factors.view(), pivots, x.view());
+        return x;
+    }
+
+    /// A^-1 * b. The result has the orientation of b.
+    Vector<U> solve(const Vector<U>& b) const {
+        Vector<U> x = b;
+        lu_solve<U>(factors.view(), pivots, detail::column_view(x));
+        return x;
+    }
+
+    /// The determinant of A: the product of the diagonal of U, negated once per row exchange.
+    U determinant() const {
+        const MatrixView<const U> lu = factors.view();
+        U product = U(1);
+        for (size_t i = 0; i < pivots.size(); ++i) {
+            product *= lu(i, i);
+            if (pivots[i] != i) product = -product;
+        }
+        return product;
+    }
+};
+
+/**
+ * @brief The Cholesky factorization of a symmetric positive definite Matrix, as returned by cholesky(): A = L * L^T.
+ *
+ * `lower` is L, with zeros above the diagonal.
+ */
+template<typename U>
+struct CholeskyFactorization {
+    Matrix<U> lower;
+
+    /// A^-1 * B, one column per right-hand side. B is used in its current orientation.
+    Matrix<U> solve(const Matrix<U>& b) const {
+        Matrix<U> x = detail::factorization_copy(b);
+        cholesky_solve<U>(lower.view(), x.view());
+        return x;
+    }
+
+    /// A^-1 * b. The result has the orientation of b.
+    Vector<U> solve(const Vector<U>& b) const {
+        Vector<U> x = b;
+        cholesky_solve<U>(lower.view(), detail::column_view(x));
+        return x;
+    }
+};
+
+/// LU factorization, with partial pivoting, of a square Matrix in its current orientation. A is not modified.
+template<typename U>
+LUFactorization<U> lu(const Matrix<U>& a) {
+    LUFactorization<U> result{detail::factorization_copy(a), {}};
+    lu_factor<U>(result.factors.view(), result.pivots);
+    return result;
+}
+
+/// Cholesky factorization of a symmetric positive definite Matrix. Only its lower triangle is read; A is not modified.
+template<typename U>
+CholeskyFactorization<U> cholesky(const Matrix<U>& a) {
+    CholeskyFactorization<U> result{detail::factorization_copy(a)};
+    const MatrixView<U> l = result.lower.view();
+    cholesky_factor<U>(l);
+    for (size_t i = 0; i < l.rows(); ++i) {
+        for (size_t j = i + 1; j < l.columns(); ++j) l(i, j) = U(0);
+    }
+    return result;
+}
+
+/// Solves A * X = B for a square A (through lu()), one column of B per right-hand side.
+template<typename U>
+Matrix<U> solve(const Matrix<U>& a, const Matrix<U>& b) { return lu(a).solve(b); }
+
+/// Solves A * x = b for a square A (through lu()).
+template<typename U>
+Vector<U> solve(const Matrix<U>& a, const Vector<U>& b) { return lu(a).solve(b); }
+
+
+#endif //COMPUTER_BRAIN_FACTORIZATION_H
@@ -0,0 +1,450 @@
+#ifndef COMPUTER_BRAIN_FIXED_H
+#define COMPUTER_BRAIN_FIXED_H
+
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "expression.h"
+#include "view.h"
+
+/*
+ * Vector<T, N> and Matrix<U, R, C>: vectors and matrices whose size is part of their type.
+ *
+ * The elements live inside the object (a std::array), so creating one never allocates, and since the sizes are known
+ * at compile time a size mismatch is a compile error rather than an exception: a Matrix<U, 3, 4> can only be
+ * multiplied by a Matrix<U, 4, C> or a Vector<U, 4>. Every operation is constexpr and is written as a fold over the
+ * indices, so it is fully unrolled into straight-line code that the compiler keeps in registers; small-matrix math
+ * costs a few nanoseconds.
+ *
+ * Unlike the dynamic Vector<T> and Matrix<U>, the fixed types have no is_transposed flag. A Vector<T, N> is a column
+ * vector; dot(a, b) and outer(a, b) name the two vector products, and Matrix<U, R, C>::t() returns the transposed
+ * Matrix<U, C, R>, since transposing changes the type. Operations are computed eagerly: with everything in registers
+ * there is nothing for an expression template to save.
+ *
+ * The fixed and dynamic types work together through views: v.view() and m.view() can be used anywhere a VectorView or
+ * MatrixView can (elementwise expressions, gemm(), operator* with a dynamic Matrix, and Vector<T>(v.view()) or
+ * Matrix<U>(m.view()) to make a dynamic copy), and a fixed object can be built from a view of the right size.
+ */
+
+
+namespace detail {
+
+/// Calls f(std::integral_constant<size_t, I>()) for I = 0, 1, ..., N - 1, as N separate statements.
+template<size_t N, typename F>
+__attribute__((always_inline)) constexpr void static_for(F&& f) {
+    [&]<size_t... I>(std::index_sequence<I...>) __attribute__((always_inline)) {
+        (f(std::integral_constant<size_t, I>()), ...);
+    }(std::make_index_sequence<N>());
+}
+
+}  // namespace detail
+
+/// True when every extent is known at compile time. Keeps the operators below away from Vector<T> and Matrix<U>.
+template<size_t... Extents>
+concept fixed_extents = ((Extents != dynamic_size) && ...);
+
+
+/* --------------------------------------------- Fixed Vector Class ------------------------------------------------- */
+
+
+template<typename T, size_t N>
+class Vector {
+    static_assert(N != dynamic_size, "Vector<T, N> needs a size known at compile time; use Vector<T> otherwise");
+private:
+    std::array<T, N> repr{};  // the elements, inside the object
+public:
+    using value_type = T;
+    static constexpr size_t extent = N;
+
+    /* Constructors */
+    constexpr Vector() = default;  // N zeros
+    template<typename... A> requires (sizeof...(A) == N && N > 0 && (std::is_convertible_v<A, T> && ...))
+    constexpr Vector(A... values) : repr{static_cast<T>(values)...} { }
+    template<typename W> explicit Vector(const VectorView<W>& view);
+    static constexpr Vector filled(T value);
+
+    /* Member Functions */
+    static constexpr size_t size() { return N; }
+    constexpr T* data() { return repr.data(); }
+    constexpr const T* data() const { return repr.data(); }
+    constexpr auto begin() { return repr.begin(); }
+    constexpr auto end() { return repr.end(); }
+    constexpr auto begin() const { return repr.begin(); }
+    constexpr auto end() const { return repr.end(); }
+    VectorView<T> view() { return VectorView<T>(repr.data(), N); }
+    VectorView<const T> view() const { return VectorView<const T>(repr.data(), N); }
+
+    /* Non-Mathematical Operations */
+    constexpr T& operator[](size_t i) { return repr[i]; }
+    constexpr const T& operator[](size_t i) const { return repr[i]; }
+    constexpr bool operator==(const Vector& other) const = default;
+};
+
+/// Copies the elements of a view, which must have N elements; throws std::invalid_argument otherwise.
+template<typename T, size_t N>
+template<typename W>
+Vector<T, N>::Vector(const VectorView<W>& view) {
+    if (view.size() != N) {
+        throw std::invalid_argument("\nA Vector of " + std::to_string(N) + " elements cannot be built from a view of " +
+                                    std::to_string(view.size()) + " elements\n");
+    }
+    for (size_t i = 0; i < N; ++i) repr[i] = view[i];
+}
+
+/// A Vector whose N elements are all value.
+template<typename T, size_t N>
+constexpr Vector<T, N> Vector<T, N>::filled(T value) {
+    Vector result;
+    detail::static_for<N>([&](auto i) __attribute__((always_inline)) { result[i] = value; });
+    return result;
+}
+
+
+/* --------------------------------------------- Fixed Matrix Class ------------------------------------------------- */
+
+
+template<typename U, size_t R, size_t C>
+class Matrix {
+    static_assert(R != dynamic_size && C != dynamic_size,
+                  "Matrix<U, R, C> needs both sizes known at compile time; use Matrix<U> otherwise");
+private:
+    std::array<U, R * C> repr{};  // row-major, inside the object
+public:
+    using value_type = U;
+
+    /* Constructors */
+    constexpr Matrix() = default;  // R x C zeros
+    template<typename... A> requires (sizeof...(A) == R * C && R * C > 0 && (std::is_convertible_v<A, U> && ...))
+    constexpr Matrix(A... values) : repr{static_cast<U>(values)...} { }  // the elements, row after row
+    template<typename W> explicit Matrix(const MatrixView<W>& view);
+    static constexpr Matrix identity() requires (R == C);
+
+    /* Member Functions */
+    static constexpr size_t rows() { return R; }
+    static constexpr size_t columns() { return C; }
+    static constexpr size_t ld() { return C; }
+    constexpr U* data() { return repr.data(); }
+    constexpr const U* data() const { return repr.data(); }
+    constexpr Matrix<U, C, R> t() const;
+    constexpr Vector<U, C> row(size_t i) const;
+    constexpr Vector<U, R> col(size_t j) const;
+    MatrixView<U> view() { return MatrixView<U>(repr.data(), R, C, C, 1); }
+    MatrixView<const U> view() const { return MatrixView<const U>(repr.data(), R, C, C, 1); }
+
+    /* Non-Mathematical Operations */
+    constexpr U& operator()(size_t i, size_t j) { return repr[i * C + j]; }
+    constexpr const U& operator()(size_t i, size_t j) const { return repr[i * C + j]; }
+    constexpr std::span<U, C> operator[](size_t i) { return std::span<U, C>(repr.data() + i * C, C); }
+    constexpr std::span<const U, C> operator[](size_t i) const {
+        return std::span<const U, C>(repr.data() + i * C, C);
+    }
+    constexpr bool operator==(const Matrix& other) const = default;
+};
+
+/// Copies the elements of a view, which must be R x C; throws std::invalid_argument otherwise.
+template<typename U, size_t R, size_t C>
+template<typename W>
+Matrix<U, R, C>::Matrix(const MatrixView<W>& view) {
+    if (view.rows() != R || view.columns() != C) {
+        throw std::invalid_argument("\nA " + std::to_string(R) + "x" + std::to_string(C) +
+                                    " Matrix cannot be built from a " + std::to_string(view.rows()) + "x" +
+                                    std::to_string(view.columns()) + " view\n");
+    }
+    for (size_t i = 0; i < R; ++i) {
+        for (size_t j = 0; j < C; ++j) repr[i * C + j] = view(i, j);
+    }
+}
+
+/// The R x R identity Matrix.
+template<typename U, size_t R, size_t C>
+constexpr Matrix<U, R, C> Matrix<U, R, C>::identity() requires (R == C) {
+    Matrix result;
+    detail::static_for<R>([&](auto i) __attribute__((always_inline)) { result(i, i) = U(1); });
+    return result;
+}
+
+/// Matrix.t() returns the transpose, a new C x R Matrix.
+template<typename U, size_t R, size_t C>
+constexpr Matrix<U, C, R> Matrix<U, R, C>::t() const {
+    Matrix<U, C, R> result;
+    detail::static_for<R>([&](auto i) __attribute__((always_inline)) {
+        detail::static_for<C>([&](auto j) __attribute__((always_inline)) { result(j, i) = (*this)(i, j); });
+    });
+    return result;
+}
+
+/// Matrix.row(i) returns a copy of row i.
+template<typename U, size_t R, size_t C>
+constexpr Vector<U, C> Matrix<U, R, C>::row(size_t i) const {
+    Vector<U, C> result;
+    detail::static_for<C>([&](auto j) __attribute__((always_inline)) { result[j] = (*this)(i, j); });
+    return result;
+}
+
+/// Matrix.col(j) returns a copy of column j.
+template<typename U, size_t R, size_t C>
+constexpr Vector<U, R> Matrix<U, R, C>::col(size_t j) const {
+    Vector<U, R> result;
+    detail::static_for<R>([&](auto i) __attribute__((always_inline)) { result[i] = (*this)(i, j); });
+    return result;
+}
+
+
+/* ------------------------------------------ Fixed Vector Operators ------------------------------------------------ */
+
+
+/// Elementwise addition. Both Vectors have N elements, which the compiler has already checked.
+template<typename T, size_t N>
+requires fixed_extents<N>
+constexpr Vector<T, N> operator+(const Vector<T, N>& left, const Vector<T, N>& right) {
+    Vector<T, N> result;
+    detail::static_for<N>([&](auto i) __attribute__((always_inline)) { result[i] = left[i] + right[i]; });
+    return result;
+}
+
+/// Elementwise subtraction.
+template<typename T, size_t N>
+requires fixed_extents<N>
+constexpr Vector<T, N> operator-(const Vector<T, N>& left, const Vector<T, N>& right) {
+    Vector<T, N> result;
+    detail::static_for<N>([&](auto i) __attribute__((always_inline)) { result[i] = left[i] - right[i]; });
+    return result;
+}
+
+/// Multiplies every element by a scalar.
+template<typename T, size_t N>
+requires fixed_extents<N>
+constexpr Vector<T, N> operator*(const Vector<T, N>& vector, const std::type_identity_t<T>& scalar) {
+    Vector<T, N> result;
+    detail::static_for<N>([&](auto i) __attribute__((always_inline)) { result[i] = vector[i] * scalar; });
+    return result;
+}
+
+/// Scalar multiplication is commutative, so scalar * Vector is the same as Vector * scalar.
+template<typename T, size_t N>
+requires fixed_extents<N>
+constexpr Vector<T, N> operator*(const std::type_identity_t<T>& scalar, const Vector<T, N>& vector) {
+    return vector * scalar;
+}
+
+/// Divides every element by a scalar.
+template<typename T, size_t N>
+requires fixed_extents<N>
+constexpr Vector<T, N> operator/(const Vector<T, N>& vector, const std::type_identity_t<T>& scalar) {
+    Vector<T, N> result;
+    detail::static_for<N>([&](auto i) __attribute__((always_inline)) { result[i] = vector[i] / scalar; });
+    return result;
+}
+
+/// Adds right to left elementwise, in place.
+template<typename T, size_t N>
+requires fixed_extents<N>
+constexpr Vector<T, N>& operator+=(Vector<T, N>& left, const Vector<T, N>& right) {
+    detail::static_for<N>([&](auto i) __attribute__((always_inline)) { left[i] += right[i]; });
+    return left;
+}
+
+/// Subtracts right from left elementwise, in place.
+template<typename T, size_t N>
+requires fixed_extents<N>
+constexpr Vector<T, N>& operator-=(Vector<T, N>& left, const Vector<T, N>& right) {
+    detail::static_for<N>([&](auto i) __attribute__((always_inline)) { left[i] -= right[i]; });
+    return left;
+}
+
+/// Multiplies every element by a scalar, in place.
+template<typename T, size_t N>
+requires fixed_extents<N>
+constexpr Vector<T, N>& operator*=(Vector<T, N>& vector, const std::type_identity_t<T>& scalar) {
+    detail::static_for<N>([&](auto i) __attribute__((always_inline)) { vector[i] *= scalar; });
+    return vector;
+}
+
+/// Divides every element by a scalar, in place.
+template<typename T, size_t N>
+requires fixed_extents<N>
+constexpr Vector<T, N>& operator/=(Vector<T, N>& vector, const std::type_identity_t<T>& scalar) {
+    detail::static_for<N>([&](auto i) __attribute__((always_inline)) { vector[i] /= scalar; });
+    return vector;
+}
+
+/// The dot product: the sum of the products of the elements i of the two Vectors, for all i.
+template<typename T, size_t N>
+requires fixed_extents<N>
+constexpr T dot(const Vector<T, N>& left, const Vector<T, N>& right) {
+    T sum = T(0);
+    detail::static_for<N>([&](auto i) __attribute__((always_inline)) { sum += left[i] * right[i]; });
+    return sum;
+}
+
+/// The outer product: the N x M Matrix whose element (i, j) is left[i] * right[j].
+template<typename T, size_t N, size_t M>
+requires fixed_extents<N, M>
+constexpr Matrix<T, N, M> outer(const Vector<T, N>& left, const Vector<T, M>& right) {
+    Matrix<T, N, M> result;
+    detail::static_for<N>([&](auto i) __attribute__((always_inline)) {
+        detail::static_for<M>([&](auto j) __attribute__((always_inline)) { result(i, j) = left[i] * right[j]; });
+    });
+    return result;
+}
+
+
+/* ------------------------------------------ Fixed Matrix Operators ------------------------------------------------ */
+
+
+/// Elementwise addition of two R x C matrices.
+template<typename U, size_t R, size_t C>
+requires fixed_extents<R, C>
+constexpr Matrix<U, R, C> operator+(const Matrix<U, R, C>& left, const Matrix<U, R, C>& right) {
+    Matrix<U, R, C> result;
+    detail::static_for<R * C>([&](auto i) __attribute__((always_inline)) {
+        result.data()[i] = left.data()[i] + right.data()[i];
+    });
+    return result;
+}
+
+/// Elementwise subtraction of two R x C matrices.
+template<typename U, size_t R, size_t C>
+requires fixed_extents<R, C>
+constexpr Matrix<U, R, C> operator-(const Matrix<U, R, C>& left, const Matrix<U, R, C>& right) {
+    Matrix<U, R, C> result;
+    detail::static_for<R * C>([&](auto i) __attribute__((always_inline)) {
+        result.data()[i] = left.data()[i] - right.data()[i];
+    });
+    return result;
+}
+
+/// Multiplies every element by a scalar.
+template<typename U, size_t R, size_t C>
+requires fixed_extents<R, C>
+constexpr Matrix<U, R, C> operator*(const Matrix<U, R, C>& matrix, const std::type_identity_t<U>& scalar) {
+    Matrix<U, R, C> result;
+    detail::static_for<R * C>([&](auto i) __attribute__((always_inline)) {
+        result.data()[i] = matrix.data()[i] * scalar;
+    });
+    return result;
+}
+
+/// Scalar multiplication is commutative, so scalar * Matrix is the same as Matrix * scalar.
+template<typename U, size_t R, size_t C>
+requires fixed_extents<R, C>
+constexpr Matrix<U, R, C> operator*(const std::type_identity_t<U>& scalar, const Matrix<U, R, C>& matrix) {
+    return matrix * scalar;
+}
+
+/// Divides every element by a scalar.
+template<typename U, size_t R, size_t C>
+requires fixed_extents<R, C>
+constexpr Matrix<U, R, C> operator/(const Matrix<U, R, C>& matrix, const std::type_identity_t<U>& scalar) {
+    Matrix<U, R, C> result;
+    detail::static_for<R * C>([&](auto i) __attribute__((always_inline)) {
+        result.data()[i] = matrix.data()[i] / scalar;
+    });
+    return result;
+}
+
+/// Adds right to left elementwise, in place.
+template<typename U, size_t R, size_t C>
+requires fixed_extents<R, C>
+constexpr Matrix<U, R, C>& operator+=(Matrix<U, R, C>& left, const Matrix<U, R, C>& right) {
+    detail::static_for<R * C>([&](auto i) __attribute__((always_inline)) { left.data()[i] += right.data()[i]; });
+    return left;
+}
+
+/// Subtracts right from left elementwise, in place.
+template<typename U, size_t R, size_t C>
+requires fixed_extents<R, C>
+constexpr Matrix<U, R, C>& operator-=(Matrix<U, R, C>& left, const Matrix<U, R, C>& right) {
+    detail::static_for<R * C>([&](auto i) __attribute__((always_inline)) { left.data()[i] -= right.data()[i]; });
+    return left;
+}
+
+/// Multiplies every element by a scalar, in place.
+template<typename U, size_t R, size_t C>
+requires fixed_extents<R, C>
+constexpr Matrix<U, R, C>& operator*=(Matrix<U, R, C>& matrix, const std::type_identity_t<U>& scalar) {
+    detail::static_for<R * C>([&](auto i) __attribute__((always_inline)) { matrix.data()[i] *= scalar; });
+    return matrix;
+}
+
+/// Divides every element by a scalar, in place.
+template<typename U, size_t R, size_t C>
+requires fixed_extents<R, C>
+constexpr Matrix<U, R, C>& operator/=(Matrix<U, R, C>& matrix, const std::type_identity_t<U>& scalar) {
+    detail::static_for<R * C>([&](auto i) __attribute__((always_inline)) { matrix.data()[i] /= scalar; });
+    return matrix;
+}
+
+/**
+ * @brief Matrix product of an R x K and a K x C Matrix.
+ *
+ * Row i of the result is accumulated as the sum over k of left(i, k) times row k of right, so the innermost unrolled
+ * statements run along contiguous rows and the compiler can pack them into SIMD instructions.
+ */
+template<typename U, size_t R, size_t K, size_t C>
+requires fixed_extents<R, K, C>
+constexpr Matrix<U, R, C> operator*(const Matrix<U, R, K>& left, const Matrix<U, K, C>& right) {
+    Matrix<U, R, C> result;
+    U* out = result.data();
+    const U* a = left.data();
+    const U* b = right.data();
+    detail::static_for<R>([&](auto i) __attribute__((always_inline)) {
+        detail::static_for<K>([&](auto k) __attribute__((always_inline)) {
+            const U scale = a[i * K + k];
+            detail::static_for<C>([&](auto j) __attribute__((always_inline)) {
+                out[i * C + j] += scale * b[k * C + j];
+            });
+        });
+    });
+    return result;
+}
+
+/// Matrix-vector product of an R x C Matrix and a column Vector of C elements.
+template<typename U, size_t R, size_t C>
+requires fixed_extents<R, C>
+constexpr Vector<U, R> operator*(const Matrix<U, R, C>& matrix, const Vector<U, C>& vector) {
+    Vector<U, R> result;
+    detail::static_for<R>([&](auto i) __attribute__((always_inline)) {
+        U sum = U(0);
+        detail::static_for<C>([&](auto j) __attribute__((always_inline)) { sum += matrix(i, j) * vector[j]; });
+        result[i] = sum;
+    });
+    return result;
+}
+
+
+/* ---------------------------------------- PRINT INSTRUCTIONS FOR FIXED TYPES -------------------------------------- */
+
+
+template<typename T, size_t N>
+requires fixed_extents<N>
+std::ostream& operator<<(std::ostream& os, const Vector<T, N>& other) {
+    os << '[' << ' ';
+    for (const T& element : other) {
+        os << element << ' ';
+    }
+    return os << ']';
+}
+
+template<typename U, size_t R, size_t C>
+requires fixed_extents<R, C>
+std::ostream& operator<<(std::ostream& os, const Matrix<U, R, C>& other) {
+    /* same square layout as the dynamic Matrix: the first row opens with "[[" and the last one closes with "]]" */
+    os << "[[";
+    for (size_t i = 0; i < R; ++i) {
+        if (i != 0) os << "[ ";
+        for (size_t j = 0; j < C; ++j) {
+            os << other(i, j) << (j + 1 < C ? " " : (i + 1 < R ? " ]\n" : "]]\n"));
+        }
+    }
+    return os;
+}
+
+
+#endif //COMPUTER_BRAIN_FIXED_H
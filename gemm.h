@@ -0,0 +1,890 @@
+#ifndef COMPUTER_BRAIN_GEMM_H
+#define COMPUTER_BRAIN_GEMM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "aligned.h"
+#include "half.h"
+#include "instrument.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+/*
+ * General matrix multiply: C = alpha * op(A) * op(B) + beta * C.
+ *
+ * Every operand is described by a pointer and a pair of strides (distance between consecutive rows, distance between
+ * consecutive columns). A row-major Matrix with leading dimension ld has strides (ld, 1); the same Matrix read as its
+ * transpose has strides (1, ld). This is how the four transposition combinations of Matrix * Matrix reach one kernel.
+ *
+ * float and double go through a cache-blocked, packed GEMM in the style of BLIS/GotoBLAS:
+ *
+ *   for jc in N step NC           B panel (KC x NC) lives in L3
+ *     for pc in K step KC         pack B[pc:pc+KC, jc:jc+NC] into NR-wide micro-panels
+ *       for ic in M step MC       pack A[ic:ic+MC, pc:pc+KC] into MR-tall micro-panels, A block lives in L2
+ *         for jr in NC step NR    B micro-panel lives in L1
+ *           for ir in MC step MR  micro-kernel: MR x NR block of C stays in registers for the whole KC loop
+ *
+ * The micro-kernel is written once with GCC/Clang vector extensions and compiled for SSE2, AVX2+FMA and AVX-512; the
+ * one matching active_simd_isa() (see simd.h) is used. Every other element type uses a plain loop.
+ *
+ * Products of at most gemm_small_threshold multiply-adds skip the packing, which costs as much as the arithmetic at
+ * those sizes, and run an unpacked register-tiled kernel instead (GemmSmallKernel). Batches of independent products
+ * (gemm_batched_strided, gemm_batched) are shared out over the thread pool a whole product at a time. A C with a
+ * single row or column is a matrix-vector product and goes to gemv(), which streams A once without packing it.
+ *
+ * Products of at least gemm_parallel_threshold multiply-adds run on the library's thread pool. For every KC x NC
+ * panel, B is packed by all threads together, then the MC x NC blocks of C (split further along N when there are
+ * fewer blocks than threads) are shared out; each task packs its own block of A and runs the macro-kernel on it.
+ */
+
+/// Below this many multiply-adds (m * n * k) a GEMM stays on the calling thread.
+inline constexpr size_t gemm_parallel_threshold = size_t(1) << 18;
+
+/// Up to this many multiply-adds, a float or double GEMM with contiguous rows of B and C skips packing altogether and
+/// runs the small-product kernel (GemmSmallKernel) on the calling thread.
+inline constexpr size_t gemm_small_threshold = size_t(1) << 18;
+
+/* ------------------------------------------- GEMM Kernel Selection ------------------------------------------------ */
+
+
+namespace detail {
+
+/// Signature shared by every micro-kernel: C[MR x NR] = alpha * Apanel * Bpanel + beta * C.
+template<typename T>
+using GemmMicroKernel = void (*)(size_t kc, const T* a, const T* b, T* c, ptrdiff_t rs_c, ptrdiff_t cs_c,
+                                 T alpha, T beta);
+
+/// A micro-kernel together with the register tile (mr x nr) and cache blocking (mc, kc, nc) it was tuned for.
+template<typename T>
+struct GemmKernel {
+    GemmMicroKernel<T> micro_kernel;
+    size_t mr, nr;
+    size_t mc, kc, nc;
+};
+
+/**
+ * @brief The body of every GEMM micro-kernel.
+ *
+ * Computes an MR x (NV * W) block of C from a packed MR-tall panel of A and a packed NR-wide panel of B. The MR * NV
+ * accumulators are vector registers of W elements; on each step of the KC loop we load NV vectors of B, broadcast MR
+ * elements of A and issue MR * NV fused multiply-adds. The function is always inlined into a wrapper carrying a
+ * target attribute, so the same source becomes SSE2, AVX2 or AVX-512 code.
+ */
+template<typename T, int MR, int NV, int W>
+__attribute__((always_inline)) inline void gemm_micro_kernel_body(size_t kc, const T* a, const T* b, T* c,
+                                                                  ptrdiff_t rs_c, ptrdiff_t cs_c, T alpha, T beta) {
+    typedef T vec __attribute__((vector_size(W * sizeof(T))));
+    constexpr int NR = NV * W;
+
+    vec acc[MR][NV] = {};
+    for (size_t p = 0; p < kc; ++p) {
+        vec b_vec[NV];
+#pragma GCC unroll 8
+        for (int v = 0; v < NV; ++v) {
+            std::memcpy(&b_vec[v], b + v * W, sizeof(vec));
+        }
+#pragma GCC unroll 16
+        for (int i = 0; i < MR; ++i) {
+            const T a_i = a[i];
+#pragma GCC unroll 8
+            for (int v = 0; v < NV; ++v) {
+                acc[i][v] += b_vec[v] * a_i;
+            }
+        }
+        a += MR;
+        b += NR;
+    }
+
+    if (cs_c == 1) {  // if: rows of C are contiguous, update them a whole vector at a time
+#pragma GCC unroll 16
+        for (int i = 0; i < MR; ++i) {
+            T* c_row = c + i * rs_c;
+#pragma GCC unroll 8
+            for (int v = 0; v < NV; ++v) {
+                vec c_vec = acc[i][v] * alpha;
+                if (beta != T(0)) {  // beta == 0 must not read C, which may hold garbage or NaN
+                    vec old;
+                    std::memcpy(&old, c_row + v * W, sizeof(vec));
+                    c_vec += old * beta;
+                }
+                std::memcpy(c_row + v * W, &c_vec, sizeof(vec));
+            }
+        }
+    } else {  // else: C is strided, spill the tile and scatter it element by element
+        T tile[MR * NR];
+        std::memcpy(tile, acc, sizeof(tile));
+        for (int i = 0; i < MR; ++i) {
+            for (int j = 0; j < NR; ++j) {
+                T& c_ij = c[i * rs_c + j * cs_c];
+                c_ij = beta == T(0) ? alpha * tile[i * NR + j] : alpha * tile[i * NR + j] + beta * c_ij;
+            }
+        }
+    }
+}
+
+/* Micro-kernels: one wrapper per (type, instruction set); the register tile is sized to the register file. */
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+// AVX-512: 32 zmm registers; 12 x 2 accumulators + 2 B vectors + 1 broadcast
+COMPUTER_BRAIN_TARGET_AVX512 inline void gemm_micro_kernel_avx512(size_t kc, const double* a, const double* b,
+        double* c, ptrdiff_t rs_c, ptrdiff_t cs_c, double alpha, double beta) {
+    gemm_micro_kernel_body<double, 12, 2, 8>(kc, a, b, c, rs_c, cs_c, alpha, beta);
+}
+COMPUTER_BRAIN_TARGET_AVX512 inline void gemm_micro_kernel_avx512(size_t kc, const float* a, const float* b,
+        float* c, ptrdiff_t rs_c, ptrdiff_t cs_c, float alpha, float beta) {
+    gemm_micro_kernel_body<float, 12, 2, 16>(kc, a, b, c, rs_c, cs_c, alpha, beta);
+}
+// AVX2 + FMA: 16 ymm registers; 6 x 2 accumulators + 2 B vectors + 1 broadcast
+COMPUTER_BRAIN_TARGET_AVX2 inline void gemm_micro_kernel_avx2(size_t kc, const double* a, const double* b,
+        double* c, ptrdiff_t rs_c, ptrdiff_t cs_c, double alpha, double beta) {
+    gemm_micro_kernel_body<double, 6, 2, 4>(kc, a, b, c, rs_c, cs_c, alpha, beta);
+}
+COMPUTER_BRAIN_TARGET_AVX2 inline void gemm_micro_kernel_avx2(size_t kc, const float* a, const float* b,
+        float* c, ptrdiff_t rs_c, ptrdiff_t cs_c, float alpha, float beta) {
+    gemm_micro_kernel_body<float, 6, 2, 8>(kc, a, b, c, rs_c, cs_c, alpha, beta);
+}
+#endif
+// SSE2 (the x86-64 baseline) or whatever the compiler targets by default: 16 xmm registers; 4 x 2 accumulators
+inline void gemm_micro_kernel_sse2(size_t kc, const double* a, const double* b, double* c, ptrdiff_t rs_c,
+                                   ptrdiff_t cs_c, double alpha, double beta) {
+    gemm_micro_kernel_body<double, 4, 2, 2>(kc, a, b, c, rs_c, cs_c, alpha, beta);
+}
+inline void gemm_micro_kernel_sse2(size_t kc, const float* a, const float* b, float* c, ptrdiff_t rs_c,
+                                   ptrdiff_t cs_c, float alpha, float beta) {
+    gemm_micro_kernel_body<float, 4, 2, 4>(kc, a, b, c, rs_c, cs_c, alpha, beta);
+}
+
+/**
+ * @brief Returns the micro-kernel and blocking parameters for T and the active instruction set.
+ *
+ * KC is chosen so that a KC x NR micro-panel of B stays in L1, MC so that the packed MC x KC block of A stays in L2,
+ * and NC so that the packed KC x NC panel of B stays in L3.
+ */
+template<typename T>
+const GemmKernel<T>& gemm_kernel() {
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>,
+                  "The packed GEMM kernel is only available for float and double");
+    constexpr size_t kc = 256;
+    constexpr size_t nc = 4096;
+    static const GemmKernel<T> baseline{&gemm_micro_kernel_sse2, 4, 16 / sizeof(T) * 2, 64, kc, nc};
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+    static const GemmKernel<T> avx2{&gemm_micro_kernel_avx2, 6, 32 / sizeof(T) * 2, 72, kc, nc};
+    static const GemmKernel<T> avx512{&gemm_micro_kernel_avx512, 12, 64 / sizeof(T) * 2, 144, kc, nc};
+    switch (active_simd_isa()) {
+        case SimdIsa::avx512: return avx512;
+        case SimdIsa::avx2: return avx2;
+        default: break;
+    }
+#endif
+    return baseline;
+}
+
+/**
+ * Packs an mc x kc block of A into consecutive MR-tall micro-panels. Within a micro-panel the MR elements of one
+ * column are contiguous, which is the order the micro-kernel broadcasts them in. Rows past mc are filled with zeros.
+ */
+template<typename T>
+void gemm_pack_a(size_t mc, size_t kc, const T* a, ptrdiff_t rs_a, ptrdiff_t cs_a, size_t mr, T* packed) {
+    for (size_t ir = 0; ir < mc; ir += mr) {
+        const size_t rows = std::min(mr, mc - ir);
+        for (size_t i = 0; i < rows; ++i) {
+            const T* a_row = a + (ir + i) * rs_a;
+            for (size_t p = 0; p < kc; ++p) {
+                packed[p * mr + i] = a_row[p * cs_a];
+            }
+        }
+        for (size_t i = rows; i < mr; ++i) {
+            for (size_t p = 0; p < kc; ++p) {
+                packed[p * mr + i] = T(0);
+            }
+        }
+        packed += mr * kc;
+    }
+}
+
+/**
+ * Packs a kc x nc panel of B into consecutive NR-wide micro-panels. Within a micro-panel the NR elements of one row
+ * are contiguous, which is the order the micro-kernel loads them in. Columns past nc are filled with zeros.
+ */
+template<typename T>
+void gemm_pack_b(size_t kc, size_t nc, const T* b, ptrdiff_t rs_b, ptrdiff_t cs_b, size_t nr, T* packed) {
+    for (size_t jr = 0; jr < nc; jr += nr) {
+        const size_t cols = std::min(nr, nc - jr);
+        for (size_t p = 0; p < kc; ++p) {
+            const T* b_row = b + p * rs_b + jr * cs_b;
+            T* out = packed + p * nr;
+            if (cs_b == 1) {  // if: the row of B is contiguous, copy it in one go
+                std::memcpy(out, b_row, cols * sizeof(T));
+            } else {
+                for (size_t j = 0; j < cols; ++j) {
+                    out[j] = b_row[j * cs_b];
+                }
+            }
+            for (size_t j = cols; j < nr; ++j) {
+                out[j] = T(0);
+            }
+        }
+        packed += nr * kc;
+    }
+}
+
+/**
+ * @brief A packing buffer borrowed from the calling thread for as long as the object lives.
+ *
+ * Buffers are kept per thread and per nesting level and are reused from one GEMM to the next, so a GEMM does not
+ * allocate once the buffers have grown. The nesting level matters because a thread waiting on its own tasks may run
+ * a task from another GEMM, which must not overwrite the buffer the first one is still reading.
+ */
+template<typename T>
+class GemmScratch {
+public:
+    explicit GemmScratch(size_t size) : level(depth()++) {
+        std::vector<std::vector<T, AlignedAllocator<T>>>& buffers = stack();
+        if (buffers.size() <= level) buffers.resize(level + 1);
+        buffers[level].resize(size);
+        buffer = buffers[level].data();
+    }
+    ~GemmScratch() { --depth(); }
+    GemmScratch(const GemmScratch& other) = delete;
+    GemmScratch& operator=(const GemmScratch& other) = delete;
+    T* data() const { return buffer; }
+private:
+    size_t level;
+    T* buffer;
+    static std::vector<std::vector<T, AlignedAllocator<T>>>& stack() {
+        thread_local std::vector<std::vector<T, AlignedAllocator<T>>> buffers;
+        return buffers;
+    }
+    static size_t& depth() { thread_local size_t nesting = 0; return nesting; }
+};
+
+/// C = beta * C, treating beta == 0 as an assignment so that C may start out uninitialised.
+template<typename T>
+void gemm_scale_c(size_t m, size_t n, T beta, T* c, ptrdiff_t rs_c, ptrdiff_t cs_c) {
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            T& c_ij = c[i * rs_c + j * cs_c];
+            c_ij = beta == T(0) ? T(0) : T(beta * c_ij);
+        }
+    }
+}
+
+/**
+ * @brief Runs the micro-kernel over one packed mc x kc block of A and one packed kc x nc panel of B.
+ *
+ * Full MR x NR tiles are written straight into C. Tiles on the bottom or right edge are computed into a small buffer
+ * and only their valid part is merged into C.
+ */
+template<typename T>
+void gemm_macro_kernel(const GemmKernel<T>& kernel, size_t mc, size_t nc, size_t kc, T alpha,
+                       const T* packed_a, const T* packed_b, T beta, T* c, ptrdiff_t rs_c, ptrdiff_t cs_c) {
+    const size_t mr = kernel.mr;
+    const size_t nr = kernel.nr;
+    alignas(64) T edge_tile[32 * 32];  // large enough for every register tile above
+    for (size_t jr = 0; jr < nc; jr += nr) {
+        const size_t cols = std::min(nr, nc - jr);
+        const T* b_panel = packed_b + jr * kc;
+        for (size_t ir = 0; ir < mc; ir += mr) {
+            const size_t rows = std::min(mr, mc - ir);
+            const T* a_panel = packed_a + ir * kc;
+            T* c_tile = c + ir * rs_c + jr * cs_c;
+            if (rows == mr && cols == nr) {
+                kernel.micro_kernel(kc, a_panel, b_panel, c_tile, rs_c, cs_c, alpha, beta);
+            } else {
+                kernel.micro_kernel(kc, a_panel, b_panel, edge_tile, (ptrdiff_t)nr, 1, alpha, T(0));
+                for (size_t i = 0; i < rows; ++i) {
+                    for (size_t j = 0; j < cols; ++j) {
+                        T& c_ij = c_tile[i * rs_c + j * cs_c];
+                        c_ij = beta == T(0) ? edge_tile[i * nr + j] : edge_tile[i * nr + j] + beta * c_ij;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// The epilogue of a plain GEMM: nothing. See gemm_blocked().
+struct GemmNoEpilogue {
+    void operator()(size_t, size_t, size_t, size_t) const { }
+};
+
+/**
+ * @brief The blocked, packed GEMM for float and double. See the comment at the top of this file for the loop structure.
+ *
+ * Once a block of C has received its last KC step, epilogue(first_row, first_column, rows, columns) is called on it by
+ * the task that computed it, while the block is still in cache; dense.h uses this to add a bias and apply an
+ * activation without another pass over C. Every element of C is covered by exactly one call.
+ */
+template<typename T, typename Epilogue = GemmNoEpilogue>
+void gemm_blocked(size_t m, size_t n, size_t k, T alpha, const T* a, ptrdiff_t rs_a, ptrdiff_t cs_a,
+                  const T* b, ptrdiff_t rs_b, ptrdiff_t cs_b, T beta, T* c, ptrdiff_t rs_c, ptrdiff_t cs_c,
+                  const Epilogue& epilogue = Epilogue()) {
+    const GemmKernel<T>& kernel = gemm_kernel<T>();
+    ThreadPool& pool = ThreadPool::global();
+    const bool parallel = pool.num_threads() > 1 && m * n * k >= gemm_parallel_threshold;
+    GemmScratch<T> packed_b(kernel.kc * (kernel.nc + kernel.nr));
+
+    for (size_t jc = 0; jc < n; jc += kernel.nc) {
+        const size_t nc = std::min(kernel.nc, n - jc);
+        const size_t b_panels = (nc + kernel.nr - 1) / kernel.nr;
+        // C is cut into (MC block of rows) x (group of NR micro-panels) tasks, at least one per thread if possible
+        const size_t ic_blocks = (m + kernel.mc - 1) / kernel.mc;
+        const size_t jr_splits = parallel ? std::min(b_panels, (pool.num_threads() + ic_blocks - 1) / ic_blocks) : 1;
+        const size_t panels_per_split = (b_panels + jr_splits - 1) / jr_splits;
+
+        for (size_t pc = 0; pc < k; pc += kernel.kc) {
+            const size_t kc = std::min(kernel.kc, k - pc);
+            const T beta_pc = pc == 0 ? beta : T(1);  // after the first KC block, C already holds a partial sum
+            const T* b_block = b + pc * rs_b + jc * cs_b;
+
+            auto pack_b = [&](size_t first_panel, size_t last_panel) {
+                const size_t j0 = first_panel * kernel.nr;
+                const size_t j1 = std::min(nc, last_panel * kernel.nr);
+                gemm_pack_b(kc, j1 - j0, b_block + j0 * cs_b, rs_b, cs_b, kernel.nr, packed_b.data() + j0 * kc);
+            };
+            auto compute = [&](size_t first_task, size_t last_task) {
+                GemmScratch<T> packed_a(kernel.mc * kernel.kc);
+                for (size_t task = first_task; task < last_task; ++task) {
+                    const size_t ic = (task / jr_splits) * kernel.mc;
+                    const size_t mc = std::min(kernel.mc, m - ic);
+                    const size_t j0 = (task % jr_splits) * panels_per_split * kernel.nr;
+                    if (j0 >= nc) continue;
+                    const size_t j1 = std::min(nc, j0 + panels_per_split * kernel.nr);
+                    gemm_pack_a(mc, kc, a + ic * rs_a + pc * cs_a, rs_a, cs_a, kernel.mr, packed_a.data());
+                    gemm_macro_kernel(kernel, mc, j1 - j0, kc, alpha, packed_a.data(), packed_b.data() + j0 * kc,
+                                      beta_pc, c + ic * rs_c + (jc + j0) * cs_c, rs_c, cs_c);
+                    if (pc + kc == k) epilogue(ic, jc + j0, mc, j1 - j0);
+                }
+            };
+
+            if (parallel) {
+                pool.parallel_for(0, b_panels, 4, pack_b);
+                pool.parallel_for(0, ic_blocks * jr_splits, 1, compute);
+            } else {
+                pack_b(0, b_panels);
+                compute(0, ic_blocks);
+            }
+        }
+    }
+}
+
+/**
+ * @brief The unpacked GEMM kernel for small products, as a SIMD kernel (see simd.h for the run<Bytes> convention).
+ *
+ * Packing A and B pays off when every packed element is reused many times, which is not the case when m, n and k are
+ * a few dozen at most: there, the copies cost as much as the multiply-adds they feed. This kernel reads B and C in
+ * place instead (their rows must be contiguous: cs_b == cs_c == 1) and keeps MR rows x NV vectors of C in registers
+ * while it runs over k, broadcasting elements of A straight from their strided positions.
+ */
+template<typename T> struct GemmSmallKernel {
+    template<int Bytes> __attribute__((always_inline)) static inline void run(
+            size_t m, size_t n, size_t k, T alpha, const T* a, ptrdiff_t rs_a, ptrdiff_t cs_a, const T* b,
+            ptrdiff_t rs_b, T beta, T* c, ptrdiff_t rs_c) {
+        size_t i = 0;
+        for (; i + 4 <= m; i += 4) {
+            rows<Bytes, 4>(n, k, alpha, a + i * rs_a, rs_a, cs_a, b, rs_b, beta, c + i * rs_c, rs_c);
+        }
+        for (; i < m; ++i) {
+            rows<Bytes, 1>(n, k, alpha, a + i * rs_a, rs_a, cs_a, b, rs_b, beta, c + i * rs_c, rs_c);
+        }
+    }
+
+    /// Computes MR full rows of C: two vectors of columns at a time, then one, then the remaining columns with
+    /// vectors half as wide, down to one element.
+    template<int Bytes, int MR> __attribute__((always_inline)) static inline void rows(
+            size_t n, size_t k, T alpha, const T* a, ptrdiff_t rs_a, ptrdiff_t cs_a, const T* b, ptrdiff_t rs_b,
+            T beta, T* c, ptrdiff_t rs_c) {
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        size_t j = 0;
+        if constexpr (W > 1) {
+            for (; j + 2 * W <= n; j += 2 * W) {
+                tile<Bytes, MR, 2>(k, alpha, a, rs_a, cs_a, b + j, rs_b, beta, c + j, rs_c);
+            }
+            for (; j + W <= n; j += W) {
+                tile<Bytes, MR, 1>(k, alpha, a, rs_a, cs_a, b + j, rs_b, beta, c + j, rs_c);
+            }
+            if (j < n) rows<Bytes / 2, MR>(n - j, k, alpha, a, rs_a, cs_a, b + j, rs_b, beta, c + j, rs_c);
+        } else {
+            for (; j < n; ++j) {
+                T acc[MR] = {};
+                for (size_t p = 0; p < k; ++p) {
+                    const T b_pj = b[p * rs_b + j];
+#pragma GCC unroll 4
+                    for (int r = 0; r < MR; ++r) acc[r] += a[r * rs_a + p * cs_a] * b_pj;
+                }
+#pragma GCC unroll 4
+                for (int r = 0; r < MR; ++r) {
+                    T& c_rj = c[r * rs_c + j];
+                    c_rj = beta == T(0) ? alpha * acc[r] : alpha * acc[r] + beta * c_rj;
+                }
+            }
+        }
+    }
+
+    /// C[MR x NV * W] = alpha * A[MR x k] * B[k x NV * W] + beta * C, with the whole tile of C held in registers.
+    template<int Bytes, int MR, int NV> __attribute__((always_inline)) static inline void tile(
+            size_t k, T alpha, const T* a, ptrdiff_t rs_a, ptrdiff_t cs_a, const T* b, ptrdiff_t rs_b, T beta,
+            T* c, ptrdiff_t rs_c) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        vec acc[MR][NV] = {};
+        for (size_t p = 0; p < k; ++p) {
+            vec b_vec[NV];
+#pragma GCC unroll 2
+            for (int v = 0; v < NV; ++v) {
+                std::memcpy(&b_vec[v], b + p * rs_b + v * W, sizeof(vec));
+            }
+#pragma GCC unroll 4
+            for (int r = 0; r < MR; ++r) {
+                const T a_rp = a[r * rs_a + p * cs_a];
+#pragma GCC unroll 2
+                for (int v = 0; v < NV; ++v) {
+                    acc[r][v] += b_vec[v] * a_rp;
+                }
+            }
+        }
+#pragma GCC unroll 4
+        for (int r = 0; r < MR; ++r) {
+#pragma GCC unroll 2
+            for (int v = 0; v < NV; ++v) {
+                T* c_rv = c + r * rs_c + v * W;
+                vec c_vec = acc[r][v] * alpha;
+                if (beta != T(0)) {  // beta == 0 must not read C, which may hold garbage or NaN
+                    vec old;
+                    std::memcpy(&old, c_rv, sizeof(vec));
+                    c_vec += old * beta;
+                }
+                std::memcpy(c_rv, &c_vec, sizeof(vec));
+            }
+        }
+    }
+};
+
+/**
+ * GEMM for element types without a packed kernel (integers, user types). Loops in i-p-j order over C; large products
+ * are split by rows of C across the thread pool.
+ */
+template<typename T>
+void gemm_reference(size_t m, size_t n, size_t k, T alpha, const T* a, ptrdiff_t rs_a, ptrdiff_t cs_a,
+                    const T* b, ptrdiff_t rs_b, ptrdiff_t cs_b, T beta, T* c, ptrdiff_t rs_c, ptrdiff_t cs_c) {
+    gemm_scale_c(m, n, beta, c, rs_c, cs_c);
+    const size_t grain = std::max<size_t>(1, gemm_parallel_threshold / (n * k));
+    parallel_for(0, m, grain, [&](size_t first_row, size_t last_row) {
+        for (size_t i = first_row; i < last_row; ++i) {
+            T* c_row = c + i * rs_c;
+            for (size_t p = 0; p < k; ++p) {
+                const T a_ip = alpha * a[i * rs_a + p * cs_a];
+                const T* b_row = b + p * rs_b;
+                for (size_t j = 0; j < n; ++j) {
+                    c_row[j * cs_c] += a_ip * b_row[j * cs_b];
+                }
+            }
+        }
+    });
+}
+
+}  // namespace detail
+
+
+/* ------------------------------------------------------ GEMV ------------------------------------------------------ */
+
+
+namespace detail {
+
+/**
+ * @brief sums[r] = A[r, :] . x for the rows of an A whose rows are contiguous, as a SIMD kernel (see simd.h).
+ *
+ * Four rows are read side by side, two vectors of each at a time, so that every vector of x loaded feeds eight
+ * independent multiply-adds. Rows left over at the end are single dot products.
+ */
+template<typename T> struct GemvRowsKernel {
+    template<int Bytes> __attribute__((always_inline)) static inline void run(
+            size_t rows, size_t n, const T* a, ptrdiff_t rs_a, const T* x, T* sums) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        size_t r = 0;
+        for (; r + 4 <= rows; r += 4) {
+            const T* row[4] = {a + r * rs_a, a + (r + 1) * rs_a, a + (r + 2) * rs_a, a + (r + 3) * rs_a};
+            vec acc[4][2] = {};
+            size_t j = 0;
+            for (; j + 2 * W <= n; j += 2 * W) {
+                vec x_vec[2];
+                std::memcpy(&x_vec[0], x + j, sizeof(vec));
+                std::memcpy(&x_vec[1], x + j + W, sizeof(vec));
+#pragma GCC unroll 4
+                for (int u = 0; u < 4; ++u) {
+#pragma GCC unroll 2
+                    for (int v = 0; v < 2; ++v) {
+                        vec a_vec;
+                        std::memcpy(&a_vec, row[u] + j + v * W, sizeof(vec));
+                        acc[u][v] += a_vec * x_vec[v];
+                    }
+                }
+            }
+#pragma GCC unroll 4
+            for (int u = 0; u < 4; ++u) {
+                const vec total = acc[u][0] + acc[u][1];
+                T sum = T(0);
+                for (size_t lane = 0; lane < W; ++lane) sum += total[lane];
+                for (size_t jj = j; jj < n; ++jj) sum += row[u][jj] * x[jj];
+                sums[r + u] = sum;
+            }
+        }
+        for (; r < rows; ++r) sums[r] = SimdDot<T>::template run<Bytes>(a + r * rs_a, x, n);
+    }
+};
+
+/**
+ * @brief sums[i] += A[i, :] . x for the rows of an A whose columns are contiguous, as a SIMD kernel (see simd.h).
+ *
+ * The columns are swept four at a time, each adding its x[j] multiple into sums, which stays in L1 for the whole
+ * sweep; every element of A is loaded exactly once.
+ */
+template<typename T> struct GemvColumnsKernel {
+    template<int Bytes> __attribute__((always_inline)) static inline void run(
+            size_t rows, size_t n, const T* a, ptrdiff_t cs_a, const T* x, T* sums) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        size_t j = 0;
+        for (; j + 4 <= n; j += 4) {
+            const T* column[4] = {a + j * cs_a, a + (j + 1) * cs_a, a + (j + 2) * cs_a, a + (j + 3) * cs_a};
+            size_t i = 0;
+            for (; i + W <= rows; i += W) {
+                vec sum;
+                std::memcpy(&sum, sums + i, sizeof(vec));
+#pragma GCC unroll 4
+                for (int u = 0; u < 4; ++u) {
+                    vec a_vec;
+                    std::memcpy(&a_vec, column[u] + i, sizeof(vec));
+                    sum += a_vec * x[j + u];
+                }
+                std::memcpy(sums + i, &sum, sizeof(vec));
+            }
+            for (; i < rows; ++i) {
+#pragma GCC unroll 4
+                for (int u = 0; u < 4; ++u) sums[i] += column[u][i] * x[j + u];
+            }
+        }
+        for (; j < n; ++j) {
+            const T* column = a + j * cs_a;
+            for (size_t i = 0; i < rows; ++i) sums[i] += column[i] * x[j];
+        }
+    }
+};
+
+}  // namespace detail
+
+
+/**
+ * @brief Matrix-vector multiply: y = alpha * A * x + beta * y, with A m x n.
+ *
+ * A is given by a pointer and strides as in gemm(), so A^T * x is the same call with the strides swapped; x and y by
+ * a pointer and a stride. Every element of A is read exactly once, whichever way it is laid out:
+ *
+ *   contiguous rows (cs_a == 1)       each row is a dot product with x, four rows at a time (GemvRowsKernel)
+ *   contiguous columns (rs_a == 1)    blocks of y are accumulated column by column (GemvColumnsKernel)
+ *   anything else                     a plain loop
+ *
+ * Rows (or blocks of rows) are shared out over the thread pool; each y[i] is computed by one thread in a fixed order,
+ * so the result does not depend on the number of threads. When beta is zero y is only written. y must not overlap A
+ * or x.
+ */
+template<typename T>
+void gemv(size_t m, size_t n, T alpha, const T* a, ptrdiff_t rs_a, ptrdiff_t cs_a, const T* x, ptrdiff_t incx,
+          T beta, T* y, ptrdiff_t incy) {
+    if (m == 0) {
+        return;
+    }
+    COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::gemv, (OpShape{{m, n}, 2}), 2 * m * n,
+                                 (m * n + n + (beta == T(0) ? 1 : 2) * m) * sizeof(T));
+    if (n == 0 || alpha == T(0)) {  // if: there is nothing to accumulate, y only needs scaling
+        detail::gemm_scale_c(m, 1, beta, y, incy, 1);
+        return;
+    }
+    detail::GemmScratch<T> x_copy(incx == 1 ? 0 : n);  // the kernels read x contiguously
+    if (incx != 1) {
+        for (size_t j = 0; j < n; ++j) x_copy.data()[j] = x[j * incx];
+        x = x_copy.data();
+    }
+    const auto finish = [&](size_t i, const T& sum) {
+        T& y_i = y[i * incy];
+        y_i = beta == T(0) ? alpha * sum : alpha * sum + beta * y_i;
+    };
+    constexpr size_t block = 512;  // rows computed into one buffer of sums
+    const size_t grain = std::max<size_t>(1, (size_t(1) << 15) / n);
+    const bool by_columns = rs_a == 1 && cs_a != 1;
+    parallel_for(0, (m + block - 1) / block, std::max<size_t>(1, grain / block), [&](size_t first, size_t last) {
+        T sums[block];
+        for (size_t b = first; b < last; ++b) {
+            const size_t i0 = b * block;
+            const size_t rows = std::min(block, m - i0);
+            const T* a_block = a + i0 * rs_a;
+            if (by_columns) {
+                std::fill(sums, sums + rows, T(0));
+                if constexpr (is_simd_type<T>) {
+                    detail::simd_dispatch<T, detail::GemvColumnsKernel<T>>(rows, n, a_block, cs_a, x, &sums[0]);
+                } else {
+                    for (size_t j = 0; j < n; ++j) {
+                        for (size_t r = 0; r < rows; ++r) sums[r] += a_block[j * cs_a + r] * x[j];
+                    }
+                }
+            } else if (cs_a == 1) {
+                if constexpr (is_simd_type<T>) {
+                    detail::simd_dispatch<T, detail::GemvRowsKernel<T>>(rows, n, a_block, rs_a, x, &sums[0]);
+                } else {
+                    for (size_t r = 0; r < rows; ++r) sums[r] = simd_dot(a_block + r * rs_a, x, n);
+                }
+            } else {
+                for (size_t r = 0; r < rows; ++r) {
+                    sums[r] = T(0);
+                    for (size_t j = 0; j < n; ++j) sums[r] += a_block[r * rs_a + j * cs_a] * x[j];
+                }
+            }
+            for (size_t r = 0; r < rows; ++r) finish(i0 + r, sums[r]);
+        }
+    });
+}
+
+
+/* ------------------------------------------------ GEMM Entry Point ------------------------------------------------ */
+
+
+namespace detail {
+template<typename H>
+void gemm_half_output(size_t m, size_t n, size_t k, H alpha, const H* a, ptrdiff_t rs_a, ptrdiff_t cs_a,
+                      const H* b, ptrdiff_t rs_b, ptrdiff_t cs_b, H beta, H* c, ptrdiff_t rs_c, ptrdiff_t cs_c);
+}  // namespace detail
+
+
+/**
+ * @brief General matrix multiply: C = alpha * A * B + beta * C.
+ *
+ * A is m x k, B is k x n and C is m x n. Each operand is given as a pointer to its first element plus the distance
+ * between consecutive rows (rs_) and consecutive columns (cs_); pass swapped strides to use an operand transposed.
+ * When beta is zero C is only written, never read.
+ *
+ * @tparam T the element type. float and double use the packed, register-tiled kernel, float16 and bfloat16 the same
+ *           kernel on blocks converted to float (half.h), other types a plain loop.
+ */
+template<typename T>
+void gemm(size_t m, size_t n, size_t k, T alpha, const T* a, ptrdiff_t rs_a, ptrdiff_t cs_a,
+          const T* b, ptrdiff_t rs_b, ptrdiff_t cs_b, T beta, T* c, ptrdiff_t rs_c, ptrdiff_t cs_c) {
+    if (m == 0 || n == 0) {
+        return;
+    }
+    COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::gemm, (OpShape{{m, n, k}, 3}), 2 * m * n * k,
+                                 (m * k + k * n + (beta == T(0) ? 1 : 2) * m * n) * sizeof(T));
+    if (k == 0 || alpha == T(0)) {  // if: there is nothing to accumulate, C only needs scaling
+        detail::gemm_scale_c(m, n, beta, c, rs_c, cs_c);
+        return;
+    }
+    if constexpr (is_half_type<T>) {
+        detail::gemm_half_output(m, n, k, alpha, a, rs_a, cs_a, b, rs_b, cs_b, beta, c, rs_c, cs_c);
+    } else if (n == 1) {  // C is a column: A * b
+        gemv(m, k, alpha, a, rs_a, cs_a, b, rs_b, beta, c, rs_c);
+    } else if (m == 1) {  // C is a row: (B^T * a)^T
+        gemv(n, k, alpha, b, cs_b, rs_b, a, cs_a, beta, c, cs_c);
+    } else if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+        if (m * n * k <= gemm_small_threshold && cs_b == 1 && cs_c == 1) {
+            detail::simd_dispatch<T, detail::GemmSmallKernel<T>>(m, n, k, alpha, a, rs_a, cs_a, b, rs_b, beta, c,
+                                                                 rs_c);
+            return;
+        }
+        detail::gemm_blocked(m, n, k, alpha, a, rs_a, cs_a, b, rs_b, cs_b, beta, c, rs_c, cs_c);
+    } else {
+        detail::gemm_reference(m, n, k, alpha, a, rs_a, cs_a, b, rs_b, cs_b, beta, c, rs_c, cs_c);
+    }
+}
+
+
+/* --------------------------------------------- Half-Precision GEMM ------------------------------------------------ */
+
+
+namespace detail {
+
+/**
+ * Converts a rows x columns block of a 16-bit operand to float, in whichever direction is contiguous in the source, and
+ * sets the strides of the converted block.
+ */
+template<typename H>
+void gemm_convert_block(size_t rows, size_t columns, const H* src, ptrdiff_t rs, ptrdiff_t cs, float* dst,
+                        ptrdiff_t& dst_rs, ptrdiff_t& dst_cs) {
+    const bool by_columns = rs == 1 && cs != 1;
+    const size_t runs = by_columns ? columns : rows;
+    const size_t run_length = by_columns ? rows : columns;
+    const ptrdiff_t run_stride = by_columns ? cs : rs;
+    const ptrdiff_t step = by_columns ? rs : cs;
+    dst_rs = by_columns ? 1 : (ptrdiff_t)columns;
+    dst_cs = by_columns ? (ptrdiff_t)rows : 1;
+    const size_t grain = std::max<size_t>(1, (size_t(1) << 16) / std::max<size_t>(run_length, 1));
+    parallel_for(0, runs, grain, [&](size_t first, size_t last) {
+        for (size_t r = first; r < last; ++r) {
+            const H* run = src + r * run_stride;
+            float* out = dst + r * run_length;
+            if (step == 1) {
+                convert_elements(run, out, run_length);
+            } else {
+                for (size_t e = 0; e < run_length; ++e) out[e] = (float)run[e * step];
+            }
+        }
+    });
+}
+
+/**
+ * @brief C = alpha * A * B + beta * C with A and B in 16 bits and C in float.
+ *
+ * Blocks of A (up to 2048 x 256) and B (up to 256 x 4096) are converted to float and multiplied by the float GEMM, so
+ * every multiply-add happens in float with the packed kernel. The conversions add O(mk + kn) work per block pair,
+ * against O(mnk) for the product, and the converted blocks take at most 6 MB.
+ */
+template<typename H>
+void gemm_half(size_t m, size_t n, size_t k, float alpha, const H* a, ptrdiff_t rs_a, ptrdiff_t cs_a,
+               const H* b, ptrdiff_t rs_b, ptrdiff_t cs_b, float beta, float* c, ptrdiff_t rs_c, ptrdiff_t cs_c) {
+    if (m == 0 || n == 0) {
+        return;
+    }
+    if (k == 0 || alpha == 0.0f) {
+        gemm_scale_c(m, n, beta, c, rs_c, cs_c);
+        return;
+    }
+    constexpr size_t mc = 2048, kc = 256, nc = 4096;
+    GemmScratch<float> a_block(std::min(m, mc) * std::min(k, kc));
+    GemmScratch<float> b_block(std::min(k, kc) * std::min(n, nc));
+    for (size_t jc = 0; jc < n; jc += nc) {
+        const size_t cols = std::min(nc, n - jc);
+        for (size_t pc = 0; pc < k; pc += kc) {
+            const size_t depth = std::min(kc, k - pc);
+            ptrdiff_t rs_bb, cs_bb;
+            gemm_convert_block(depth, cols, b + pc * rs_b + jc * cs_b, rs_b, cs_b, b_block.data(), rs_bb, cs_bb);
+            for (size_t ic = 0; ic < m; ic += mc) {
+                const size_t rows = std::min(mc, m - ic);
+                ptrdiff_t rs_ab, cs_ab;
+                gemm_convert_block(rows, depth, a + ic * rs_a + pc * cs_a, rs_a, cs_a, a_block.data(), rs_ab, cs_ab);
+                gemm<float>(rows, cols, depth, alpha, a_block.data(), rs_ab, cs_ab, b_block.data(), rs_bb, cs_bb,
+                            pc == 0 ? beta : 1.0f, c + ic * rs_c + jc * cs_c, rs_c, cs_c);
+            }
+        }
+    }
+}
+
+/// gemm() for a C in 16 bits: the product is accumulated into a float copy of C, which is rounded once at the end.
+template<typename H>
+void gemm_half_output(size_t m, size_t n, size_t k, H alpha, const H* a, ptrdiff_t rs_a, ptrdiff_t cs_a,
+                      const H* b, ptrdiff_t rs_b, ptrdiff_t cs_b, H beta, H* c, ptrdiff_t rs_c, ptrdiff_t cs_c) {
+    GemmScratch<float> c_float(m * n);
+    ptrdiff_t rs_cf = (ptrdiff_t)n, cs_cf = 1;
+    if ((float)beta != 0.0f) gemm_convert_block(m, n, c, rs_c, cs_c, c_float.data(), rs_cf, cs_cf);
+    gemm_half(m, n, k, (float)alpha, a, rs_a, cs_a, b, rs_b, cs_b, (float)beta, c_float.data(), rs_cf, cs_cf);
+    for (size_t i = 0; i < m; ++i) {
+        if (cs_c == 1 && cs_cf == 1) {
+            convert_elements(c_float.data() + i * n, c + i * rs_c, n);
+        } else {
+            for (size_t j = 0; j < n; ++j) c[i * rs_c + j * cs_c] = H(c_float.data()[i * rs_cf + j * cs_cf]);
+        }
+    }
+}
+
+}  // namespace detail
+
+
+/**
+ * @brief C = alpha * A * B + beta * C with A and B in float16 or bfloat16 and C in float.
+ *
+ * The arguments are those of gemm(); every multiply-add is done in float (see detail::gemm_half). gemm() with a C of
+ * the same 16-bit type as A and B also works, and rounds the float result to 16 bits once.
+ */
+template<typename H> requires is_half_type<H>
+void gemm(size_t m, size_t n, size_t k, float alpha, const H* a, ptrdiff_t rs_a, ptrdiff_t cs_a,
+          const H* b, ptrdiff_t rs_b, ptrdiff_t cs_b, float beta, float* c, ptrdiff_t rs_c, ptrdiff_t cs_c) {
+    COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::gemm, (OpShape{{m, n, k}, 3}), 2 * m * n * k,
+                                 (m * k + k * n) * sizeof(H) + (beta == 0.0f ? 1 : 2) * m * n * sizeof(float));
+    detail::gemm_half(m, n, k, alpha, a, rs_a, cs_a, b, rs_b, cs_b, beta, c, rs_c, cs_c);
+}
+
+
+
+/* ------------------------------------------------- Batched GEMM --------------------------------------------------- */
+
+
+/**
+ * @brief One product of a variable-shaped batch: C = alpha * A * B + beta * C, with the arguments of gemm().
+ */
+template<typename T>
+struct GemmProblem {
+    size_t m, n, k;
+    T alpha;
+    const T* a;
+    ptrdiff_t rs_a, cs_a;
+    const T* b;
+    ptrdiff_t rs_b, cs_b;
+    T beta;
+    T* c;
+    ptrdiff_t rs_c, cs_c;
+};
+
+
+namespace detail {
+
+/**
+ * Runs product(i) for every i in [0, count) of a batch whose products add up to total_work multiply-adds. The batch is
+ * shared out over the thread pool in chunks of about gemm_parallel_threshold multiply-adds each, so a batch of tiny
+ * products is not cut into tasks that cost more to schedule than to run. A product that is large on its own still
+ * goes parallel inside gemm(), which is safe from a worker.
+ */
+template<typename F>
+void gemm_batch_for(size_t count, size_t total_work, F&& product) {
+    const size_t work_per_product = std::max<size_t>(1, total_work / std::max<size_t>(count, 1));
+    const size_t grain = std::max<size_t>(1, gemm_parallel_threshold / work_per_product);
+    parallel_for(0, count, grain, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) product(i);
+    });
+}
+
+}  // namespace detail
+
+
+/**
+ * @brief Batched GEMM over same-shaped operands laid out at a fixed distance from each other.
+ *
+ * For every i in [0, batch): C_i = alpha * A_i * B_i + beta * C_i, where A_i starts at a + i * stride_a, B_i at
+ * b + i * stride_b and C_i at c + i * stride_c, and every A_i, B_i and C_i has the strides of gemm(). A stride of zero
+ * shares one operand between all products (the same B for a batch of A, for example); the C_i must not overlap.
+ *
+ * The products are distributed over the thread pool, and each one runs on a single thread with the small-product
+ * kernel when it is small enough, which is where batches spend most of their time with one gemm() call per product.
+ */
+template<typename T>
+void gemm_batched_strided(size_t batch, size_t m, size_t n, size_t k, T alpha,
+                          const T* a, ptrdiff_t rs_a, ptrdiff_t cs_a, ptrdiff_t stride_a,
+                          const T* b, ptrdiff_t rs_b, ptrdiff_t cs_b, ptrdiff_t stride_b, T beta,
+                          T* c, ptrdiff_t rs_c, ptrdiff_t cs_c, ptrdiff_t stride_c) {
+    if (batch == 0 || m == 0 || n == 0) {
+        return;
+    }
+    detail::gemm_batch_for(batch, batch * m * n * std::max<size_t>(k, 1), [&](size_t i) {
+        gemm<T>(m, n, k, alpha, a + (ptrdiff_t)i * stride_a, rs_a, cs_a, b + (ptrdiff_t)i * stride_b, rs_b, cs_b,
+                beta, c + (ptrdiff_t)i * stride_c, rs_c, cs_c);
+    });
+}
+
+/**
+ * @brief Batched GEMM over products of any shapes, each described by a GemmProblem.
+ *
+ * Every problem is computed as by gemm(); the batch is distributed over the thread pool as in gemm_batched_strided().
+ * The C of one problem must not overlap the operands of another.
+ */
+template<typename T>
+void gemm_batched(std::span<const GemmProblem<T>> problems) {
+    size_t total_work = 0;
+    for (const GemmProblem<T>& p : problems) total_work += p.m * p.n * std::max<size_t>(p.k, 1);
+    detail::gemm_batch_for(problems.size(), total_work, [&](size_t i) {
+        const GemmProblem<T>& p = problems[i];
+        gemm<T>(p.m, p.n, p.k, p.alpha, p.a, p.rs_a, p.cs_a, p.b, p.rs_b, p.cs_b, p.beta, p.c, p.rs_c, p.cs_c);
+    });
+}
+
+#endif //COMPUTER_BRAIN_GEMM_H
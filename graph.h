@@ -0,0 +1,796 @@
+#ifndef COMPUTER_BRAIN_GRAPH_H
+#define COMPUTER_BRAIN_GRAPH_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "aligned.h"
+#include "elementwise.h"
+#include "expression.h"
+#include "gemm.h"
+#include "instrument.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "view.h"
+
+/*
+ * Lazy evaluation: Graph and LazyMatrix.
+ *
+ * Every operator on Vector and Matrix runs when it is called and returns a new object. For a whole model that is one
+ * allocation per intermediate result, each of them alive until the statement or scope ends, and one operation at a
+ * time. A Graph instead records the operations and runs them all at once when evaluate() is called:
+ *
+ *     Graph<float> graph;
+ *     LazyMatrix<float> x = graph.input(X), w1 = graph.input(W1), b1 = graph.input(B1);  // nothing is copied
+ *     LazyMatrix<float> w2 = graph.input(W2), b2 = graph.input(B2);
+ *     LazyMatrix<float> h = tanh(add_row(x * w1, b1));
+ *     LazyMatrix<float> y = softmax(add_row(h * w2, b2));
+ *     Matrix<float> out = graph.evaluate(y);
+ *
+ * The graph is optimised in four ways:
+ *
+ *   - Common subexpressions are merged when they are built: asking twice for x * w1 (or for a + b and b + a) returns
+ *     the same node, so it is computed once.
+ *   - Elementwise nodes (+, -, scalar * and /, add_row() and the functions of elementwise.h) whose result is used only
+ *     by another elementwise node are fused into it. A chain like tanh(add_row(x * w1, b1) * 0.5f) is computed in one
+ *     pass, a block of a row at a time, with the blocks of its intermediate results in registers and L1 cache.
+ *   - The nodes that do need a buffer share a few: once the last node reading a result has run, its buffer is given to
+ *     a later node, and an elementwise node or a softmax writes over its operand when nothing else reads that operand.
+ *   - Nodes are scheduled by level (the longest path from the inputs), and the nodes of a level, which do not depend on
+ *     each other, run in parallel on the thread pool, each of them parallel inside as well.
+ *
+ * The graph holds views of its inputs: they must outlive every evaluate(), and they are read when evaluate() runs, so
+ * the same graph can be evaluated again after the inputs were changed in place. The plan of the last evaluate() and the
+ * buffers of the intermediate results are kept by the Graph, so that evaluating the same outputs again allocates only
+ * the results. stats() describes what the last evaluate() did.
+ *
+ * A Graph is used by one thread at a time, and only float and double elements are supported. LazyMatrix handles are
+ * small values that refer to a node of their Graph; they are invalidated by clear().
+ */
+
+template<typename T> class Graph;
+
+/// The operations a Graph node can perform.
+enum class GraphOp {
+    input,     // a Matrix, Vector or view given to Graph::input()
+    product,   // a * b, Matrix product
+    add,       // a + b
+    sub,       // a - b
+    scale,     // a * scalar
+    divide,    // a / scalar
+    add_row,   // a + b for every row of a, b having a single row
+    exp,
+    log,
+    sqrt,
+    abs,
+    tanh,
+    sigmoid,
+    softmax,   // softmax of every row of a
+};
+
+/// What the last Graph::evaluate() computed, and with how much memory.
+struct GraphStats {
+    size_t nodes = 0;           // nodes the outputs depend on, inputs and outputs included
+    size_t merged = 0;          // operations merged with an existing node when the graph was built
+    size_t fused = 0;           // elementwise nodes computed inside another node's loop and never stored
+    size_t stored = 0;          // nodes whose result was written to memory, outputs included
+    size_t levels = 0;          // steps of the schedule; the nodes of one level ran in parallel
+    size_t buffers = 0;         // buffers shared by the intermediate results
+    size_t buffer_bytes = 0;    // the memory those buffers needed: the peak memory of the intermediate results
+    size_t unshared_bytes = 0;  // the memory of one buffer per intermediate node, as when evaluating step by step
+};
+
+
+/* ------------------------------------------------- Lazy Matrices -------------------------------------------------- */
+
+
+/// A node of a Graph, in a given orientation: the handle the lazy operators take and return.
+template<typename T>
+class LazyMatrix {
+public:
+    size_t rows() const;
+    size_t columns() const;
+    /// The same node, transposed. Transposing is free: it only changes the strides the node is read with.
+    LazyMatrix t() const { return LazyMatrix(owner, index, !is_transposed); }
+    Graph<T>& graph() const { return *owner; }
+    size_t node() const { return index; }
+    bool transposed() const { return is_transposed; }
+
+private:
+    friend class Graph<T>;
+    LazyMatrix(Graph<T>* owner, size_t index, bool is_transposed)
+        : owner(owner), index(index), is_transposed(is_transposed) { }
+
+    Graph<T>* owner;
+    size_t index;
+    bool is_transposed;
+};
+
+
+/* --------------------------------------------------- Graph Class -------------------------------------------------- */
+
+
+namespace detail {
+
+/// Elements in a block of the fused loop: every intermediate result of a fused chain holds one block at a time.
+inline constexpr size_t graph_block = 256;
+
+/// True for the operations that can be fused into the loop of the node reading them.
+inline bool graph_elementwise(GraphOp op) {
+    return op != GraphOp::input && op != GraphOp::product && op != GraphOp::softmax;
+}
+
+/// The OpKind a node is recorded under by instrument.h.
+inline OpKind graph_kind(GraphOp op) {
+    switch (op) {
+        case GraphOp::product: return OpKind::gemm;
+        case GraphOp::add: case GraphOp::add_row: return OpKind::add;
+        case GraphOp::sub: return OpKind::sub;
+        case GraphOp::scale: case GraphOp::divide: return OpKind::scale;
+        default: return OpKind::map;
+    }
+}
+
+/// out[i] = op(a[i], b[i]) (or op(a[i], scalar)) for i in [0, n): one step of the fused loop on one block.
+template<typename T>
+void graph_step(GraphOp op, const T* a, const T* b, T scalar, T* out, size_t n) {
+    switch (op) {
+        case GraphOp::add: case GraphOp::add_row: simd_dispatch<T, SimdAdd<T>>(a, b, out, n); break;
+        case GraphOp::sub: simd_dispatch<T, SimdSub<T>>(a, b, out, n); break;
+        case GraphOp::scale: simd_dispatch<T, SimdScale<T>>(a, scalar, out, n); break;
+        case GraphOp::divide: simd_dispatch<T, SimdDivide<T>>(a, scalar, out, n); break;
+        case GraphOp::exp: apply_elementwise(ExpOp(), a, out, n); break;
+        case GraphOp::log: apply_elementwise(LogOp(), a, out, n); break;
+        case GraphOp::sqrt: apply_elementwise(SqrtOp(), a, out, n); break;
+        case GraphOp::abs: apply_elementwise(AbsOp(), a, out, n); break;
+        case GraphOp::tanh: apply_elementwise(TanhOp(), a, out, n); break;
+        case GraphOp::sigmoid: apply_elementwise(SigmoidOp(), a, out, n); break;
+        default: throw std::logic_error("\nGraph operation " + std::to_string(int(op)) + " is not elementwise\n");
+    }
+}
+
+}  // namespace detail
+
+template<typename T>
+class Graph {
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "Graphs need float or double elements");
+public:
+    Graph() = default;
+    Graph(const Graph& other) = delete;             // LazyMatrix handles point at their Graph
+    Graph& operator=(const Graph& other) = delete;
+
+    /* Building */
+    LazyMatrix<T> input(const MatrixView<const T>& source);
+    LazyMatrix<T> input(const Matrix<T>& source) { return input(source.view()); }
+    LazyMatrix<T> input(const Vector<T>& source);
+    LazyMatrix<T> operation(GraphOp op, const LazyMatrix<T>& a, T scalar = T(0));
+    LazyMatrix<T> operation(GraphOp op, const LazyMatrix<T>& a, const LazyMatrix<T>& b);
+
+    /* Evaluation */
+    Matrix<T> evaluate(const LazyMatrix<T>& output);
+    std::vector<Matrix<T>> evaluate(const std::vector<LazyMatrix<T>>& outputs);
+
+    /* Member Functions */
+    size_t size() const { return nodes.size(); }
+    const GraphStats& stats() const { return last_stats; }
+    void clear();
+    size_t rows(const LazyMatrix<T>& m) const;
+    size_t columns(const LazyMatrix<T>& m) const;
+
+private:
+    static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+    struct Operand {
+        size_t node = none;
+        bool transposed = false;
+    };
+    struct Node {
+        GraphOp op;
+        Operand a, b;
+        T scalar;
+        size_t rows, columns;
+        MatrixView<const T> source;  // the elements of an input
+    };
+    /// What identifies a node for common subexpression elimination. Scalars are compared by their bits.
+    using Key = std::tuple<int, size_t, bool, size_t, bool, std::uint64_t, const T*, size_t, size_t, ptrdiff_t,
+                           ptrdiff_t>;
+
+    /// One leaf of a fused loop: a stored result read directly, or one row of it for every row (add_row()).
+    struct Leaf {
+        Operand x;
+        bool broadcast;
+        const T* data;  // where the leaf is in this evaluate(), set before the schedule runs
+        ptrdiff_t row_stride, col_stride;
+    };
+    /// One operation of a fused loop, reading and writing registers (leaves first, then one per step).
+    struct Step {
+        GraphOp op;
+        size_t a, b;
+        T scalar;
+    };
+    /// The loop of a stored elementwise node and of the nodes fused into it.
+    struct Loop {
+        std::vector<Leaf> leaves;
+        std::vector<Step> steps;
+    };
+
+    /// The storage and schedule of the outputs last evaluated, kept until the outputs or the nodes change.
+    struct Plan {
+        std::vector<bool> fused;            // computed inside the loop of the node reading it
+        std::vector<size_t> level;          // position in the schedule, 0 for inputs
+        std::vector<size_t> slot;           // buffer of an intermediate result, none for inputs and outputs
+        std::vector<T*> data;               // where a stored node's result is, row-major
+        std::vector<size_t> ld;
+        std::vector<std::vector<size_t>> levels;
+        std::vector<Loop> loops;            // the loop of every stored elementwise node
+    };
+
+    std::vector<Node> nodes;
+    std::map<Key, size_t> known;
+    std::vector<std::vector<T, detail::AlignedAllocator<T>>> buffers;  // kept from one evaluate() to the next
+    size_t merged = 0;
+    GraphStats last_stats;
+    Plan last_plan;
+    std::vector<size_t> planned_outputs;  // the output nodes last_plan was made for
+    size_t planned_nodes = 0;             // and the size of the graph then; 0 when there is no plan
+
+    size_t logical_rows(const Operand& x) const { return x.transposed ? nodes[x.node].columns : nodes[x.node].rows; }
+    size_t logical_columns(const Operand& x) const {
+        return x.transposed ? nodes[x.node].rows : nodes[x.node].columns;
+    }
+    Operand operand(const LazyMatrix<T>& m) const;
+    LazyMatrix<T> add_node(GraphOp op, Operand a, Operand b, T scalar, size_t rows, size_t columns,
+                           const MatrixView<const T>& source);
+    MatrixView<const T> view(const Plan& plan, const Operand& x) const;
+    void plan_storage(Plan& plan, const std::vector<bool>& is_output, const std::vector<size_t>& readers,
+                      const std::vector<bool>& direct);
+    void compile(Plan& plan, size_t index) const;
+    void find_leaves(const Plan& plan, Loop& loop, size_t i) const;
+    /// The register of leaf x in loop, or the number of leaves if x is not one of them.
+    static size_t find_leaf(const Loop& loop, const Operand& x, bool broadcast) {
+        size_t r = 0;
+        while (r < loop.leaves.size() && (loop.leaves[r].x.node != x.node ||
+               loop.leaves[r].x.transposed != x.transposed || loop.leaves[r].broadcast != broadcast)) ++r;
+        return r;
+    }
+    size_t compile_steps(const Plan& plan, Loop& loop, size_t i) const;
+    void run(const Plan& plan, size_t index) const;
+    void run_fused(const Plan& plan, size_t index) const;
+};
+
+/// LazyMatrix.rows() returns the number of rows of the node, in the orientation of this handle.
+template<typename T>
+size_t LazyMatrix<T>::rows() const { return owner->rows(*this); }
+
+/// LazyMatrix.columns() returns the number of columns of the node, in the orientation of this handle.
+template<typename T>
+size_t LazyMatrix<T>::columns() const { return owner->columns(*this); }
+
+template<typename T>
+size_t Graph<T>::rows(const LazyMatrix<T>& m) const { return logical_rows(operand(m)); }
+
+template<typename T>
+size_t Graph<T>::columns(const LazyMatrix<T>& m) const { return logical_columns(operand(m)); }
+
+/// Checks that m is a node of this Graph.
+template<typename T>
+typename Graph<T>::Operand Graph<T>::operand(const LazyMatrix<T>& m) const {
+    if (m.owner != this || m.index >= nodes.size()) {
+        throw std::invalid_argument("\nThe LazyMatrix is not a node of this Graph\n");
+    }
+    return Operand{m.index, m.is_transposed};
+}
+
+/// Adds a node, or returns the existing node that computes the same thing.
+template<typename T>
+LazyMatrix<T> Graph<T>::add_node(GraphOp op, Operand a, Operand b, T scalar, size_t rows, size_t columns,
+                                 const MatrixView<const T>& source) {
+    if (op == GraphOp::add && std::tie(b.node, b.transposed) < std::tie(a.node, a.transposed)) {
+        std::swap(a, b);  // a + b and b + a are the same node
+    }
+    using Bits = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+    const Key key(int(op), a.node, a.transposed, b.node, b.transposed, std::uint64_t(std::bit_cast<Bits>(scalar)),
+                  source.data(), rows, columns, source.row_stride(), source.col_stride());
+    const auto found = known.find(key);
+    if (found != known.end()) {
+        ++merged;
+        return LazyMatrix<T>(this, found->second, false);
+    }
+    nodes.push_back(Node{op, a, b, scalar, rows, columns, source});
+    known.emplace(key, nodes.size() - 1);
+    return LazyMatrix<T>(this, nodes.size() - 1, false);
+}
+
+/// Adds a view as an input. Its elements are read by every evaluate(), not copied now.
+template<typename T>
+LazyMatrix<T> Graph<T>::input(const MatrixView<const T>& source) {
+    return add_node(GraphOp::input, Operand(), Operand(), T(0), source.rows(), source.columns(), source);
+}
+
+/// Adds a Vector as an input: an n x 1 column, or a 1 x n row when the Vector is transposed.
+template<typename T>
+LazyMatrix<T> Graph<T>::input(const Vector<T>& source) {
+    const VectorView<const T> v = source.view();
+    if (v.transposed()) {
+        return input(MatrixView<const T>(v.data(), 1, v.size(), ptrdiff_t(v.size()) * v.stride(), v.stride()));
+    }
+    return input(MatrixView<const T>(v.data(), v.size(), 1, v.stride(), 1));
+}
+
+/**
+ * @brief Adds a node computing op on a: one of the functions of elementwise.h, softmax, or a scaling by `scalar`.
+ *
+ * The operators and functions on LazyMatrix below call this and operation(op, a, b); it is public so that a graph can
+ * also be built from a description of the operations.
+ */
+template<typename T>
+LazyMatrix<T> Graph<T>::operation(GraphOp op, const LazyMatrix<T>& a, T scalar) {
+    if (op == GraphOp::input || op == GraphOp::product || op == GraphOp::add || op == GraphOp::sub ||
+        op == GraphOp::add_row) {
+        throw std::invalid_argument("\nGraph operation " + std::to_string(int(op)) + " does not take one operand\n");
+    }
+    const Operand x = operand(a);
+    if (op != GraphOp::scale && op != GraphOp::divide) {
+        scalar = T(0);
+    }
+    return add_node(op, x, Operand(), scalar, logical_rows(x), logical_columns(x), MatrixView<const T>(nullptr, 0, 0,
+                                                                                                       0, 0));
+}
+
+/// Adds a node computing the product, sum or difference of a and b, or adding the single row b to every row of a.
+template<typename T>
+LazyMatrix<T> Graph<T>::operation(GraphOp op, const LazyMatrix<T>& a, const LazyMatrix<T>& b) {
+    const Operand x = operand(a);
+    const Operand y = operand(b);
+    const size_t m = logical_rows(x), n = logical_columns(x);
+    const MatrixView<const T> none_source(nullptr, 0, 0, 0, 0);
+    switch (op) {
+        case GraphOp::product:
+            if (n != logical_rows(y)) {
+                throw std::invalid_argument("The Matrix product cannot be computed due to incompatible Matrix "
+                                            "Dimensions\n");
+            }
+            return add_node(op, x, y, T(0), m, logical_columns(y), none_source);
+        case GraphOp::add:
+        case GraphOp::sub:
+            if (m != logical_rows(y) || n != logical_columns(y)) {
+                throw std::invalid_argument(std::string("\nThe Matrices you attempted to ") +
+                                            (op == GraphOp::add ? "add" : "subtract") + " are " + std::to_string(m) +
+                                            " x " + std::to_string(n) + " and " + std::to_string(logical_rows(y)) +
+                                            " x " + std::to_string(logical_columns(y)) + "\n");
+            }
+            return add_node(op, x, y, T(0), m, n, none_source);
+        case GraphOp::add_row:
+            if (logical_rows(y) != 1 || logical_columns(y) != n) {
+                throw std::invalid_argument("\nThe row added to every row of a " + std::to_string(m) + " x " +
+                                            std::to_string(n) + " Matrix must be 1 x " + std::to_string(n) +
+                                            ", not " + std::to_string(logical_rows(y)) + " x " +
+                                            std::to_string(logical_columns(y)) + "\n");
+            }
+            return add_node(op, x, y, T(0), m, n, none_source);
+        default:
+            throw std::invalid_argument("\nGraph operation " + std::to_string(int(op)) + " does not take two "
+                                        "operands\n");
+    }
+}
+
+/// Graph.clear() removes every node, which invalidates every LazyMatrix of the Graph. The buffers are kept.
+template<typename T>
+void Graph<T>::clear() {
+    nodes.clear();
+    known.clear();
+    merged = 0;
+    last_stats = GraphStats();
+    planned_nodes = 0;
+}
+
+/// Evaluates a single output. See evaluate() on several outputs.
+template<typename T>
+Matrix<T> Graph<T>::evaluate(const LazyMatrix<T>& output) {
+    return std::move(evaluate(std::vector<LazyMatrix<T>>{output}).front());
+}
+
+/**
+ * @brief Computes the outputs, and every node they depend on, once.
+ *
+ * Returns one new Matrix per output, in the orientation of its handle. Outputs are never fused or shared with other
+ * nodes; an output asked for twice is computed once and copied. The plan is kept: evaluating the same outputs again,
+ * with no node added in between, reuses it without analysing the graph.
+ */
+template<typename T>
+std::vector<Matrix<T>> Graph<T>::evaluate(const std::vector<LazyMatrix<T>>& outputs) {
+    const size_t count = nodes.size();
+    bool planned = planned_nodes == count && planned_outputs.size() == outputs.size();
+    for (size_t k = 0; k < outputs.size(); ++k) {
+        const size_t i = operand(outputs[k]).node;
+        planned = planned && planned_outputs[k] == i;
+    }
+    if (!planned) {
+        std::vector<bool> is_output(count, false), live(count, false), direct(count, true);
+        std::vector<size_t> uses(count, 0), readers(count, 0), reader(count, none);
+        planned_outputs.clear();
+        for (const LazyMatrix<T>& output : outputs) {
+            is_output[output.index] = true;
+            live[output.index] = true;
+            planned_outputs.push_back(output.index);
+        }
+        // operands are always older than the nodes reading them, so one pass from the newest node finds every use
+        for (size_t i = count; i-- > 0;) {
+            if (!live[i] || nodes[i].op == GraphOp::input) continue;
+            const Node& node = nodes[i];
+            for (const Operand* x : {&node.a, &node.b}) {
+                if (x->node == none) continue;
+                live[x->node] = true;
+                ++uses[x->node];
+                if (reader[x->node] != i) ++readers[x->node];
+                reader[x->node] = i;
+                // direct: read element (i, j) for element (i, j), as a fused loop or an in-place update needs
+                if (x->transposed || (x == &node.b && node.op == GraphOp::add_row)) direct[x->node] = false;
+            }
+        }
+
+        last_plan = Plan();
+        last_plan.fused.assign(count, false);
+        last_stats = GraphStats();
+        last_stats.merged = merged;
+        for (size_t i = 0; i < count; ++i) {
+            if (!live[i]) continue;
+            ++last_stats.nodes;
+            last_plan.fused[i] = detail::graph_elementwise(nodes[i].op) && !is_output[i] && uses[i] == 1 &&
+                                 direct[i] && detail::graph_elementwise(nodes[reader[i]].op);
+            if (!is_output[i] && nodes[i].op != GraphOp::input) {
+                last_stats.unshared_bytes += nodes[i].rows * nodes[i].columns * sizeof(T);
+            }
+        }
+        plan_storage(last_plan, is_output, readers, direct);
+        planned_nodes = count;
+    }
+
+    // the first of equal outputs is computed in place by the schedule, the others are copied from it afterwards
+    std::vector<Matrix<T>> results;
+    results.reserve(outputs.size());
+    for (size_t k = 0; k < outputs.size(); ++k) {
+        const size_t i = outputs[k].index;
+        const bool repeated = std::find(planned_outputs.begin(), planned_outputs.begin() + ptrdiff_t(k), i) !=
+                              planned_outputs.begin() + ptrdiff_t(k);
+        results.emplace_back(repeated ? 0 : nodes[i].rows, repeated ? 0 : nodes[i].columns);
+        if (repeated) continue;
+        if (nodes[i].op == GraphOp::input) {
+            results.back().view() = nodes[i].source;
+        } else {
+            last_plan.data[i] = results.back().data();
+            last_plan.ld[i] = results.back().ld();
+        }
+    }
+    for (Loop& loop : last_plan.loops) {
+        for (Leaf& leaf : loop.leaves) {
+            const MatrixView<const T> v = view(last_plan, leaf.x);
+            leaf.data = v.data();
+            leaf.row_stride = v.row_stride();
+            leaf.col_stride = v.col_stride();
+        }
+    }
+    for (size_t l = 1; l < last_plan.levels.size(); ++l) {
+        const std::vector<size_t>& level = last_plan.levels[l];
+        parallel_for(0, level.size(), 1, [&](size_t first, size_t last) {
+            for (size_t k = first; k < last; ++k) run(last_plan, level[k]);
+        });
+    }
+
+    for (size_t k = 0; k < outputs.size(); ++k) {
+        const size_t first = size_t(std::find(planned_outputs.begin(), planned_outputs.end(), outputs[k].index) -
+                                    planned_outputs.begin());
+        if (first != k) results[k] = results[first];
+        results[k].is_transposed = outputs[k].is_transposed;
+    }
+    return results;
+}
+
+/**
+ * Schedules the stored nodes by level and gives each intermediate result a buffer: a free one when possible (the
+ * smallest that is large enough, else the largest, grown), or the buffer of an operand read only by this node, which
+ * is then updated in place.
+ */
+template<typename T>
+void Graph<T>::plan_storage(Plan& plan, const std::vector<bool>& is_output, const std::vector<size_t>& readers,
+                            const std::vector<bool>& direct) {
+    const size_t count = nodes.size();
+    plan.level.assign(count, 0);
+    plan.slot.assign(count, none);
+    plan.data.assign(count, nullptr);
+    plan.ld.assign(count, 0);
+    plan.loops.resize(count);
+    std::vector<size_t> last_read(count, 0);
+    std::vector<std::vector<size_t>> leaves(count);
+    std::vector<bool> stored(count, false);
+    for (size_t i = 0; i < count; ++i) {
+        const bool live = is_output[i] || readers[i] > 0;
+        if (!live || plan.fused[i]) continue;
+        stored[i] = true;
+        if (nodes[i].op == GraphOp::input) continue;
+        // leaves[i]: the stored nodes and inputs that node i reads, through the nodes fused into it
+        const auto read = [&](size_t leaf) {
+            if (std::find(leaves[i].begin(), leaves[i].end(), leaf) == leaves[i].end()) leaves[i].push_back(leaf);
+        };
+        if (detail::graph_elementwise(nodes[i].op)) {
+            compile(plan, i);
+            for (const Leaf& leaf : plan.loops[i].leaves) read(leaf.x.node);
+        } else {
+            for (const Operand* x : {&nodes[i].a, &nodes[i].b}) {
+                if (x->node != none) read(x->node);
+            }
+        }
+        size_t level = 0;
+        for (size_t leaf : leaves[i]) level = std::max(level, plan.level[leaf]);
+        plan.level[i] = level + 1;
+        for (size_t leaf : leaves[i]) last_read[leaf] = std::max(last_read[leaf], level + 1);
+        if (plan.levels.size() < level + 2) plan.levels.resize(level + 2);
+        plan.levels[level + 1].push_back(i);
+    }
+
+    std::vector<size_t> size;           // elements each buffer must hold
+    std::vector<size_t> free;           // buffers whose results are no longer read
+    std::vector<bool> handed_over(count, false);
+    std::vector<std::vector<size_t>> released(plan.levels.size() + 1);
+    for (size_t l = 1; l < plan.levels.size(); ++l) {
+        for (size_t i : plan.levels[l]) {
+            ++last_stats.stored;
+            if (is_output[i]) continue;
+            const size_t need = nodes[i].rows * nodes[i].columns;
+            size_t slot = none;
+            if (detail::graph_elementwise(nodes[i].op) || nodes[i].op == GraphOp::softmax) {
+                for (size_t leaf : leaves[i]) {  // an operand only this node reads is overwritten in place
+                    if (plan.slot[leaf] != none && readers[leaf] == 1 && direct[leaf] && !is_output[leaf] &&
+                        nodes[leaf].rows == nodes[i].rows && nodes[leaf].columns == nodes[i].columns) {
+                        slot = plan.slot[leaf];
+                        handed_over[leaf] = true;  // not released when the leaf dies: this node owns it now
+                        break;
+                    }
+                }
+            }
+            if (slot == none) {
+                size_t best = none;
+                for (size_t k = 0; k < free.size(); ++k) {
+                    const size_t s = free[k];
+                    const bool fits = size[s] >= need;
+                    if (best == none) {
+                        best = k;
+                        continue;
+                    }
+                    const size_t b = free[best];
+                    if (fits ? (size[b] < need || size[s] < size[b]) : (size[b] < need && size[s] > size[b])) best = k;
+                }
+                if (best != none) {
+                    slot = free[best];
+                    free.erase(free.begin() + ptrdiff_t(best));
+                } else {
+                    slot = size.size();
+                    size.push_back(0);
+                }
+            }
+            size[slot] = std::max(size[slot], need);
+            plan.slot[i] = slot;
+            released[last_read[i]].push_back(i);
+        }
+        for (size_t i : released[l]) {
+            if (!handed_over[i]) free.push_back(plan.slot[i]);
+        }
+    }
+
+    if (buffers.size() < size.size()) buffers.resize(size.size());
+    for (size_t s = 0; s < size.size(); ++s) {
+        if (buffers[s].size() < size[s]) {
+            COMPUTER_BRAIN_INSTRUMENT_ALLOCATION(OpKind::map, size[s] * sizeof(T));
+            buffers[s].resize(size[s]);
+        }
+        last_stats.buffer_bytes += size[s] * sizeof(T);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (plan.fused[i]) ++last_stats.fused;
+        if (stored[i] && !is_output[i] && nodes[i].op != GraphOp::input) {
+            plan.data[i] = buffers[plan.slot[i]].data();
+            plan.ld[i] = nodes[i].columns;
+        }
+    }
+    last_stats.buffers = size.size();
+    last_stats.levels = plan.levels.empty() ? 0 : plan.levels.size() - 1;
+}
+
+/// The elements of a stored node or an input, in the orientation of x.
+template<typename T>
+MatrixView<const T> Graph<T>::view(const Plan& plan, const Operand& x) const {
+    const Node& node = nodes[x.node];
+    const MatrixView<const T> v = node.op == GraphOp::input ? node.source :
+        MatrixView<const T>(plan.data[x.node], node.rows, node.columns, ptrdiff_t(plan.ld[x.node]), 1);
+    return x.transposed ? v.t() : v;
+}
+
+/// Computes one stored node.
+template<typename T>
+void Graph<T>::run(const Plan& plan, size_t index) const {
+    const Node& node = nodes[index];
+    T* out = plan.data[index];
+    const size_t ld = plan.ld[index];
+    if (node.op == GraphOp::product) {
+        const MatrixView<const T> a = view(plan, node.a), b = view(plan, node.b);
+        gemm<T>(node.rows, node.columns, a.columns(), T(1), a.data(), a.row_stride(), a.col_stride(), b.data(),
+                b.row_stride(), b.col_stride(), T(0), out, ptrdiff_t(ld), 1);
+    } else if (node.op == GraphOp::softmax) {
+        const MatrixView<const T> a = view(plan, node.a);
+        if (a.data() != out) {
+            MatrixView<T>(out, node.rows, node.columns, ptrdiff_t(ld), 1) = a;
+        }
+        COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::map, (OpShape{{node.rows, node.columns}, 2}),
+                                     4 * node.rows * node.columns, 2 * node.rows * node.columns * sizeof(T));
+        parallel_for(0, node.rows, std::max<size_t>(1, elementwise_parallel_grain / std::max<size_t>(node.columns, 1)),
+                     [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) detail::softmax_row(out + i * ld, node.columns);
+        });
+    } else {
+        run_fused(plan, index);
+    }
+}
+
+/**
+ * Turns a stored elementwise node and the nodes fused into it into the steps of its loop, on registers: the leaves
+ * first, then one per step, in the order the steps run.
+ */
+template<typename T>
+void Graph<T>::compile(Plan& plan, size_t index) const {
+    Loop& loop = plan.loops[index];
+    find_leaves(plan, loop, index);
+    compile_steps(plan, loop, index);
+}
+
+template<typename T>
+void Graph<T>::find_leaves(const Plan& plan, Loop& loop, size_t i) const {
+    const Node& node = nodes[i];
+    for (const Operand* x : {&node.a, &node.b}) {
+        if (x->node == none) continue;
+        if (plan.fused[x->node]) {
+            find_leaves(plan, loop, x->node);
+            continue;
+        }
+        const bool broadcast = x == &node.b && node.op == GraphOp::add_row;
+        if (find_leaf(loop, *x, broadcast) == loop.leaves.size()) {
+            loop.leaves.push_back(Leaf{*x, broadcast, nullptr, 0, 0});
+        }
+    }
+}
+
+/// Appends the steps computing node i and returns the register holding its result.
+template<typename T>
+size_t Graph<T>::compile_steps(const Plan& plan, Loop& loop, size_t i) const {
+    const Node& node = nodes[i];
+    size_t registers[2] = {none, none};
+    const Operand* operands[2] = {&node.a, &node.b};
+    for (int k = 0; k < 2; ++k) {
+        const Operand& x = *operands[k];
+        if (x.node == none) continue;
+        if (plan.fused[x.node]) {
+            registers[k] = compile_steps(plan, loop, x.node);
+            continue;
+        }
+        registers[k] = find_leaf(loop, x, k == 1 && node.op == GraphOp::add_row);
+    }
+    loop.steps.push_back(Step{node.op, registers[0], registers[1], node.scalar});
+    return loop.leaves.size() + loop.steps.size() - 1;
+}
+
+/**
+ * Runs the loop of a stored elementwise node on one block of graph_block elements of a row at a time. The registers
+ * are per-thread scratch buffers, so that nothing is allocated once they have grown.
+ */
+template<typename T>
+void Graph<T>::run_fused(const Plan& plan, size_t index) const {
+    const std::vector<Leaf>& leaves = plan.loops[index].leaves;
+    const std::vector<Step>& steps = plan.loops[index].steps;
+    const Node& node = nodes[index];
+    T* out = plan.data[index];
+    const size_t ld = plan.ld[index];
+    const size_t rows = node.rows, columns = node.columns;
+    if (rows == 0 || columns == 0) {
+        return;
+    }
+    COMPUTER_BRAIN_INSTRUMENT_OP(detail::graph_kind(node.op), (OpShape{{rows, columns}, 2}),
+                                 steps.size() * rows * columns, (leaves.size() + 1) * rows * columns * sizeof(T));
+    const size_t blocks_per_row = (columns + detail::graph_block - 1) / detail::graph_block;
+    const size_t registers = leaves.size() + steps.size();
+    parallel_for(0, rows * blocks_per_row, std::max<size_t>(1, elementwise_parallel_grain / detail::graph_block),
+                 [&](size_t first, size_t last) {
+        const detail::GemmScratch<T> scratch(registers * detail::graph_block);
+        const detail::GemmScratch<const T*> values(registers);
+        const T** value = values.data();
+        for (size_t block = first; block < last; ++block) {
+            const size_t i = block / blocks_per_row;
+            const size_t j = block % blocks_per_row * detail::graph_block;
+            const size_t n = std::min(detail::graph_block, columns - j);
+            for (size_t r = 0; r < leaves.size(); ++r) {
+                const Leaf& leaf = leaves[r];
+                const T* source = leaf.data + (leaf.broadcast ? 0 : ptrdiff_t(i) * leaf.row_stride) +
+                                  ptrdiff_t(j) * leaf.col_stride;
+                if (leaf.col_stride == 1) {
+                    value[r] = source;
+                } else {  // a transposed operand: gather the block
+                    T* gathered = scratch.data() + r * detail::graph_block;
+                    for (size_t k = 0; k < n; ++k) gathered[k] = source[ptrdiff_t(k) * leaf.col_stride];
+                    value[r] = gathered;
+                }
+            }
+            for (size_t s = 0; s < steps.size(); ++s) {
+                const Step& step = steps[s];
+                const size_t r = leaves.size() + s;
+                T* result = s + 1 == steps.size() ? out + i * ld + j : scratch.data() + r * detail::graph_block;
+                detail::graph_step(step.op, value[step.a], step.b == none ? nullptr : value[step.b], step.scalar,
+                                   result, n);
+                value[r] = result;
+            }
+        }
+    });
+}
+
+
+/* ------------------------------------------------- Lazy Operators ------------------------------------------------- */
+
+
+/// Matrix product of two nodes.
+template<typename T>
+LazyMatrix<T> operator*(const LazyMatrix<T>& a, const LazyMatrix<T>& b) {
+    return a.graph().operation(GraphOp::product, a, b);
+}
+
+template<typename T>
+LazyMatrix<T> operator+(const LazyMatrix<T>& a, const LazyMatrix<T>& b) {
+    return a.graph().operation(GraphOp::add, a, b);
+}
+
+template<typename T>
+LazyMatrix<T> operator-(const LazyMatrix<T>& a, const LazyMatrix<T>& b) {
+    return a.graph().operation(GraphOp::sub, a, b);
+}
+
+template<typename T>
+LazyMatrix<T> operator*(const LazyMatrix<T>& a, const std::type_identity_t<T>& scalar) {
+    return a.graph().operation(GraphOp::scale, a, scalar);
+}
+
+template<typename T>
+LazyMatrix<T> operator*(const std::type_identity_t<T>& scalar, const LazyMatrix<T>& a) {
+    return a.graph().operation(GraphOp::scale, a, scalar);
+}
+
+template<typename T>
+LazyMatrix<T> operator/(const LazyMatrix<T>& a, const std::type_identity_t<T>& scalar) {
+    return a.graph().operation(GraphOp::divide, a, scalar);
+}
+
+/// `row` (1 x n) added to every row of a (m x n), as for the bias of a layer.
+template<typename T>
+LazyMatrix<T> add_row(const LazyMatrix<T>& a, const LazyMatrix<T>& row) {
+    return a.graph().operation(GraphOp::add_row, a, row);
+}
+
+template<typename T> LazyMatrix<T> exp(const LazyMatrix<T>& a) { return a.graph().operation(GraphOp::exp, a); }
+template<typename T> LazyMatrix<T> log(const LazyMatrix<T>& a) { return a.graph().operation(GraphOp::log, a); }
+template<typename T> LazyMatrix<T> sqrt(const LazyMatrix<T>& a) { return a.graph().operation(GraphOp::sqrt, a); }
+template<typename T> LazyMatrix<T> abs(const LazyMatrix<T>& a) { return a.graph().operation(GraphOp::abs, a); }
+template<typename T> LazyMatrix<T> tanh(const LazyMatrix<T>& a) { return a.graph().operation(GraphOp::tanh, a); }
+template<typename T> LazyMatrix<T> sigmoid(const LazyMatrix<T>& a) { return a.graph().operation(GraphOp::sigmoid, a); }
+
+/// The softmax of every row of a. See softmax() on a Matrix.
+template<typename T>
+LazyMatrix<T> softmax(const LazyMatrix<T>& a) {
+    return a.graph().operation(GraphOp::softmax, a);
+}
+
+
+#endif //COMPUTER_BRAIN_GRAPH_H
@@ -0,0 +1,452 @@
+#ifndef COMPUTER_BRAIN_HALF_H
+#define COMPUTER_BRAIN_HALF_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "instrument.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+#include <immintrin.h>
+#define COMPUTER_BRAIN_TARGET_AVX2_F16C __attribute__((target("avx2,fma,f16c")))
+#define COMPUTER_BRAIN_TARGET_AVX512_F16C __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,f16c")))
+#define COMPUTER_BRAIN_TARGET_AVX512_BF16 \
+    __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,f16c,avx512bf16")))
+#endif
+
+/*
+ * 16-bit floating-point element types: float16 (IEEE 754 binary16) and bfloat16 (the upper half of a float).
+ *
+ *              sign  exponent  mantissa  largest finite   relative precision
+ *   float16       1         5        10  65504            2^-11
+ *   bfloat16      1         8         7  3.4e38           2^-8
+ *
+ * Both are storage types: they halve the memory and bandwidth of a Vector or Matrix, and every computation on them is
+ * done in float. A float16 or bfloat16 converts implicitly to and from float (rounding to nearest even), so
+ * Vector<bfloat16> and Matrix<float16> work with every operation of the library. The kernels that matter for speed
+ * never accumulate in 16 bits:
+ *
+ *   convert_elements()    bulk conversion between float and a 16-bit type
+ *   half_dot()            dot product, accumulated in float (also behind Vector<H> * Vector<H>)
+ *   half_gemv()           y = alpha * A * x + beta * y with A and x in 16 bits and y in float
+ *   gemm()                (gemm.h) A and B in 16 bits, C in float or in the same 16-bit type
+ *
+ * float16 conversions use F16C (present on every AVX2 CPU) and bfloat16 dot products use AVX-512 BF16 when the CPU has
+ * them and the active instruction set (simd.h) allows it; bfloat16 conversions are integer shifts and rounding in
+ * AVX2 or AVX-512 registers. Conversions of non-NaN values give the same bits on every path; a float16 NaN keeps its
+ * payload under F16C, where the scalar routine returns the default quiet NaN. Dot products and half_gemv() add their
+ * terms in a different order on each path, and with fused multiply-adds in the vector kernels, so their results
+ * differ in the last bits between instruction sets; each stays within the usual bound of float summation,
+ * n * 2^-24 * (|a[0] * x[0]| + ... + |a[n-1] * x[n-1]|). AVX-512 BF16 dot products also treat subnormal inputs as
+ * zero (as does its VCVTNEPS2BF16 rounding instruction, which is why conversions do not use it).
+ */
+
+
+/* ----------------------------------------------- 16-bit Float Types ----------------------------------------------- */
+
+
+namespace detail {
+
+/// float -> binary16, round to nearest even, with subnormals, infinities and NaN.
+constexpr std::uint16_t float_to_float16_bits(float value) {
+    std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+    const std::uint32_t sign = (bits >> 16) & 0x8000u;
+    bits &= 0x7fffffffu;
+    if (bits >= 0x47800000u) {  // if: too large for a float16 (2^16 and up), or infinity, or NaN
+        return (std::uint16_t)(sign | (bits > 0x7f800000u ? 0x7e00u : 0x7c00u));
+    }
+    if (bits < 0x38800000u) {  // if: below 2^-14, the result is subnormal: let the FPU round it by adding 0.5f
+        const float shifted = std::bit_cast<float>(bits) + 0.5f;
+        return (std::uint16_t)(sign | (std::bit_cast<std::uint32_t>(shifted) - 0x3f000000u));
+    }
+    const std::uint32_t odd = (bits >> 13) & 1u;
+    bits += 0xc8000fffu + odd;  // rebias the exponent from 127 to 15 and round the 13 dropped bits to nearest even
+    return (std::uint16_t)(sign | (bits >> 13));
+}
+
+/// binary16 -> float; exact.
+constexpr float float16_bits_to_float(std::uint16_t half) {
+    const std::uint32_t shifted_exponent = 0x7c00u << 13;
+    std::uint32_t bits = (std::uint32_t)(half & 0x7fffu) << 13;
+    const std::uint32_t exponent = bits & shifted_exponent;
+    bits += (127u - 15u) << 23;
+    if (exponent == shifted_exponent) {  // if: infinity or NaN, move the exponent all the way up
+        bits += (128u - 16u) << 23;
+    } else if (exponent == 0) {  // else if: zero or subnormal, renormalise through the FPU
+        bits += 1u << 23;
+        bits = std::bit_cast<std::uint32_t>(std::bit_cast<float>(bits) - std::bit_cast<float>(113u << 23));
+    }
+    return std::bit_cast<float>(bits | (std::uint32_t)(half & 0x8000u) << 16);
+}
+
+/// float -> bfloat16, round to nearest even; NaN stays NaN.
+constexpr std::uint16_t float_to_bfloat16_bits(float value) {
+    const std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+    if ((bits & 0x7fffffffu) > 0x7f800000u) return (std::uint16_t)((bits >> 16) | 0x40u);
+    return (std::uint16_t)((bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16);
+}
+
+/// bfloat16 -> float; exact.
+constexpr float bfloat16_bits_to_float(std::uint16_t half) { return std::bit_cast<float>((std::uint32_t)half << 16); }
+
+}  // namespace detail
+
+/// IEEE 754 half precision. Converts to and from float implicitly; arithmetic happens in float.
+struct float16 {
+    std::uint16_t bits = 0;
+
+    constexpr float16() = default;
+    constexpr float16(float value) : bits(detail::float_to_float16_bits(value)) { }
+    constexpr operator float() const { return detail::float16_bits_to_float(bits); }
+    static constexpr float16 from_bits(std::uint16_t bits) { float16 h; h.bits = bits; return h; }
+};
+
+/// Brain floating point: the sign, exponent and top 7 mantissa bits of a float. Arithmetic happens in float.
+struct bfloat16 {
+    std::uint16_t bits = 0;
+
+    constexpr bfloat16() = default;
+    constexpr bfloat16(float value) : bits(detail::float_to_bfloat16_bits(value)) { }
+    constexpr operator float() const { return detail::bfloat16_bits_to_float(bits); }
+    static constexpr bfloat16 from_bits(std::uint16_t bits) { bfloat16 h; h.bits = bits; return h; }
+};
+
+static_assert(sizeof(float16) == 2 && sizeof(bfloat16) == 2);
+
+/// True for float16 and bfloat16.
+template<typename T>
+inline constexpr bool is_half_type = std::is_same_v<T, float16> || std::is_same_v<T, bfloat16>;
+
+
+/* ---------------------------------------------- Hardware Selection ------------------------------------------------ */
+
+
+namespace detail {
+
+/// Which conversion and dot-product kernels run: decided by the active instruction set and the CPU's F16C and BF16.
+enum class HalfPath { scalar, avx2, avx512, avx512_bf16 };
+
+inline HalfPath active_half_path() {
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+    static const bool f16c = (__builtin_cpu_init(), __builtin_cpu_supports("f16c"));
+    static const bool bf16 = __builtin_cpu_supports("avx512bf16");
+    switch (active_simd_isa()) {
+        case SimdIsa::avx512: return !f16c ? HalfPath::scalar : bf16 ? HalfPath::avx512_bf16 : HalfPath::avx512;
+        case SimdIsa::avx2: return f16c ? HalfPath::avx2 : HalfPath::scalar;
+        default: return HalfPath::scalar;
+    }
+#else
+    return HalfPath::scalar;
+#endif
+}
+
+/* Scalar kernels: the reference every other path must agree with. */
+
+template<typename H>
+void half_to_float_scalar(const H* in, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = (float)in[i];
+}
+
+template<typename H>
+void float_to_half_scalar(const float* in, H* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = H(in[i]);
+}
+
+/// sum of a[i] * x[i], accumulated in float in four independent sums
+template<typename H>
+float half_dot_scalar(const H* a, const float* x, size_t n) {
+    float acc[4] = {};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (int u = 0; u < 4; ++u) acc[u] += (float)a[i + u] * x[i + u];
+    }
+    for (; i < n; ++i) acc[0] += (float)a[i] * x[i];
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+
+// GCC 12's AVX-512 intrinsics start some results from an undefined register, which -Wall reports as uninitialised
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/* AVX2 + F16C: 8 elements per register. */
+
+COMPUTER_BRAIN_TARGET_AVX2_F16C __attribute__((always_inline)) inline __m256 load8_avx2(const float16* p) {
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+COMPUTER_BRAIN_TARGET_AVX2_F16C __attribute__((always_inline)) inline __m256 load8_avx2(const bfloat16* p) {
+    const __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16));
+}
+COMPUTER_BRAIN_TARGET_AVX2_F16C __attribute__((always_inline)) inline void store8_avx2(__m256 x, float16* p) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT));
+}
+COMPUTER_BRAIN_TARGET_AVX2_F16C __attribute__((always_inline)) inline void store8_avx2(__m256 x, bfloat16* p) {
+    // round to nearest even as float_to_bfloat16_bits() does, then keep the upper halves; NaN is kept quiet
+    const __m256i bits = _mm256_castps_si256(x);
+    const __m256i odd = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1));
+    __m256i rounded = _mm256_add_epi32(bits, _mm256_add_epi32(_mm256_set1_epi32(0x7fff), odd));
+    const __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+    rounded = _mm256_blendv_epi8(rounded, _mm256_or_si256(bits, _mm256_set1_epi32(0x400000)), nan);
+    const __m256i halves = _mm256_srli_epi32(rounded, 16);
+    const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(halves), _mm256_extracti128_si256(halves, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), packed);
+}
+
+template<typename H>
+COMPUTER_BRAIN_TARGET_AVX2_F16C void half_to_float_avx2(const H* in, float* out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(out + i, load8_avx2(in + i));
+    half_to_float_scalar(in + i, out + i, n - i);
+}
+
+template<typename H>
+COMPUTER_BRAIN_TARGET_AVX2_F16C void float_to_half_avx2(const float* in, H* out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) store8_avx2(_mm256_loadu_ps(in + i), out + i);
+    float_to_half_scalar(in + i, out + i, n - i);
+}
+
+template<typename H>
+COMPUTER_BRAIN_TARGET_AVX2_F16C float half_dot_avx2(const H* a, const float* x, size_t n) {
+    __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+#pragma GCC unroll 4
+        for (int u = 0; u < 4; ++u) {
+            acc[u] = _mm256_fmadd_ps(load8_avx2(a + i + 8 * u), _mm256_loadu_ps(x + i + 8 * u), acc[u]);
+        }
+    }
+    for (; i + 8 <= n; i += 8) acc[0] = _mm256_fmadd_ps(load8_avx2(a + i), _mm256_loadu_ps(x + i), acc[0]);
+    const __m256 total = _mm256_add_ps(_mm256_add_ps(acc[0], acc[1]), _mm256_add_ps(acc[2], acc[3]));
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, total);
+    float sum = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    return sum + half_dot_scalar(a + i, x + i, n - i);
+}
+
+/* AVX-512 (+ F16C for the 8-element tails): 16 elements per register. */
+
+COMPUTER_BRAIN_TARGET_AVX512_F16C __attribute__((always_inline)) inline __m512 load16_avx512(const float16* p) {
+    return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+}
+COMPUTER_BRAIN_TARGET_AVX512_F16C __attribute__((always_inline)) inline __m512 load16_avx512(const bfloat16* p) {
+    const __m512i wide = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(wide, 16));
+}
+COMPUTER_BRAIN_TARGET_AVX512_F16C __attribute__((always_inline)) inline void store16_avx512(__m512 x, float16* p) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT));
+}
+COMPUTER_BRAIN_TARGET_AVX512_F16C __attribute__((always_inline)) inline void store16_avx512(__m512 x, bfloat16* p) {
+    const __m512i bits = _mm512_castps_si512(x);
+    const __m512i odd = _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1));
+    __m512i rounded = _mm512_add_epi32(bits, _mm512_add_epi32(_mm512_set1_epi32(0x7fff), odd));
+    const __mmask16 nan = _mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q);
+    rounded = _mm512_mask_mov_epi32(rounded, nan, _mm512_or_si512(bits, _mm512_set1_epi32(0x400000)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtepi32_epi16(_mm512_srli_epi32(rounded, 16)));
+}
+
+template<typename H>
+COMPUTER_BRAIN_TARGET_AVX512_F16C void half_to_float_avx512(const H* in, float* out, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) _mm512_storeu_ps(out + i, load16_avx512(in + i));
+    half_to_float_scalar(in + i, out + i, n - i);
+}
+
+template<typename H>
+COMPUTER_BRAIN_TARGET_AVX512_F16C void float_to_half_avx512(const float* in, H* out, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) store16_avx512(_mm512_loadu_ps(in + i), out + i);
+    float_to_half_scalar(in + i, out + i, n - i);
+}
+
+template<typename H>
+COMPUTER_BRAIN_TARGET_AVX512_F16C float half_dot_avx512(const H* a, const float* x, size_t n) {
+    __m512 acc[4] = {_mm512_setzero_ps(), _mm512_setzero_ps(), _mm512_setzero_ps(), _mm512_setzero_ps()};
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+#pragma GCC unroll 4
+        for (int u = 0; u < 4; ++u) {
+            acc[u] = _mm512_fmadd_ps(load16_avx512(a + i + 16 * u), _mm512_loadu_ps(x + i + 16 * u), acc[u]);
+        }
+    }
+    for (; i + 16 <= n; i += 16) acc[0] = _mm512_fmadd_ps(load16_avx512(a + i), _mm512_loadu_ps(x + i), acc[0]);
+    const float sum = _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(acc[0], acc[1]), _mm512_add_ps(acc[2], acc[3])));
+    return sum + half_dot_scalar(a + i, x + i, n - i);
+}
+
+/// bfloat16 x bfloat16 dot product with VDPBF16PS: 32 products per instruction, summed in pairs into float lanes.
+COMPUTER_BRAIN_TARGET_AVX512_BF16 inline float bfloat16_dot_avx512_bf16(const bfloat16* a, const bfloat16* b,
+                                                                        size_t n) {
+    __m512 acc[2] = {_mm512_setzero_ps(), _mm512_setzero_ps()};
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+#pragma GCC unroll 2
+        for (int u = 0; u < 2; ++u) {
+            __m512bh x, y;
+            std::memcpy(&x, a + i + 32 * u, sizeof(x));
+            std::memcpy(&y, b + i + 32 * u, sizeof(y));
+            acc[u] = _mm512_dpbf16_ps(acc[u], x, y);
+        }
+    }
+    for (; i + 32 <= n; i += 32) {
+        __m512bh x, y;
+        std::memcpy(&x, a + i, sizeof(x));
+        std::memcpy(&y, b + i, sizeof(y));
+        acc[0] = _mm512_dpbf16_ps(acc[0], x, y);
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc[0], acc[1]));
+    for (; i < n; ++i) sum += (float)a[i] * (float)b[i];
+    return sum;
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+}  // namespace detail
+
+
+/* ------------------------------------------------- Half Kernels --------------------------------------------------- */
+
+
+/// out[i] = float(in[i]) for i in [0, n). Exact.
+template<typename H> requires is_half_type<H>
+void convert_elements(const H* in, float* out, size_t n) {
+    switch (detail::active_half_path()) {
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+        case detail::HalfPath::avx512_bf16:
+        case detail::HalfPath::avx512: return detail::half_to_float_avx512(in, out, n);
+        case detail::HalfPath::avx2: return detail::half_to_float_avx2(in, out, n);
+#endif
+        default: return detail::half_to_float_scalar(in, out, n);
+    }
+}
+
+/// out[i] = H(in[i]) for i in [0, n), rounded to nearest even.
+template<typename H> requires is_half_type<H>
+void convert_elements(const float* in, H* out, size_t n) {
+    switch (detail::active_half_path()) {
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+        case detail::HalfPath::avx512_bf16:
+        case detail::HalfPath::avx512: return detail::float_to_half_avx512(in, out, n);
+        case detail::HalfPath::avx2: return detail::float_to_half_avx2(in, out, n);
+#endif
+        default: return detail::float_to_half_scalar(in, out, n);
+    }
+}
+
+/// Returns the sum of a[i] * x[i] for i in [0, n), accumulated in float.
+template<typename H> requires is_half_type<H>
+float half_dot(const H* a, const float* x, size_t n) {
+    switch (detail::active_half_path()) {
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+        case detail::HalfPath::avx512_bf16:
+        case detail::HalfPath::avx512: return detail::half_dot_avx512(a, x, n);
+        case detail::HalfPath::avx2: return detail::half_dot_avx2(a, x, n);
+#endif
+        default: return detail::half_dot_scalar(a, x, n);
+    }
+}
+
+/**
+ * @brief Returns the sum of a[i] * b[i] for i in [0, n), accumulated in float.
+ *
+ * bfloat16 uses the AVX-512 BF16 dot-product instruction when available. Otherwise b is converted to float 256
+ * elements at a time, into a buffer on the stack, and multiplied with a as it is converted.
+ */
+template<typename H> requires is_half_type<H>
+float half_dot(const H* a, const H* b, size_t n) {
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+    if constexpr (std::is_same_v<H, bfloat16>) {
+        if (detail::active_half_path() == detail::HalfPath::avx512_bf16) {
+            return detail::bfloat16_dot_avx512_bf16(a, b, n);
+        }
+    }
+#endif
+    constexpr size_t chunk = 256;
+    alignas(64) float converted[chunk];
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i += chunk) {
+        const size_t count = std::min(chunk, n - i);
+        convert_elements(b + i, converted, count);
+        sum += half_dot(a + i, converted, count);
+    }
+    return sum;
+}
+
+/*
+ * The dot product of Vector<H> (simd.h's simd_dot, found by argument-dependent lookup) accumulates in float and rounds
+ * once at the end, instead of rounding to 16 bits after every multiply-add.
+ */
+inline float16 simd_dot(const float16* a, const float16* b, size_t n) { return float16(half_dot(a, b, n)); }
+inline bfloat16 simd_dot(const bfloat16* a, const bfloat16* b, size_t n) { return bfloat16(half_dot(a, b, n)); }
+
+/**
+ * @brief y = alpha * A * x + beta * y, with A (m x n) and x in 16 bits, y in float, and float accumulation.
+ *
+ * A is given by a pointer and strides as in gemm(); x and y by a pointer and a stride. x is converted to float once,
+ * then each thread takes a range of rows: with contiguous rows of A (cs_a == 1) every row is a half_dot(), with
+ * contiguous columns (rs_a == 1) columns are converted and accumulated a block of rows at a time. When beta is zero y
+ * is only written.
+ */
+template<typename H> requires is_half_type<H>
+void half_gemv(size_t m, size_t n, float alpha, const H* a, ptrdiff_t rs_a, ptrdiff_t cs_a, const H* x,
+               ptrdiff_t incx, float beta, float* y, ptrdiff_t incy) {
+    COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::gemv, (OpShape{{m, n}, 2}), 2 * m * n,
+                                 (m * n + n) * sizeof(H) + (beta == 0.0f ? 1 : 2) * m * sizeof(float));
+    std::vector<float> x_float(n);
+    if (incx == 1) {
+        convert_elements(x, x_float.data(), n);
+    } else {
+        for (size_t j = 0; j < n; ++j) x_float[j] = (float)x[j * incx];
+    }
+    const auto finish = [&](size_t i, float sum) {
+        float& y_i = y[i * incy];
+        y_i = beta == 0.0f ? alpha * sum : alpha * sum + beta * y_i;
+    };
+    const size_t grain = std::max<size_t>(1, (size_t(1) << 15) / std::max<size_t>(n, 1));
+    if (cs_a == 1 || rs_a != 1) {
+        parallel_for(0, m, grain, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                const H* row = a + i * rs_a;
+                float sum = 0.0f;
+                if (cs_a == 1) {
+                    sum = half_dot(row, x_float.data(), n);
+                } else {
+                    for (size_t j = 0; j < n; ++j) sum += (float)row[j * cs_a] * x_float[j];
+                }
+                finish(i, sum);
+            }
+        });
+    } else {  // else: columns are contiguous; y[block] += x[j] * A[block, j] column by column
+        constexpr size_t block = 256;
+        parallel_for(0, (m + block - 1) / block, std::max<size_t>(1, grain / block), [&](size_t first, size_t last) {
+            alignas(64) float column[block];
+            alignas(64) float sums[block];
+            for (size_t b = first; b < last; ++b) {
+                const size_t i0 = b * block;
+                const size_t rows = std::min(block, m - i0);
+                std::fill(sums, sums + rows, 0.0f);
+                for (size_t j = 0; j < n; ++j) {
+                    convert_elements(a + i0 + j * cs_a, column, rows);
+                    const float x_j = x_float[j];
+                    for (size_t i = 0; i < rows; ++i) sums[i] += column[i] * x_j;
+                }
+                for (size_t i = 0; i < rows; ++i) finish(i0 + i, sums[i]);
+            }
+        });
+    }
+}
+
+
+#endif //COMPUTER_BRAIN_HALF_H
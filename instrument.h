@@ -0,0 +1,326 @@
+#ifndef COMPUTER_BRAIN_INSTRUMENT_H
+#define COMPUTER_BRAIN_INSTRUMENT_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Per-operation instrumentation: how often each kind of operation runs, on which shapes, how much arithmetic and
+ * memory traffic it does, how much it allocates and how long it takes.
+ *
+ * Instrumentation is compiled in only when COMPUTER_BRAIN_INSTRUMENT is defined before the first include of the
+ * library (-DCOMPUTER_BRAIN_INSTRUMENT). Otherwise every recording point expands to nothing, its arguments are not even
+ * evaluated, and the library runs exactly as without this header. The API below exists in both cases, so code that
+ * reads the counters compiles either way; without COMPUTER_BRAIN_INSTRUMENT the counters simply stay at zero.
+ *
+ * What is recorded, per OpKind:
+ *
+ *   calls          number of operations
+ *   flops          arithmetic operations (a multiply-add counts as two)
+ *   bytes          compulsory memory traffic: every operand read once, the result written once (and read once more
+ *                  when it is accumulated into, as in gemm() with a non-zero beta)
+ *   allocations    new Vector or Matrix storage created for the result of the operation
+ *   seconds        wall time
+ *   shapes         the same numbers broken down by shape, so that the few shapes that dominate (or run far below the
+ *                  rate of the others) stand out
+ *
+ * An elementwise expression is one operation, evaluated in one pass, and is counted under the operation at its root:
+ * (a + b) * 2 is a scale, a * 2 + b an add, exp(a + b) a map, and an assignment of a plain view a copy. Its flops are
+ * one per node per element. An operation that runs inside another instrumented one on the same thread (the gemv() a
+ * single-column gemm() turns into, the float gemm() of a float16 product) is counted as part of the outer one only.
+ *
+ * Recording takes a lock, so it adds some tens of nanoseconds to every operation, and the first operation of each new
+ * shape allocates the entry of that shape; it is meant for finding where the time goes, not to be left on for the
+ * smallest operations in a hot loop.
+ */
+
+/// The kinds of operation that are counted separately.
+enum class OpKind {
+    add,     // elementwise expressions whose last step is an addition
+    sub,     // elementwise expressions whose last step is a subtraction
+    scale,   // elementwise expressions whose last step is a multiplication or division by a scalar
+    copy,    // assignment of a Vector or Matrix (or a view of one) without arithmetic
+    dot,     // dot product: dot(), or Vector * Vector
+    outer,   // Vector * Vector outer product
+    gemv,    // Matrix-Vector product
+    gemm,    // Matrix product, in any precision
+    reduce,  // sum(), norm(), argmin(), argmax() and the like over a Vector
+    map,     // elementwise functions: exp(), tanh(), map() and the others of elementwise.h, softmax()
+};
+
+inline constexpr size_t op_kind_count = 10;
+
+/// Returns the name of an OpKind, as it appears in the JSON dump.
+inline const char* op_kind_name(OpKind kind) {
+    switch (kind) {
+        case OpKind::add: return "add";
+        case OpKind::sub: return "sub";
+        case OpKind::scale: return "scale";
+        case OpKind::copy: return "copy";
+        case OpKind::dot: return "dot";
+        case OpKind::outer: return "outer";
+        case OpKind::gemv: return "gemv";
+        case OpKind::gemm: return "gemm";
+        case OpKind::reduce: return "reduce";
+        default: return "map";
+    }
+}
+
+#ifdef COMPUTER_BRAIN_INSTRUMENT
+inline constexpr bool instrumentation_enabled = true;
+#else
+inline constexpr bool instrumentation_enabled = false;
+#endif
+
+/// Distinct shapes recorded per OpKind; calls on further shapes are only counted in the totals (OpStats::other_calls).
+inline constexpr size_t instrument_max_shapes = 256;
+
+
+/* ------------------------------------------------ Snapshot Types -------------------------------------------------- */
+
+
+/**
+ * @brief The shape of one operation: up to three extents, `rank` of which are used.
+ *
+ * Elementwise Vector operations, dot products and reductions have (size), elementwise Matrix operations (rows,
+ * columns), outer products (rows, columns) of the result, gemv() (rows, columns) of A, and gemm() (m, n, k).
+ */
+struct OpShape {
+    std::array<size_t, 3> extents{};
+    size_t rank = 0;
+
+    auto operator<=>(const OpShape& other) const = default;
+};
+
+/// The counters of one shape of one OpKind.
+struct OpShapeStats {
+    OpShape shape;
+    std::uint64_t calls = 0;
+    std::uint64_t flops = 0;
+    std::uint64_t bytes = 0;
+    double seconds = 0;
+};
+
+/// The counters of one OpKind. `shapes` is sorted by decreasing time.
+struct OpStats {
+    std::uint64_t calls = 0;
+    std::uint64_t flops = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t allocated_bytes = 0;
+    double seconds = 0;
+    std::uint64_t other_calls = 0;  // calls whose shape did not fit in the instrument_max_shapes shapes recorded
+    std::vector<OpShapeStats> shapes;
+};
+
+/**
+ * @brief A copy of every counter, taken at one point in time by instrument_snapshot().
+ */
+struct InstrumentSnapshot {
+    std::array<OpStats, op_kind_count> ops;
+
+    const OpStats& operator[](OpKind kind) const { return ops[size_t(kind)]; }
+
+    std::string to_json() const;
+};
+
+
+/* --------------------------------------------------- Recording ---------------------------------------------------- */
+
+
+namespace detail {
+
+struct InstrumentRecord {
+    OpStats totals;
+    std::map<OpShape, OpShapeStats> shapes;
+};
+
+struct InstrumentRegistry {
+    std::mutex mutex;
+    std::array<InstrumentRecord, op_kind_count> records;
+};
+
+inline InstrumentRegistry& instrument_registry() {
+    static InstrumentRegistry registry;
+    return registry;
+}
+
+/// Number of instrumented operations running on the calling thread; only the outermost one is recorded.
+inline int& instrument_depth() {
+    thread_local int depth = 0;
+    return depth;
+}
+
+inline void instrument_record(OpKind kind, const OpShape& shape, std::uint64_t flops, std::uint64_t bytes,
+                              double seconds) {
+    InstrumentRegistry& registry = instrument_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    InstrumentRecord& record = registry.records[size_t(kind)];
+    record.totals.calls += 1;
+    record.totals.flops += flops;
+    record.totals.bytes += bytes;
+    record.totals.seconds += seconds;
+    auto found = record.shapes.find(shape);
+    if (found == record.shapes.end()) {
+        if (record.shapes.size() >= instrument_max_shapes) {
+            record.totals.other_calls += 1;
+            return;
+        }
+        found = record.shapes.emplace(shape, OpShapeStats{shape}).first;
+    }
+    found->second.calls += 1;
+    found->second.flops += flops;
+    found->second.bytes += bytes;
+    found->second.seconds += seconds;
+}
+
+inline void instrument_allocation(OpKind kind, std::uint64_t bytes) {
+    InstrumentRegistry& registry = instrument_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    OpStats& totals = registry.records[size_t(kind)].totals;
+    totals.allocations += 1;
+    totals.allocated_bytes += bytes;
+}
+
+/**
+ * Times one operation from its construction to its destruction and records it then, unless it runs inside another
+ * instrumented operation on the same thread.
+ */
+class InstrumentScope {
+public:
+    InstrumentScope(OpKind kind, OpShape shape, std::uint64_t flops, std::uint64_t bytes)
+        : kind(kind), shape(shape), flops(flops), bytes(bytes), outermost(instrument_depth()++ == 0) {
+        if (outermost) start = std::chrono::steady_clock::now();
+    }
+    ~InstrumentScope() {
+        --instrument_depth();
+        if (outermost) {
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            instrument_record(kind, shape, flops, bytes, elapsed.count());
+        }
+    }
+    InstrumentScope(const InstrumentScope& other) = delete;
+    InstrumentScope& operator=(const InstrumentScope& other) = delete;
+
+private:
+    OpKind kind;
+    OpShape shape;
+    std::uint64_t flops;
+    std::uint64_t bytes;
+    bool outermost;
+    std::chrono::steady_clock::time_point start;
+};
+
+}  // namespace detail
+
+/*
+ * The recording points used inside the library. COMPUTER_BRAIN_INSTRUMENT_OP(kind, shape, flops, bytes) times the rest
+ * of the enclosing block; COMPUTER_BRAIN_INSTRUMENT_ALLOCATION(kind, bytes) counts one allocation. Without
+ * COMPUTER_BRAIN_INSTRUMENT both are empty statements and their arguments are never evaluated.
+ */
+#ifdef COMPUTER_BRAIN_INSTRUMENT
+#define COMPUTER_BRAIN_INSTRUMENT_OP(kind, shape, flops, bytes) \
+    const ::detail::InstrumentScope computer_brain_instrument_scope_((kind), (shape), (flops), (bytes))
+#define COMPUTER_BRAIN_INSTRUMENT_ALLOCATION(kind, bytes) ::detail::instrument_allocation((kind), (bytes))
+#else
+#define COMPUTER_BRAIN_INSTRUMENT_OP(kind, shape, flops, bytes) static_cast<void>(0)
+#define COMPUTER_BRAIN_INSTRUMENT_ALLOCATION(kind, bytes) static_cast<void>(0)
+#endif
+
+
+/* ---------------------------------------------- Snapshot and Reset ------------------------------------------------ */
+
+
+/// Returns a copy of every counter recorded since the start of the program or the last instrument_reset().
+inline InstrumentSnapshot instrument_snapshot() {
+    InstrumentSnapshot snapshot;
+    detail::InstrumentRegistry& registry = detail::instrument_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (size_t kind = 0; kind < op_kind_count; ++kind) {
+        const detail::InstrumentRecord& record = registry.records[kind];
+        OpStats& stats = snapshot.ops[kind];
+        stats = record.totals;
+        stats.shapes.reserve(record.shapes.size());
+        for (const auto& entry : record.shapes) stats.shapes.push_back(entry.second);
+        std::stable_sort(stats.shapes.begin(), stats.shapes.end(), [](const OpShapeStats& a, const OpShapeStats& b) {
+            return a.seconds > b.seconds;
+        });
+    }
+    return snapshot;
+}
+
+/// Sets every counter back to zero and forgets every shape.
+inline void instrument_reset() {
+    detail::InstrumentRegistry& registry = detail::instrument_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (detail::InstrumentRecord& record : registry.records) record = detail::InstrumentRecord{};
+}
+
+
+/* -------------------------------------------------- JSON Output --------------------------------------------------- */
+
+
+namespace detail {
+
+inline void instrument_append_counters(std::string& out, std::uint64_t calls, std::uint64_t flops,
+                                       std::uint64_t bytes, double seconds) {
+    char buffer[256];
+    std::snprintf(buffer, sizeof(buffer), "\"calls\": %llu, \"flops\": %llu, \"bytes\": %llu, \"seconds\": %.9g",
+                  (unsigned long long)calls, (unsigned long long)flops, (unsigned long long)bytes, seconds);
+    out += buffer;
+}
+
+}  // namespace detail
+
+/**
+ * @brief The snapshot as a JSON document: one object per OpKind, with its totals and its shapes, slowest first.
+ *
+ *     {"operations": [
+ *       {"op": "gemm", "calls": 3, "flops": ..., "bytes": ..., "seconds": ..., "allocations": 3,
+ *        "allocated_bytes": ..., "other_calls": 0,
+ *        "shapes": [{"shape": [512, 512, 512], "calls": 2, "flops": ..., "bytes": ..., "seconds": ...}, ...]},
+ *       ...]}
+ */
+inline std::string InstrumentSnapshot::to_json() const {
+    std::string out = "{\"operations\": [\n";
+    for (size_t kind = 0; kind < op_kind_count; ++kind) {
+        const OpStats& stats = ops[kind];
+        out += "  {\"op\": \"";
+        out += op_kind_name(OpKind(kind));
+        out += "\", ";
+        detail::instrument_append_counters(out, stats.calls, stats.flops, stats.bytes, stats.seconds);
+        out += ", \"allocations\": " + std::to_string(stats.allocations);
+        out += ", \"allocated_bytes\": " + std::to_string(stats.allocated_bytes);
+        out += ", \"other_calls\": " + std::to_string(stats.other_calls);
+        out += ",\n   \"shapes\": [";
+        for (size_t s = 0; s < stats.shapes.size(); ++s) {
+            const OpShapeStats& shape = stats.shapes[s];
+            out += s == 0 ? "\n    {\"shape\": [" : ",\n    {\"shape\": [";
+            for (size_t d = 0; d < shape.shape.rank; ++d) {
+                if (d > 0) out += ", ";
+                out += std::to_string(shape.shape.extents[d]);
+            }
+            out += "], ";
+            detail::instrument_append_counters(out, shape.calls, shape.flops, shape.bytes, shape.seconds);
+            out += "}";
+        }
+        out += stats.shapes.empty() ? "]}" : "\n   ]}";
+        out += kind + 1 < op_kind_count ? ",\n" : "\n";
+    }
+    out += "]}\n";
+    return out;
+}
+
+/// Shorthand for instrument_snapshot().to_json().
+inline std::string instrument_json() { return instrument_snapshot().to_json(); }
+
+
+#endif //COMPUTER_BRAIN_INSTRUMENT_H
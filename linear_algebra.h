@@ -4,15 +4,42 @@
 #ifndef COMPUTER_BRAIN_LINEAR_ALGEBRA_H
 #define COMPUTER_BRAIN_LINEAR_ALGEBRA_H
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
+#include <span>
+#include <string>
 #include <stdexcept>
 #include <iostream>
 
+#include "aligned.h"
+#include "binary_io.h"
+#include "dense.h"
+#include "elementwise.h"
+#include "expression.h"
+#include "factorization.h"
+#include "fixed.h"
+#include "gemm.h"
+#include "graph.h"
+#include "half.h"
+#include "instrument.h"
+#include "quantize.h"
+#include "reduce.h"
+#include "simd.h"
+#include "sparse.h"
+#include "streaming.h"
+#include "text_io.h"
+#include "thread_pool.h"
+#include "view.h"
+#include "workspace.h"
+
 /* ----------------------------------------- Vector Class Definitions ----------------------------------------------- */
-template<typename T> class Vector {
+template<typename T> class Vector<T, dynamic_size> : public VectorExpression<Vector<T>> {
 private:
-    std::vector<T> repr;  // the representation of the Vector class is a std::vector
+    std::vector<T, detail::WorkspaceAllocator<T>> repr;  // a std::vector whose memory may come from a Workspace
 public:
+    using value_type = T;
+
     /* Constructors and Destructor */
     ~Vector();                                      // destructor
     Vector(const Vector& other);                    // copy constructor
@@ -20,39 +47,66 @@ public:
     Vector(Vector&& other) noexcept;                // move constructor
     Vector& operator=(Vector && other) noexcept;    // move assignment operator
     Vector(int num_elements, T element);
-    explicit Vector(std::vector<T> vec);
+    explicit Vector(const std::vector<T>& vec);
+    template<typename E> Vector(const VectorExpression<E>& expr);             // evaluates an expression
+    template<typename E> Vector& operator=(const VectorExpression<E>& expr);  // evaluates an expression
 
     /* Member Variables */
     bool is_transposed = false;
 
     /* Member Functions */
-    size_t size();
+    size_t size() const;
     auto begin();
     auto end();
     void transpose();
     Vector<T>& t();
+    T* data();
+    const T* data() const;
+    VectorView<T> view();
+    VectorView<const T> view() const;
 
     /* Non-Mathematical Operations */
     T& operator[](const size_t& i);
+    const T& operator[](const size_t& i) const;
 
     /* Mathematical Operations */
-    Vector operator+(Vector& other);
-    Vector operator-(Vector& other);
+    /* +, -, scalar * and scalar / are the expression operators of expression.h */
     T operator*(Vector& other);         // dot product
-    Vector& operator*(const T& other);  // scalar multiplication with variable
-    Vector& operator*(T&& other);       // scalar multiplication with literal
-    Vector& operator/(const T& other);  // scalar division by a variable
-    Vector& operator/(T&& other);       // scalar division by a literal
+    template<typename E> Vector& operator+=(const VectorExpression<E>& expr);  // in place, one pass, no allocation
+    template<typename E> Vector& operator-=(const VectorExpression<E>& expr);
+    Vector& operator*=(const T& scalar);
+    Vector& operator/=(const T& scalar);
 };
 
 
 /* ---------------------------------------- Matrix Class Declarations ----------------------------------------------- */
 
 
-template<typename U> class Matrix {
+template<typename U> class Matrix<U, dynamic_size, dynamic_size> : public MatrixExpression<Matrix<U>> {
 private:
-    std::vector<Vector<U>> repr;  // representation is a std::vector of computer_brain Vectors
+    std::vector<U, detail::WorkspaceAllocator<U>> repr;  // one contiguous, row-major buffer holding every element
+    size_t num_rows = 0;      // number of rows held in repr
+    size_t num_cols = 0;      // number of columns held in repr
+    size_t leading_dim = 0;   // distance, in elements, between the first elements of two consecutive rows
+    MatrixLayout storage_layout = MatrixLayout::packed;
+
+    /* Row Iterator: lets the range based for loop walk the Matrix one row (a std::span) at a time */
+    template<typename V> class RowIterator {
+    private:
+        V* row_ptr;
+        size_t num_cols;
+        size_t leading_dim;
+    public:
+        RowIterator(V* row_ptr, size_t num_cols, size_t leading_dim)
+            : row_ptr(row_ptr), num_cols(num_cols), leading_dim(leading_dim) { }
+        std::span<V> operator*() const { return std::span<V>(row_ptr, num_cols); }
+        RowIterator& operator++() { row_ptr += leading_dim; return *this; }
+        bool operator==(const RowIterator& other) const { return row_ptr == other.row_ptr; }
+        bool operator!=(const RowIterator& other) const { return row_ptr != other.row_ptr; }
+    };
 public:
+    using value_type = U;
+
     /* Constructors and Destructor */
     ~Matrix();                                           // destructor
     Matrix(const Matrix& other);                         // copy constructor
@@ -60,7 +114,9 @@ public:
     Matrix(Matrix&& other) noexcept;                     // move constructor
     Matrix& operator=(Matrix && other) noexcept;         // move assignment operator
     explicit Matrix(const std::vector<Vector<U>>& mat);  // value constructor: takes a std::vector<Vector>
-    Matrix(size_t num_rows, size_t num_cols);            // value constructor: takes two ints
+    Matrix(size_t num_rows, size_t num_cols, MatrixLayout layout = MatrixLayout::packed);  // a Matrix of zeros
+    template<typename E> Matrix(const MatrixExpression<E>& expr);             // evaluates an expression
+    template<typename E> Matrix& operator=(const MatrixExpression<E>& expr);  // evaluates an expression
 
 
 
@@ -68,21 +124,38 @@ public:
     bool is_transposed = false;
 
     /* Member Functions */
-    size_t rows();
-    size_t columns();
-    auto begin();
-    auto end();
+    size_t rows() const;
+    size_t columns() const;
+    size_t ld() const;
+    MatrixLayout layout() const;
+    U* data();
+    const U* data() const;
+    RowIterator<U> begin();
+    RowIterator<U> end();
+    RowIterator<const U> begin() const;
+    RowIterator<const U> end() const;
     void t();
-    Vector<U>& get_column(size_t col_num);
+    MatrixView<U> view();
+    MatrixView<const U> view() const;
+    VectorView<U> row(size_t i);
+    VectorView<const U> row(size_t i) const;
+    VectorView<U> col(size_t j);
+    VectorView<const U> col(size_t j) const;
+    VectorView<U> get_column(size_t col_num);
+    VectorView<const U> get_column(size_t col_num) const;
+    MatrixView<U> submatrix(size_t first_row, size_t first_col, size_t rows, size_t columns);
+    MatrixView<const U> submatrix(size_t first_row, size_t first_col, size_t rows, size_t columns) const;
 
     /* Non-Mathematical Operations */
-    Vector<U>& operator[](const size_t& i);
+    std::span<U> operator[](const size_t& i);
+    std::span<const U> operator[](const size_t& i) const;
 
     /* Mathematical Operations */
-    Matrix operator+(const Matrix& other);
-    Matrix operator-(const Matrix& other);
-    Matrix& operator*(const U& other);      // scalar multiplication; with scalar variable
-    Matrix& operator*(U&& other);           // scalar multiplication; with scalar literal
+    /* +, -, scalar * and scalar / are the expression operators of expression.h */
+    template<typename E> Matrix& operator+=(const MatrixExpression<E>& expr);  // in place, one pass, no allocation
+    template<typename E> Matrix& operator-=(const MatrixExpression<E>& expr);
+    Matrix& operator*=(const U& scalar);
+    Matrix& operator/=(const U& scalar);
 };
 
 
@@ -139,19 +212,54 @@ Vector<T>& Vector<T>::operator=(Vector<T>&& other) noexcept{
 /// Create a computer_brain Vector by passing an integer and an element to be repeated.
 template<typename T>
 Vector<T>::Vector(int num_elements, T element){
-    std::vector temp_vec(num_elements, element);
-    repr = temp_vec;
+    repr.assign(num_elements, element);
 }
 
-/// Create a computer_brain Vector by passing the constructor an std::vector.
+/// Create a computer_brain Vector by passing the constructor an std::vector. The elements are copied.
 template<typename T>
-Vector<T>::Vector(std::vector<T> vec) : repr(std::move(vec)) { }
+Vector<T>::Vector(const std::vector<T>& vec) : repr(vec.begin(), vec.end()) { }
+
+/**
+ * @brief Expression constructor: evaluates an elementwise expression such as a + b - c * 2 into a new Vector.
+ *
+ * The whole expression is computed in a single pass over the new Vector, without any temporary Vector. The new
+ * Vector takes the orientation of the expression.
+ */
+template<typename T>
+template<typename E>
+Vector<T>::Vector(const VectorExpression<E>& expr)
+    : repr(detail::as_operand(expr.self()).size()), is_transposed(detail::as_operand(expr.self()).transposed()) {
+    COMPUTER_BRAIN_INSTRUMENT_ALLOCATION(detail::ExpressionCost<E>::kind, repr.size() * sizeof(T));
+    detail::evaluate(expr, repr.data());
+}
+
+/**
+ * @brief Expression assignment: evaluates an elementwise expression into this Vector.
+ *
+ * The expression may use this Vector as an operand (a = a + b): every element i is read before element i is written,
+ * and no other element is read, so the result is correct without a temporary. When the expression reads this Vector
+ * through a strided or shifted view, that no longer holds and the expression is evaluated into a new buffer instead.
+ */
+template<typename T>
+template<typename E>
+Vector<T>& Vector<T>::operator=(const VectorExpression<E>& expr) {
+    auto&& source = detail::as_operand(expr.self());
+    if (!repr.empty() && source.aliases(repr.data(), repr.data() + repr.size(), repr.data(), 1)) {
+        *this = Vector<T>(expr);
+        return *this;
+    }
+    const bool orientation = source.transposed();
+    repr.resize(expr.self().size());
+    detail::evaluate(expr, repr.data());
+    is_transposed = orientation;
+    return *this;
+}
 
 /* Vector Member Functions */
 
 /// Vector.size() returns the number of elements that the vector contains.
 template<typename T>
-size_t Vector<T>::size(){ return repr.size(); }
+size_t Vector<T>::size() const { return repr.size(); }
 
 /**
  * Vector.begin() calls the begin function on the representation of a Vector. The begin function, along with the end
@@ -196,97 +304,47 @@ Vector<T>& Vector<T>::t(){
     return *this;
 }
 
+/// Vector.data() returns a pointer to the first element of the Vector.
+template<typename T>
+T* Vector<T>::data() { return repr.data(); }
+
+/// Vector.data() returns a pointer to the first element of the Vector.
+template<typename T>
+const T* Vector<T>::data() const { return repr.data(); }
+
+/// Vector.view() returns a view of every element of the Vector, in its current orientation.
+template<typename T>
+VectorView<T> Vector<T>::view() { return VectorView<T>(repr.data(), repr.size(), 1, is_transposed); }
+
+/// Read-only version of Vector.view().
+template<typename T>
+VectorView<const T> Vector<T>::view() const { return VectorView<const T>(repr.data(), repr.size(), 1, is_transposed); }
+
 /* Non-Mathematical Operation */
 
 /// Indexing a Vector is similar to indexing a std::vector.
 template <typename T>
 T& Vector<T>::operator[](const size_t& i) { return repr[i]; }
 
+/// Read-only version of Vector[i].
+template <typename T>
+const T& Vector<T>::operator[](const size_t& i) const { return repr[i]; }
+
 /* Mathematical Operations */
-/**
- * Addition between two Vectors is defined by elementwise addition. In other words, given two Vectors of the same
- * size, regardless of orientation, the sum of two matrices is equal to a Vector of the same size whose element i is
- * equal to the sum of the elements i in each of the Vectors; for all i.
+/*
+ * Addition and subtraction between two Vectors are defined elementwise: given two Vectors of the same size and
+ * orientation, element i of the result is the sum (difference) of the elements i of each Vector, for all i. Both, and
+ * multiplication and division by a scalar, are lazy expressions; see expression.h.
  */
-template<typename T>
-Vector<T> Vector<T>::operator+(Vector& other){
-    if (is_transposed == other.is_transposed && size() == other.size()) { // if: vectors have the same orientation and size
-        std::vector<T> result_repr(repr.size(), 0);
-        Vector<T> result(result_repr);
-        for (size_t i = 0; i < repr.size(); ++i) {
-            result[i] = repr[i] + other[i];
-        }
-        if (is_transposed) {  // if: the vectors are transposed, then un-transpose them
-            is_transposed = false;
-            other.is_transposed = false;
-            result.is_transposed = true;  // result vector takes the orientation of the argument vectors
-        }
-        return result;
-    }
-    else if(size() == other.size() == 1){  // else if: the vectors have different orientation, but only one element
-        std::vector<T> result_repr(repr.size(), 0);
-        Vector<T> result(result_repr);
-        result[0] = repr[0] + other[0];
-        if (is_transposed)  // if: this vector is transposed, un-transpose it
-            is_transposed = false;
-        else                // else: other vector must be transposed, un-transpose it
-            other.is_transposed = false;
-        return result;
-    }
-    else{  // else: throw an error
-        throw std::invalid_argument("\nEither: (a) The vectors you attempted to add have different orientation\n"
-                                    "        (b) The Vectors you attempted to add have different sizes\n"
-                                    "        (c) Both\n"
-        );
-    }
-}
 
 /**
- * Subtraction between two Vectors is defined by elementwise subtraction. In other words, given two Vectors of the
- * same size, regardless of orientation, the difference of two matrices is equal to a Vector of the same size whose
- * element i is equal to the difference of the elements i in each of the Vectors; for all i.
+ * The dot product of a row Vector (transposed) with a column Vector (not transposed) of the same size: the sum of the
+ * products of the elements i of the two Vectors, for all i.
  */
-template<typename T>
-Vector<T> Vector<T>::operator-(Vector& other){
-    if (is_transposed == other.is_transposed && size() == other.size()) { // if: vectors have the same orientation and size
-        std::vector<T> result_repr(repr.size(), 0);
-        Vector<T> result(result_repr);
-        for (size_t i = 0; i < repr.size(); ++i) {
-            result[i] = repr[i] - other[i];
-        }
-        if (is_transposed) {  // if: the vectors are transposed, then un-transpose them
-            is_transposed = false;
-            other.is_transposed = false;
-            result.is_transposed = true;  // result vector takes the orientation of the argument vectors
-        }
-        return result;
-    }
-    else if(size() == other.size() == 1){  // else if: the vectors have different orientation, but only one element
-        std::vector<T> result_repr(repr.size(), 0);
-        Vector<T> result(result_repr);
-        result[0] = repr[0] - other[0];
-        if (is_transposed)  // if: this vector is transposed, un-transpose it
-            is_transposed = false;
-        else                // else: other vector must be transposed, un-transpose it
-            other.is_transposed = false;
-        return result;
-    }
-    else{  // else: throw an error
-        throw std::invalid_argument("\nEither: (a) The vectors you attempted to subtract have different orientation\n"
-                                    "        (b) The Vectors you attempted to subtract have different sizes\n"
-                                    "        (c) Both\n"
-        );
-    }
-}
-
 template <typename T>
 T Vector<T>::operator*(Vector& other){
     if(is_transposed && !other.is_transposed && (size() == other.size())) {
-        T sum = 0;
-        for (int i = 0; i < size(); ++i) {
-            sum += (repr[i] + other[i]);
-        }
-        return sum;
+        return dot(view(), other.view());
     } else {
         throw std::invalid_argument("\nEither: (a) The dot product cannot be computed due to incompatible orientation of vectors\n"
                                     "        (b) The dot product cannot be computed due to incompatible vector length\n"
@@ -295,67 +353,41 @@ T Vector<T>::operator*(Vector& other){
     }
 }
 
-template<typename T>
 /**
- * @brief Multiply each element by a scalar number.
+ * @brief Compound assignment: every element of this Vector becomes this + expr, in one pass and without allocating.
  *
- * @tparam T a scalar number type (int, float, double, etc..)
- * @param other a scalar number held in a variable
- * @return Vector<T> where T is the same as the vector which we are operating on
+ * The Vector keeps its size and orientation; expr must have the same size and orientation (std::invalid_argument
+ * otherwise), as for +. The work is done through view() (see VectorView::operator+=).
  */
-Vector<T>& Vector<T>::operator*(const T& other){
-    for(size_t i = 0; i < size(); ++i){
-        repr[i] *= other;
-    }
+template<typename T>
+template<typename E>
+Vector<T>& Vector<T>::operator+=(const VectorExpression<E>& expr) {
+    view() += expr;
     return *this;
 }
 
-template <typename T>
-/**
- * @brief Multiply each element by a scalar number.
- *
- * @tparam T a scalar number type (int, float, double, etc..)
- * @param other a scalar literal
- * @return Vector<T> where T is the same as the vector which we are operating on
- */
-Vector<T>& Vector<T>::operator*(T&& other){
-    for(size_t i = 0; i < size(); ++i){
-        repr[i] *= other;
-    }
+/// Compound assignment: every element of this Vector becomes this - expr. See operator+=.
+template<typename T>
+template<typename E>
+Vector<T>& Vector<T>::operator-=(const VectorExpression<E>& expr) {
+    view() -= expr;
     return *this;
 }
 
+/// Multiplies every element of this Vector by a scalar, in place. Unlike Vector * scalar, this modifies the Vector.
 template<typename T>
-/**
- * @brief Divide each element by a scalar number.
- *
- * @tparam T a scalar number type (int, float, double, etc..)
- * @param other a scalar number held in a variable
- * @return Vector<T> where T is the same as the vector which we are operating on
- */
-Vector<T>& Vector<T>::operator/(const T& other){
-    for(size_t i = 0; i < size(); ++i){
-        repr[i] /= other;
-    }
+Vector<T>& Vector<T>::operator*=(const T& scalar) {
+    view() *= scalar;
     return *this;
 }
 
-template <typename T>
-/**
- * @brief Divide each element by a scalar number.
- *
- * @tparam T a scalar number type (int, float, double, etc..)
- * @param other a scalar literal
- * @return Vector<T> where T is the same as the vector which we are operating on
- */
-Vector<T>& Vector<T>::operator/(T&& other){
-    for(size_t i = 0; i < size(); ++i){
-        repr[i] /= other;
-    }
+/// Divides every element of this Vector by a scalar, in place. Unlike Vector / scalar, this modifies the Vector.
+template<typename T>
+Vector<T>& Vector<T>::operator/=(const T& scalar) {
+    view() /= scalar;
     return *this;
 }
 
-
 /* ----------------------------------------- Matrix Class Definitions ----------------------------------------------- */
 
 
@@ -371,10 +403,9 @@ Matrix<U>::~Matrix() = default;  // classic destructor
  * Deep copy of another Matrix.
  */
 template<typename U>
-Matrix<U>::Matrix(const Matrix& other){
-    repr = other.repr;
-    is_transposed = other.is_transposed;
-}
+Matrix<U>::Matrix(const Matrix& other)
+    : repr(other.repr), num_rows(other.num_rows), num_cols(other.num_cols), leading_dim(other.leading_dim),
+      storage_layout(other.storage_layout), is_transposed(other.is_transposed) { }
 
 /**
  * Copy assignment operator: Assigns data from one object to another object. Used when the assignment operator = is
@@ -384,6 +415,10 @@ template<typename U>
 Matrix<U>& Matrix<U>::operator=(const Matrix &other) {
     if (this != &other){  // if: this Matrix is not the same vector as other, make a deep copy of other
         repr = other.repr;
+        num_rows = other.num_rows;
+        num_cols = other.num_cols;
+        leading_dim = other.leading_dim;
+        storage_layout = other.storage_layout;
         is_transposed = other.is_transposed;
     }
     return *this;
@@ -391,7 +426,11 @@ Matrix<U>& Matrix<U>::operator=(const Matrix &other) {
 
 /// Move constructor: Transfers the ownership of resources from one Matrix to another.
 template<typename U>
-Matrix<U>::Matrix(Matrix&& other) noexcept : repr(std::move(other.repr)), is_transposed(other.is_transposed) { }
+Matrix<U>::Matrix(Matrix&& other) noexcept
+    : repr(std::move(other.repr)), num_rows(other.num_rows), num_cols(other.num_cols),
+      leading_dim(other.leading_dim), storage_layout(other.storage_layout), is_transposed(other.is_transposed) {
+    other.num_rows = other.num_cols = other.leading_dim = 0;  // the moved-from Matrix no longer owns any elements
+}
 
 /**
  * Move assignment operator: Used when an existing Matrix is assigned the value of an rvalue. It is activated when
@@ -400,8 +439,13 @@ Matrix<U>::Matrix(Matrix&& other) noexcept : repr(std::move(other.repr)), is_tra
 template<typename U>
 Matrix<U>& Matrix<U>::operator=(Matrix<U>&& other) noexcept{
     if (this != &other){  // if: this vector and the other are not the same Matrix, transfer resources to this vector
-        repr(std::move(other.repr));
+        repr = std::move(other.repr);
+        num_rows = other.num_rows;
+        num_cols = other.num_cols;
+        leading_dim = other.leading_dim;
+        storage_layout = other.storage_layout;
         is_transposed = other.is_transposed;
+        other.num_rows = other.num_cols = other.leading_dim = 0;
     }
     return *this;
 }
@@ -411,66 +455,164 @@ Matrix<U>& Matrix<U>::operator=(Matrix<U>&& other) noexcept{
  *
  * This value constructor takes one parameter: @param mat a std::vector<Vector<U>>, a standard vector full of Vectors
  * with elements of type U. This is useful when we want to transform a vector into a Matrix or when we want to define
- * a Matrix with particular values.
+ * a Matrix with particular values. The elements of every Vector are copied, row after row, into the contiguous
+ * representation of the Matrix.
+ *
+ * A Matrix cannot have uneven rows, so if the Vectors in mat do not all have the same size, std::invalid_argument is
+ * thrown.
  *
  * @tparam U should be a numerical type
  */
 template <typename U>
-Matrix<U>::Matrix(const std::vector<Vector<U>>& mat) : repr(std::move(mat)) { }
+Matrix<U>::Matrix(const std::vector<Vector<U>>& mat)
+    : num_rows(mat.size()), num_cols(mat.empty() ? 0 : mat[0].size()), leading_dim(num_cols) {
+    repr.resize(num_rows * leading_dim);
+    for (size_t i = 0; i < num_rows; ++i) {
+        if (mat[i].size() != num_cols) {  // if: this row is not the same length as the first row, refuse to build
+            throw std::invalid_argument("\nThe Vectors used to build a Matrix must all have the same size. Row " +
+                                        std::to_string(i) + " has " + std::to_string(mat[i].size()) +
+                                        " elements, but row 0 has " + std::to_string(num_cols) + "\n");
+        }
+        U* row = repr.data() + i * leading_dim;
+        for (size_t j = 0; j < num_cols; ++j) {
+            row[j] = mat[i][j];
+        }
+    }
+}
 
 /**
  * @brief Value constructor. Takes two integer values and returns a Matrix of zeros.
  *
  * This value constructor takes two parameters: @param num_cols, num_rows these parameters are both of type size_t.
- * Calling this value constructor will return a Matrix full of zeros with num_rows rows and num_cols columns.
+ * Calling this value constructor will return a Matrix full of zeros with num_rows rows and num_cols columns. All of
+ * the elements live in a single allocation, which starts on a 64-byte boundary.
+ *
+ * The optional @param layout chooses how the rows are laid out: packed (the default) puts them back to back, padded
+ * starts every row on a 64-byte boundary and keeps the row stride away from multiples of 512 bytes (see aligned.h).
+ * The padding elements are zero and are never read by any operation.
  *
  * @tparam U should be a numerical type.
  */
  template <typename U>
-Matrix<U>::Matrix(size_t num_rows, size_t num_cols){
-    Vector<U> temp_vec(std::vector(num_cols, (U)0));  // (U) here means cast the 0 to whatever type U is
-    repr = std::vector(num_rows, temp_vec);
+Matrix<U>::Matrix(size_t num_rows, size_t num_cols, MatrixLayout layout)
+    : num_rows(num_rows), num_cols(num_cols), leading_dim(leading_dim_for<U>(num_cols, layout)),
+      storage_layout(layout) {
+    repr.assign(num_rows * leading_dim, (U)0);
 }
 
-/* Matrix Member Functions */
-
-/// Matrix.rows() returns the number of elements -rows- that the Matrix contains.
+/**
+ * @brief Expression constructor: evaluates an elementwise expression such as A + B.t() - C * 2 into a new Matrix.
+ *
+ * The whole expression is computed in a single pass over the new Matrix, without any temporary Matrix. Every operand
+ * is read in its current orientation, and the new Matrix is not transposed.
+ */
 template<typename U>
-size_t Matrix<U>::rows(){
-    return repr.size();
+template<typename E>
+Matrix<U>::Matrix(const MatrixExpression<E>& expr)
+    : num_rows(detail::as_operand(expr.self()).logical_rows()),
+      num_cols(detail::as_operand(expr.self()).logical_columns()), leading_dim(num_cols) {
+    repr.resize(num_rows * leading_dim);
+    COMPUTER_BRAIN_INSTRUMENT_ALLOCATION(detail::ExpressionCost<E>::kind, repr.size() * sizeof(U));
+    detail::evaluate(expr, repr.data(), leading_dim);
 }
 
 /**
- * @brief Returns the number of elements in the first row of the matrix.
+ * @brief Expression assignment: evaluates an elementwise expression into this Matrix.
  *
- * Matrix.columns() returns the number of elements in the [FIRST] row of the Matrix. If there are no elements -no
- * rows- in the Matrix, you will receive an error. This is because we cannot count the number of columns in a non-
- * existent object.
- *
- * WARNING: Because the representation of a Matrix is an std::vector, it is possible to create a Matrix with uneven
- * rows. This Matrix class was built to reflect the matrices used in mathematics, which cannot have uneven rows.
- * If you create a Matrix with uneven rows, the behavior will be undefined. Do not create a Matrix with uneven rows.
+ * The Matrix keeps its layout: a padded Matrix stays padded, and when the shape does not change the elements are
+ * written into the existing buffer. The expression may use this Matrix as an operand (A = A + B): when every element
+ * (i, j) of the result reads only element (i, j) of this Matrix, the expression is evaluated in place. When this
+ * Matrix is also read transposed, or through a view that is shifted or strided differently, writing in place would
+ * overwrite elements that are still to be read, so the expression is evaluated into a new buffer instead.
  */
 template<typename U>
-size_t Matrix<U>::columns() {
-    if (!repr.empty()){ return repr[0].size(); }
-    throw std::logic_error("The matrix, on which Matrix.columns() was called, is empty and thus does not contain any "
-                           "elements. Therefore, Matrix cannot report a column count.");
+template<typename E>
+Matrix<U>& Matrix<U>::operator=(const MatrixExpression<E>& expr) {
+    auto&& source = detail::as_operand(expr.self());
+    const size_t new_rows = source.logical_rows();
+    const size_t new_cols = source.logical_columns();
+    const size_t new_ld = new_cols == num_cols ? leading_dim : leading_dim_for<U>(new_cols, storage_layout);
+    if (!repr.empty() &&
+        source.aliases(repr.data(), repr.data() + repr.size(), repr.data(), (ptrdiff_t)new_ld, 1)) {
+        Matrix<U> result(new_rows, new_cols, storage_layout);
+        COMPUTER_BRAIN_INSTRUMENT_ALLOCATION(detail::ExpressionCost<E>::kind, new_rows * result.ld() * sizeof(U));
+        detail::evaluate(expr, result.data(), result.ld());
+        *this = std::move(result);
+        return *this;
+    }
+    num_rows = new_rows;
+    num_cols = new_cols;
+    leading_dim = new_ld;
+    repr.resize(num_rows * leading_dim);
+    detail::evaluate(expr, repr.data(), leading_dim);
+    is_transposed = false;
+    return *this;
 }
 
+/* Matrix Member Functions */
+
+/// Matrix.rows() returns the number of rows that the Matrix contains.
+template<typename U>
+size_t Matrix<U>::rows() const { return num_rows; }
+
 /**
- * Matrix.begin() calls the begin function on the representation of a Matrix. The begin function, along with the end
- * function, allows us to use the range based for loop on our Matrix(s).
+ * @brief Returns the number of columns in the Matrix.
+ *
+ * Because every row of a Matrix lives in the same contiguous buffer, all rows have exactly the same number of
+ * elements; a Matrix with uneven rows cannot be built.
+ */
+template<typename U>
+size_t Matrix<U>::columns() const { return num_cols; }
+
+/**
+ * Matrix.ld() returns the leading dimension of the Matrix: the number of elements between the start of one row and
+ * the start of the next row in the underlying buffer. Element (i, j) lives at data()[i * ld() + j].
  */
 template<typename U>
-auto Matrix<U>::begin(){ return repr.begin(); }
+size_t Matrix<U>::ld() const { return leading_dim; }
+
+/// Matrix.layout() tells whether the rows of the Matrix are packed or padded (see aligned.h).
+template<typename U>
+MatrixLayout Matrix<U>::layout() const { return storage_layout; }
+
+/// Matrix.data() returns a pointer to the first element of the contiguous, row-major buffer.
+template<typename U>
+U* Matrix<U>::data() { return repr.data(); }
+
+/// Matrix.data() returns a pointer to the first element of the contiguous, row-major buffer.
+template<typename U>
+const U* Matrix<U>::data() const { return repr.data(); }
 
 /**
- * Matrix.end() calls the end function on the representation of a Matrix. The end function, along with the begin
+ * Matrix.begin() returns an iterator over the rows of the Matrix. Each row is handed out as a std::span over the
+ * contiguous buffer. The begin function, along with the end function, allows us to use the range based for loop on
+ * our Matrix(s).
+ */
+template<typename U>
+typename Matrix<U>::template RowIterator<U> Matrix<U>::begin(){
+    return RowIterator<U>(repr.data(), num_cols, leading_dim);
+}
+
+/**
+ * Matrix.end() returns an iterator one past the last row of the Matrix. The end function, along with the begin
  * function, allows us to use the range based for loop on our Matrix(s).
  */
 template<typename U>
-auto Matrix<U>::end(){ return repr.end(); }
+typename Matrix<U>::template RowIterator<U> Matrix<U>::end(){
+    return RowIterator<U>(repr.data() + num_rows * leading_dim, num_cols, leading_dim);
+}
+
+/// Read-only version of Matrix.begin().
+template<typename U>
+typename Matrix<U>::template RowIterator<const U> Matrix<U>::begin() const {
+    return RowIterator<const U>(repr.data(), num_cols, leading_dim);
+}
+
+/// Read-only version of Matrix.end().
+template<typename U>
+typename Matrix<U>::template RowIterator<const U> Matrix<U>::end() const {
+    return RowIterator<const U>(repr.data() + num_rows * leading_dim, num_cols, leading_dim);
+}
 
 /**
  * @brief Matrix.t() changes the orientation of the Matrix from not transposed to transposed, or vice-versa.
@@ -483,213 +625,124 @@ auto Matrix<U>::end(){ return repr.end(); }
 template<typename U>
 void Matrix<U>::t(){ is_transposed = !is_transposed; }
 
-/* Non-Mathematical Operation */
-/// Indexing a Vector is similar to indexing a std::vector.
-template <typename U>
-Vector<U>& Matrix<U>::operator[](const size_t& i) { return repr[i]; }
-
-/* Mathematical Operations */
 /**
- * @brief Elementwise addition between two Matrix.
- *
- * Given two Matrix the (+) operator performs elementwise addition between matrices. Matrix addition is performed as
- * learned in linear algebra. If the matrices are both NxM, then addition is legal. If matrices have shape MxN and NxM,
- * then addition is only legal if one of the matrices is transposed.
- *
- * The resulting Matrix will have shape corresponding to the input. If both matrices are, MxN and transposed, then the
- * result matrix will have shape NxM. Just as you would expect in linear algebra
+ * @brief Matrix.view() returns a view of every element of the Matrix, in its current orientation.
  *
- * @tparam U should be a numerical type
- * @param other should be a Matrix with compatible dimensions for addition
- * @return a Matrix<U> with dimension defined by the input
- */
-template<typename U>
-Matrix<U> Matrix<U>::operator+(const Matrix<U> &other) {
-    // if matrices have the same orientation and dimensions
-    if (is_transposed == other.is_transposed and rows() == other.rows() and columns() == other.columns()){
-        if (!is_transposed) {  // and if the matrices are not transposed
-            Matrix<U> result(rows(), columns());
-            for (size_t i; i < rows(); ++i) {
-                for (size_t j; j < columns(); ++j) {
-                    result[i][j] = this[i][j] + other[i][j];
-                }
-            }
-            return result;
-        } else {  // and if the matrices are transposed
-            Matrix<U> result(columns(), rows());
-            for (size_t i; i < rows(); ++i) {
-                for (size_t j; j < columns(); ++j) {
-                    result[j][i] = this[i][j] + other[i][j];
-                }
-            }
-            return result;
-        }
-    }
-    // else if the matrices dont have the same orientation, but are compatible for addition in their current orientation
-    else if(rows()==other.columns() and columns() == other.rows()) {
-        if(!is_transposed){  // if this matrix is not transposed
-            Matrix<U> result(rows(), columns());
-            for (size_t i; i < rows(); ++i) {
-                for (size_t j; j < columns(); ++j) {
-                    result[i][j] = this[i][j] + other[j][i];
-                }
-            }
-            return result;
-        } else {  // this matrix is transposed
-            Matrix<U> result(columns(), rows());
-            for (size_t i; i < rows(); ++i) {
-                for (size_t j; j < columns(); ++j) {
-                    result[j][i] = this[i][j] + other[j][i];
-                }
-            }
-        }
-    }
-    else {  // else the matrices are not compatible for addition
-        throw std::invalid_argument("\nEither: (a) The matrices you attempted to add have different orientation\n"
-                                    "        (b) The matrices you attempted to add have different sizes\n"
-                                    "        (c) Both\n");
-    }
+ * This is the one place where is_transposed is looked at: a transposed Matrix gives a view whose shape and strides
+ * are swapped, and every kernel that takes the view (elementwise expressions, gemm()) then reads it through its
+ * strides without caring about orientation. view().t() is a transpose that leaves is_transposed alone.
+ */
+template<typename U>
+MatrixView<U> Matrix<U>::view() {
+    if (is_transposed) return MatrixView<U>(repr.data(), num_cols, num_rows, 1, (ptrdiff_t)leading_dim);
+    return MatrixView<U>(repr.data(), num_rows, num_cols, (ptrdiff_t)leading_dim, 1);
 }
 
-/**
- * @brief Elementwise subtraction between two Matrix.
- *
- * Given two Matrix the (-) operator performs elementwise subtraction between matrices. Matrix subtraction is performed
- * as learned in linear algebra. If the matrices are both NxM, then subtraction is legal. If matrices have shape MxN and
- * NxM, then subtraction is legal only if one of the matrices is transposed.
- *
- * The resulting Matrix will have shape corresponding to the input. If both matrices are, MxN and transposed, then the
- * result matrix will have shape NxM. Just as you would expect in linear algebra
- *
- * @tparam U should be a numerical type
- * @param other should be a Matrix with compatible dimensions for subtraction
- * @return a Matrix<U> with dimension defined by the input
- */
-template<typename U>
-Matrix<U> Matrix<U>::operator-(const Matrix<U> &other) {
-    // if matrices have the same orientation and dimensions
-    if (is_transposed == other.is_transposed and rows() == other.rows() and columns() == other.columns()){
-        if (!is_transposed) {  // and if the matrices are not transposed
-            Matrix<U> result(rows(), columns());
-            for (size_t i; i < rows(); ++i) {
-                for (size_t j; j < columns(); ++j) {
-                    result[i][j] = this[i][j] - other[i][j];
-                }
-            }
-            return result;
-        } else {  // and if the matrices are transposed
-            Matrix<U> result(columns(), rows());
-            for (size_t i; i < rows(); ++i) {
-                for (size_t j; j < columns(); ++j) {
-                    result[j][i] = this[i][j] - other[i][j];
-                }
-            }
-            return result;
-        }
-    }
-        // else if the matrices dont have the same orientation, but are compatible for addition in their current orientation
-    else if(rows()==other.columns() and columns() == other.rows()) {
-        if(!is_transposed){  // if this matrix is not transposed
-            Matrix<U> result(rows(), columns());
-            for (size_t i; i < rows(); ++i) {
-                for (size_t j; j < columns(); ++j) {
-                    result[i][j] = this[i][j] - other[j][i];
-                }
-            }
-            return result;
-        } else {  // this matrix is transposed
-            Matrix<U> result(columns(), rows());
-            for (size_t i; i < rows(); ++i) {
-                for (size_t j; j < columns(); ++j) {
-                    result[j][i] = this[i][j] - other[j][i];
-                }
-            }
-        }
-    }
-    else {  // else the matrices are not compatible for addition
-        throw std::invalid_argument("\nEither: (a) The matrices you attempted to subtract have different orientation\n"
-                                    "        (b) The matrices you attempted to subtract have different sizes\n"
-                                    "        (c) Both\n");
-    }
+/// Read-only version of Matrix.view().
+template<typename U>
+MatrixView<const U> Matrix<U>::view() const {
+    if (is_transposed) return MatrixView<const U>(repr.data(), num_cols, num_rows, 1, (ptrdiff_t)leading_dim);
+    return MatrixView<const U>(repr.data(), num_rows, num_cols, (ptrdiff_t)leading_dim, 1);
 }
 
+/// Matrix.row(i) returns row i of the Matrix, in its current orientation, as a row vector that points into the Matrix.
+template<typename U>
+VectorView<U> Matrix<U>::row(size_t i) { return view().row(i); }
+
+/// Read-only version of Matrix.row(i).
 template<typename U>
+VectorView<const U> Matrix<U>::row(size_t i) const { return view().row(i); }
+
 /**
- * @brief Multiply each element by a scalar number. In the case of this function, that scalar number is held in a
- * variable.
- *
- * @tparam U a scalar number type (int, float, double, etc..)
- * @param other a scalar number held in a variable
- * @return Matrix<U> where U is the same as the vector which we are operating on
- */
-Matrix<U>& Matrix<U>::operator*(const U &other){
-    for (size_t i = 0; i < rows(); ++i){
-        for (size_t j = 0; j < columns(); ++j){
-            repr[i][j] *= other;
-        }
-    }
-    return *this;
+ * Matrix.col(j) returns column j of the Matrix, in its current orientation, as a column vector that points into the
+ * Matrix. The elements of the column are ld() apart; nothing is copied.
+ */
+template<typename U>
+VectorView<U> Matrix<U>::col(size_t j) { return view().col(j); }
+
+/// Read-only version of Matrix.col(j).
+template<typename U>
+VectorView<const U> Matrix<U>::col(size_t j) const { return view().col(j); }
+
+/// Matrix.get_column(col_num) is the same as Matrix.col(col_num).
+template<typename U>
+VectorView<U> Matrix<U>::get_column(size_t col_num) { return col(col_num); }
+
+/// Read-only version of Matrix.get_column(col_num).
+template<typename U>
+VectorView<const U> Matrix<U>::get_column(size_t col_num) const { return col(col_num); }
+
+/// Matrix.submatrix() returns a view of the rows x columns block whose top-left element is (first_row, first_col).
+template<typename U>
+MatrixView<U> Matrix<U>::submatrix(size_t first_row, size_t first_col, size_t rows, size_t columns) {
+    return view().submatrix(first_row, first_col, rows, columns);
 }
 
+/// Read-only version of Matrix.submatrix().
 template<typename U>
+MatrixView<const U> Matrix<U>::submatrix(size_t first_row, size_t first_col, size_t rows, size_t columns) const {
+    return view().submatrix(first_row, first_col, rows, columns);
+}
+
+/* Non-Mathematical Operation */
+/// Indexing a Matrix returns row i as a std::span; finding the row is a single pointer offset into the buffer.
+template <typename U>
+std::span<U> Matrix<U>::operator[](const size_t& i) { return std::span<U>(repr.data() + i * leading_dim, num_cols); }
+
+/// Read-only version of Matrix[i].
+template <typename U>
+std::span<const U> Matrix<U>::operator[](const size_t& i) const {
+    return std::span<const U>(repr.data() + i * leading_dim, num_cols);
+}
+
 /**
- * Multiply each element by a scalar number. In the case of this function, that scalar number is in the form of a
- * literal.
+ * @brief Compound assignment: every element of this Matrix becomes this + expr, in one pass and without allocating.
  *
- * @tparam U a scalar number type (int, float, double, etc..)
- * @param other a scalar number held in a variable
- * @return Matrix<U> where U is the same as the vector which we are operating on
- */
-Matrix<U>& Matrix<U>::operator*(U&& other){
-    for (size_t i = 0; i < rows(); ++i){
-        for (size_t j = 0; j < columns(); ++j){
-            repr[i][j] *= other;
-        }
-    }
+ * The Matrix keeps its shape, layout and orientation; expr must have the shape of this Matrix in its current
+ * orientation (std::invalid_argument otherwise), as for +. The work is done through view() (see
+ * MatrixView::operator+=).
+ */
+template<typename U>
+template<typename E>
+Matrix<U>& Matrix<U>::operator+=(const MatrixExpression<E>& expr) {
+    view() += expr;
     return *this;
 }
 
+/// Compound assignment: every element of this Matrix becomes this - expr. See operator+=.
+template<typename U>
+template<typename E>
+Matrix<U>& Matrix<U>::operator-=(const MatrixExpression<E>& expr) {
+    view() -= expr;
+    return *this;
+}
 
-/* --------------------------------------- Non-Member Vector Operators ---------------------------------------------- */
+/// Multiplies every element of this Matrix by a scalar, in place. Unlike Matrix * scalar, this modifies the Matrix.
+template<typename U>
+Matrix<U>& Matrix<U>::operator*=(const U& scalar) {
+    view() *= scalar;
+    return *this;
+}
 
+/// Divides every element of this Matrix by a scalar, in place. Unlike Matrix / scalar, this modifies the Matrix.
+template<typename U>
+Matrix<U>& Matrix<U>::operator/=(const U& scalar) {
+    view() /= scalar;
+    return *this;
+}
 
-template <typename T>
-/**
- * @brief Multiply each element by a scalar number.
- *
- * Because we are multiplying the scalar number on the right, we cannot write a member function of the Vector class to
- * achieve this. Instead we write a non-member function that tells the (*) operator what to do when it encounters a
- * Vector to its left and a scalar to its right.
- *
- * Because scalar multiplication is commutative, the thing it should do is multiplicate the scalar on the right side of
- * the Vector. And we have defined this operation already
- *
- * @tparam T a scalar number type (int, float, double, etc..)
- * @param scalar, vec a scalar number and a Vector; respectively
- * @return Vector<T> where T is the same as the Vector which we are operating on
+/* Mathematical Operations */
+/*
+ * Addition and subtraction between two Matrix are performed elementwise, as learned in linear algebra. If the
+ * matrices are both NxM, the operation is legal. If the matrices have shape MxN and NxM, it is legal only if one of
+ * the matrices is transposed. The result has the shape of the operands in their current orientation: if both
+ * matrices are MxN and transposed, the result is NxM. Both, and multiplication and division by a scalar, are lazy
+ * expressions; see expression.h.
  */
- Vector<T>& operator*(const T& scalar, Vector<T>& vec){
-    return vec * scalar;
- }
 
-template <typename T>
-/**
- * @brief Multiply each element by a scalar number.
- *
- * Because we are multiplying the scalar number on the right, we cannot write a member function of the Vector class to
- * achieve this. Instead we write a non-member function that tells the (*) operator what to do when it encounters a
- * Vector to its left and a scalar to its right.
- *
- * Because scalar multiplication is commutative, the thing it should do is multiplicate the scalar on the right side of
- * the Vector. And we have defined this operation already
- *
- * @tparam T a scalar number type (int, float, double, etc..)
- * @param scalar, vec a scalar number and a Vector; respectively
- * @return Vector<T> where T is the same as the Vector which we are operating on
- */
-Vector<T>& operator*(T&& scalar, Vector<T>& vec){
-    return vec * scalar;
-}
+
+/* --------------------------------------- Non-Member Vector Operators ---------------------------------------------- */
+
 
 template <typename U>
 /**
@@ -704,11 +757,15 @@ template <typename U>
  * @param right_vector
  * @return a matrix with elements of type <U>
  */
-Matrix<U>& operator*(Vector<U>& left_vector, Vector<U>& right_vector){
+Matrix<U> operator*(Vector<U>& left_vector, Vector<U>& right_vector){
     if(left_vector.is_transposed && !right_vector.is_transposed && (left_vector.size() == right_vector.size())) {
-        Matrix<U> result(left_vector.size(), right_vector.size());
-        for (size_t j = 0; j < right_vector.size(); ++j) {
-            result[j] = right_vector[j] * left_vector;  // each row of the matrix is
+        const size_t m = left_vector.size(), n = right_vector.size();
+        COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::outer, (OpShape{{m, n}, 2}), m * n, (m + n + m * n) * sizeof(U));
+        Matrix<U> result(m, n);
+        COMPUTER_BRAIN_INSTRUMENT_ALLOCATION(OpKind::outer, m * result.ld() * sizeof(U));
+        // row i of the result is right_vector scaled by left_vector[i]
+        for (size_t i = 0; i < left_vector.size(); ++i) {
+            simd_scale(right_vector.data(), left_vector[i], result.data() + i * result.ld(), right_vector.size());
         }
         return result;
     } else {
@@ -723,73 +780,149 @@ Matrix<U>& operator*(Vector<U>& left_vector, Vector<U>& right_vector){
 /* --------------------------------------- Non-Member Matrix Operators ---------------------------------------------- */
 
 
+namespace detail {
+
+/// The product of two views, into a new Matrix that is not transposed.
+template<typename U>
+Matrix<U> matrix_product(const MatrixView<const U>& left, const MatrixView<const U>& right) {
+    if (left.columns() != right.rows()) {
+        throw std::invalid_argument("The Matrix product cannot be computed due to incompatible Matrix Dimensions\n");
+    }
+    Matrix<U> result(left.rows(), right.columns());
+    COMPUTER_BRAIN_INSTRUMENT_ALLOCATION(OpKind::gemm, result.rows() * result.ld() * sizeof(U));
+    gemm<U>(U(1), left, right, U(0), result.view());
+    return result;
+}
+
+}  // namespace detail
+
 template <typename U>
 /**
- * @brief Multiply each element by a scalar number.
- *
- * Because we are multiplying the scalar number on the right, we cannot write a member function of the Matrix class to
- * achieve this. Instead we write a non-member function that tells the (*) operator what to do when it encounters a
- * Matrix to its left and a scalar to its right.
+ * @brief Matrix product of two Matrix.
  *
- * Because scalar multiplication is commutative, the thing it should do is multiplicate the scalar on the right side of
- * the Matrix. And we have defined this operation already
+ * Both matrices are used in the orientation given by their is_transposed flag, so the product of an MxK and a KxN
+ * Matrix is an MxN Matrix. The result is a new Matrix that is not transposed. Each operand is handed to gemm() as a
+ * view, whose strides already encode its orientation, so none of the four orientation combinations copies its inputs.
  *
- * @tparam T a scalar number type (int, float, double, etc..)
- * @param scalar, mat a scalar number and a Matrix; respectively
- * @return Vector<T> where T is the same as the Matrix which we are operating on
+ * @tparam U should be a numerical type
+ * @param left_mat, right_mat the Matrix on the left and on the right of the (*) operator; respectively
+ * @return a Matrix<U> with as many rows as left_mat and as many columns as right_mat
  */
-Matrix<U>& operator*(const U& scalar, Matrix<U>& mat){
-    return mat * scalar;
+Matrix<U> operator*(const Matrix<U>& left_mat, const Matrix<U>& right_mat){
+    return detail::matrix_product<U>(left_mat.view(), right_mat.view());
+}
+
+/// Matrix product of two views (transposed views and submatrices included). Nothing is copied before gemm().
+template<typename U, typename W, typename = std::enable_if_t<std::is_same_v<std::remove_const_t<U>,
+                                                                             std::remove_const_t<W>>>>
+Matrix<std::remove_const_t<U>> operator*(const MatrixView<U>& left_view, const MatrixView<W>& right_view) {
+    return detail::matrix_product<std::remove_const_t<U>>(left_view, right_view);
 }
 
+/// Matrix product of a Matrix and a view.
+template<typename U, typename W, typename = std::enable_if_t<std::is_same_v<U, std::remove_const_t<W>>>>
+Matrix<U> operator*(const Matrix<U>& left_mat, const MatrixView<W>& right_view) {
+    return detail::matrix_product<U>(left_mat.view(), right_view);
+}
+
+/// Matrix product of a view and a Matrix.
+template<typename U, typename W, typename = std::enable_if_t<std::is_same_v<std::remove_const_t<U>, W>>>
+Matrix<W> operator*(const MatrixView<U>& left_view, const Matrix<W>& right_mat) {
+    return detail::matrix_product<W>(left_view, right_mat.view());
+}
+
+/* --------------------------------------- Matrix-Vector Operators ------------------------------------------------- */
+
+
 template <typename U>
 /**
- * @brief Multiply each element by a scalar number.
- *
- * Because we are multiplying the scalar number on the right, we cannot write a member function of the Matrix class to
- * achieve this. Instead we write a non-member function that tells the (*) operator what to do when it encounters a
- * Matrix to its left and a scalar to its right.
+ * @brief Matrix-Vector product A * x.
  *
- * Because scalar multiplication is commutative, the thing it should do is multiplicate the scalar on the right side of
- * the Matrix. And we have defined this operation already
+ * x must be a column vector (a Vector that is not transposed) with as many elements as A has columns, A taken in the
+ * orientation given by its is_transposed flag. The result is a new column Vector with as many elements as A has rows.
+ * The product runs on gemv(), which reads A once whatever its orientation.
  *
- * @tparam T a scalar number type (int, float, double, etc..)
- * @param scalar, vec a scalar number and a Matrix; respectively
- * @return Vector<T> where T is the same as the Matrix which we are operating on
+ * @tparam U should be a numerical type
+ * @param matrix, vector the Matrix on the left and the column Vector on the right of the (*) operator; respectively
+ * @return a Vector<U>, not transposed, with as many elements as matrix has rows
  */
-Matrix<U>& operator*(U&& scalar, Matrix<U>& mat){
-    return mat * scalar;
+Vector<U> operator*(const Matrix<U>& matrix, const Vector<U>& vector) {
+    const MatrixView<const U> a = matrix.view();  // the Matrix in its current orientation
+    if (vector.is_transposed || vector.size() != a.columns()) {
+        throw std::invalid_argument("\nEither: (a) A Matrix can only multiply a column vector (a Vector that is not "
+                                    "transposed)\n"
+                                    "          (b) The Vector needs as many elements as the Matrix has columns\n");
+    }
+    Vector<U> result((int)a.rows(), U(0));
+    COMPUTER_BRAIN_INSTRUMENT_ALLOCATION(OpKind::gemv, result.size() * sizeof(U));
+    gemv<U>(U(1), a, vector.view(), U(0), result.view());
+    return result;
 }
 
 template <typename U>
-Matrix<U>& operator*(const Matrix<U>& right_mat, const Matrix<U>& left_mat){
-    // if neither matrix is transposed
-    if (right_mat.is_transposed == left_mat.is_transposed) {
-        if (right_mat.columns() == left_mat.rows()) {
-            Matrix<U> result(right_mat.rows(), left_mat.columns());
-            for (size_t i = 0; i < right_mat.rows(); ++i) {
-                for (size_t j = 0; j < left_mat.columns(); ++j) {
-                    result[i][j] += right_mat[i][j] * left_mat[j][i];
-                }
-            }
-            return result;
-        }
-    }
-    // if onlf left matrix is transposed
-    else if(!right_mat.is_transposed == false and right_mat.is_transposed != left_mat.is_transposed){
-        if (right_mat.columns() == left_mat.columns()){
-            Matrix<U> result(right_mat.rows(), left_mat.rows());
-            for (size_t i = 0; i < right_mat.rows(); ++i) {
-                for (size_t j = 0; j < left_mat.columns(); ++j) {
-                    result[i][j] += right_mat[i][j] * left_mat[i][j];
-                }
-            }
-            return result;
-        }
-    }
-    else {
-        throw std::invalid_argument("The Matrix product cannot be computed due to incompatible Matrix Dimensions\n");
+/**
+ * @brief Vector-Matrix product x * A, that is (A^T * x)^T.
+ *
+ * x must be a row vector (a transposed Vector) with as many elements as A has rows. The result is a new row Vector
+ * with as many elements as A has columns. gemv() runs on the transposed view of A, so nothing is copied.
+ *
+ * @tparam U should be a numerical type
+ * @param vector, matrix the row Vector on the left and the Matrix on the right of the (*) operator; respectively
+ * @return a transposed Vector<U> with as many elements as matrix has columns
+ */
+Vector<U> operator*(const Vector<U>& vector, const Matrix<U>& matrix) {
+    const MatrixView<const U> a = matrix.view();
+    if (!vector.is_transposed || vector.size() != a.rows()) {
+        throw std::invalid_argument("\nEither: (a) Only a row vector (a transposed Vector) can multiply a Matrix\n"
+                                    "          (b) The Vector needs as many elements as the Matrix has rows\n");
     }
+    Vector<U> result((int)a.columns(), U(0));
+    COMPUTER_BRAIN_INSTRUMENT_ALLOCATION(OpKind::gemv, result.size() * sizeof(U));
+    result.is_transposed = true;
+    gemv<U>(U(1), a.t(), vector.view(), U(0), result.view());
+    return result;
+}
+
+/* ------------------------------------------------ BLAS-1 Routines ------------------------------------------------- */
+
+
+/*
+ * The Vector and Matrix forms of scal, axpy and axpby (view.h): one fused pass over the operands, no allocation. The
+ * operands must have the same size and orientation (Vector) or the same shape in their current orientation (Matrix).
+ */
+
+/// x = alpha * x
+template<typename T>
+void scal(const std::type_identity_t<T>& alpha, Vector<T>& x) { scal<T>(alpha, x.view()); }
+
+/// y = alpha * x + y
+template<typename T>
+void axpy(const std::type_identity_t<T>& alpha, const Vector<T>& x, Vector<T>& y) {
+    axpy<T>(alpha, x.view(), y.view());
+}
+
+/// y = alpha * x + beta * y
+template<typename T>
+void axpby(const std::type_identity_t<T>& alpha, const Vector<T>& x, const std::type_identity_t<T>& beta,
+           Vector<T>& y) {
+    axpby<T>(alpha, x.view(), beta, y.view());
+}
+
+/// X = alpha * X
+template<typename U>
+void scal(const std::type_identity_t<U>& alpha, Matrix<U>& x) { scal<U>(alpha, x.view()); }
+
+/// Y = alpha * X + Y
+template<typename U>
+void axpy(const std::type_identity_t<U>& alpha, const Matrix<U>& x, Matrix<U>& y) {
+    axpy<U>(alpha, x.view(), y.view());
+}
+
+/// Y = alpha * X + beta * Y
+template<typename U>
+void axpby(const std::type_identity_t<U>& alpha, const Matrix<U>& x, const std::type_identity_t<U>& beta,
+           Matrix<U>& y) {
+    axpby<U>(alpha, x.view(), beta, y.view());
 }
 
 /* -------------------------------PRINT INSTRUCTIONS FOR VECTOR AND MATRIX------------------------------------------- */
@@ -810,7 +943,7 @@ std::ostream& operator<<(std::ostream& os, Vector<T>& other){
 }
 
 template<typename U>
-std::ostream& operator<<(std::ostream& os, Matrix<U>& other) {
+std::ostream& operator<<(std::ostream& os, const Matrix<U>& other) {
     /* how to print a 2D matrix. It's a little ugly looking, but I wanted the matrices to print as a perfect square
      * where the first row of the matrix is preceded by a '[' and the last row concluded by an additional ']'.
      * This meant all other rows would have to be padded with a space. Hence, all the logic.*/
@@ -819,14 +952,15 @@ std::ostream& operator<<(std::ostream& os, Matrix<U>& other) {
         if (i != 0){
             os << "[ ";
         }
+        const std::span<const U> row = other[i];  // row i is a view into the contiguous buffer, not a copy
         for (size_t j = 0; j < other.columns(); ++j) {
             if (j != other.columns() - 1) {
-                os << other[i][j] << " ";
+                os << row[j] << " ";
             } else {
                 if (i == other.rows() - 1) {
-                    os << other[i][j] << "]]\n";
+                    os << row[j] << "]]\n";
                 } else {
-                    os << other[i][j] << " ]\n";
+                    os << row[j] << " ]\n";
                 }
             }
         }
@@ -0,0 +1,541 @@
+#ifndef COMPUTER_BRAIN_QUANTIZE_H
+#define COMPUTER_BRAIN_QUANTIZE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "aligned.h"
+#include "gemm.h"
+#include "instrument.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "view.h"
+
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+#include <immintrin.h>
+#define COMPUTER_BRAIN_TARGET_AVX512_VNNI __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx512vnni")))
+#endif
+
+/*
+ * 8-bit quantization and the int8 GEMM.
+ *
+ * A QuantizedMatrix stores a float Matrix as 8-bit integers q with a scale s and a zero point z per tensor, per row or
+ * per column, so that each element is approximately s * (q - z). It takes a quarter of the memory of a float Matrix.
+ *
+ *   quantize<Q>()     float (or double) Matrix -> QuantizedMatrix<Q>, with Q = int8_t or uint8_t
+ *   dequantize()      QuantizedMatrix -> Matrix<float>
+ *   gemm_int8()       C (int32) = A (int8 or uint8) * B (int8), exactly
+ *   operator*         QuantizedMatrix * QuantizedMatrix<int8_t> -> Matrix<float>, through gemm_int8()
+ *
+ * int8_t is quantized symmetrically by default (z = 0, q in [-127, 127]), which suits weights; uint8_t asymmetrically
+ * (q in [0, 255], z chosen so that 0.0 is exact), which suits activations such as the output of a ReLU.
+ *
+ * gemm_int8() packs B into panels in the layout of its micro-kernel and runs, by the active instruction set (simd.h):
+ *
+ *   AVX-512 VNNI   VPDPBUSD: 64 unsigned x signed byte products summed four at a time into 16 int32 lanes per
+ *                  instruction. A signed A is shifted to unsigned (a + 128) and 128 * (column sums of B) subtracted.
+ *   AVX2           bytes widened to int16 and VPMADDWD: 16 products summed in pairs into 8 int32 lanes. (PMADDUBSW is
+ *                  not used: it saturates its int16 pair sums, which makes results inexact for large operands.)
+ *   otherwise      a plain int32 loop.
+ *
+ * Sums are added modulo 2^32 on every path (an int32 lane wraps; the scalar loops add as uint32_t), so every path gives
+ * the exact product whenever it fits in int32, even if a partial sum, or a sum of the shifted A of VNNI, does not. The
+ * product always fits for k up to 65536.
+ */
+
+/// Which elements share a scale and a zero point.
+enum class QuantAxis { per_tensor, per_row, per_column };
+
+
+/* ----------------------------------------------- Quantized Matrix ------------------------------------------------- */
+
+
+/**
+ * @brief A row-major Matrix of 8-bit integers, with the scales and zero points that map them back to real numbers.
+ *
+ * values holds rows * columns elements with no padding; element (i, j) stands for scale(i, j) * (q - zero_point(i, j)).
+ * scales and zero_points have 1 entry (per_tensor), one per row (per_row) or one per column (per_column).
+ */
+template<typename Q>
+struct QuantizedMatrix {
+    static_assert(std::is_same_v<Q, std::int8_t> || std::is_same_v<Q, std::uint8_t>,
+                  "QuantizedMatrix holds int8_t or uint8_t");
+
+    size_t rows = 0;
+    size_t columns = 0;
+    QuantAxis axis = QuantAxis::per_tensor;
+    std::vector<Q, detail::AlignedAllocator<Q>> values;
+    std::vector<float> scales;
+    std::vector<std::int32_t> zero_points;
+
+    /// Index into scales and zero_points of element (i, j).
+    size_t group(size_t i, size_t j) const {
+        return axis == QuantAxis::per_row ? i : axis == QuantAxis::per_column ? j : 0;
+    }
+    float scale(size_t i, size_t j) const { return scales[group(i, j)]; }
+    std::int32_t zero_point(size_t i, size_t j) const { return zero_points[group(i, j)]; }
+    const Q* data() const { return values.data(); }
+    size_t memory_bytes() const {
+        return values.size() * sizeof(Q) + scales.size() * sizeof(float) + zero_points.size() * sizeof(std::int32_t);
+    }
+};
+
+
+namespace detail {
+
+/// Scale and zero point that map [lo, hi] onto the range of Q; see quantize().
+template<typename Q>
+void quantization_parameters(float lo, float hi, bool symmetric, float& scale, std::int32_t& zero_point) {
+    constexpr float q_min = std::is_signed_v<Q> ? -127.0f : 0.0f;  // -128 is left out so that the range is symmetric
+    constexpr float q_max = std::is_signed_v<Q> ? 127.0f : 255.0f;
+    if (symmetric) {
+        const float magnitude = std::max(std::fabs(lo), std::fabs(hi));
+        scale = magnitude > 0 ? magnitude / 127.0f : 1.0f;
+        zero_point = std::is_signed_v<Q> ? 0 : 128;
+    } else {
+        lo = std::min(lo, 0.0f);  // 0.0 must be representable exactly, for padding and ReLU outputs
+        hi = std::max(hi, 0.0f);
+        scale = hi > lo ? (hi - lo) / (q_max - q_min) : 1.0f;
+        zero_point = (std::int32_t)std::clamp(std::nearbyint(q_min - lo / scale), q_min, q_max);
+    }
+}
+
+template<typename Q>
+Q quantize_value(float x, float inverse_scale, std::int32_t zero_point) {
+    constexpr float q_min = std::is_signed_v<Q> ? -127.0f : 0.0f;
+    constexpr float q_max = std::is_signed_v<Q> ? 127.0f : 255.0f;
+    return (Q)std::clamp(std::nearbyint(x * inverse_scale) + (float)zero_point, q_min, q_max);
+}
+
+}  // namespace detail
+
+
+/**
+ * @brief Quantizes a view of float or double to 8-bit integers.
+ *
+ * The scale of each group (the whole Matrix, a row or a column) is set by the smallest and largest element of the
+ * group. Symmetric quantization maps [-max|x|, max|x|] onto [-127, 127] (int8_t, zero point 0) or onto [1, 255]
+ * around 128 (uint8_t). Asymmetric quantization maps [min(x, 0), max(x, 0)] onto the whole range of Q. Elements are
+ * rounded to nearest; the error of each is at most half its group's scale.
+ */
+template<typename Q, typename W>
+QuantizedMatrix<Q> quantize(const MatrixView<W>& matrix, QuantAxis axis = QuantAxis::per_row,
+                            bool symmetric = std::is_signed_v<Q>) {
+    static_assert(std::is_floating_point_v<std::remove_const_t<W>>, "Only float and double matrices are quantized");
+    const size_t rows = matrix.rows();
+    const size_t columns = matrix.columns();
+    QuantizedMatrix<Q> result;
+    result.rows = rows;
+    result.columns = columns;
+    result.axis = axis;
+    result.values.resize(rows * columns);
+    const size_t groups = axis == QuantAxis::per_row ? rows : axis == QuantAxis::per_column ? columns : 1;
+    std::vector<float> lo(groups, std::numeric_limits<float>::infinity());
+    std::vector<float> hi(groups, -std::numeric_limits<float>::infinity());
+
+    const size_t grain = std::max<size_t>(1, (size_t(1) << 16) / std::max<size_t>(columns, 1));
+    if (axis == QuantAxis::per_row) {
+        parallel_for(0, rows, grain, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                for (size_t j = 0; j < columns; ++j) {
+                    lo[i] = std::min(lo[i], (float)matrix(i, j));
+                    hi[i] = std::max(hi[i], (float)matrix(i, j));
+                }
+            }
+        });
+    } else {  // per-column and per-tensor ranges are gathered serially: they are shared by every row
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t j = 0; j < columns; ++j) {
+                const size_t g = axis == QuantAxis::per_column ? j : 0;
+                lo[g] = std::min(lo[g], (float)matrix(i, j));
+                hi[g] = std::max(hi[g], (float)matrix(i, j));
+            }
+        }
+    }
+
+    result.scales.resize(groups);
+    result.zero_points.resize(groups);
+    std::vector<float> inverse(groups);
+    for (size_t g = 0; g < groups; ++g) {
+        if (lo[g] > hi[g]) lo[g] = hi[g] = 0.0f;  // empty group
+        detail::quantization_parameters<Q>(lo[g], hi[g], symmetric, result.scales[g], result.zero_points[g]);
+        inverse[g] = 1.0f / result.scales[g];
+    }
+    parallel_for(0, rows, grain, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            Q* out = result.values.data() + i * columns;
+            for (size_t j = 0; j < columns; ++j) {
+                const size_t g = result.group(i, j);
+                out[j] = detail::quantize_value<Q>((float)matrix(i, j), inverse[g], result.zero_points[g]);
+            }
+        }
+    });
+    return result;
+}
+
+/// Quantizes a Matrix of float or double, in its current orientation.
+template<typename Q, typename U>
+QuantizedMatrix<Q> quantize(const Matrix<U>& matrix, QuantAxis axis = QuantAxis::per_row,
+                            bool symmetric = std::is_signed_v<Q>) {
+    return quantize<Q>(matrix.view(), axis, symmetric);
+}
+
+/// Returns the Matrix a QuantizedMatrix stands for: scale * (q - zero_point) for every element, in float by default.
+template<typename U = float, typename Q>
+Matrix<U> dequantize(const QuantizedMatrix<Q>& quantized) {
+    Matrix<U> result(quantized.rows, quantized.columns);
+    const size_t columns = quantized.columns;
+    parallel_for(0, quantized.rows, std::max<size_t>(1, (size_t(1) << 16) / std::max<size_t>(columns, 1)),
+                 [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const Q* q = quantized.data() + i * columns;
+            U* out = result.data() + i * result.ld();
+            for (size_t j = 0; j < columns; ++j) {
+                out[j] = (U)quantized.scale(i, j) * (U)((std::int32_t)q[j] - quantized.zero_point(i, j));
+            }
+        }
+    });
+    return result;
+}
+
+
+/* -------------------------------------------------- Int8 Kernels -------------------------------------------------- */
+
+
+namespace detail {
+
+/*
+ * Both SIMD kernels compute an MR x NR block of C from packed panels. A k-group is the KU consecutive values of k that
+ * one instruction sums into an int32 lane (4 bytes for VPDPBUSD, 2 int16 for VPMADDWD). Panels are laid out by
+ * k-group:
+ *
+ *   A panel   [k-group][MR] int32 words, each holding the KU values A[i, k..k+KU) of one row
+ *   B panel   [k-group][NR][KU] values, so that one k-group of NR columns is one (or two) vector registers
+ *
+ * Rows past m, columns past n and k past the end are packed as zeros.
+ */
+
+/// int8 kernel traits: register tile, k-group size and packed element types.
+struct Int8KernelVnni {
+    static constexpr size_t mr = 8, nr = 32, ku = 4;
+    using a_type = std::uint8_t;  // VPDPBUSD multiplies unsigned bytes of A by signed bytes of B
+    using b_type = std::int8_t;
+};
+struct Int8KernelAvx2 {
+    static constexpr size_t mr = 6, nr = 16, ku = 2;
+    using a_type = std::int16_t;
+    using b_type = std::int16_t;
+};
+
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/// C[8 x 32] (+)= A panel * B panel over kg k-groups, with AVX-512 VNNI.
+COMPUTER_BRAIN_TARGET_AVX512_VNNI inline void int8_micro_kernel_vnni(size_t kg, const std::int32_t* a,
+        const std::int8_t* b, std::int32_t* c, ptrdiff_t ldc, bool accumulate) {
+    __m512i acc[8][2];
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) acc[i][0] = acc[i][1] = _mm512_setzero_si512();
+    for (size_t g = 0; g < kg; ++g) {
+        const __m512i b0 = _mm512_loadu_si512(b);
+        const __m512i b1 = _mm512_loadu_si512(b + 64);
+#pragma GCC unroll 8
+        for (int i = 0; i < 8; ++i) {
+            const __m512i a_i = _mm512_set1_epi32(a[i]);
+            acc[i][0] = _mm512_dpbusd_epi32(acc[i][0], a_i, b0);
+            acc[i][1] = _mm512_dpbusd_epi32(acc[i][1], a_i, b1);
+        }
+        a += 8;
+        b += 128;
+    }
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+#pragma GCC unroll 2
+        for (int v = 0; v < 2; ++v) {
+            std::int32_t* out = c + i * ldc + 16 * v;
+            __m512i result = acc[i][v];
+            if (accumulate) result = _mm512_add_epi32(result, _mm512_loadu_si512(out));
+            _mm512_storeu_si512(out, result);
+        }
+    }
+}
+
+/// C[6 x 16] (+)= A panel * B panel over kg k-groups, with AVX2.
+COMPUTER_BRAIN_TARGET_AVX2 inline void int8_micro_kernel_avx2(size_t kg, const std::int32_t* a,
+        const std::int16_t* b, std::int32_t* c, ptrdiff_t ldc, bool accumulate) {
+    __m256i acc[6][2];
+#pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i) acc[i][0] = acc[i][1] = _mm256_setzero_si256();
+    for (size_t g = 0; g < kg; ++g) {
+        const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        const __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 16));
+#pragma GCC unroll 6
+        for (int i = 0; i < 6; ++i) {
+            const __m256i a_i = _mm256_set1_epi32(a[i]);
+            acc[i][0] = _mm256_add_epi32(acc[i][0], _mm256_madd_epi16(a_i, b0));
+            acc[i][1] = _mm256_add_epi32(acc[i][1], _mm256_madd_epi16(a_i, b1));
+        }
+        a += 6;
+        b += 32;
+    }
+#pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i) {
+#pragma GCC unroll 2
+        for (int v = 0; v < 2; ++v) {
+            auto* out = reinterpret_cast<__m256i*>(c + i * ldc + 8 * v);
+            __m256i result = acc[i][v];
+            if (accumulate) result = _mm256_add_epi32(result, _mm256_loadu_si256(out));
+            _mm256_storeu_si256(out, result);
+        }
+    }
+}
+
+#pragma GCC diagnostic pop
+#endif
+
+/// Packs rows [0, mc) and k in [0, kc) of A into MR-row panels of int32 words. A signed A is shifted by 128 for VNNI.
+template<typename Kernel, typename QA>
+void int8_pack_a(size_t mc, size_t kc, const QA* a, ptrdiff_t lda, std::int32_t* packed) {
+    using P = typename Kernel::a_type;
+    constexpr size_t mr = Kernel::mr, ku = Kernel::ku;
+    const size_t groups = (kc + ku - 1) / ku;
+    for (size_t ir = 0; ir < mc; ir += mr) {
+        for (size_t g = 0; g < groups; ++g) {
+            for (size_t i = 0; i < mr; ++i) {
+                P word[ku] = {};
+                if (ir + i < mc) {
+                    const QA* row = a + (ir + i) * lda;
+                    for (size_t t = 0; t < ku && g * ku + t < kc; ++t) {
+                        const QA value = row[g * ku + t];
+                        if constexpr (std::is_same_v<P, std::uint8_t> && std::is_signed_v<QA>) {
+                            word[t] = (P)((std::int32_t)value + 128);
+                        } else {
+                            word[t] = (P)value;
+                        }
+                    }
+                }
+                std::memcpy(packed + g * mr + i, word, sizeof(std::int32_t));
+            }
+        }
+        packed += groups * mr;
+    }
+}
+
+/// Packs k in [0, kc) and columns [0, nc) of B into NR-column panels.
+template<typename Kernel>
+void int8_pack_b(size_t kc, size_t nc, const std::int8_t* b, ptrdiff_t ldb, typename Kernel::b_type* packed) {
+    constexpr size_t nr = Kernel::nr, ku = Kernel::ku;
+    const size_t groups = (kc + ku - 1) / ku;
+    for (size_t jr = 0; jr < nc; jr += nr) {
+        for (size_t g = 0; g < groups; ++g) {
+            for (size_t j = 0; j < nr; ++j) {
+                for (size_t t = 0; t < ku; ++t) {
+                    const size_t p = g * ku + t;
+                    packed[(g * nr + j) * ku + t] = jr + j < nc && p < kc ? b[p * ldb + jr + j] : 0;
+                }
+            }
+        }
+        packed += groups * nr * ku;
+    }
+}
+
+/**
+ * The blocked int8 GEMM: for every KC x NC block of B (packed once and shared), the MC-row blocks of A are packed and
+ * multiplied on the thread pool. Edge tiles go through a small buffer.
+ */
+template<typename Kernel, typename QA, typename MicroKernel>
+void gemm_int8_blocked(MicroKernel micro_kernel, size_t m, size_t n, size_t k, const QA* a, ptrdiff_t lda,
+                       const std::int8_t* b, ptrdiff_t ldb, std::int32_t* c, ptrdiff_t ldc) {
+    using PB = typename Kernel::b_type;
+    constexpr size_t mr = Kernel::mr, nr = Kernel::nr, ku = Kernel::ku;
+    constexpr size_t mc = 16 * mr, kc = 512, nc = 2048;
+    GemmScratch<PB> packed_b(((std::min(nc, n) + nr - 1) / nr * nr) * ((std::min(kc, k) + ku - 1) / ku * ku));
+
+    for (size_t jc = 0; jc < n; jc += nc) {
+        const size_t cols = std::min(nc, n - jc);
+        for (size_t pc = 0; pc < k; pc += kc) {
+            const size_t depth = std::min(kc, k - pc);
+            const size_t groups = (depth + ku - 1) / ku;
+            int8_pack_b<Kernel>(depth, cols, b + pc * ldb + jc, ldb, packed_b.data());
+            const size_t blocks = (m + mc - 1) / mc;
+            const size_t grain = std::max<size_t>(1, gemm_parallel_threshold / (mc * cols * depth));
+            parallel_for(0, blocks, grain, [&](size_t first, size_t last) {
+                GemmScratch<std::int32_t> packed_a(mc * groups);
+                alignas(64) std::int32_t edge[mr * nr];
+                for (size_t block = first; block < last; ++block) {
+                    const size_t ic = block * mc;
+                    const size_t rows = std::min(mc, m - ic);
+                    int8_pack_a<Kernel>(rows, depth, a + ic * lda + pc, lda, packed_a.data());
+                    for (size_t jr = 0; jr < cols; jr += nr) {
+                        const PB* b_panel = packed_b.data() + jr * groups * ku;
+                        for (size_t ir = 0; ir < rows; ir += mr) {
+                            const std::int32_t* a_panel = packed_a.data() + ir * groups;
+                            std::int32_t* c_tile = c + (ic + ir) * ldc + jc + jr;
+                            const size_t tile_rows = std::min(mr, rows - ir);
+                            const size_t tile_cols = std::min(nr, cols - jr);
+                            if (tile_rows == mr && tile_cols == nr) {
+                                micro_kernel(groups, a_panel, b_panel, c_tile, ldc, pc != 0);
+                                continue;
+                            }
+                            micro_kernel(groups, a_panel, b_panel, edge, (ptrdiff_t)nr, false);
+                            for (size_t i = 0; i < tile_rows; ++i) {  // added modulo 2^32, as the kernels' lanes do
+                                for (size_t j = 0; j < tile_cols; ++j) {
+                                    const std::uint32_t sum = (pc != 0 ? (std::uint32_t)c_tile[i * ldc + j] : 0u) +
+                                                              (std::uint32_t)edge[i * nr + j];
+                                    c_tile[i * ldc + j] = (std::int32_t)sum;
+                                }
+                            }
+                        }
+                    }
+                }
+            });
+        }
+    }
+}
+
+/// The int32 loop for CPUs without AVX2, split by rows over the thread pool.
+template<typename QA>
+void gemm_int8_reference(size_t m, size_t n, size_t k, const QA* a, ptrdiff_t lda, const std::int8_t* b,
+                         ptrdiff_t ldb, std::int32_t* c, ptrdiff_t ldc) {
+    parallel_for(0, m, std::max<size_t>(1, gemm_parallel_threshold / std::max<size_t>(n * k, 1)),
+                 [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            std::int32_t* c_row = c + i * ldc;
+            std::fill(c_row, c_row + n, 0);
+            for (size_t p = 0; p < k; ++p) {
+                const std::int32_t a_ip = a[i * lda + p];
+                const std::int8_t* b_row = b + p * ldb;
+                for (size_t j = 0; j < n; ++j) {
+                    c_row[j] = (std::int32_t)((std::uint32_t)c_row[j] + (std::uint32_t)(a_ip * b_row[j]));
+                }
+            }
+        }
+    });
+}
+
+inline bool cpu_has_avx512_vnni() {
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+    static const bool vnni = (__builtin_cpu_init(), __builtin_cpu_supports("avx512vnni"));
+    return vnni;
+#else
+    return false;
+#endif
+}
+
+}  // namespace detail
+
+
+/* ------------------------------------------------- Int8 GEMM ------------------------------------------------------ */
+
+
+/**
+ * @brief C = A * B in exact integer arithmetic: A is m x k of int8_t or uint8_t, B is k x n of int8_t, C is m x n of
+ * int32_t. Each operand is row-major with the given leading dimension; C is overwritten.
+ */
+template<typename QA>
+void gemm_int8(size_t m, size_t n, size_t k, const QA* a, ptrdiff_t lda, const std::int8_t* b, ptrdiff_t ldb,
+               std::int32_t* c, ptrdiff_t ldc) {
+    static_assert(std::is_same_v<QA, std::int8_t> || std::is_same_v<QA, std::uint8_t>,
+                  "gemm_int8 multiplies int8_t or uint8_t by int8_t");
+    if (m == 0 || n == 0) {
+        return;
+    }
+    COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::gemm, (OpShape{{m, n, k}, 3}), 2 * m * n * k,
+                                 m * k + k * n + m * n * sizeof(std::int32_t));
+    if (k == 0) {
+        for (size_t i = 0; i < m; ++i) std::fill(c + i * ldc, c + i * ldc + n, 0);
+        return;
+    }
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+    if (active_simd_isa() == SimdIsa::avx512 && detail::cpu_has_avx512_vnni()) {
+        detail::gemm_int8_blocked<detail::Int8KernelVnni>(&detail::int8_micro_kernel_vnni, m, n, k, a, lda, b, ldb,
+                                                          c, ldc);
+        if constexpr (std::is_signed_v<QA>) {  // A was packed as a + 128: take 128 * sum_p B[p, j] back off
+            std::vector<std::int32_t> column_sums(n, 0);
+            for (size_t p = 0; p < k; ++p) {
+                for (size_t j = 0; j < n; ++j) column_sums[j] += b[p * ldb + j];
+            }
+            for (size_t i = 0; i < m; ++i) {  // the shifted sums may have wrapped: subtract modulo 2^32 too
+                for (size_t j = 0; j < n; ++j) {
+                    const std::uint32_t shift = 128u * (std::uint32_t)column_sums[j];
+                    c[i * ldc + j] = (std::int32_t)((std::uint32_t)c[i * ldc + j] - shift);
+                }
+            }
+        }
+        return;
+    }
+    if (active_simd_isa() >= SimdIsa::avx2) {
+        detail::gemm_int8_blocked<detail::Int8KernelAvx2>(&detail::int8_micro_kernel_avx2, m, n, k, a, lda, b, ldb,
+                                                          c, ldc);
+        return;
+    }
+#endif
+    detail::gemm_int8_reference(m, n, k, a, lda, b, ldb, c, ldc);
+}
+
+/**
+ * @brief The float product of two quantized matrices.
+ *
+ * The integer product runs through gemm_int8(), then the zero points are corrected for with the row sums of A and the
+ * column sums of B, and every element is scaled:
+ *
+ *     C[i, j] = sa * sb * (sum_p qa qb - za * sum_p qb - zb * sum_p qa + k * za * zb)
+ *
+ * This factorisation needs one scale per row of A (or per tensor) and one per column of B (or per tensor).
+ */
+template<typename QA, typename U = float>
+Matrix<U> operator*(const QuantizedMatrix<QA>& a, const QuantizedMatrix<std::int8_t>& b) {
+    if (a.columns != b.rows) {
+        throw std::invalid_argument("The Matrix product cannot be computed due to incompatible Matrix Dimensions\n");
+    }
+    if (a.axis == QuantAxis::per_column || b.axis == QuantAxis::per_row) {
+        throw std::invalid_argument("\nA quantized product needs per-row or per-tensor scales on the left operand and "
+                                    "per-column or per-tensor scales on the right operand\n");
+    }
+    const size_t m = a.rows, n = b.columns, k = a.columns;
+    std::vector<std::int32_t> product(m * n);
+    gemm_int8(m, n, k, a.data(), (ptrdiff_t)k, b.data(), (ptrdiff_t)n, product.data(), (ptrdiff_t)n);
+
+    std::vector<std::int32_t> row_sums(m, 0), column_sums(n, 0);
+    const bool a_offset = std::any_of(a.zero_points.begin(), a.zero_points.end(), [](std::int32_t z) { return z; });
+    const bool b_offset = std::any_of(b.zero_points.begin(), b.zero_points.end(), [](std::int32_t z) { return z; });
+    if (b_offset) {
+        for (size_t i = 0; i < m; ++i) {
+            for (size_t p = 0; p < k; ++p) row_sums[i] += a.values[i * k + p];
+        }
+    }
+    if (a_offset) {
+        for (size_t p = 0; p < k; ++p) {
+            for (size_t j = 0; j < n; ++j) column_sums[j] += b.values[p * n + j];
+        }
+    }
+
+    Matrix<U> result(m, n);
+    parallel_for(0, m, std::max<size_t>(1, (size_t(1) << 16) / std::max<size_t>(n, 1)), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const std::int64_t za = a.zero_point(i, 0);
+            const float sa = a.scale(i, 0);
+            U* out = result.data() + i * result.ld();
+            for (size_t j = 0; j < n; ++j) {
+                const std::int64_t zb = b.zero_point(0, j);
+                const std::int64_t sum = (std::int64_t)product[i * n + j] - za * column_sums[j] - zb * row_sums[i] +
+                                         (std::int64_t)k * za * zb;
+                out[j] = sa * b.scale(0, j) * (float)sum;
+            }
+        }
+    });
+    return result;
+}
+
+
+#endif //COMPUTER_BRAIN_QUANTIZE_H
@@ -0,0 +1,444 @@
+#ifndef COMPUTER_BRAIN_REDUCE_H
+#define COMPUTER_BRAIN_REDUCE_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "expression.h"
+#include "gemm.h"
+#include "instrument.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "view.h"
+
+/*
+ * Reductions over Vectors: sum, dot, norm, minimum, maximum, argmin and argmax.
+ *
+ * A reduction splits its Vector into blocks of reduction_block elements, at fixed offsets that do not depend on the
+ * number of threads. Blocks are reduced independently (in parallel when there are enough of them), and the results of
+ * the blocks are combined on the calling thread in a fixed order. Within a block, the SIMD kernels keep
+ * reduction_lane_bytes bytes of partial sums whatever the instruction set (four AVX-512 registers, eight AVX2
+ * registers, sixteen SSE2 registers, or that many scalars): element i of a block always goes to partial sum
+ * i mod (reduction_lane_bytes / sizeof(T)), and the partial sums are added up in the same tree every time. The result
+ * of a reduction is therefore the same bit for bit with any number of threads. It is also the same with any
+ * instruction set, except for the pairwise dot() and norm() when the compiler contracts a * b + c into a fused
+ * multiply-add in the AVX2 and AVX-512 kernels (GCC does by default; -ffp-contract=off prevents it).
+ *
+ * Sums are computed one of two ways (Summation):
+ *
+ *   pairwise       each partial sum of a block adds reduction_block * sizeof(T) / reduction_lane_bytes elements, and
+ *                  the partial sums and the block sums are then added pairwise. The error grows with that count plus
+ *                  log2(n), not with n as in a single running sum. As fast as an uncompensated loop.
+ *   compensated    every addition keeps its rounding error in a second accumulator (Neumaier's variant of Kahan
+ *                  summation), so the error does not grow with n at all. Four more operations per element, which
+ *                  still leaves a long sum bound by memory bandwidth. Used for floating-point types only.
+ *
+ * argmin and argmax return the first index of the smallest (largest) element. NaN elements are never selected unless
+ * every element is NaN, in which case the index is 0.
+ */
+
+/// Elements per block of a reduction; blocks are the unit of parallel work and fix the order of the additions.
+inline constexpr size_t reduction_block = size_t(1) << 13;
+
+/// Bytes of partial sums kept by the reduction kernels, the same for every instruction set (see above).
+inline constexpr int reduction_lane_bytes = 256;
+
+/// How sum(), dot() and norm() add their terms.
+enum class Summation { pairwise, compensated };
+
+
+/* ------------------------------------------------ Reduction Kernels ----------------------------------------------- */
+
+
+namespace detail {
+
+/// sum += x, with the rounding error of the addition added to compensation (Neumaier). V is a scalar or a vector.
+template<typename V>
+__attribute__((always_inline)) inline void neumaier_add(V& sum, V& compensation, const V& x) {
+    const V total = sum + x;
+    const V sum_magnitude = sum < 0 ? -sum : sum;
+    const V x_magnitude = x < 0 ? -x : x;
+    compensation += sum_magnitude >= x_magnitude ? (sum - total) + x : (x - total) + sum;
+    sum = total;
+}
+
+/// Adds up values[0], values[stride], ..., values[(count - 1) * stride] pairwise, in place. count must not be zero.
+template<typename T>
+T pairwise_sum(T* values, size_t count, size_t stride = 1) {
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t k = 0; k + width < count; k += 2 * width) values[k * stride] += values[(k + width) * stride];
+    }
+    return values[0];
+}
+
+/**
+ * The sum of a[i] (or of a[i] * b[i] when Product) for i in [0, n), written to out[0], with the accumulated rounding
+ * error in out[1] when Compensated (and zero otherwise). The accumulators are laid out as described at the top of this
+ * file, so the result does not depend on Bytes.
+ */
+template<typename T, bool Product, bool Compensated>
+struct ReduceSumKernel {
+    template<int Bytes> __attribute__((always_inline)) static inline void run(const T* a, const T* b, size_t n,
+                                                                              T* out) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        constexpr size_t R = reduction_lane_bytes / Bytes;
+        constexpr size_t K = R * W;
+        vec sum[R] = {};
+        vec compensation[R] = {};
+        size_t i = 0;
+        for (; i + K <= n; i += K) {
+#pragma GCC unroll 16
+            for (size_t r = 0; r < R; ++r) {
+                vec x;
+                std::memcpy(&x, a + i + r * W, sizeof(vec));
+                if constexpr (Product) {
+                    vec y;
+                    std::memcpy(&y, b + i + r * W, sizeof(vec));
+                    x *= y;
+                }
+                if constexpr (Compensated) {
+                    neumaier_add(sum[r], compensation[r], x);
+                } else {
+                    sum[r] += x;
+                }
+            }
+        }
+        T lane_sum[K];
+        T lane_compensation[K];
+        std::memcpy(lane_sum, sum, sizeof(lane_sum));
+        std::memcpy(lane_compensation, compensation, sizeof(lane_compensation));
+        for (size_t k = 0; i < n; ++i, ++k) {
+            const T x = Product ? T(a[i] * b[i]) : a[i];
+            if constexpr (Compensated) {
+                neumaier_add(lane_sum[k], lane_compensation[k], x);
+            } else {
+                lane_sum[k] += x;
+            }
+        }
+        if constexpr (Compensated) {
+            T total = T(0);
+            T error = T(0);
+            for (size_t k = 0; k < K; ++k) {
+                neumaier_add(total, error, lane_sum[k]);
+                error += lane_compensation[k];
+            }
+            out[0] = total;
+            out[1] = error;
+        } else {
+            out[0] = pairwise_sum(lane_sum, K);
+            out[1] = T(0);
+        }
+    }
+};
+
+/// The smallest (Max false) or largest (Max true) of a[0 .. n), NaNs aside; the sentinel if there is none.
+template<typename T, bool Max>
+struct ReduceExtremumKernel {
+    static constexpr T sentinel() {
+        if constexpr (std::numeric_limits<T>::has_infinity) {
+            return Max ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::infinity();
+        } else {
+            return Max ? std::numeric_limits<T>::lowest() : std::numeric_limits<T>::max();
+        }
+    }
+
+    template<int Bytes> __attribute__((always_inline)) static inline T run(const T* a, size_t n) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        vec best[4];
+#pragma GCC unroll 4
+        for (int u = 0; u < 4; ++u) best[u] = vec{} + sentinel();
+        size_t i = 0;
+        for (; i + 4 * W <= n; i += 4 * W) {
+#pragma GCC unroll 4
+            for (int u = 0; u < 4; ++u) {
+                vec x;
+                std::memcpy(&x, a + i + u * W, sizeof(vec));
+                best[u] = (Max ? x > best[u] : x < best[u]) ? x : best[u];
+            }
+        }
+        T result = sentinel();
+        for (int u = 0; u < 4; ++u) {
+            for (size_t lane = 0; lane < W; ++lane) {
+                if (Max ? best[u][lane] > result : best[u][lane] < result) result = best[u][lane];
+            }
+        }
+        for (; i < n; ++i) {
+            if (Max ? a[i] > result : a[i] < result) result = a[i];
+        }
+        return result;
+    }
+};
+
+/// The type reductions over T are computed in: float for float16 and bfloat16, T itself otherwise.
+template<typename T>
+using reduction_type = std::conditional_t<is_half_type<T>, float, T>;
+
+/// Whether reduction_operand() has to copy the elements of x rather than hand out its own memory.
+template<typename T>
+bool reduction_copies(const VectorView<const T>& x) { return is_half_type<T> || x.stride() != 1; }
+
+/// The elements [first, first + count) of a view, as a contiguous array of reduction_type<T>: the view's own memory, or
+/// a (converted) copy in `buffer`.
+template<typename T, typename A = reduction_type<T>>
+const A* reduction_operand(const VectorView<const T>& x, size_t first, size_t count, A* buffer) {
+    if constexpr (is_half_type<T>) {
+        if (x.stride() == 1) {
+            convert_elements(x.data() + first, buffer, count);
+            return buffer;
+        }
+    } else if (x.stride() == 1) {
+        return x.data() + first;
+    }
+    for (size_t i = 0; i < count; ++i) buffer[i] = A(x.data()[(ptrdiff_t)(first + i) * x.stride()]);
+    return buffer;
+}
+
+/// Sum (and compensation) of one block; see ReduceSumKernel. Types without SIMD kernels use a plain running sum.
+template<typename T, bool Product, bool Compensated>
+void reduce_sum_block(const T* a, const T* b, size_t n, T* out) {
+    if constexpr (is_simd_type<T>) {
+        simd_dispatch<T, ReduceSumKernel<T, Product, Compensated>>(a, b, n, out);
+    } else {
+        T sum = T(0);
+        T compensation = T(0);
+        for (size_t i = 0; i < n; ++i) {
+            const T x = Product ? T(a[i] * b[i]) : a[i];
+            if constexpr (Compensated) {
+                neumaier_add(sum, compensation, x);
+            } else {
+                sum += x;
+            }
+        }
+        out[0] = sum;
+        out[1] = compensation;
+    }
+}
+
+/// The smallest (Max false) or largest (Max true) element of one block, NaNs aside.
+template<typename T, bool Max>
+T reduce_extremum_block(const T* a, size_t n) {
+    if constexpr (is_simd_type<T>) {
+        return simd_dispatch<T, ReduceExtremumKernel<T, Max>>(a, n);
+    } else {
+        T result = ReduceExtremumKernel<T, Max>::sentinel();
+        for (size_t i = 0; i < n; ++i) {
+            if (Max ? a[i] > result : a[i] < result) result = a[i];
+        }
+        return result;
+    }
+}
+
+/**
+ * The sum of the elements of a (or of the products of the elements of a and b, when Product), block by block as
+ * described at the top of this file. Compensated sums return the accumulated rounding error in `compensation`.
+ */
+template<typename T, bool Product, bool Compensated, typename A = reduction_type<T>>
+A reduce_sum(const VectorView<const T>& a, const VectorView<const T>& b, A& compensation) {
+    const size_t n = a.size();
+    const size_t blocks = (n + reduction_block - 1) / reduction_block;
+    const size_t copied_a = reduction_copies(a);
+    const size_t copied = copied_a + (Product && reduction_copies(b));
+    A result[2] = {A(0), A(0)};
+    if (blocks <= 1) {
+        GemmScratch<A> buffer(copied * n);
+        const A* x = reduction_operand(a, 0, n, buffer.data());
+        const A* y = Product ? reduction_operand(b, 0, n, buffer.data() + copied_a * n) : nullptr;
+        reduce_sum_block<A, Product, Compensated>(x, y, n, result);
+        compensation = result[1];
+        return result[0];
+    }
+    GemmScratch<A> partials(2 * blocks);
+    A* partial = partials.data();
+    parallel_for(0, blocks, std::max<size_t>(1, elementwise_parallel_grain / reduction_block),
+                 [&](size_t first, size_t last) {
+        GemmScratch<A> buffer(copied * reduction_block);
+        for (size_t block = first; block < last; ++block) {
+            const size_t offset = block * reduction_block;
+            const size_t count = std::min(reduction_block, n - offset);
+            const A* x = reduction_operand(a, offset, count, buffer.data());
+            const A* y = Product ? reduction_operand(b, offset, count, buffer.data() + copied_a * reduction_block)
+                                 : nullptr;
+            reduce_sum_block<A, Product, Compensated>(x, y, count, partial + 2 * block);
+        }
+    });
+    if constexpr (Compensated) {
+        A total = A(0);
+        A error = A(0);
+        for (size_t block = 0; block < blocks; ++block) {
+            neumaier_add(total, error, partial[2 * block]);
+            error += partial[2 * block + 1];
+        }
+        compensation = error;
+        return total;
+    } else {
+        compensation = A(0);
+        return pairwise_sum(partial, blocks, 2);
+    }
+}
+
+/// The sum of a (or of a * b) in the requested Summation; compensation only applies to floating-point types.
+template<typename T, bool Product, typename A = reduction_type<T>>
+A reduce_sum(const VectorView<const T>& a, const VectorView<const T>& b, Summation summation) {
+    A compensation = A(0);
+    if constexpr (std::is_floating_point_v<A>) {
+        if (summation == Summation::compensated) {
+            const A sum = reduce_sum<T, Product, true>(a, b, compensation);
+            return sum + compensation;
+        }
+    }
+    return reduce_sum<T, Product, false>(a, b, compensation);
+}
+
+/// The index of the first smallest (Max false) or largest (Max true) element; see argmin() and argmax().
+template<typename T, bool Max, typename A = reduction_type<T>>
+size_t reduce_arg_extremum(const VectorView<const T>& x, const char* name) {
+    const size_t n = x.size();
+    if (n == 0) {
+        throw std::invalid_argument("\nThe " + std::string(name) + " of an empty Vector is undefined\n");
+    }
+    const size_t blocks = (n + reduction_block - 1) / reduction_block;
+    GemmScratch<A> extrema(blocks);
+    A* extremum = extrema.data();
+    parallel_for(0, blocks, std::max<size_t>(1, elementwise_parallel_grain / reduction_block),
+                 [&](size_t first, size_t last) {
+        GemmScratch<A> buffer(reduction_copies(x) ? reduction_block : 0);
+        for (size_t block = first; block < last; ++block) {
+            const size_t offset = block * reduction_block;
+            const size_t count = std::min(reduction_block, n - offset);
+            extremum[block] = reduce_extremum_block<A, Max>(reduction_operand(x, offset, count, buffer.data()),
+                                                            count);
+        }
+    });
+    size_t best_block = 0;
+    for (size_t block = 1; block < blocks; ++block) {
+        if (Max ? extremum[block] > extremum[best_block] : extremum[block] < extremum[best_block]) best_block = block;
+    }
+    const A best = extremum[best_block];
+    for (size_t i = best_block * reduction_block; i < n; ++i) {  // the first block that holds the extremum
+        if (A(x.data()[(ptrdiff_t)i * x.stride()]) == best) return i;
+    }
+    return 0;  // every element is NaN
+}
+
+}  // namespace detail
+
+
+/* ---------------------------------------------------- Reductions -------------------------------------------------- */
+
+
+/// The sum of the elements of a view. See Summation for the two ways of adding them up.
+template<typename T>
+std::remove_const_t<T> sum(const VectorView<T>& x, Summation summation = Summation::pairwise) {
+    using V = std::remove_const_t<T>;
+    COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::reduce, (OpShape{{x.size()}, 1}), x.size(), x.size() * sizeof(V));
+    return V(detail::reduce_sum<V, false>(x, x, summation));
+}
+
+/**
+ * @brief The dot product of two views: the sum of x[i] * y[i].
+ *
+ * The views need the same number of elements; their orientation is not looked at. See Summation for the two ways of
+ * adding up the products.
+ */
+template<typename T, typename W, typename = std::enable_if_t<std::is_same_v<std::remove_const_t<T>,
+                                                                             std::remove_const_t<W>>>>
+std::remove_const_t<T> dot(const VectorView<T>& x, const VectorView<W>& y,
+                           Summation summation = Summation::pairwise) {
+    using V = std::remove_const_t<T>;
+    if (x.size() != y.size()) {
+        throw std::invalid_argument("\nThe dot product of a Vector of " + std::to_string(x.size()) +
+                                    " elements and a Vector of " + std::to_string(y.size()) +
+                                    " elements cannot be computed\n");
+    }
+    COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::dot, (OpShape{{x.size()}, 1}), 2 * x.size(), 2 * x.size() * sizeof(V));
+    return V(detail::reduce_sum<V, true>(x, y, summation));
+}
+
+/**
+ * @brief The Euclidean norm of a view: the square root of the sum of the squares of its elements.
+ *
+ * The squares are summed directly; only when that sum overflows or underflows are the elements scaled by the largest
+ * magnitude first, so that the norm of a Vector of huge or tiny elements is still accurate.
+ */
+template<typename T>
+std::remove_const_t<T> norm(const VectorView<T>& x, Summation summation = Summation::pairwise) {
+    using V = std::remove_const_t<T>;
+    using A = detail::reduction_type<V>;
+    static_assert(std::is_floating_point_v<A>, "norm() needs a floating-point element type");
+    COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::reduce, (OpShape{{x.size()}, 1}), 2 * x.size(), x.size() * sizeof(V));
+    const A squares = detail::reduce_sum<V, true>(x, x, summation);
+    if (!std::isinf(squares) && !(squares < std::numeric_limits<A>::min())) {
+        return V(std::sqrt(squares));
+    }
+    if (x.size() == 0) {
+        return V(0);
+    }
+    const A largest = std::max(std::abs(A(x[detail::reduce_arg_extremum<V, true>(x, "norm")])),
+                               std::abs(A(x[detail::reduce_arg_extremum<V, false>(x, "norm")])));
+    if (largest == A(0) || std::isinf(largest)) {
+        return V(largest);
+    }
+    A scaled = A(0);
+    for (size_t i = 0; i < x.size(); ++i) {
+        const A ratio = A(x[i]) / largest;
+        scaled += ratio * ratio;
+    }
+    return V(largest * std::sqrt(scaled));
+}
+
+/// The index of the first smallest element of a non-empty view. NaN elements are skipped.
+template<typename T>
+size_t argmin(const VectorView<T>& x) {
+    COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::reduce, (OpShape{{x.size()}, 1}), x.size(), x.size() * sizeof(T));
+    return detail::reduce_arg_extremum<std::remove_const_t<T>, false>(x, "minimum");
+}
+
+/// The index of the first largest element of a non-empty view. NaN elements are skipped.
+template<typename T>
+size_t argmax(const VectorView<T>& x) {
+    COMPUTER_BRAIN_INSTRUMENT_OP(OpKind::reduce, (OpShape{{x.size()}, 1}), x.size(), x.size() * sizeof(T));
+    return detail::reduce_arg_extremum<std::remove_const_t<T>, true>(x, "maximum");
+}
+
+/// The smallest element of a non-empty view.
+template<typename T>
+std::remove_const_t<T> minimum(const VectorView<T>& x) { return x[argmin(x)]; }
+
+/// The largest element of a non-empty view.
+template<typename T>
+std::remove_const_t<T> maximum(const VectorView<T>& x) { return x[argmax(x)]; }
+
+/* The same reductions on a Vector. */
+
+template<typename T>
+T sum(const Vector<T>& x, Summation summation = Summation::pairwise) { return sum(x.view(), summation); }
+
+template<typename T>
+T dot(const Vector<T>& x, const Vector<T>& y, Summation summation = Summation::pairwise) {
+    return dot(x.view(), y.view(), summation);
+}
+
+template<typename T>
+T norm(const Vector<T>& x, Summation summation = Summation::pairwise) { return norm(x.view(), summation); }
+
+template<typename T>
+size_t argmin(const Vector<T>& x) { return argmin(x.view()); }
+
+template<typename T>
+size_t argmax(const Vector<T>& x) { return argmax(x.view()); }
+
+template<typename T>
+T minimum(const Vector<T>& x) { return minimum(x.view()); }
+
+template<typename T>
+T maximum(const Vector<T>& x) { return maximum(x.view()); }
+
+
+#endif //COMPUTER_BRAIN_REDUCE_H
@@ -0,0 +1,329 @@
+#ifndef COMPUTER_BRAIN_SIMD_H
+#define COMPUTER_BRAIN_SIMD_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+/*
+ * SIMD kernels with runtime CPU dispatch.
+ *
+ * Each kernel is written once, as a template over the vector width in bytes, using GCC/Clang vector extensions. The
+ * template is instantiated inside wrappers that carry a target attribute, which gives us an SSE2, an AVX2 and an
+ * AVX-512 build of the same source in one binary, plus a scalar build that runs anywhere. The widest instruction set
+ * the CPU supports is found with CPUID the first time a kernel runs.
+ *
+ * For testing, the instruction set can be forced with force_simd_isa() or with the COMPUTER_BRAIN_SIMD environment
+ * variable (scalar, sse2, avx2 or avx512). Forcing an instruction set the CPU does not have is an error, and so is any
+ * other value of COMPUTER_BRAIN_SIMD: the first kernel to run then throws std::invalid_argument instead of silently
+ * running with another instruction set.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define COMPUTER_BRAIN_X86_DISPATCH 1
+#define COMPUTER_BRAIN_TARGET_SSE2 __attribute__((target("sse2")))
+#define COMPUTER_BRAIN_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define COMPUTER_BRAIN_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl")))
+#endif
+
+/* ------------------------------------------ Instruction Set Selection --------------------------------------------- */
+
+
+/// The instruction sets the kernels are compiled for, from narrowest to widest.
+enum class SimdIsa { scalar = 0, sse2 = 1, avx2 = 2, avx512 = 3 };
+
+/// Returns the name used for isa by COMPUTER_BRAIN_SIMD.
+inline const char* simd_isa_name(SimdIsa isa) {
+    switch (isa) {
+        case SimdIsa::sse2: return "sse2";
+        case SimdIsa::avx2: return "avx2";
+        case SimdIsa::avx512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+/// Returns the widest instruction set the CPU supports, as reported by CPUID.
+inline SimdIsa detected_simd_isa() {
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+    static const SimdIsa isa = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+            __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")) {
+            return SimdIsa::avx512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdIsa::avx2;
+        return SimdIsa::sse2;
+    }();
+    return isa;
+#else
+    return SimdIsa::scalar;
+#endif
+}
+
+namespace detail {
+
+/// Throws unless the CPU supports isa.
+inline void check_simd_isa(SimdIsa isa) {
+    if (isa > detected_simd_isa()) {
+        throw std::invalid_argument(std::string("\nThe instruction set ") + simd_isa_name(isa) + " cannot be forced: "
+                                    "this CPU only supports up to " + simd_isa_name(detected_simd_isa()) + "\n");
+    }
+}
+
+/// Parses COMPUTER_BRAIN_SIMD: unset or empty means "use what the CPU has", and any other value must be a name the CPU
+/// supports.
+inline SimdIsa simd_isa_from_environment() {
+    const char* env = std::getenv("COMPUTER_BRAIN_SIMD");
+    if (env == nullptr || *env == '\0') return detected_simd_isa();
+    const std::string name(env);
+    for (SimdIsa isa : {SimdIsa::scalar, SimdIsa::sse2, SimdIsa::avx2, SimdIsa::avx512}) {
+        if (name == simd_isa_name(isa)) {
+            check_simd_isa(isa);
+            return isa;
+        }
+    }
+    throw std::invalid_argument("\nCOMPUTER_BRAIN_SIMD=" + name + " is not an instruction set: "
+                                "use scalar, sse2, avx2 or avx512, or leave it unset\n");
+}
+
+inline std::atomic<SimdIsa>& simd_isa_state() {
+    static std::atomic<SimdIsa> isa(simd_isa_from_environment());
+    return isa;
+}
+
+}  // namespace detail
+
+/// Returns the instruction set the kernels currently run with.
+inline SimdIsa active_simd_isa() { return detail::simd_isa_state().load(std::memory_order_relaxed); }
+
+/**
+ * @brief Makes every kernel run with the given instruction set, instead of the widest one available.
+ *
+ * This exists so that every code path can be tested on one machine. Asking for an instruction set the CPU does not
+ * support throws std::invalid_argument, since running it would crash with an illegal instruction.
+ */
+inline void force_simd_isa(SimdIsa isa) {
+    detail::check_simd_isa(isa);
+    detail::simd_isa_state().store(isa, std::memory_order_relaxed);
+}
+
+/// Goes back to running every kernel with the widest instruction set the CPU supports.
+inline void reset_simd_isa() { detail::simd_isa_state().store(detected_simd_isa(), std::memory_order_relaxed); }
+
+/// True for the element types the SIMD kernels are written for: the built-in integer and floating-point types.
+template<typename T>
+inline constexpr bool is_simd_type = std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && sizeof(T) <= 8;
+
+
+/* ------------------------------------------------ Kernel Bodies --------------------------------------------------- */
+
+
+namespace detail {
+
+/*
+ * Each kernel is a struct with one static run<Bytes>() template. Bytes is the width of one vector register; with
+ * Bytes == sizeof(T) every "vector" holds a single element and the body is the scalar fallback. The main loops are
+ * unrolled four times so that there are enough independent operations in flight to hide instruction latency.
+ */
+
+template<typename T, int Bytes>
+struct SimdVec {
+    typedef T type __attribute__((vector_size(Bytes)));
+    static constexpr size_t lanes = Bytes / sizeof(T);
+};
+
+/// out[i] = a[i] + b[i]
+template<typename T> struct SimdAdd {
+    template<int Bytes> __attribute__((always_inline)) static inline void run(const T* a, const T* b, T* out,
+                                                                              size_t n) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        size_t i = 0;
+        for (; i + W <= n; i += W) {
+            vec x, y;
+            std::memcpy(&x, a + i, sizeof(vec));
+            std::memcpy(&y, b + i, sizeof(vec));
+            x += y;
+            std::memcpy(out + i, &x, sizeof(vec));
+        }
+        for (; i < n; ++i) out[i] = a[i] + b[i];
+    }
+};
+
+/// out[i] = a[i] - b[i]
+template<typename T> struct SimdSub {
+    template<int Bytes> __attribute__((always_inline)) static inline void run(const T* a, const T* b, T* out,
+                                                                              size_t n) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        size_t i = 0;
+        for (; i + W <= n; i += W) {
+            vec x, y;
+            std::memcpy(&x, a + i, sizeof(vec));
+            std::memcpy(&y, b + i, sizeof(vec));
+            x -= y;
+            std::memcpy(out + i, &x, sizeof(vec));
+        }
+        for (; i < n; ++i) out[i] = a[i] - b[i];
+    }
+};
+
+/// out[i] = a[i] * scalar; out may be a
+template<typename T> struct SimdScale {
+    template<int Bytes> __attribute__((always_inline)) static inline void run(const T* a, T scalar, T* out,
+                                                                              size_t n) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        size_t i = 0;
+        for (; i + W <= n; i += W) {
+            vec x;
+            std::memcpy(&x, a + i, sizeof(vec));
+            x *= scalar;
+            std::memcpy(out + i, &x, sizeof(vec));
+        }
+        for (; i < n; ++i) out[i] = a[i] * scalar;
+    }
+};
+
+/// out[i] = a[i] / scalar; out may be a. Floating-point division is not replaced by a reciprocal multiply, so the
+/// results are exactly those of the scalar loop.
+template<typename T> struct SimdDivide {
+    template<int Bytes> __attribute__((always_inline)) static inline void run(const T* a, T scalar, T* out,
+                                                                              size_t n) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        size_t i = 0;
+        for (; i + W <= n; i += W) {
+            vec x;
+            std::memcpy(&x, a + i, sizeof(vec));
+            x /= scalar;
+            std::memcpy(out + i, &x, sizeof(vec));
+        }
+        for (; i < n; ++i) out[i] = a[i] / scalar;
+    }
+};
+
+/// returns sum(a[i] * b[i]), accumulated in four independent vector registers
+template<typename T> struct SimdDot {
+    template<int Bytes> __attribute__((always_inline)) static inline T run(const T* a, const T* b, size_t n) {
+        using vec = typename SimdVec<T, Bytes>::type;
+        constexpr size_t W = SimdVec<T, Bytes>::lanes;
+        vec acc[4] = {};
+        size_t i = 0;
+        for (; i + 4 * W <= n; i += 4 * W) {
+#pragma GCC unroll 4
+            for (int u = 0; u < 4; ++u) {
+                vec x, y;
+                std::memcpy(&x, a + i + u * W, sizeof(vec));
+                std::memcpy(&y, b + i + u * W, sizeof(vec));
+                acc[u] += x * y;
+            }
+        }
+        for (; i + W <= n; i += W) {
+            vec x, y;
+            std::memcpy(&x, a + i, sizeof(vec));
+            std::memcpy(&y, b + i, sizeof(vec));
+            acc[0] += x * y;
+        }
+        const vec total = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+        T sum = T(0);
+        for (size_t lane = 0; lane < W; ++lane) sum += total[lane];
+        for (; i < n; ++i) sum += a[i] * b[i];
+        return sum;
+    }
+};
+
+/* One wrapper per instruction set; each compiles Kernel::run with the vector width of that instruction set. */
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+template<typename Kernel, typename... Args>
+COMPUTER_BRAIN_TARGET_AVX512 auto simd_run_avx512(Args... args) { return Kernel::template run<64>(args...); }
+template<typename Kernel, typename... Args>
+COMPUTER_BRAIN_TARGET_AVX2 auto simd_run_avx2(Args... args) { return Kernel::template run<32>(args...); }
+template<typename Kernel, typename... Args>
+COMPUTER_BRAIN_TARGET_SSE2 auto simd_run_sse2(Args... args) { return Kernel::template run<16>(args...); }
+#endif
+template<typename T, typename Kernel, typename... Args>
+auto simd_run_scalar(Args... args) { return Kernel::template run<sizeof(T)>(args...); }
+
+/// Runs Kernel with the active instruction set.
+template<typename T, typename Kernel, typename... Args>
+auto simd_dispatch(Args... args) {
+    switch (active_simd_isa()) {
+#ifdef COMPUTER_BRAIN_X86_DISPATCH
+        case SimdIsa::avx512: return simd_run_avx512<Kernel>(args...);
+        case SimdIsa::avx2: return simd_run_avx2<Kernel>(args...);
+        case SimdIsa::sse2: return simd_run_sse2<Kernel>(args...);
+#endif
+        default: return simd_run_scalar<T, Kernel>(args...);
+    }
+}
+
+}  // namespace detail
+
+
+/* ------------------------------------------------- Kernel Entry Points -------------------------------------------- */
+
+
+/*
+ * Element types that are not built-in arithmetic types (user-defined numbers, long double) use a plain loop, so
+ * these functions can be called for any T that Vector<T> supports.
+ */
+
+/// out[i] = a[i] + b[i] for i in [0, n). out may alias a or b.
+template<typename T>
+void simd_add(const T* a, const T* b, T* out, size_t n) {
+    if constexpr (is_simd_type<T>) {
+        detail::simd_dispatch<T, detail::SimdAdd<T>>(a, b, out, n);
+    } else {
+        for (size_t i = 0; i < n; ++i) out[i] = a[i] + b[i];
+    }
+}
+
+/// out[i] = a[i] - b[i] for i in [0, n). out may alias a or b.
+template<typename T>
+void simd_sub(const T* a, const T* b, T* out, size_t n) {
+    if constexpr (is_simd_type<T>) {
+        detail::simd_dispatch<T, detail::SimdSub<T>>(a, b, out, n);
+    } else {
+        for (size_t i = 0; i < n; ++i) out[i] = a[i] - b[i];
+    }
+}
+
+/// out[i] = a[i] * scalar for i in [0, n). out may alias a.
+template<typename T>
+void simd_scale(const T* a, T scalar, T* out, size_t n) {
+    if constexpr (is_simd_type<T>) {
+        detail::simd_dispatch<T, detail::SimdScale<T>>(a, scalar, out, n);
+    } else {
+        for (size_t i = 0; i < n; ++i) out[i] = a[i] * scalar;
+    }
+}
+
+/// out[i] = a[i] / scalar for i in [0, n). out may alias a.
+template<typename T>
+void simd_divide(const T* a, T scalar, T* out, size_t n) {
+    if constexpr (is_simd_type<T>) {
+        detail::simd_dispatch<T, detail::SimdDivide<T>>(a, scalar, out, n);
+    } else {
+        for (size_t i = 0; i < n; ++i) out[i] = a[i] / scalar;
+    }
+}
+
+/// Returns the sum of a[i] * b[i] for i in [0, n).
+template<typename T>
+T simd_dot(const T* a, const T* b, size_t n) {
+    if constexpr (is_simd_type<T>) {
+        return detail::simd_dispatch<T, detail::SimdDot<T>>(a, b, n);
+    } else {
+        T sum = T(0);
+        for (size_t i = 0; i < n; ++i) sum += a[i] * b[i];
+        return sum;
+    }
+}
+
+
+#endif //COMPUTER_BRAIN_SIMD_H
@@ -0,0 +1,477 @@
+#ifndef COMPUTER_BRAIN_SPARSE_H
+#define COMPUTER_BRAIN_SPARSE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "expression.h"
+#include "thread_pool.h"
+#include "view.h"
+
+/*
+ * Compressed sparse matrices.
+ *
+ * A SparseMatrix stores only its nonzero elements, in one of two layouts:
+ *
+ *   CSR (compressed sparse row): the nonzeros of row 0, then those of row 1, and so on. offsets[i] is the position of
+ *        the first nonzero of row i, so row i is [offsets[i], offsets[i + 1]); indices[p] is the column of nonzero p.
+ *   CSC (compressed sparse column): the same with rows and columns swapped.
+ *
+ * The row (CSR) or column (CSC) is called the outer dimension, the other one the inner dimension. A matrix with nnz
+ * nonzeros takes nnz * (sizeof(U) + 4) + (outer + 1) * 8 bytes instead of rows * columns * sizeof(U); inner indices are
+ * 32-bit, so neither dimension may exceed 2^32 - 1.
+ *
+ * Products with dense operands (spmv, spmm and operator*) touch every nonzero once and run on the thread pool. Work
+ * is split into chunks holding the same number of nonzeros rather than the same number of rows, so a few very dense
+ * rows do not leave the other threads idle.
+ */
+
+/// Sparse products with fewer nonzeros than this run serially.
+inline constexpr size_t sparse_parallel_grain = size_t(1) << 14;
+
+enum class SparseFormat { csr, csc };
+
+
+/* ------------------------------------------------ Sparse Matrix Class --------------------------------------------- */
+
+
+template<typename U>
+class SparseMatrix {
+public:
+    using value_type = U;
+    using index_type = std::uint32_t;
+
+    /* Constructors */
+    SparseMatrix(size_t num_rows, size_t num_cols, SparseFormat format = SparseFormat::csr);  // all zeros
+    SparseMatrix(size_t num_rows, size_t num_cols, std::vector<size_t> offsets, std::vector<index_type> indices,
+                 std::vector<U> values, SparseFormat format = SparseFormat::csr);
+    template<typename W> explicit SparseMatrix(const MatrixView<W>& dense, SparseFormat format = SparseFormat::csr);
+    explicit SparseMatrix(const Matrix<U>& dense, SparseFormat format = SparseFormat::csr);
+    static SparseMatrix from_triplets(size_t num_rows, size_t num_cols,
+                                      const std::vector<std::tuple<size_t, size_t, U>>& triplets,
+                                      SparseFormat format = SparseFormat::csr);
+
+    /* Member Functions */
+    size_t rows() const { return num_rows; }
+    size_t columns() const { return num_cols; }
+    size_t nnz() const { return nonzeros.size(); }
+    SparseFormat format() const { return storage_format; }
+    const std::vector<size_t>& offsets() const { return outer_offsets; }
+    const std::vector<index_type>& indices() const { return inner_indices; }
+    const std::vector<U>& values() const { return nonzeros; }
+    std::vector<U>& values() { return nonzeros; }
+    size_t memory_bytes() const;
+    U at(size_t i, size_t j) const;
+
+    SparseMatrix to_csr() const;
+    SparseMatrix to_csc() const;
+    SparseMatrix t() const;
+    Matrix<U> to_dense() const;
+
+private:
+    SparseFormat storage_format;
+    size_t num_rows;
+    size_t num_cols;
+    std::vector<size_t> outer_offsets;      // outer() + 1 entries
+    std::vector<index_type> inner_indices;  // nnz() entries
+    std::vector<U> nonzeros;                // nnz() entries
+
+    size_t outer() const { return storage_format == SparseFormat::csr ? num_rows : num_cols; }
+    size_t inner() const { return storage_format == SparseFormat::csr ? num_cols : num_rows; }
+    SparseMatrix converted() const;
+};
+
+
+namespace detail {
+
+inline void check_sparse_dimensions(size_t num_rows, size_t num_cols) {
+    constexpr size_t limit = size_t(UINT32_MAX);
+    if (num_rows > limit || num_cols > limit) {
+        throw std::invalid_argument("\nA SparseMatrix cannot have more than " + std::to_string(limit) +
+                                    " rows or columns\n");
+    }
+}
+
+/// First outer index of chunk `chunk` out of `num_chunks`, with boundaries chosen so that every chunk holds about
+/// nnz / num_chunks nonzeros.
+inline size_t balanced_outer_begin(const std::vector<size_t>& offsets, size_t chunk, size_t num_chunks) {
+    if (chunk == 0) return 0;
+    const size_t outer = offsets.size() - 1;
+    if (chunk >= num_chunks) return outer;
+    const size_t target = offsets.back() / num_chunks * chunk + offsets.back() % num_chunks * chunk / num_chunks;
+    return (size_t)(std::lower_bound(offsets.begin(), offsets.end(), target) - offsets.begin());
+}
+
+/// Number of nonzero-balanced chunks worth running in parallel for a matrix with nnz nonzeros.
+inline size_t sparse_chunks(size_t nnz) {
+    return std::max<size_t>(1, std::min(get_num_threads() * 4, nnz / sparse_parallel_grain));
+}
+
+/// Runs body(outer_begin, outer_end) over nonzero-balanced ranges of the outer dimension, in parallel.
+template<typename F>
+void parallel_over_nonzeros(const std::vector<size_t>& offsets, F&& body) {
+    const size_t num_chunks = sparse_chunks(offsets.back());
+    parallel_for(0, num_chunks, 1, [&](size_t first, size_t last) {
+        for (size_t chunk = first; chunk < last; ++chunk) {
+            const size_t begin = balanced_outer_begin(offsets, chunk, num_chunks);
+            const size_t end = balanced_outer_begin(offsets, chunk + 1, num_chunks);
+            if (begin < end) body(begin, end);
+        }
+    });
+}
+
+/// y[0 .. n) += scale * x[0 .. n), for rows of B and C; the unit-stride case is the one the compiler vectorises.
+template<typename U>
+void sparse_axpy(U scale, const U* x, ptrdiff_t incx, U* y, ptrdiff_t incy, size_t n) {
+    if (incx == 1 && incy == 1) {
+        for (size_t j = 0; j < n; ++j) y[j] += scale * x[j];
+    } else {
+        for (size_t j = 0; j < n; ++j) y[j * incy] += scale * x[j * incx];
+    }
+}
+
+}  // namespace detail
+
+
+/* --------------------------------------------- Sparse Matrix Definitions ------------------------------------------ */
+
+
+/// Creates a num_rows x num_cols SparseMatrix with no nonzeros.
+template<typename U>
+SparseMatrix<U>::SparseMatrix(size_t num_rows, size_t num_cols, SparseFormat format)
+    : storage_format(format), num_rows(num_rows), num_cols(num_cols) {
+    detail::check_sparse_dimensions(num_rows, num_cols);
+    outer_offsets.assign(outer() + 1, 0);
+}
+
+/**
+ * @brief Creates a SparseMatrix from its three arrays, in the layout given by format (see the top of this file).
+ *
+ * The arrays are checked: offsets must have outer + 1 nondecreasing entries from 0 to nnz, and every inner index must
+ * be in range; otherwise std::invalid_argument is thrown. Indices within a row (column) do not need to be sorted.
+ */
+template<typename U>
+SparseMatrix<U>::SparseMatrix(size_t num_rows, size_t num_cols, std::vector<size_t> offsets,
+                              std::vector<index_type> indices, std::vector<U> values, SparseFormat format)
+    : storage_format(format), num_rows(num_rows), num_cols(num_cols), outer_offsets(std::move(offsets)),
+      inner_indices(std::move(indices)), nonzeros(std::move(values)) {
+    detail::check_sparse_dimensions(num_rows, num_cols);
+    if (outer_offsets.size() != outer() + 1 || outer_offsets.front() != 0 ||
+        outer_offsets.back() != nonzeros.size() || inner_indices.size() != nonzeros.size() ||
+        !std::is_sorted(outer_offsets.begin(), outer_offsets.end())) {
+        throw std::invalid_argument("\nThe offsets, indices and values given to SparseMatrix do not describe a " +
+                                    std::to_string(num_rows) + "x" + std::to_string(num_cols) + " matrix\n");
+    }
+    for (const index_type index : inner_indices) {
+        if (index >= inner()) {
+            throw std::invalid_argument("\nSparseMatrix index " + std::to_string(index) + " is out of range\n");
+        }
+    }
+}
+
+/**
+ * @brief Compresses a dense view, keeping every element that is not zero.
+ *
+ * Two parallel passes: the first counts the nonzeros of every row (column), the second copies them. A transposed view
+ * or a submatrix can be compressed directly.
+ */
+template<typename U>
+template<typename W>
+SparseMatrix<U>::SparseMatrix(const MatrixView<W>& dense, SparseFormat format)
+    : SparseMatrix(dense.rows(), dense.columns(), format) {
+    const bool by_rows = format == SparseFormat::csr;
+    const size_t outer_size = outer(), inner_size = inner();
+    auto element = [&](size_t o, size_t p) -> const U& { return by_rows ? dense(o, p) : dense(p, o); };
+    const size_t grain = std::max<size_t>(1, elementwise_parallel_grain / std::max<size_t>(1, inner_size));
+    parallel_for(0, outer_size, grain, [&](size_t first, size_t last) {
+        for (size_t o = first; o < last; ++o) {
+            size_t count = 0;
+            for (size_t p = 0; p < inner_size; ++p) count += element(o, p) != U(0);
+            outer_offsets[o + 1] = count;
+        }
+    });
+    for (size_t o = 0; o < outer_size; ++o) outer_offsets[o + 1] += outer_offsets[o];
+    inner_indices.resize(outer_offsets.back());
+    nonzeros.resize(outer_offsets.back());
+    parallel_for(0, outer_size, grain, [&](size_t first, size_t last) {
+        for (size_t o = first; o < last; ++o) {
+            size_t position = outer_offsets[o];
+            for (size_t p = 0; p < inner_size; ++p) {
+                const U value = element(o, p);
+                if (value != U(0)) {
+                    inner_indices[position] = (index_type)p;
+                    nonzeros[position++] = value;
+                }
+            }
+        }
+    });
+}
+
+/// Compresses a dense Matrix, in its current orientation.
+template<typename U>
+SparseMatrix<U>::SparseMatrix(const Matrix<U>& dense, SparseFormat format) : SparseMatrix(dense.view(), format) { }
+
+/**
+ * @brief Builds a SparseMatrix from (row, column, value) triplets, in any order.
+ *
+ * Triplets with the same row and column are added together, as is usual for assembling sparse matrices. Indices within
+ * each row (column) of the result are sorted. Throws std::invalid_argument if a triplet is out of range.
+ */
+template<typename U>
+SparseMatrix<U> SparseMatrix<U>::from_triplets(size_t num_rows, size_t num_cols,
+                                               const std::vector<std::tuple<size_t, size_t, U>>& triplets,
+                                               SparseFormat format) {
+    SparseMatrix result(num_rows, num_cols, format);
+    const bool by_rows = format == SparseFormat::csr;
+    std::vector<std::tuple<size_t, size_t, U>> sorted;  // (outer, inner, value)
+    sorted.reserve(triplets.size());
+    for (const auto& [i, j, value] : triplets) {
+        if (i >= num_rows || j >= num_cols) {
+            throw std::invalid_argument("\nThe triplet (" + std::to_string(i) + ", " + std::to_string(j) +
+                                        ") is outside a " + std::to_string(num_rows) + "x" +
+                                        std::to_string(num_cols) + " SparseMatrix\n");
+        }
+        sorted.emplace_back(by_rows ? i : j, by_rows ? j : i, value);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return std::get<0>(a) != std::get<0>(b) ? std::get<0>(a) < std::get<0>(b) : std::get<1>(a) < std::get<1>(b);
+    });
+    for (size_t t = 0; t < sorted.size(); ++t) {
+        const auto& [o, p, value] = sorted[t];
+        if (t > 0 && std::get<0>(sorted[t - 1]) == o && std::get<1>(sorted[t - 1]) == p) {
+            result.nonzeros.back() += value;  // if: same position as the previous triplet, sum them
+            continue;
+        }
+        result.inner_indices.push_back((index_type)p);
+        result.nonzeros.push_back(value);
+        ++result.outer_offsets[o + 1];
+    }
+    for (size_t o = 0; o < result.outer(); ++o) result.outer_offsets[o + 1] += result.outer_offsets[o];
+    return result;
+}
+
+/// SparseMatrix.memory_bytes() returns the number of bytes held by the three arrays.
+template<typename U>
+size_t SparseMatrix<U>::memory_bytes() const {
+    return outer_offsets.size() * sizeof(size_t) + inner_indices.size() * sizeof(index_type) +
+           nonzeros.size() * sizeof(U);
+}
+
+/// SparseMatrix.at(i, j) returns element (i, j), which is zero when it is not stored. Costs a scan of one row (column).
+template<typename U>
+U SparseMatrix<U>::at(size_t i, size_t j) const {
+    if (i >= num_rows || j >= num_cols) {
+        throw std::out_of_range("\nElement (" + std::to_string(i) + ", " + std::to_string(j) +
+                                ") does not exist in a " + std::to_string(num_rows) + "x" + std::to_string(num_cols) +
+                                " SparseMatrix\n");
+    }
+    const size_t o = storage_format == SparseFormat::csr ? i : j;
+    const size_t p = storage_format == SparseFormat::csr ? j : i;
+    U sum = U(0);
+    for (size_t k = outer_offsets[o]; k < outer_offsets[o + 1]; ++k) {
+        if (inner_indices[k] == p) sum += nonzeros[k];
+    }
+    return sum;
+}
+
+/// The same matrix in the other layout: a counting sort of the nonzeros by inner index, in O(nnz + rows + columns).
+template<typename U>
+SparseMatrix<U> SparseMatrix<U>::converted() const {
+    const SparseFormat other = storage_format == SparseFormat::csr ? SparseFormat::csc : SparseFormat::csr;
+    SparseMatrix result(num_rows, num_cols, other);
+    result.inner_indices.resize(nnz());
+    result.nonzeros.resize(nnz());
+    for (const index_type p : inner_indices) ++result.outer_offsets[p + 1];
+    for (size_t p = 0; p < inner(); ++p) result.outer_offsets[p + 1] += result.outer_offsets[p];
+    std::vector<size_t> next(result.outer_offsets.begin(), result.outer_offsets.end() - 1);
+    for (size_t o = 0; o < outer(); ++o) {  // walking the outer dimension in order keeps every new row (column) sorted
+        for (size_t k = outer_offsets[o]; k < outer_offsets[o + 1]; ++k) {
+            const size_t position = next[inner_indices[k]]++;
+            result.inner_indices[position] = (index_type)o;
+            result.nonzeros[position] = nonzeros[k];
+        }
+    }
+    return result;
+}
+
+/// SparseMatrix.to_csr() returns the matrix in CSR layout (a copy if it already is).
+template<typename U>
+SparseMatrix<U> SparseMatrix<U>::to_csr() const {
+    return storage_format == SparseFormat::csr ? *this : converted();
+}
+
+/// SparseMatrix.to_csc() returns the matrix in CSC layout (a copy if it already is).
+template<typename U>
+SparseMatrix<U> SparseMatrix<U>::to_csc() const {
+    return storage_format == SparseFormat::csc ? *this : converted();
+}
+
+/**
+ * SparseMatrix.t() returns the transpose. The CSR layout of a matrix is the CSC layout of its transpose, so this copies
+ * the three arrays and swaps the shape and the layout, without reordering anything.
+ */
+template<typename U>
+SparseMatrix<U> SparseMatrix<U>::t() const {
+    SparseMatrix result(*this);
+    std::swap(result.num_rows, result.num_cols);
+    result.storage_format = storage_format == SparseFormat::csr ? SparseFormat::csc : SparseFormat::csr;
+    return result;
+}
+
+/// SparseMatrix.to_dense() expands the matrix into a new Matrix.
+template<typename U>
+Matrix<U> SparseMatrix<U>::to_dense() const {
+    Matrix<U> result(num_rows, num_cols);
+    U* out = result.data();
+    const size_t ld = result.ld();
+    const bool by_rows = storage_format == SparseFormat::csr;
+    // different outer ranges write disjoint elements
+    detail::parallel_over_nonzeros(outer_offsets, [&](size_t begin, size_t end) {
+        for (size_t o = begin; o < end; ++o) {
+            for (size_t k = outer_offsets[o]; k < outer_offsets[o + 1]; ++k) {
+                const size_t p = inner_indices[k];
+                (by_rows ? out[o * ld + p] : out[p * ld + o]) += nonzeros[k];
+            }
+        }
+    });
+    return result;
+}
+
+
+/* ---------------------------------------------- Sparse-Dense Products --------------------------------------------- */
+
+
+/**
+ * @brief y = alpha * A * x + beta * y, with A sparse and x, y dense.
+ *
+ * CSR: every nonzero-balanced range of rows is one task, and each row is a sparse dot product with x. CSC: each task
+ * scatters a range of columns into its own accumulator, and the accumulators are summed at the end, which costs
+ * O(rows) per task on top of the nonzeros. beta == 0 overwrites y without reading it.
+ */
+template<typename U>
+void spmv(U alpha, const SparseMatrix<U>& a, const std::type_identity_t<VectorView<const U>>& x, U beta,
+          const std::type_identity_t<VectorView<U>>& y) {
+    if (x.size() != a.columns() || y.size() != a.rows()) {
+        throw std::invalid_argument("\nThe sparse matrix-vector product cannot be computed: a " +
+                                    std::to_string(a.rows()) + "x" + std::to_string(a.columns()) +
+                                    " SparseMatrix times a Vector of " + std::to_string(x.size()) +
+                                    " into a Vector of " + std::to_string(y.size()) + "\n");
+    }
+    const auto& offsets = a.offsets();
+    const auto& indices = a.indices();
+    const auto& values = a.values();
+    if (a.format() == SparseFormat::csr) {
+        detail::parallel_over_nonzeros(offsets, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                U sum = U(0);
+                for (size_t k = offsets[i]; k < offsets[i + 1]; ++k) sum += values[k] * x[indices[k]];
+                y[i] = beta == U(0) ? alpha * sum : alpha * sum + beta * y[i];
+            }
+        });
+        return;
+    }
+    const size_t m = a.rows();
+    const size_t num_chunks = detail::sparse_chunks(a.nnz());
+    std::vector<U> partial(num_chunks * m, U(0));  // one accumulator per chunk of columns
+    parallel_for(0, num_chunks, 1, [&](size_t first, size_t last) {
+        for (size_t chunk = first; chunk < last; ++chunk) {
+            U* accumulator = partial.data() + chunk * m;
+            const size_t begin = detail::balanced_outer_begin(offsets, chunk, num_chunks);
+            const size_t end = detail::balanced_outer_begin(offsets, chunk + 1, num_chunks);
+            for (size_t j = begin; j < end; ++j) {
+                const U xj = x[j];
+                for (size_t k = offsets[j]; k < offsets[j + 1]; ++k) accumulator[indices[k]] += values[k] * xj;
+            }
+        }
+    });
+    parallel_for(0, m, elementwise_parallel_grain, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            U sum = U(0);
+            for (size_t chunk = 0; chunk < num_chunks; ++chunk) sum += partial[chunk * m + i];
+            y[i] = beta == U(0) ? alpha * sum : alpha * sum + beta * y[i];
+        }
+    });
+}
+
+/**
+ * @brief C = alpha * A * B + beta * C, with A sparse and B, C dense.
+ *
+ * Each nonzero A(i, p) adds A(i, p) times row p of B to row i of C. With CSR, nonzero-balanced ranges of rows of C are
+ * the tasks. With CSC, the rows of C a column of A writes to are scattered, so the tasks are ranges of columns of B
+ * and C instead, which never overlap.
+ */
+template<typename U>
+void spmm(U alpha, const SparseMatrix<U>& a, const std::type_identity_t<MatrixView<const U>>& b, U beta,
+          const std::type_identity_t<MatrixView<U>>& c) {
+    if (b.rows() != a.columns() || c.rows() != a.rows() || c.columns() != b.columns()) {
+        throw std::invalid_argument("The sparse Matrix product cannot be computed due to incompatible Matrix "
+                                    "Dimensions\n");
+    }
+    const size_t n = b.columns();
+    const auto& offsets = a.offsets();
+    const auto& indices = a.indices();
+    const auto& values = a.values();
+    auto scale_rows = [&](size_t row_begin, size_t row_end, size_t col_begin, size_t col_end) {
+        for (size_t i = row_begin; i < row_end; ++i) {
+            for (size_t j = col_begin; j < col_end; ++j) c(i, j) = beta == U(0) ? U(0) : beta * c(i, j);
+        }
+    };
+    if (a.format() == SparseFormat::csr) {
+        detail::parallel_over_nonzeros(offsets, [&](size_t begin, size_t end) {
+            scale_rows(begin, end, 0, n);
+            for (size_t i = begin; i < end; ++i) {
+                for (size_t k = offsets[i]; k < offsets[i + 1]; ++k) {
+                    detail::sparse_axpy(alpha * values[k], &b(indices[k], 0), b.col_stride(), &c(i, 0),
+                                        c.col_stride(), n);
+                }
+            }
+        });
+        return;
+    }
+    const size_t grain = std::max<size_t>(1, sparse_parallel_grain / std::max<size_t>(1, a.nnz()));
+    parallel_for(0, n, grain, [&](size_t col_begin, size_t col_end) {
+        scale_rows(0, a.rows(), col_begin, col_end);
+        for (size_t p = 0; p < a.columns(); ++p) {
+            for (size_t k = offsets[p]; k < offsets[p + 1]; ++k) {
+                detail::sparse_axpy(alpha * values[k], &b(p, col_begin), b.col_stride(), &c(indices[k], col_begin),
+                                    c.col_stride(), col_end - col_begin);
+            }
+        }
+    });
+}
+
+/// Sparse matrix times a column Vector (not transposed) of as many elements as the matrix has columns.
+template<typename U>
+Vector<U> operator*(const SparseMatrix<U>& sparse, const Vector<U>& vector) {
+    if (vector.is_transposed) {
+        throw std::invalid_argument("\nA SparseMatrix can only be multiplied by a column Vector (not transposed)\n");
+    }
+    Vector<U> result((int)sparse.rows(), U(0));
+    spmv<U>(U(1), sparse, vector.view(), U(0), result.view());
+    return result;
+}
+
+/// Sparse matrix times a dense Matrix, in its current orientation.
+template<typename U>
+Matrix<U> operator*(const SparseMatrix<U>& sparse, const Matrix<U>& dense) {
+    Matrix<U> result(sparse.rows(), dense.view().columns());
+    spmm<U>(U(1), sparse, dense.view(), U(0), result.view());
+    return result;
+}
+
+/// Sparse matrix times a dense view.
+template<typename U, typename W, typename = std::enable_if_t<std::is_same_v<U, std::remove_const_t<W>>>>
+Matrix<U> operator*(const SparseMatrix<U>& sparse, const MatrixView<W>& dense) {
+    Matrix<U> result(sparse.rows(), dense.columns());
+    spmm<U>(U(1), sparse, dense, U(0), result.view());
+    return result;
+}
+
+
+#endif //COMPUTER_BRAIN_SPARSE_H
@@ -0,0 +1,279 @@
+#ifndef COMPUTER_BRAIN_STREAMING_H
+#define COMPUTER_BRAIN_STREAMING_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "aligned.h"
+#include "binary_io.h"
+#include "gemm.h"
+
+/*
+ * Out-of-core matrix multiply: C = A * B for matrices stored in binary files (binary_io.h) that need not fit in memory.
+ *
+ * C is produced one mb x nb block at a time. For each block, the loop runs over K in steps of kb: it reads the
+ * mb x kb tile of A and the kb x nb tile of B, and accumulates their product into the block with gemm(). A finished
+ * block is written to the C file. Only the tiles live in memory:
+ *
+ *   2 tiles of A + 2 tiles of B     the tiles of the next step are read by a background thread while gemm() runs on
+ *                                   the current ones (double buffering), so disk reads overlap with compute
+ *   2 blocks of C                   a finished block is written by a background thread while the next one is computed
+ *
+ * The tile sizes are the largest that keep these six buffers within StreamingGemmOptions::memory_budget. Larger tiles
+ * mean less I/O: every element of A is read N / nb times and every element of B M / mb times.
+ *
+ * The operands are read in the orientation they were saved in (the is_transposed flag is honoured). A file's rows or
+ * its columns must be contiguous, which is true of every file written by save_binary(); a tile is read as one run
+ * per row, or per column, or in one piece when it covers whole rows of a packed file. The result is a packed, row-major
+ * Matrix file that load_matrix() or MappedMatrix can open.
+ */
+
+/// Settings of gemm_streaming().
+struct StreamingGemmOptions {
+    size_t memory_budget = size_t(256) << 20;  // bytes of tile buffers gemm_streaming() may hold at once
+};
+
+/// What gemm_streaming() did, for tuning the budget.
+struct StreamingGemmReport {
+    size_t tile_rows = 0;        // mb: rows of a block of C and of a tile of A
+    size_t tile_columns = 0;     // nb: columns of a block of C and of a tile of B
+    size_t tile_depth = 0;       // kb: columns of a tile of A, rows of a tile of B
+    size_t buffer_bytes = 0;     // memory held by the tile buffers, never more than the budget
+    size_t bytes_read = 0;
+    size_t bytes_written = 0;
+    double io_wait_seconds = 0;  // time the compute thread spent waiting for reads or writes to finish
+};
+
+
+/* ------------------------------------------------ Streamed Operands ----------------------------------------------- */
+
+
+namespace detail {
+
+/// A Matrix file read tile by tile, seen in the orientation it was saved in.
+template<typename U>
+class StreamedOperand {
+public:
+    StreamedOperand(const std::string& path) : path(path), file(path, std::ios::binary) {
+        const BinaryHeader header = read_binary_header<U>(file, 2, path);
+        const bool transposed = header.flags & BinaryHeader::transposed_flag;
+        num_rows = transposed ? header.columns : header.rows;
+        num_cols = transposed ? header.rows : header.columns;
+        rs = (size_t)(transposed ? header.col_stride : header.row_stride);
+        cs = (size_t)(transposed ? header.row_stride : header.col_stride);
+        data_offset = header.data_offset;
+        if (cs != 1 && rs != 1 && num_rows > 1 && num_cols > 1) {
+            throw std::invalid_argument("\n" + path + " has neither contiguous rows nor contiguous columns and "
+                                        "cannot be streamed\n");
+        }
+    }
+
+    size_t rows() const { return num_rows; }
+    size_t columns() const { return num_cols; }
+
+    /**
+     * Reads the rows x columns tile at (first_row, first_col) into out, in the direction that is contiguous in the
+     * file: row-major when rows are contiguous, column-major otherwise. Returns the bytes read, and sets the strides
+     * of the tile in out.
+     */
+    size_t read_tile(size_t first_row, size_t first_col, size_t rows, size_t columns, U* out,
+                     ptrdiff_t& tile_rs, ptrdiff_t& tile_cs) {
+        const bool by_rows = cs == 1 || num_cols == 1;
+        const size_t runs = by_rows ? rows : columns;           // contiguous runs in the file
+        const size_t run_length = by_rows ? columns : rows;     // elements per run
+        const size_t run_stride = by_rows ? rs : cs;            // file distance between runs
+        tile_rs = by_rows ? (ptrdiff_t)columns : 1;
+        tile_cs = by_rows ? 1 : (ptrdiff_t)rows;
+        if (runs == 0 || run_length == 0) return 0;
+        const size_t first = first_row * rs + first_col * cs;
+        if (run_length == run_stride || runs == 1) {  // if: the runs follow each other in the file, read them at once
+            read(first, runs * run_length, out);
+        } else {
+            for (size_t r = 0; r < runs; ++r) read(first + r * run_stride, run_length, out + r * run_length);
+        }
+        return runs * run_length * sizeof(U);
+    }
+
+private:
+    void read(size_t element, size_t count, U* out) {
+        file.seekg((std::streamoff)(data_offset + element * sizeof(U)), std::ios::beg);
+        if (!file.read(reinterpret_cast<char*>(out), (std::streamsize)(count * sizeof(U)))) {
+            throw std::runtime_error("\nCannot read the elements of " + path + "\n");
+        }
+    }
+
+    std::string path;
+    std::ifstream file;
+    size_t num_rows = 0, num_cols = 0;
+    size_t rs = 0, cs = 0;
+    size_t data_offset = 0;
+};
+
+/**
+ * Chooses mb, nb and kb so that 2 * mb * kb + 2 * kb * nb + 2 * mb * nb elements fit in the budget: kb as large as a
+ * square split of the budget allows, then mb = nb as large as the rest allows, then whichever of the two is not
+ * already the whole dimension takes what is left when the other one is.
+ */
+inline void streaming_tile_sizes(size_t m, size_t n, size_t k, size_t budget_elements,
+                                 size_t& mb, size_t& nb, size_t& kb) {
+    const double budget = (double)budget_elements;
+    kb = std::min(k, (size_t)std::sqrt(budget / 6));
+    const double b = 2.0 * (double)kb;  // 2 x^2 + 2 b x <= budget, for mb = nb = x
+    const size_t x = (size_t)((-b + std::sqrt(b * b + 2 * budget)) / 2);
+    mb = std::min(m, x);
+    nb = std::min(n, x);
+    const auto rest = [&](size_t other) {  // the largest x with 2 x kb + 2 kb other + 2 x other <= budget
+        return (size_t)std::max(0.0, (budget - 2.0 * other * kb) / (2.0 * kb + 2.0 * other));
+    };
+    if (mb == m && nb < n) nb = std::min(n, rest(mb));
+    if (nb == n && mb < m) mb = std::min(m, rest(nb));
+    if (mb > 64 && mb < m) mb -= mb % 64;  // whole cache lines of C rows and whole micro-panels in gemm()
+    if (nb > 64 && nb < n) nb -= nb % 64;
+}
+
+}  // namespace detail
+
+
+/* ------------------------------------------------ Streaming GEMM -------------------------------------------------- */
+
+
+/**
+ * @brief C = A * B, where A, B and C are Matrix files (see binary_io.h) that may be larger than memory.
+ *
+ * The file at c_path is created or overwritten with the mb x nb blocks of the product as they are finished. At most
+ * options.memory_budget bytes of tiles are held at any time; a budget too small for 16 x 16 tiles (or the whole
+ * problem, if smaller) is rejected. Each tile product runs through gemm() and therefore on the thread pool, while
+ * reading and writing happen on two background threads.
+ *
+ * @throws std::invalid_argument if c_path names the file of A or B, the inner dimensions differ, a file holds another
+ *         element type, or the budget is too small; std::runtime_error if a file cannot be read or written
+ */
+template<typename U>
+StreamingGemmReport gemm_streaming(const std::string& a_path, const std::string& b_path, const std::string& c_path,
+                                   const StreamingGemmOptions& options = {}) {
+    using clock = std::chrono::steady_clock;
+    for (const std::string& operand : {a_path, b_path}) {  // C is truncated before A and B are read
+        std::error_code error;
+        if (c_path == operand || std::filesystem::equivalent(c_path, operand, error)) {
+            throw std::invalid_argument("\nThe product cannot be written to " + c_path + ": it is also an operand\n");
+        }
+    }
+    detail::StreamedOperand<U> a(a_path);
+    detail::StreamedOperand<U> b(b_path);
+    if (a.columns() != b.rows()) {
+        throw std::invalid_argument("The Matrix product cannot be computed due to incompatible Matrix Dimensions\n");
+    }
+    const size_t m = a.rows(), n = b.columns(), k = a.columns();
+
+    StreamingGemmReport report;
+    size_t mb, nb, kb;
+    detail::streaming_tile_sizes(m, n, k, options.memory_budget / sizeof(U), mb, nb, kb);
+    if (mb < std::min<size_t>(m, 16) || nb < std::min<size_t>(n, 16) || kb < std::min<size_t>(k, 16)) {
+        throw std::invalid_argument("\nA memory budget of " + std::to_string(options.memory_budget) +
+                                    " bytes is too small to stream this product\n");
+    }
+    report.tile_rows = mb;
+    report.tile_columns = nb;
+    report.tile_depth = kb;
+
+    // the C file is laid out in full before any block is written, so that blocks can be written in any order
+    {
+        std::ofstream header_file(c_path, std::ios::binary | std::ios::trunc);
+        const BinaryHeader header = detail::make_binary_header<U>(2, m, n, (ptrdiff_t)n, 1, false);
+        header_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!header_file) {
+            throw std::runtime_error("\nCannot open " + c_path + " for writing\n");
+        }
+    }
+    std::filesystem::resize_file(c_path, sizeof(BinaryHeader) + m * n * sizeof(U));
+    std::fstream c_file(c_path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!c_file) {
+        throw std::runtime_error("\nCannot open " + c_path + " for writing\n");
+    }
+    if (m == 0 || n == 0) return report;
+
+    using Buffer = std::vector<U, detail::AlignedAllocator<U>>;
+    Buffer a_tiles[2], b_tiles[2], c_blocks[2];
+    for (int s = 0; s < 2; ++s) {
+        a_tiles[s].resize(mb * kb);
+        b_tiles[s].resize(kb * nb);
+        c_blocks[s].resize(mb * nb);
+    }
+    report.buffer_bytes = (2 * mb * kb + 2 * kb * nb + 2 * mb * nb) * sizeof(U);
+
+    // one step per (block of C, tile of K); with k == 0 each block still gets one step, which zeroes it
+    const size_t row_blocks = (m + mb - 1) / mb;
+    const size_t col_blocks = (n + nb - 1) / nb;
+    const size_t depth_steps = k == 0 ? 1 : (k + kb - 1) / kb;
+    const size_t steps = row_blocks * col_blocks * depth_steps;
+    struct Tiles { ptrdiff_t a_rs, a_cs, b_rs, b_cs; size_t bytes; };
+
+    auto load = [&](size_t step) {
+        const size_t block = step / depth_steps;
+        const size_t i0 = (block / col_blocks) * mb, j0 = (block % col_blocks) * nb, p0 = (step % depth_steps) * kb;
+        const size_t rows = std::min(mb, m - i0), cols = std::min(nb, n - j0), depth = std::min(kb, k - p0);
+        Tiles tiles{};
+        tiles.bytes = a.read_tile(i0, p0, rows, depth, a_tiles[step % 2].data(), tiles.a_rs, tiles.a_cs);
+        tiles.bytes += b.read_tile(p0, j0, depth, cols, b_tiles[step % 2].data(), tiles.b_rs, tiles.b_cs);
+        return tiles;
+    };
+    auto store = [&](size_t block, const U* data) {
+        const size_t i0 = (block / col_blocks) * mb, j0 = (block % col_blocks) * nb;
+        const size_t rows = std::min(mb, m - i0), cols = std::min(nb, n - j0);
+        const auto write = [&](size_t element, size_t count, const U* from) {
+            c_file.seekp((std::streamoff)(sizeof(BinaryHeader) + element * sizeof(U)), std::ios::beg);
+            c_file.write(reinterpret_cast<const char*>(from), (std::streamsize)(count * sizeof(U)));
+        };
+        if (cols == n) {  // if: the block covers whole rows, it is one run in the file
+            write(i0 * n, rows * n, data);
+        } else {
+            for (size_t i = 0; i < rows; ++i) write((i0 + i) * n + j0, cols, data + i * cols);
+        }
+        if (!c_file.flush()) {
+            throw std::runtime_error("\nCannot write " + c_path + "\n");
+        }
+        return rows * cols * sizeof(U);
+    };
+    auto wait = [&](auto& future) {
+        const auto start = clock::now();
+        auto result = future.get();
+        report.io_wait_seconds += std::chrono::duration<double>(clock::now() - start).count();
+        return result;
+    };
+
+    std::future<Tiles> pending_read = std::async(std::launch::async, load, 0);
+    std::future<size_t> pending_write;
+    for (size_t step = 0; step < steps; ++step) {
+        const Tiles tiles = wait(pending_read);
+        report.bytes_read += tiles.bytes;
+        if (step + 1 < steps) pending_read = std::async(std::launch::async, load, step + 1);
+
+        const size_t block = step / depth_steps;
+        const size_t depth_step = step % depth_steps;
+        const size_t i0 = (block / col_blocks) * mb, j0 = (block % col_blocks) * nb, p0 = depth_step * kb;
+        const size_t rows = std::min(mb, m - i0), cols = std::min(nb, n - j0), depth = std::min(kb, k - p0);
+        U* c_block = c_blocks[block % 2].data();
+        gemm<U>(rows, cols, depth, U(1), a_tiles[step % 2].data(), tiles.a_rs, tiles.a_cs, b_tiles[step % 2].data(),
+                tiles.b_rs, tiles.b_cs, depth_step == 0 ? U(0) : U(1), c_block, (ptrdiff_t)cols, 1);
+
+        if (depth_step + 1 == depth_steps) {  // if: the block is finished, write it while the next one is computed
+            if (pending_write.valid()) report.bytes_written += wait(pending_write);  // frees the other C buffer
+            pending_write = std::async(std::launch::async, store, block, c_block);
+        }
+    }
+    if (pending_write.valid()) report.bytes_written += wait(pending_write);
+    return report;
+}
+
+
+#endif //COMPUTER_BRAIN_STREAMING_H
@@ -0,0 +1,48 @@
+#ifndef COMPUTER_BRAIN_TEST_H
+#define COMPUTER_BRAIN_TEST_H
+
+#include <cstdio>
+#include <functional>
+#include <string>
+
+/*
+ * The checks shared by the behaviour tests (test_*.cpp).
+ *
+ * Each test is one program with its own main(). A failed check prints what was expected and the program goes on, so
+ * that one run reports every failure; tests_passed() then gives the exit status, 1 if any check failed. Build and run
+ * any of them the same way, for example:
+ *     g++ -std=c++20 -O2 -pthread test_sparse.cpp -o test_sparse
+ *     ./test_sparse
+ */
+
+/// The number of checks that have failed so far.
+inline int test_failures = 0;
+
+/// Prints what and counts a failure unless condition holds.
+inline void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::printf("FAIL: %s\n", what.c_str());
+        ++test_failures;
+    }
+}
+
+/// The message of the exception of type E that f throws, or "" if it throws none.
+template<typename E>
+std::string error_of(const std::function<void()>& f) {
+    try {
+        f();
+    } catch (const E& error) {
+        return error.what();
+    }
+    return "";
+}
+
+inline bool contains(const std::string& text, const std::string& part) { return text.find(part) != std::string::npos; }
+
+/// Prints a summary line if every check passed, and returns the exit status of the test.
+inline int tests_passed(const char* name) {
+    if (test_failures == 0) std::printf("All %s tests passed\n", name);
+    return test_failures == 0 ? 0 : 1;
+}
+
+#endif //COMPUTER_BRAIN_TEST_H
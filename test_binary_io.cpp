@@ -0,0 +1,174 @@
+/*
+ * Behaviour tests for the binary format of binary_io.h.
+ *
+ * Checks that Matrices (packed, padded, transposed), views and Vectors come back from load_matrix(), load_vector()
+ * and MappedMatrix exactly as they were saved, and that files with a corrupt header are rejected with an exception
+ * before anything is allocated or read: a Vector of several rows, strides that overlap or are zero, shapes whose size
+ * overflows, a Vector too long for its int size, a truncated file, another format, type or rank. Worth running under
+ * -fsanitize=address, which turns a header that slips through into a reported overflow.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "linear_algebra.h"
+#include "test.h"
+
+static const std::string path = (std::filesystem::temp_directory_path() /
+                                 ("computer_brain_test_binary_io_" + std::to_string(std::random_device()()) +
+                                  ".bin")).string();
+
+template<typename U>
+static Matrix<U> numbered(size_t rows, size_t columns, MatrixLayout layout = MatrixLayout::packed) {
+    Matrix<U> m(rows, columns, layout);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < columns; ++j) m.view()(i, j) = U(i * columns + j + 1);
+    }
+    return m;
+}
+
+template<typename U, typename W>
+static bool same(const MatrixView<U>& a, const MatrixView<W>& b) {
+    if (a.rows() != b.rows() || a.columns() != b.columns()) return false;
+    for (size_t i = 0; i < a.rows(); ++i) {
+        for (size_t j = 0; j < a.columns(); ++j) {
+            if (a(i, j) != b(i, j)) return false;
+        }
+    }
+    return true;
+}
+
+/// Overwrites the header field at offset (see the table at the top of binary_io.h) of the file at path.
+template<typename F>
+static void patch(size_t offset, F value) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp((std::streamoff)offset);
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void test_round_trips() {
+    const Matrix<float> packed = numbered<float>(5, 7);
+    save_binary(path, packed);
+    const Matrix<float> back = load_matrix<float>(path);
+    check(same(back.view(), packed.view()) && back.ld() == 7, "a packed Matrix comes back packed and unchanged");
+    const MappedMatrix<float> mapped(path);
+    check(same(mapped.view(), packed.view()), "a mapped Matrix shows the saved elements");
+
+    Matrix<double> padded = numbered<double>(9, 3, MatrixLayout::padded);
+    padded.is_transposed = true;
+    save_binary(path, padded);
+    const Matrix<double> padded_back = load_matrix<double>(path);
+    check(same(padded_back.view(), padded.view()) && padded_back.ld() == padded.ld() && padded_back.is_transposed,
+          "a padded, transposed Matrix comes back padded and transposed");
+    check(same(MappedMatrix<double>(path).view(), padded.view()), "a mapped transposed Matrix is seen transposed");
+
+    const Matrix<std::int16_t> large = numbered<std::int16_t>(20, 30);
+    const MatrixView<const std::int16_t> view = large.view().t().submatrix(3, 2, 11, 6);
+    save_binary(path, view);
+    check(same(load_matrix<std::int16_t>(path).view(), view), "a strided view is saved packed and read back");
+
+    Vector<double> column(std::vector<double>{1.5, -2, 1e300});
+    Vector<double> row = column;
+    row.is_transposed = true;
+    for (const Vector<double>* v : {&column, &row}) {
+        save_binary(path, *v);
+        const Vector<double> loaded = load_vector<double>(path);
+        bool equal = loaded.size() == v->size() && loaded.is_transposed == v->is_transposed;
+        for (size_t i = 0; equal && i < v->size(); ++i) equal = loaded[i] == (*v)[i];
+        check(equal, std::string(v->is_transposed ? "a row" : "a column") + " Vector comes back unchanged");
+    }
+    save_binary(path, Vector<float>(std::vector<float>{}));
+    check(load_vector<float>(path).size() == 0, "an empty Vector comes back empty");
+    save_binary(path, Matrix<float>(3, 0));
+    const Matrix<float> empty = load_matrix<float>(path);
+    check(empty.rows() == 3 && empty.columns() == 0, "a Matrix of 3 empty rows (row stride 0) comes back");
+
+    // a file written column by column (row stride 1, column stride rows) is not what save_binary() writes, but its
+    // strides do not overlap, so it is read (and gathered into a row-major Matrix)
+    save_binary(path, packed.view().t());  // 7 x 5, packed: read as the 5 x 7 column-major storage of packed
+    patch(24, std::uint64_t(5));
+    patch(32, std::uint64_t(7));
+    patch(40, std::int64_t(1));
+    patch(48, std::int64_t(5));
+    check(same(load_matrix<float>(path).view(), packed.view()) &&
+          same(MappedMatrix<float>(path).view(), packed.view()), "a column-major file is read");
+}
+
+/// Saves a 4 x 6 Matrix<float> (or a Vector of 6 floats), applies change to the file, and returns the message of the
+/// exception that loading it throws ("" if none).
+template<typename E, typename F>
+static std::string load_error(bool vector, F change) {
+    if (vector) {
+        save_binary(path, Vector<float>(6, 1.0f));
+    } else {
+        save_binary(path, numbered<float>(4, 6));
+    }
+    change();
+    if (vector) return error_of<E>([] { load_vector<float>(path); });
+    const std::string loaded = error_of<E>([] { load_matrix<float>(path); });
+    const std::string mapped = error_of<E>([] { MappedMatrix<float> m(path); });
+    return loaded == mapped ? loaded : "load_matrix: " + loaded + ", MappedMatrix: " + mapped;
+}
+
+static void test_corrupt_headers() {
+    using limits = std::numeric_limits<std::uint64_t>;
+    check(contains(load_error<std::runtime_error>(true, [] { patch(24, std::uint64_t(3)); }), "invalid header"),
+          "a Vector file of 3 rows is rejected");
+    check(contains(load_error<std::runtime_error>(false, [] {
+                       patch(24, std::uint64_t(1) << 33);
+                       patch(32, std::uint64_t(1) << 33);
+                       patch(40, std::int64_t(0));
+                       patch(48, std::int64_t(0));
+                   }), "too large"),
+          "a shape of 2^66 elements with zero strides is rejected");
+    check(contains(load_error<std::runtime_error>(false, [] { patch(32, limits::max()); }), "too large"),
+          "a shape whose size overflows is rejected");
+    check(contains(load_error<std::runtime_error>(false, [] { patch(40, std::int64_t(0)); }), "overlapping strides"),
+          "a zero row stride is rejected");
+    check(contains(load_error<std::runtime_error>(false, [] { patch(48, std::int64_t(0)); }), "overlapping strides"),
+          "a zero column stride is rejected");
+    check(contains(load_error<std::runtime_error>(false, [] { patch(40, std::int64_t(5)); }), "overlapping strides"),
+          "a row stride shorter than a row is rejected");
+    check(contains(load_error<std::runtime_error>(false, [] {
+                       patch(40, std::int64_t(2));
+                       patch(48, std::int64_t(3));
+                   }), "overlapping strides"),
+          "interleaved strides are rejected");
+    check(contains(load_error<std::runtime_error>(false, [] { patch(40, std::int64_t(-6)); }), "invalid header"),
+          "a negative stride is rejected");
+    check(contains(load_error<std::runtime_error>(true, [] {
+                       patch(32, std::uint64_t(1) << 31);
+                       patch(40, std::int64_t(1) << 31);
+                   }), "too large"),
+          "a Vector of 2^31 elements, more than its int size holds, is rejected");
+    check(contains(load_error<std::runtime_error>(false, [] { patch(24, std::uint64_t(5)); }), "truncated"),
+          "a header describing more rows than the file holds is rejected");
+    check(contains(load_error<std::runtime_error>(false, [] {
+                       std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+                   }), "truncated"),
+          "a file missing its last byte is rejected");
+    check(contains(load_error<std::runtime_error>(false, [] { patch(0, 'X'); }), "not a computer_brain binary file"),
+          "a file without the magic is rejected");
+    check(contains(load_error<std::runtime_error>(false, [] { patch(8, std::uint32_t(99)); }), "format version 99"),
+          "a file of a newer format version is rejected");
+
+    save_binary(path, numbered<float>(4, 6));
+    check(contains(error_of<std::invalid_argument>([] { load_matrix<double>(path); }), "not of the requested type"),
+          "a float file read as double is rejected");
+    check(contains(error_of<std::invalid_argument>([] { load_vector<float>(path); }), "not of rank 1"),
+          "a Matrix file read as a Vector is rejected");
+}
+
+int main() {
+    test_round_trips();
+    test_corrupt_headers();
+    std::filesystem::remove(path);
+    return tests_passed("binary I/O");
+}
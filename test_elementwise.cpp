@@ -0,0 +1,167 @@
+/*
+ * Behaviour tests for the elementwise functions of elementwise.h.
+ *
+ * Checks the error bounds of the table at the top of elementwise.h, measured against a long double reference in units
+ * in the last place, for float and double and on every instruction set this CPU supports (forced with
+ * force_simd_isa()), and the special values the header promises: those of the C library. The largest error of every
+ * function is printed for each type, instruction set and range of arguments.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "linear_algebra.h"
+#include "test.h"
+
+/// The distance from got to the exact result, in units in the last place of the result rounded to T.
+template<typename T>
+static long double ulp_error(T got, long double exact) {
+    if (std::isnan(exact)) return std::isnan(got) ? 0 : std::numeric_limits<long double>::infinity();
+    const T rounded = T(exact);
+    if (std::isinf(rounded)) return got == rounded ? 0 : std::numeric_limits<long double>::infinity();
+    const T magnitude = std::abs(rounded);
+    const long double ulp = magnitude == std::numeric_limits<T>::max() ?
+        (long double)magnitude - std::nextafter(magnitude, T(0)) :
+        (long double)std::nextafter(magnitude, std::numeric_limits<T>::infinity()) - magnitude;
+    return std::abs((long double)got - exact) / ulp;
+}
+
+/// Random positive finite numbers with uniformly distributed bits: every binade, subnormals included.
+template<typename T>
+static T random_positive(std::mt19937_64& generator) {
+    if constexpr (sizeof(T) == 4) {
+        return std::bit_cast<float>(std::uint32_t(generator()) % 0x7f800000u);
+    } else {
+        return std::bit_cast<double>(generator() % 0x7ff0000000000000ull);
+    }
+}
+
+/// One function under test: how to call it, its exact value, its bound, and where its arguments come from.
+template<typename T>
+struct Function {
+    const char* name;
+    Vector<T> (*apply)(const Vector<T>&);
+    long double (*exact)(long double);
+    double bound;
+    T low, high;         // arguments uniform in [low, high], or random_positive() if low == high
+    bool tiny = false;   // a quarter of the arguments uniform in [-1e-5, 1e-5] instead, where the function is linear
+};
+
+template<typename T>
+static std::vector<T> arguments(const Function<T>& f, size_t count) {
+    std::mt19937_64 generator(42);
+    std::vector<T> x(count);
+    std::uniform_real_distribution<double> uniform(f.low, f.high);
+    std::uniform_real_distribution<double> small(-1e-5, 1e-5);
+    for (size_t i = 0; i < count; ++i) {
+        if (f.low == f.high) {
+            x[i] = random_positive<T>(generator);
+        } else {
+            x[i] = T(f.tiny && i % 4 == 0 ? small(generator) : uniform(generator));
+        }
+    }
+    return x;
+}
+
+template<typename T>
+static void test_bounds(const char* type, size_t count) {
+    const bool is_float = sizeof(T) == 4;
+    const double exp_bound = is_float ? 1.1 : 1.2;
+    const Function<T> functions[] = {
+        {"exp", [](const Vector<T>& v) { return Vector<T>(exp(v)); }, [](long double x) { return std::exp(x); },
+         exp_bound, T(is_float ? -104 : -746), T(is_float ? 89 : 710)},
+        {"exp", [](const Vector<T>& v) { return Vector<T>(exp(v)); }, [](long double x) { return std::exp(x); },
+         exp_bound, T(-2), T(2)},
+        {"log", [](const Vector<T>& v) { return Vector<T>(log(v)); }, [](long double x) { return std::log(x); },
+         0.9, T(0), T(0)},
+        {"log", [](const Vector<T>& v) { return Vector<T>(log(v)); }, [](long double x) { return std::log(x); },
+         0.9, T(0.5), T(2)},
+        {"sqrt", [](const Vector<T>& v) { return Vector<T>(sqrt(v)); }, [](long double x) { return std::sqrt(x); },
+         0.5, T(0), T(0)},
+        {"abs", [](const Vector<T>& v) { return Vector<T>(abs(v)); }, [](long double x) { return std::abs(x); },
+         0, T(-1e30), T(1e30)},
+        {"tanh", [](const Vector<T>& v) { return Vector<T>(tanh(v)); }, [](long double x) { return std::tanh(x); },
+         1.4, T(-20), T(20), true},
+        {"tanh", [](const Vector<T>& v) { return Vector<T>(tanh(v)); }, [](long double x) { return std::tanh(x); },
+         1.4, T(-1), T(1), true},
+        {"sigmoid", [](const Vector<T>& v) { return Vector<T>(sigmoid(v)); },
+         [](long double x) { return 1 / (1 + std::exp(-x)); }, 2.4, T(is_float ? -100 : -740), T(is_float ? 100 : 740)},
+        {"sigmoid", [](const Vector<T>& v) { return Vector<T>(sigmoid(v)); },
+         [](long double x) { return 1 / (1 + std::exp(-x)); }, 2.4, T(-5), T(5)},
+    };
+    for (int isa = 0; isa <= int(detected_simd_isa()); ++isa) {
+        force_simd_isa(SimdIsa(isa));
+        for (const Function<T>& f : functions) {
+            const std::vector<T> x = arguments(f, count);
+            const Vector<T> y = f.apply(Vector<T>(x));
+            long double worst = 0;
+            T worst_at = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const long double error = ulp_error(y[i], f.exact((long double)x[i]));
+                if (error > worst) {
+                    worst = error;
+                    worst_at = x[i];
+                }
+            }
+            char range[64] = "all positive";
+            if (f.low != f.high) std::snprintf(range, sizeof(range), "[%g, %g]", double(f.low), double(f.high));
+            std::printf("%-8s %-7s %-7s %-16s %.3Lf ulp\n", f.name, type, simd_isa_name(SimdIsa(isa)), range, worst);
+            check(worst <= f.bound, std::string(f.name) + " on " + type + " with " + simd_isa_name(SimdIsa(isa)) +
+                                    ": " + std::to_string(double(worst)) + " ulp at " + std::to_string(worst_at) +
+                                    ", more than " + std::to_string(f.bound));
+        }
+    }
+    reset_simd_isa();
+}
+
+/// f(x) must be the C library's value: the same, both NaN, or (finite) within 2 ulp of it.
+template<typename T>
+static bool same_special(T got, T expected) {
+    if (std::isnan(expected)) return std::isnan(got);
+    if (!std::isfinite(expected) || expected == 0) {
+        return got == expected && std::signbit(got) == std::signbit(expected);
+    }
+    return std::abs(got - expected) <= 2 * std::numeric_limits<T>::epsilon() * std::abs(expected);
+}
+
+template<typename T>
+static void test_special_values(const char* type) {
+    using limits = std::numeric_limits<T>;
+    const std::vector<T> values = {T(0), -T(0), limits::infinity(), -limits::infinity(), limits::quiet_NaN(),
+                                   -limits::quiet_NaN(), T(-1), T(1), T(1000), T(-1000), limits::max(),
+                                   limits::lowest(), limits::min(), limits::denorm_min(), -limits::denorm_min()};
+    std::vector<T> x(67);  // longer than one register of every instruction set, with a tail
+    for (size_t i = 0; i < x.size(); ++i) x[i] = values[i % values.size()];
+    for (int isa = 0; isa <= int(detected_simd_isa()); ++isa) {
+        force_simd_isa(SimdIsa(isa));
+        const Vector<T> v(x);
+        const Vector<T> e = exp(v), l = log(v), s = sqrt(v), a = abs(v), t = tanh(v), g = sigmoid(v);
+        for (size_t i = 0; i < x.size(); ++i) {
+            const std::string at = std::string(type) + " with " + simd_isa_name(SimdIsa(isa)) + " at " +
+                                   std::to_string(x[i]);
+            check(same_special(e[i], std::exp(x[i])), "exp " + at);
+            check(same_special(l[i], std::log(x[i])), "log " + at);
+            check(same_special(s[i], std::sqrt(x[i])), "sqrt " + at);
+            check(same_special(a[i], std::abs(x[i])), "abs " + at);
+            check(same_special(t[i], std::tanh(x[i])), "tanh " + at);
+            check(same_special(g[i], T(1) / (T(1) + std::exp(-x[i]))), "sigmoid " + at);
+        }
+    }
+    reset_simd_isa();
+}
+
+int main() {
+    test_bounds<float>("float", 300000);
+    test_bounds<double>("double", 300000);
+    test_special_values<float>("float");
+    test_special_values<double>("double");
+
+    return tests_passed("elementwise");
+}
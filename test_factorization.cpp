@@ -0,0 +1,107 @@
+/*
+ * Behaviour tests for the Cholesky factorization of factorization.h.
+ *
+ * Checks that cholesky_factor() leaves the strictly upper triangle of its argument exactly as it was, on sizes around
+ * the block sizes of the blocked algorithm and on a view into a larger Matrix, that L * L^T reproduces A, that
+ * cholesky_solve() solves the system, and that a matrix that is not positive definite is rejected.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "linear_algebra.h"
+#include "test.h"
+
+/// A random symmetric positive definite n x n Matrix: B * B^T + n * I.
+template<typename U>
+static Matrix<U> random_spd(size_t n, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::normal_distribution<U> normal;
+    Matrix<U> b(n, n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) b.view()(i, j) = normal(generator);
+    }
+    Matrix<U> a = b * b.view().t();
+    for (size_t i = 0; i < n; ++i) a.view()(i, i) += U(n);
+    return a;
+}
+
+/// Factors the n x n SPD matrix held at (offset, offset) of a larger Matrix whose other elements are a marker.
+template<typename U>
+static void test_cholesky_factor(size_t n, size_t offset, U tolerance) {
+    const std::string name = "cholesky_factor, n = " + std::to_string(n) + ", offset = " + std::to_string(offset);
+    const U marker = U(12345.5);
+    const Matrix<U> a = random_spd<U>(n, unsigned(n));
+    Matrix<U> storage(n + 2 * offset, n + 2 * offset);
+    for (size_t i = 0; i < storage.rows(); ++i) {
+        for (size_t j = 0; j < storage.columns(); ++j) storage.view()(i, j) = marker;
+    }
+    const MatrixView<U> f = storage.view().submatrix(offset, offset, n, n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j <= i; ++j) f(i, j) = a.view()(i, j);  // only the lower triangle is given
+    }
+
+    cholesky_factor<U>(f);
+
+    size_t changed = 0;
+    for (size_t i = 0; i < storage.rows(); ++i) {
+        for (size_t j = 0; j < storage.columns(); ++j) {
+            const bool lower = i >= offset && i < offset + n && j >= offset && j <= i;
+            if (!lower && storage.view()(i, j) != marker) ++changed;
+        }
+    }
+    check(changed == 0, name + ": " + std::to_string(changed) + " elements outside the lower triangle changed");
+
+    U error = 0;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j <= i; ++j) {
+            U sum = 0;
+            for (size_t k = 0; k <= j; ++k) sum += f(i, k) * f(j, k);
+            error = std::max(error, std::abs(sum - a.view()(i, j)) / U(n));
+        }
+    }
+    check(error <= tolerance, name + ": L * L^T differs from A by " + std::to_string(error));
+}
+
+template<typename U>
+static void test_cholesky_solve(size_t n, U tolerance) {
+    const Matrix<U> a = random_spd<U>(n, 7);
+    std::vector<U> x(n), b(n);
+    for (size_t i = 0; i < n; ++i) x[i] = U(1) + U(i % 5);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) b[i] += a.view()(i, j) * x[j];
+    }
+    const Vector<U> solution = cholesky(a).solve(Vector<U>(b));
+    U error = 0;
+    for (size_t i = 0; i < n; ++i) error = std::max(error, std::abs(solution[i] - x[i]));
+    check(error <= tolerance, "cholesky().solve(), n = " + std::to_string(n) + ": error " + std::to_string(error));
+}
+
+static void test_not_positive_definite() {
+    Matrix<double> a(3, 3);
+    a.view()(0, 0) = 1;
+    a.view()(1, 0) = 2;
+    a.view()(1, 1) = 1;  // the leading minor of order 2 is 1 - 4 < 0
+    a.view()(2, 2) = 1;
+    check(contains(error_of<std::runtime_error>([&] { cholesky_factor<double>(a.view()); }), "not positive definite"),
+          "cholesky_factor of an indefinite Matrix throws std::runtime_error");
+}
+
+int main() {
+    // around factorization_block and the 256 rows of a trailing update block
+    for (size_t n : {1, 2, 5, 63, 64, 65, 128, 129, 255, 257, 300, 600}) {
+        test_cholesky_factor<double>(n, 0, 1e-12);
+    }
+    test_cholesky_factor<double>(130, 3, 1e-12);
+    test_cholesky_factor<float>(200, 0, 1e-4f);
+    test_cholesky_factor<float>(77, 5, 1e-4f);
+    test_cholesky_solve<double>(150, 1e-10);
+    test_cholesky_solve<float>(40, 1e-3f);
+    test_not_positive_definite();
+
+    return tests_passed("factorization");
+}
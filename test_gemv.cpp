@@ -0,0 +1,119 @@
+/*
+ * Behaviour tests for the matrix-vector product: gemv() and the Matrix-Vector operators of linear_algebra.h.
+ *
+ * Checks the orientations the operators take and give, the library's own: a Vector that is not transposed is a
+ * column vector, so A * x takes and returns column Vectors and x * A row Vectors, and the other orientations are
+ * rejected. Also checks the values against plain loops for a Matrix with the is_transposed flag set, for shapes around
+ * the blocks of the kernels, for both float and double, and for gemv() on strided views with alpha and beta. Elements
+ * are small integers, so every sum is exact whatever the kernels add first.
+ */
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "linear_algebra.h"
+#include "test.h"
+
+template<typename U>
+static Matrix<U> random_integers(size_t rows, size_t columns, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> value(-5, 5);
+    Matrix<U> m(rows, columns);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < columns; ++j) m.view()(i, j) = U(value(generator));
+    }
+    return m;
+}
+
+template<typename U>
+static Vector<U> random_vector(size_t size, bool transposed, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> value(-5, 5);
+    std::vector<U> elements(size);
+    for (U& element : elements) element = U(value(generator));
+    Vector<U> v(elements);
+    v.is_transposed = transposed;
+    return v;
+}
+
+/// Element i of A * x (column) with A seen through its is_transposed flag, by a plain loop.
+template<typename U>
+static U row_times(const MatrixView<const U>& a, const Vector<U>& x, size_t i) {
+    U sum = 0;
+    for (size_t j = 0; j < a.columns(); ++j) sum += a(i, j) * x[j];
+    return sum;
+}
+
+template<typename U>
+static void test_products(size_t rows, size_t columns, bool transposed_matrix) {
+    const std::string name = std::to_string(rows) + "x" + std::to_string(columns) +
+                             (transposed_matrix ? " transposed" : "") + (sizeof(U) == 4 ? " float" : " double");
+    Matrix<U> a = random_integers<U>(transposed_matrix ? columns : rows, transposed_matrix ? rows : columns, 1);
+    a.is_transposed = transposed_matrix;
+    const MatrixView<const U> seen = a.view();  // rows x columns in either case
+
+    const Vector<U> column = random_vector<U>(columns, false, 2);
+    const Vector<U> ax = a * column;
+    bool equal = ax.size() == rows && !ax.is_transposed;
+    for (size_t i = 0; equal && i < rows; ++i) equal = ax[i] == row_times(seen, column, i);
+    check(equal, name + ": A * (column Vector) is the column Vector of the products of the rows");
+
+    const Vector<U> row = random_vector<U>(rows, true, 3);
+    const Vector<U> xa = row * a;
+    equal = xa.size() == columns && xa.is_transposed;
+    for (size_t j = 0; equal && j < columns; ++j) {
+        U sum = 0;
+        for (size_t i = 0; i < rows; ++i) sum += row[i] * seen(i, j);
+        equal = xa[j] == sum;
+    }
+    check(equal, name + ": (row Vector) * A is the row Vector of the products of the columns");
+}
+
+static void test_orientation_errors() {
+    const Matrix<double> a = random_integers<double>(3, 4, 4);
+    const Vector<double> row_of_4 = random_vector<double>(4, true, 5);
+    const Vector<double> column_of_3 = random_vector<double>(3, false, 6);
+    check(contains(error_of<std::invalid_argument>([&] { a * row_of_4; }), "column vector"),
+          "A * (row Vector) is rejected");
+    check(contains(error_of<std::invalid_argument>([&] { column_of_3 * a; }), "row vector"),
+          "(column Vector) * A is rejected");
+    check(!error_of<std::invalid_argument>([&] { a * column_of_3; }).empty(),
+          "A * x with x as long as A has rows, not columns, is rejected");
+    Matrix<double> a_t = random_integers<double>(4, 3, 8);
+    a_t.is_transposed = true;  // seen as 3 x 4
+    check(error_of<std::invalid_argument>([&] { a_t * random_vector<double>(4, false, 9); }).empty(),
+          "a transposed Matrix takes a column Vector as long as its columns as seen");
+}
+
+/// gemv() on a strided view of A, with x and y strided columns of other matrices.
+static void test_gemv_views() {
+    const Matrix<double> storage = random_integers<double>(70, 90, 10);
+    const MatrixView<const double> a = storage.view().t().submatrix(5, 3, 60, 41);  // 60 x 41, column stride 90
+    const Matrix<double> x_storage = random_integers<double>(41, 3, 11);
+    Matrix<double> y_storage = random_integers<double>(60, 2, 12);
+    const Matrix<double> y_before = y_storage;
+    gemv<double>(2.0, a, x_storage.view().col(1), -1.0, y_storage.view().col(0));
+    bool equal = true;
+    for (size_t i = 0; i < 60; ++i) {
+        double sum = 0;
+        for (size_t j = 0; j < 41; ++j) sum += a(i, j) * x_storage.view()(j, 1);
+        equal = equal && y_storage.view()(i, 0) == 2 * sum - y_before.view()(i, 0) &&
+                y_storage.view()(i, 1) == y_before.view()(i, 1);
+    }
+    check(equal, "gemv() on strided views computes alpha * A * x + beta * y and writes only y");
+}
+
+int main() {
+    for (bool transposed : {false, true}) {
+        for (const auto& [rows, columns] : {std::pair<size_t, size_t>{1, 1}, {3, 7}, {64, 64}, {513, 130},
+                                            {130, 1100}}) {
+            test_products<float>(rows, columns, transposed);
+            test_products<double>(rows, columns, transposed);
+        }
+    }
+    test_orientation_errors();
+    test_gemv_views();
+    return tests_passed("matrix-vector");
+}
@@ -0,0 +1,207 @@
+/*
+ * Behaviour tests for the lazy evaluation of graph.h.
+ *
+ * Checks that Graph::evaluate() gives what evaluating the same operations one at a time gives: for a two-layer network,
+ * for long fused elementwise chains (with transposed operands and rows broadcast by add_row()), for repeated
+ * subexpressions, which must be merged into one node, and for graphs where a result is still read after its last
+ * elementwise use, where the shared buffers and the in-place updates must not overwrite a value that is still needed.
+ * Also checks that evaluating again after the inputs changed in place gives the new result.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "linear_algebra.h"
+#include "test.h"
+
+static Matrix<double> random_matrix(size_t rows, size_t columns, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> uniform(-1, 1);
+    Matrix<double> m(rows, columns);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < columns; ++j) m.view()(i, j) = uniform(generator);
+    }
+    return m;
+}
+
+/* The eager reference: one plain loop per operation, on views in their current orientation. */
+
+static Matrix<double> product(const MatrixView<const double>& a, const MatrixView<const double>& b) {
+    Matrix<double> c(a.rows(), b.columns());
+    for (size_t i = 0; i < a.rows(); ++i) {
+        for (size_t j = 0; j < b.columns(); ++j) {
+            double sum = 0;
+            for (size_t p = 0; p < a.columns(); ++p) sum += a(i, p) * b(p, j);
+            c.view()(i, j) = sum;
+        }
+    }
+    return c;
+}
+
+/// f(a(i, j), b(i or 0, j)) for every element: b may have one row, which is then added to every row.
+template<typename F>
+static Matrix<double> elementwise(const MatrixView<const double>& a, const MatrixView<const double>& b, F f) {
+    Matrix<double> c(a.rows(), a.columns());
+    for (size_t i = 0; i < a.rows(); ++i) {
+        for (size_t j = 0; j < a.columns(); ++j) c.view()(i, j) = f(a(i, j), b(b.rows() == 1 ? 0 : i, j));
+    }
+    return c;
+}
+
+template<typename F>
+static Matrix<double> elementwise(const MatrixView<const double>& a, F f) {
+    return elementwise(a, a, [&](double x, double) { return f(x); });
+}
+
+static Matrix<double> row_softmax(const MatrixView<const double>& a) {
+    Matrix<double> c(a.rows(), a.columns());
+    for (size_t i = 0; i < a.rows(); ++i) {
+        double largest = a(i, 0), sum = 0;
+        for (size_t j = 0; j < a.columns(); ++j) largest = std::max(largest, a(i, j));
+        for (size_t j = 0; j < a.columns(); ++j) sum += std::exp(a(i, j) - largest);
+        for (size_t j = 0; j < a.columns(); ++j) c.view()(i, j) = std::exp(a(i, j) - largest) / sum;
+    }
+    return c;
+}
+
+/// The largest difference relative to the magnitude of the element (or to 1 for elements below 1).
+static double difference(const MatrixView<const double>& a, const MatrixView<const double>& b) {
+    if (a.rows() != b.rows() || a.columns() != b.columns()) return INFINITY;
+    double worst = 0;
+    for (size_t i = 0; i < a.rows(); ++i) {
+        for (size_t j = 0; j < a.columns(); ++j) {
+            worst = std::max(worst, std::abs(a(i, j) - b(i, j)) / std::max(1.0, std::abs(b(i, j))));
+        }
+    }
+    return worst;
+}
+
+static void check_close(const MatrixView<const double>& lazy, const MatrixView<const double>& eager,
+                        const std::string& what) {
+    const double error = difference(lazy, eager);
+    check(error <= 1e-13, what + ": the graph differs from the step by step result by " + std::to_string(error));
+}
+
+static void test_network() {
+    const Matrix<double> x = random_matrix(300, 70, 1), w1 = random_matrix(70, 90, 2), b1 = random_matrix(1, 90, 3);
+    const Matrix<double> w2 = random_matrix(90, 20, 4), b2 = random_matrix(1, 20, 5);
+    Graph<double> graph;
+    const LazyMatrix<double> h = tanh(add_row(graph.input(x) * graph.input(w1), graph.input(b1)));
+    const LazyMatrix<double> y = softmax(add_row(h * graph.input(w2), graph.input(b2)));
+    const Matrix<double> lazy = graph.evaluate(y);
+
+    const Matrix<double> h_eager = elementwise(
+            elementwise(product(x.view(), w1.view()).view(), b1.view(), [](double a, double b) { return a + b; })
+                    .view(),
+            [](double a) { return std::tanh(a); });
+    const Matrix<double> eager = row_softmax(
+            elementwise(product(h_eager.view(), w2.view()).view(), b2.view(), [](double a, double b) { return a + b; })
+                    .view());
+    check_close(lazy.view(), eager.view(), "two-layer network");
+    check(graph.stats().fused == 1, "the add_row() of the first layer is fused into its tanh()");
+}
+
+static void test_fused_chain() {
+    const Matrix<double> a = random_matrix(257, 129, 6), b = random_matrix(129, 257, 7), c = random_matrix(1, 129, 8);
+    Graph<double> graph;
+    const LazyMatrix<double> la = graph.input(a), lb = graph.input(b), lc = graph.input(c);
+    // a chain of nine elementwise operations over three inputs, one of them transposed and one broadcast
+    const LazyMatrix<double> chain = sigmoid(
+            exp(abs(add_row(la - lb.t(), lc) * 0.5) / 3.0) + sqrt(abs(la)) - tanh(lb.t()));
+    const Matrix<double> lazy = graph.evaluate(chain);
+
+    const MatrixView<const double> bt = b.view().t();
+    Matrix<double> eager(a.rows(), a.columns());
+    for (size_t i = 0; i < a.rows(); ++i) {
+        for (size_t j = 0; j < a.columns(); ++j) {
+            const double u = std::exp(std::abs((a.view()(i, j) - bt(i, j) + c.view()(0, j)) * 0.5) / 3.0) +
+                             std::sqrt(std::abs(a.view()(i, j))) - std::tanh(bt(i, j));
+            eager.view()(i, j) = 1 / (1 + std::exp(-u));
+        }
+    }
+    check_close(lazy.view(), eager.view(), "fused elementwise chain");
+    check(graph.stats().stored == 1 && graph.stats().buffers == 0,
+          "a chain of elementwise operations stores only its output (stored " +
+          std::to_string(graph.stats().stored) + ", buffers " + std::to_string(graph.stats().buffers) + ")");
+
+    const Matrix<double> transposed = graph.evaluate(chain.t());
+    check_close(transposed.view(), eager.view().t(), "a transposed output");
+}
+
+static void test_common_subexpressions() {
+    const Matrix<double> x = random_matrix(40, 30, 9), w = random_matrix(30, 40, 10);
+    Graph<double> graph;
+    const LazyMatrix<double> lx = graph.input(x), lw = graph.input(w);
+    const LazyMatrix<double> p1 = lx * lw, p2 = lx * lw;
+    check(p1.node() == p2.node(), "x * w asked for twice is one node");
+    const LazyMatrix<double> s1 = p1 + p1.t(), s2 = p2.t() + p2;
+    check(s1.node() == s2.node(), "a + b and b + a are one node");
+    const size_t nodes = graph.size();
+    const LazyMatrix<double> e1 = exp(s1 * 0.25), e2 = exp(s2 * 0.25);
+    check(e1.node() == e2.node() && graph.size() == nodes + 2, "a repeated chain adds its nodes once");
+    check(exp(s1 * 0.5).node() != e1.node(), "a different scalar is a different node");
+
+    const std::vector<Matrix<double>> lazy = graph.evaluate({e1 - e2 * 2.0, e1, e2});
+    check(graph.stats().merged == 4, "p2, s2 and the two nodes of e2 are merged, not " +
+                                     std::to_string(graph.stats().merged));
+
+    const Matrix<double> p = product(x.view(), w.view());
+    const Matrix<double> s = elementwise(p.view(), p.view().t(), [](double a, double b) { return a + b; });
+    const Matrix<double> e = elementwise(s.view(), [](double a) { return std::exp(a * 0.25); });
+    check_close(lazy[0].view(), elementwise(e.view(), [](double a) { return a - a * 2; }).view(), "e1 - 2 * e2");
+    check_close(lazy[1].view(), e.view(), "e1, an output also read by another output");
+    check_close(lazy[2].view(), e.view(), "e2, the same node as e1, asked for again");
+}
+
+/// Results read again after their last elementwise use, by nodes of later levels: their buffers must not be reused or
+/// written over in place too early.
+static void test_live_values() {
+    const Matrix<double> x = random_matrix(64, 64, 11), w = random_matrix(64, 64, 12);
+    Graph<double> graph;
+    const LazyMatrix<double> lx = graph.input(x), lw = graph.input(w);
+    const LazyMatrix<double> p = lx * lw;          // stored: read by a product and by the last add
+    const LazyMatrix<double> q = tanh(p);          // may be computed in place only if p is not read again: it is
+    const LazyMatrix<double> r = q * lw;           // a later level
+    const LazyMatrix<double> s = exp(r * 0.1);     // may take the buffer of q, which is dead by now, but not that of p
+    const LazyMatrix<double> t = softmax(s + p);   // p is read here, three levels after it was computed
+    const LazyMatrix<double> u = t * p.t();        // and here, transposed, after the softmax wrote over s + p
+    const std::vector<Matrix<double>> lazy = graph.evaluate({u, q});
+
+    const Matrix<double> p_eager = product(x.view(), w.view());
+    const Matrix<double> q_eager = elementwise(p_eager.view(), [](double a) { return std::tanh(a); });
+    const Matrix<double> r_eager = product(q_eager.view(), w.view());
+    const Matrix<double> s_eager = elementwise(r_eager.view(), [](double a) { return std::exp(a * 0.1); });
+    const Matrix<double> t_eager = row_softmax(
+            elementwise(s_eager.view(), p_eager.view(), [](double a, double b) { return a + b; }).view());
+    check_close(lazy[0].view(), product(t_eager.view(), p_eager.view().t()).view(),
+                "a value read three levels after it was computed");
+    check_close(lazy[1].view(), q_eager.view(), "an output read by later nodes");
+}
+
+static void test_evaluate_again() {
+    Matrix<double> x = random_matrix(50, 20, 13);
+    const Matrix<double> w = random_matrix(20, 30, 14);
+    Graph<double> graph;
+    const LazyMatrix<double> y = sigmoid(graph.input(x) * graph.input(w) * 2.0);
+    const auto eager = [&] {
+        return elementwise(product(x.view(), w.view()).view(), [](double a) { return 1 / (1 + std::exp(-2 * a)); });
+    };
+    check_close(graph.evaluate(y).view(), eager().view(), "first evaluation");
+    for (size_t i = 0; i < x.rows(); ++i) x.view()(i, 3) = 4.0;
+    check_close(graph.evaluate(y).view(), eager().view(), "evaluation after an input changed in place");
+    const LazyMatrix<double> z = exp(y) - y * 0.5;  // new nodes: the plan is made again
+    check_close(graph.evaluate(z).view(), elementwise(eager().view(), [](double a) { return std::exp(a) - a * 0.5; })
+                                                  .view(), "evaluation of new nodes");
+}
+
+int main() {
+    test_network();
+    test_fused_chain();
+    test_common_subexpressions();
+    test_live_values();
+    test_evaluate_again();
+    return tests_passed("graph");
+}
@@ -0,0 +1,136 @@
+/*
+ * Behaviour tests for the 8-bit quantization and the int8 GEMM of quantize.h.
+ *
+ * Checks that dequantize(quantize(x)) is within half a scale step of x for every axis, symmetric and asymmetric, and
+ * that gemm_int8() equals a plain int64 product exactly on every instruction set this CPU supports (forced with
+ * force_simd_isa(); AVX-512 runs the VNNI kernel when the CPU has it): on shapes with partial tiles and blocks, with
+ * the extreme values of int8_t and uint8_t, and with a k long enough that the sums of the VNNI kernel's shifted A no
+ * longer fit in int32 although the product does.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "linear_algebra.h"
+#include "test.h"
+
+static const char* axis_name(QuantAxis axis) {
+    return axis == QuantAxis::per_tensor ? "per tensor" : axis == QuantAxis::per_row ? "per row" : "per column";
+}
+
+template<typename Q>
+static void test_round_trip(QuantAxis axis, bool symmetric) {
+    const std::string name = std::string(std::is_signed_v<Q> ? "int8_t " : "uint8_t ") + axis_name(axis) +
+                             (symmetric ? ", symmetric" : ", asymmetric");
+    std::mt19937 generator(3);
+    std::normal_distribution<float> normal;
+    Matrix<float> x(45, 70);
+    for (size_t i = 0; i < x.rows(); ++i) {
+        for (size_t j = 0; j < x.columns(); ++j) {
+            // rows and columns of very different ranges, one row of zeros, and a row that is never negative
+            const float value = normal(generator) * float(1 + i % 5) * float(1 + j % 3) * (i % 9 == 4 ? 100 : 1);
+            x.view()(i, j) = i == 7 ? 0.0f : i == 8 ? std::abs(value) : value;
+        }
+    }
+    const QuantizedMatrix<Q> q = quantize<Q>(x, axis, symmetric);
+    const Matrix<float> back = dequantize(q);
+    double worst = 0;  // in scale steps
+    for (size_t i = 0; i < x.rows(); ++i) {
+        for (size_t j = 0; j < x.columns(); ++j) {
+            const float original = x.view()(i, j);
+            const float slack = 4 * std::numeric_limits<float>::epsilon() * std::abs(original);
+            worst = std::max(worst, double(std::max(0.0f, std::abs(back.view()(i, j) - original) - slack)) /
+                                    q.scale(i, j));
+        }
+    }
+    check(worst <= 0.5, name + ": dequantized elements are " + std::to_string(worst) + " scale steps off");
+    bool zeros = true;
+    for (size_t j = 0; j < x.columns(); ++j) zeros = zeros && back.view()(7, j) == 0.0f;
+    check(zeros, name + ": zero is represented exactly");
+}
+
+/// C = A * B in int64, the reference gemm_int8() must equal.
+template<typename QA>
+static std::vector<std::int64_t> reference_product(size_t m, size_t n, size_t k, const std::vector<QA>& a,
+                                                   const std::vector<std::int8_t>& b) {
+    std::vector<std::int64_t> c(m * n, 0);
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t p = 0; p < k; ++p) {
+            for (size_t j = 0; j < n; ++j) c[i * n + j] += std::int64_t(a[i * k + p]) * b[p * n + j];
+        }
+    }
+    return c;
+}
+
+/// Multiplies with every instruction set; fill(i, p) and fill_b(p, j) give the elements. lda and ldc are padded.
+template<typename QA, typename FA, typename FB>
+static void test_gemm_int8(size_t m, size_t n, size_t k, FA fill_a, FB fill_b) {
+    const std::string shape = std::string(std::is_signed_v<QA> ? "int8_t " : "uint8_t ") + std::to_string(m) + "x" +
+                              std::to_string(k) + " times " + std::to_string(k) + "x" + std::to_string(n);
+    std::vector<QA> a(m * k);
+    std::vector<std::int8_t> b(k * n);
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t p = 0; p < k; ++p) a[i * k + p] = fill_a(i, p);
+    }
+    for (size_t p = 0; p < k; ++p) {
+        for (size_t j = 0; j < n; ++j) b[p * n + j] = fill_b(p, j);
+    }
+    const std::vector<std::int64_t> expected = reference_product(m, n, k, a, b);
+    bool fits = true;
+    for (const std::int64_t value : expected) fits = fits && value == std::int32_t(value);
+    check(fits, shape + ": the test product must fit in int32");
+
+    for (int isa = 0; isa <= int(detected_simd_isa()); ++isa) {
+        force_simd_isa(SimdIsa(isa));
+        const std::string name = shape + " with " + simd_isa_name(SimdIsa(isa)) +
+                                 (SimdIsa(isa) == SimdIsa::avx512 && detail::cpu_has_avx512_vnni() ? " (VNNI)" : "");
+        const size_t ldc = n + 3;
+        std::vector<std::int32_t> c(m * ldc, -7);  // the padding must survive, the rest is overwritten
+        gemm_int8(m, n, k, a.data(), (ptrdiff_t)k, b.data(), (ptrdiff_t)n, c.data(), (ptrdiff_t)ldc);
+        size_t wrong = 0;
+        for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < ldc; ++j) wrong += c[i * ldc + j] != (j < n ? expected[i * n + j] : -7);
+        }
+        check(wrong == 0, name + ": " + std::to_string(wrong) + " elements differ from the int64 product");
+    }
+    reset_simd_isa();
+}
+
+template<typename QA>
+static void test_gemm_int8_shapes() {
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<int> byte(std::numeric_limits<QA>::min(), std::numeric_limits<QA>::max());
+    std::uniform_int_distribution<int> signed_byte(-128, 127);
+    const auto random_a = [&](size_t, size_t) { return QA(byte(generator)); };
+    const auto random_b = [&](size_t, size_t) { return std::int8_t(signed_byte(generator)); };
+    for (const auto& [m, n, k] : {std::tuple<size_t, size_t, size_t>{1, 1, 1}, {3, 5, 7}, {17, 33, 65},
+                                  {64, 64, 64}, {130, 70, 600}, {300, 50, 1030}}) {
+        test_gemm_int8<QA>(m, n, k, random_a, random_b);
+    }
+    // the extremes of both types everywhere: -128 * -128 or 255 * -128 summed 65536 times still fits in int32
+    const QA a_extreme = std::is_signed_v<QA> ? QA(-128) : QA(255);
+    test_gemm_int8<QA>(5, 19, 65536, [&](size_t, size_t) { return a_extreme; },
+                       [](size_t, size_t) { return std::int8_t(-128); });
+}
+
+int main() {
+    for (QuantAxis axis : {QuantAxis::per_tensor, QuantAxis::per_row, QuantAxis::per_column}) {
+        test_round_trip<std::int8_t>(axis, true);
+        test_round_trip<std::int8_t>(axis, false);
+        test_round_trip<std::uint8_t>(axis, false);
+        test_round_trip<std::uint8_t>(axis, true);
+    }
+    test_gemm_int8_shapes<std::int8_t>();
+    test_gemm_int8_shapes<std::uint8_t>();
+
+    // 127 * -128 summed 100000 times is -1.6e9, but VNNI adds (127 + 128) * -128 and reaches -3.3e9 before 128 times
+    // the column sums of B are taken back off: the shifted sums must wrap around and come back exactly
+    test_gemm_int8<std::int8_t>(3, 21, 100000, [](size_t, size_t) { return std::int8_t(127); },
+                                [](size_t, size_t) { return std::int8_t(-128); });
+    return tests_passed("quantization");
+}
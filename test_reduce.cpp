@@ -0,0 +1,139 @@
+/*
+ * Behaviour tests for the reductions of reduce.h.
+ *
+ * Checks the promise at the top of reduce.h: sum(), dot() and norm() give the same bits with 1, 2, 3 and 8 threads,
+ * and sum() and the compensated dot() the same bits on every instruction set this CPU supports, for lengths on either
+ * side of a block and for strided views. Also checks that the compensated sum is exact where the pairwise one is not,
+ * and that argmin() and argmax() return the first index of the extremum, skip NaN, and return 0 when every element is
+ * NaN.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "linear_algebra.h"
+#include "test.h"
+
+template<typename T>
+static bool same_bits(T a, T b) { return std::memcmp(&a, &b, sizeof(T)) == 0; }
+
+/// The results that must not change with the thread count or the instruction set, for one length.
+template<typename T>
+struct Results {
+    T sum, compensated_sum, dot, compensated_dot, norm, strided_sum;
+};
+
+template<typename T>
+static Results<T> reduce_all(const Vector<T>& x, const Vector<T>& y) {
+    const VectorView<const T> every_third(x.data(), x.size() / 3, 3, false);
+    return {sum(x), sum(x, Summation::compensated), dot(x, y), dot(x, y, Summation::compensated), norm(x),
+            sum(every_third)};
+}
+
+template<typename T>
+static void test_reproducibility(const char* type, size_t n) {
+    const std::string name = std::string(type) + ", n = " + std::to_string(n);
+    std::mt19937_64 generator(n);
+    std::uniform_real_distribution<T> uniform(-1, 1);
+    std::vector<T> xs(n), ys(n);
+    for (size_t i = 0; i < n; ++i) {
+        xs[i] = uniform(generator) * std::ldexp(T(1), int(i % 23) - 11);  // magnitudes that make the order matter
+        ys[i] = uniform(generator);
+    }
+    const Vector<T> x(xs), y(ys);
+
+    ThreadPool& pool = ThreadPool::global();
+    const size_t threads = pool.num_threads();
+    pool.resize(1);
+    const Results<T> serial = reduce_all(x, y);
+    for (size_t count : {2, 3, 8}) {
+        pool.resize(count);
+        const Results<T> parallel = reduce_all(x, y);
+        const std::string with = name + " with " + std::to_string(count) + " threads";
+        check(same_bits(parallel.sum, serial.sum) && same_bits(parallel.compensated_sum, serial.compensated_sum),
+              with + ": sum() differs from one thread");
+        check(same_bits(parallel.dot, serial.dot) && same_bits(parallel.compensated_dot, serial.compensated_dot),
+              with + ": dot() differs from one thread");
+        check(same_bits(parallel.norm, serial.norm) && same_bits(parallel.strided_sum, serial.strided_sum),
+              with + ": norm() or a strided sum() differs from one thread");
+    }
+    pool.resize(threads);
+
+    force_simd_isa(SimdIsa::scalar);
+    const Results<T> scalar = reduce_all(x, y);
+    for (int isa = 1; isa <= int(detected_simd_isa()); ++isa) {
+        force_simd_isa(SimdIsa(isa));
+        const Results<T> vector = reduce_all(x, y);
+        const std::string with = name + " with " + simd_isa_name(SimdIsa(isa));
+        check(same_bits(vector.sum, scalar.sum) && same_bits(vector.compensated_sum, scalar.compensated_sum) &&
+              same_bits(vector.strided_sum, scalar.strided_sum), with + ": sum() differs from the scalar code");
+        // the pairwise dot() and norm() may differ by the fused multiply-adds the compiler forms (see reduce.h)
+        check(same_bits(vector.compensated_dot, scalar.compensated_dot),
+              with + ": the compensated dot() differs from the scalar code");
+    }
+    reset_simd_isa();
+}
+
+static void test_compensated() {
+    // 1 followed by a million times 2^-53: a running or pairwise double sum loses much of the small terms, the
+    // compensated sum keeps them all
+    const size_t n = 1000001;
+    Vector<double> x((int)n, std::ldexp(1.0, -53));
+    x[0] = 1;
+    const double exact = 1 + double(n - 1) * std::ldexp(1.0, -53);
+    check(sum(x, Summation::compensated) == exact, "the compensated sum of 1 and 10^6 tiny terms is exact");
+}
+
+static void test_arg_extrema() {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    // ties: the first index wins, in the first block and across blocks
+    std::vector<double> values(3 * reduction_block + 17, 0.5);
+    values[100] = values[reduction_block + 5] = values[2 * reduction_block + 9] = -3;
+    values[7] = values[3 * reduction_block + 2] = 4;
+    const Vector<double> ties(values);
+    check(argmin(ties) == 100 && argmax(ties) == 7, "argmin() and argmax() return the first of equal extrema");
+    check(minimum(ties) == -3 && maximum(ties) == 4, "minimum() and maximum() return the extrema");
+
+    // NaN is skipped wherever it is: the first element, inside a block, a whole block
+    values.assign(2 * reduction_block + 3, 1.0);
+    values[0] = nan;
+    for (size_t i = reduction_block; i < 2 * reduction_block; ++i) values[i] = nan;
+    values[3] = nan;
+    values[2 * reduction_block + 1] = -2;
+    values[5] = 9;
+    const Vector<double> with_nan(values);
+    check(argmin(with_nan) == 2 * reduction_block + 1 && argmax(with_nan) == 5, "argmin() and argmax() skip NaN");
+    check(!std::isnan(minimum(with_nan)) && !std::isnan(maximum(with_nan)),
+          "minimum() and maximum() do not return NaN when a number exists");
+
+    const Vector<float> all_nan(40, std::numeric_limits<float>::quiet_NaN());
+    check(argmin(all_nan) == 0 && argmax(all_nan) == 0, "argmin() and argmax() of NaN only return 0");
+    const Vector<float> one(std::vector<float>{-0.0f});
+    check(argmin(one) == 0 && argmax(one) == 0, "argmin() and argmax() of one element return 0");
+
+    // integer elements, and infinities
+    const Vector<std::int32_t> integers(std::vector<std::int32_t>{5, -7, 3, -7, 12, 12});
+    check(argmin(integers) == 1 && argmax(integers) == 4, "argmin() and argmax() of integers");
+    const float infinity = std::numeric_limits<float>::infinity();
+    const Vector<float> infinite(std::vector<float>{1, -infinity, std::numeric_limits<float>::quiet_NaN(), infinity});
+    check(argmin(infinite) == 1 && argmax(infinite) == 3, "infinities are extrema like any number");
+
+    check(!error_of<std::invalid_argument>([] { argmin(Vector<double>(std::vector<double>{})); }).empty(),
+          "the argmin() of an empty Vector is rejected");
+}
+
+int main() {
+    for (size_t n : {size_t(1), size_t(31), size_t(1000), reduction_block - 1, reduction_block + 1,
+                     5 * reduction_block + 123, size_t(1) << 20}) {
+        test_reproducibility<float>("float", n);
+        test_reproducibility<double>("double", n);
+    }
+    test_compensated();
+    test_arg_extrema();
+    return tests_passed("reduction");
+}
@@ -0,0 +1,163 @@
+/*
+ * Behaviour tests for the compressed sparse matrices of sparse.h.
+ *
+ * Checks that a dense Matrix goes to CSR and CSC and back unchanged, that conversions between the layouts, t() and
+ * from_triplets() describe the same matrix, and that spmv(), spmm() and operator* give the dense product, serially and
+ * on the thread pool, with strided operands and with alpha and beta. Elements are small integers, so that every sum is
+ * exact whatever order the kernels add in and results can be compared with ==.
+ */
+
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "linear_algebra.h"
+#include "test.h"
+
+/// A rows x columns Matrix of integers in [-4, 4], a fraction density of them nonzero, with a few rows left empty.
+static Matrix<double> random_sparse(size_t rows, size_t columns, double density, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::uniform_int_distribution<int> value(1, 4);
+    Matrix<double> m(rows, columns);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < columns; ++j) {
+            const bool nonzero = i % 7 != 3 && uniform(generator) < density;
+            m.view()(i, j) = nonzero ? value(generator) * (uniform(generator) < 0.5 ? -1 : 1) : 0;
+        }
+    }
+    return m;
+}
+
+static bool same(const MatrixView<const double>& a, const MatrixView<const double>& b) {
+    if (a.rows() != b.rows() || a.columns() != b.columns()) return false;
+    for (size_t i = 0; i < a.rows(); ++i) {
+        for (size_t j = 0; j < a.columns(); ++j) {
+            if (a(i, j) != b(i, j)) return false;
+        }
+    }
+    return true;
+}
+
+/// C = alpha * A * B + beta * C with three loops.
+static void dense_product(double alpha, const MatrixView<const double>& a, const MatrixView<const double>& b,
+                          double beta, const MatrixView<double>& c) {
+    for (size_t i = 0; i < c.rows(); ++i) {
+        for (size_t j = 0; j < c.columns(); ++j) {
+            double sum = 0;
+            for (size_t p = 0; p < a.columns(); ++p) sum += a(i, p) * b(p, j);
+            c(i, j) = alpha * sum + beta * c(i, j);
+        }
+    }
+}
+
+static void test_conversions() {
+    const Matrix<double> dense = random_sparse(37, 53, 0.2, 1);
+    size_t nonzeros = 0;
+    for (size_t i = 0; i < dense.rows(); ++i) {
+        for (size_t j = 0; j < dense.columns(); ++j) nonzeros += dense.view()(i, j) != 0;
+    }
+    for (SparseFormat format : {SparseFormat::csr, SparseFormat::csc}) {
+        const std::string name = format == SparseFormat::csr ? "CSR" : "CSC";
+        const SparseMatrix<double> sparse(dense, format);
+        check(sparse.format() == format && sparse.nnz() == nonzeros, name + " keeps exactly the nonzeros");
+        check(same(sparse.to_dense().view(), dense.view()), name + " expands back to the dense Matrix");
+        check(same(sparse.to_csr().to_dense().view(), dense.view()) &&
+              same(sparse.to_csc().to_dense().view(), dense.view()), name + " converts to either layout unchanged");
+        check(sparse.at(5, 9) == dense.view()(5, 9) && sparse.at(3, 0) == 0, name + " at() reads single elements");
+        check(same(sparse.t().to_dense().view(), dense.view().t()), name + " t() is the transpose");
+    }
+
+    // converting CSR to CSC and back gives the same three arrays, indices sorted within each row
+    const SparseMatrix<double> csr(dense, SparseFormat::csr);
+    const SparseMatrix<double> back = csr.to_csc().to_csr();
+    check(back.offsets() == csr.offsets() && back.indices() == csr.indices() && back.values() == csr.values(),
+          "CSR -> CSC -> CSR gives the same arrays");
+
+    const SparseMatrix<double> view_csc(dense.view().t().submatrix(2, 3, 20, 10), SparseFormat::csc);
+    check(same(view_csc.to_dense().view(), dense.view().t().submatrix(2, 3, 20, 10)),
+          "a transposed submatrix is compressed directly");
+
+    const SparseMatrix<double> triplets = SparseMatrix<double>::from_triplets(
+            3, 4, {{2, 1, 5.0}, {0, 3, 1.0}, {2, 1, -2.0}, {1, 0, 4.0}}, SparseFormat::csc);
+    check(triplets.nnz() == 3 && triplets.at(2, 1) == 3 && triplets.at(0, 3) == 1 && triplets.at(1, 0) == 4,
+          "from_triplets() adds duplicate triplets together");
+    check(!error_of<std::invalid_argument>([] { SparseMatrix<double>::from_triplets(2, 2, {{2, 0, 1.0}}); }).empty(),
+          "a triplet outside the matrix is rejected");
+}
+
+static void test_spmv(size_t rows, size_t columns, double density) {
+    const std::string name = "spmv, " + std::to_string(rows) + "x" + std::to_string(columns);
+    const Matrix<double> dense = random_sparse(rows, columns, density, unsigned(rows));
+    const Matrix<double> x_source = random_sparse(columns, 3, 1.0, 2);  // x is a strided column of it
+    const VectorView<const double> x = x_source.view().col(1);
+    const Matrix<double> y_start = random_sparse(rows, 1, 1.0, 3);
+
+    Matrix<double> expected = y_start;
+    dense_product(2, dense.view(), x_source.view().submatrix(0, 1, columns, 1), -3, expected.view());
+    for (SparseFormat format : {SparseFormat::csr, SparseFormat::csc}) {
+        const SparseMatrix<double> sparse(dense, format);
+        Matrix<double> y = y_start;
+        spmv<double>(2, sparse, x, -3, y.view().col(0));
+        check(same(y.view(), expected.view()),
+              name + (format == SparseFormat::csr ? " (CSR)" : " (CSC)") + " equals the dense product");
+    }
+
+    Vector<double> column(std::vector<double>(x.size()));
+    for (size_t j = 0; j < x.size(); ++j) column[j] = x[j];
+    const Vector<double> product = SparseMatrix<double>(dense, SparseFormat::csc) * column;
+    Matrix<double> unscaled(rows, 1);
+    dense_product(1, dense.view(), x_source.view().submatrix(0, 1, columns, 1), 0, unscaled.view());
+    bool equal = product.size() == rows && !product.is_transposed;
+    for (size_t i = 0; equal && i < rows; ++i) equal = product[i] == unscaled.view()(i, 0);
+    check(equal, name + ": SparseMatrix * Vector is a column Vector equal to the dense product");
+}
+
+static void test_spmm(size_t rows, size_t depth, size_t columns, double density) {
+    const std::string name = "spmm, " + std::to_string(rows) + "x" + std::to_string(depth) + " times " +
+                             std::to_string(depth) + "x" + std::to_string(columns);
+    const Matrix<double> dense = random_sparse(rows, depth, density, unsigned(depth));
+    const Matrix<double> b_source = random_sparse(columns, depth, 1.0, 4);
+    const MatrixView<const double> b = b_source.view().t();  // column stride != 1
+    Matrix<double> c_start = random_sparse(rows + 2, columns + 3, 1.0, 5);
+
+    Matrix<double> expected = c_start;
+    dense_product(-1, dense.view(), b, 0.5, expected.view().submatrix(1, 2, rows, columns));
+    for (SparseFormat format : {SparseFormat::csr, SparseFormat::csc}) {
+        const SparseMatrix<double> sparse(dense, format);
+        Matrix<double> c = c_start;
+        spmm<double>(-1, sparse, b, 0.5, c.view().submatrix(1, 2, rows, columns));
+        check(same(c.view(), expected.view()), name + (format == SparseFormat::csr ? " (CSR)" : " (CSC)") +
+                                               " equals the dense product and leaves the rest of C alone");
+        Matrix<double> unscaled(rows, columns);
+        dense_product(1, dense.view(), b, 0, unscaled.view());
+        check(same((sparse * b).view(), unscaled.view()), name + ": SparseMatrix * MatrixView");
+    }
+}
+
+static void test_errors() {
+    const SparseMatrix<double> sparse(random_sparse(4, 3, 0.5, 6));
+    Vector<double> row(3, 1.0);
+    row.is_transposed = true;
+    check(!error_of<std::invalid_argument>([&] { sparse * row; }).empty(),
+          "a SparseMatrix times a row Vector is rejected");
+    const Vector<double> too_long(4, 1.0);
+    check(!error_of<std::invalid_argument>([&] { sparse * too_long; }).empty(),
+          "a Vector of the wrong size is rejected");
+    const Matrix<double> b(4, 2);
+    check(!error_of<std::invalid_argument>([&] { sparse * b; }).empty(), "a Matrix of the wrong shape is rejected");
+}
+
+int main() {
+    test_conversions();
+    test_spmv(1, 1, 1.0);
+    test_spmv(40, 70, 0.1);
+    test_spmv(3000, 2000, 0.01);  // more than sparse_parallel_grain nonzeros: split over the thread pool
+    test_spmm(25, 30, 7, 0.2);
+    test_spmm(900, 600, 33, 0.05);
+    test_errors();
+    return tests_passed("sparse");
+}
@@ -0,0 +1,114 @@
+/*
+ * Behaviour tests for the out-of-core product of streaming.h.
+ *
+ * Checks that gemm_streaming() writes the same C as the in-memory product: with shapes that leave partial blocks and
+ * tiles at every edge, with budgets from the smallest one accepted (16 x 16 tiles) to one that holds the whole
+ * problem, and with operands saved transposed (contiguous columns). Elements are small integers, so the products are
+ * exact whichever way K is split. Also checks that the budget is respected, that a budget too small is rejected, and
+ * that C may not be written over one of its operands.
+ */
+
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+#include "linear_algebra.h"
+#include "test.h"
+
+static const std::filesystem::path directory = std::filesystem::temp_directory_path() /
+        ("computer_brain_test_streaming_" + std::to_string(std::random_device()()));
+static const std::string a_path = (directory / "a.bin").string();
+static const std::string b_path = (directory / "b.bin").string();
+static const std::string c_path = (directory / "c.bin").string();
+
+static Matrix<double> random_integers(size_t rows, size_t columns, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> value(-8, 8);
+    Matrix<double> m(rows, columns);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < columns; ++j) m.view()(i, j) = value(generator);
+    }
+    return m;
+}
+
+/// Saves A (m x k) and B (k x n), transposed in the file if asked, streams their product and compares it with A * B.
+static void test_product(size_t m, size_t n, size_t k, size_t budget, bool transposed_a, bool transposed_b) {
+    const std::string name = std::to_string(m) + "x" + std::to_string(k) + " times " + std::to_string(k) + "x" +
+                             std::to_string(n) + " in " + std::to_string(budget) + " bytes" +
+                             (transposed_a ? ", A transposed" : "") + (transposed_b ? ", B transposed" : "");
+    const Matrix<double> a = random_integers(m, k, unsigned(m + k));
+    const Matrix<double> b = random_integers(k, n, unsigned(n + k));
+    for (auto [operand, path, transposed] : {std::tuple(&a, a_path, transposed_a),
+                                             std::tuple(&b, b_path, transposed_b)}) {
+        if (transposed) {  // the transpose of the transpose, stored column by column
+            Matrix<double> stored(operand->columns(), operand->rows());
+            for (size_t i = 0; i < operand->rows(); ++i) {
+                for (size_t j = 0; j < operand->columns(); ++j) stored.view()(j, i) = operand->view()(i, j);
+            }
+            stored.is_transposed = true;
+            save_binary(path, stored);
+        } else {
+            save_binary(path, *operand);
+        }
+    }
+
+    const StreamingGemmReport report = gemm_streaming<double>(a_path, b_path, c_path, StreamingGemmOptions{budget});
+    const Matrix<double> expected = a * b;
+    const Matrix<double> c = load_matrix<double>(c_path);
+    bool equal = c.rows() == m && c.columns() == n;
+    for (size_t i = 0; equal && i < m; ++i) {
+        for (size_t j = 0; equal && j < n; ++j) equal = c.view()(i, j) == expected.view()(i, j);
+    }
+    check(equal, name + ": C equals the in-memory product");
+    check(report.buffer_bytes <= budget, name + ": " + std::to_string(report.buffer_bytes) + " bytes of buffers");
+    check(report.bytes_written >= m * n * sizeof(double), name + ": every block of C is written");
+}
+
+static void test_errors() {
+    save_binary(a_path, random_integers(40, 30, 1));
+    save_binary(b_path, random_integers(30, 20, 2));
+    check(contains(error_of<std::invalid_argument>([] {
+                       gemm_streaming<double>(a_path, b_path, c_path, StreamingGemmOptions{1000});
+                   }), "too small"),
+          "a budget too small for 16 x 16 tiles is rejected");
+    check(contains(error_of<std::invalid_argument>([] { gemm_streaming<double>(a_path, a_path, c_path); }),
+                   "cannot be computed"),
+          "operands of different inner dimensions are rejected");
+
+    const Matrix<double> a_before = load_matrix<double>(a_path);
+    const std::string same_a = (directory / "." / "a.bin").string();  // another name for the file of A
+    check(contains(error_of<std::invalid_argument>([] { gemm_streaming<double>(a_path, b_path, a_path); }),
+                   "also an operand"),
+          "C may not be the file of A");
+    check(contains(error_of<std::invalid_argument>([&] { gemm_streaming<double>(a_path, b_path, same_a); }),
+                   "also an operand"),
+          "C may not be the file of A under another name");
+    check(contains(error_of<std::invalid_argument>([] { gemm_streaming<double>(a_path, b_path, b_path); }),
+                   "also an operand"),
+          "C may not be the file of B");
+    const Matrix<double> a_after = load_matrix<double>(a_path);
+    bool unchanged = a_after.rows() == a_before.rows() && a_after.columns() == a_before.columns();
+    for (size_t i = 0; unchanged && i < a_before.rows(); ++i) {
+        for (size_t j = 0; unchanged && j < a_before.columns(); ++j) {
+            unchanged = a_after.view()(i, j) == a_before.view()(i, j);
+        }
+    }
+    check(unchanged, "a rejected product leaves its operands alone");
+}
+
+int main() {
+    std::filesystem::create_directory(directory);
+    const size_t smallest = 6 * 16 * 16 * sizeof(double);  // two tiles of A, two of B, two blocks of C, all 16 x 16
+    test_product(1, 1, 1, smallest, false, false);
+    test_product(50, 37, 45, smallest, false, false);  // 16 x 16 tiles, partial ones at every edge
+    test_product(50, 37, 45, smallest, true, true);
+    test_product(130, 70, 200, 40000, false, true);
+    test_product(130, 70, 200, 40000, true, false);
+    test_product(300, 257, 129, size_t(256) << 20, false, false);  // the whole problem in one block
+    test_product(20, 0, 10, smallest, false, false);
+    test_errors();
+    std::filesystem::remove_all(directory);
+    return tests_passed("streaming");
+}
@@ -0,0 +1,160 @@
+/*
+ * Behaviour tests for the text import and export of text_io.h.
+ *
+ * Checks that what write_text() writes is read back exactly by parse_matrix_text() in every format, for floating-point
+ * values with the default precision (special values included) and for integers at the ends of their range, that
+ * Vectors keep their orientation through a file, and that the errors name the right line and say what went wrong.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "linear_algebra.h"
+#include "test.h"
+
+static const char* format_name(TextFormat format) {
+    return format == TextFormat::csv ? "csv" : format == TextFormat::tsv ? "tsv" : "numpy";
+}
+
+/// Writes m in format and parses it back; true if every element comes back as the same value, with the same sign.
+template<typename U>
+static bool round_trips(const Matrix<U>& m, TextFormat format) {
+    std::ostringstream out;
+    write_text(out, m.view(), format);
+    const Matrix<U> back = parse_matrix_text<U>(out.str());
+    if (back.rows() != m.rows() || back.columns() != m.columns()) return false;
+    for (size_t i = 0; i < m.rows(); ++i) {
+        for (size_t j = 0; j < m.columns(); ++j) {
+            const U a = m.view()(i, j), b = back.view()(i, j);
+            if constexpr (std::is_floating_point_v<U>) {
+                if (std::isnan(a) ? !std::isnan(b) : a != b || std::signbit(a) != std::signbit(b)) return false;
+            } else if (a != b) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template<typename U>
+static void test_floating_point_round_trip(const char* type) {
+    using limits = std::numeric_limits<U>;
+    const std::vector<U> special = {U(0), -U(0), limits::min(), limits::denorm_min(), -limits::denorm_min(),
+                                    limits::max(), limits::lowest(), limits::epsilon(), limits::infinity(),
+                                    -limits::infinity(), limits::quiet_NaN(), U(1) / U(3), U(-0.1), U(1e-30)};
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> exponent(-60, 60);
+    std::normal_distribution<U> normal;
+    Matrix<U> m(37, 29);
+    for (size_t i = 0; i < m.rows(); ++i) {
+        for (size_t j = 0; j < m.columns(); ++j) {
+            const size_t k = i * m.columns() + j;
+            m.view()(i, j) = k < special.size() ? special[k] : std::ldexp(normal(generator), exponent(generator));
+        }
+    }
+    for (TextFormat format : {TextFormat::csv, TextFormat::tsv, TextFormat::numpy}) {
+        check(round_trips(m, format), std::string(type) + " elements read back exactly in " + format_name(format));
+    }
+}
+
+template<typename U>
+static void test_integer_round_trip(const char* type) {
+    using limits = std::numeric_limits<U>;
+    Matrix<U> m(3, 4);
+    const U values[12] = {limits::min(), limits::max(), U(0), U(1), U(limits::max() - 1), U(limits::min() + 1),
+                          U(42), U(limits::max() / 3), U(7), U(limits::min() / 5), U(100), U(limits::max() / 2)};
+    for (size_t k = 0; k < 12; ++k) m.view()(k / 4, k % 4) = values[k];
+    for (TextFormat format : {TextFormat::csv, TextFormat::tsv, TextFormat::numpy}) {
+        check(round_trips(m, format), std::string(type) + " elements read back exactly in " + format_name(format));
+    }
+}
+
+static void test_parsing() {
+    const Matrix<double> m = parse_matrix_text<double>("# a comment\r\n\r\n 1, +2.5\t\r\n3 -4e2\n\n# end\n");
+    check(m.rows() == 2 && m.columns() == 2 && m.view()(0, 0) == 1 && m.view()(0, 1) == 2.5 &&
+          m.view()(1, 0) == 3 && m.view()(1, 1) == -400,
+          "comments, blank lines, \\r\\n, '+' and mixed delimiters are read");
+    check(parse_matrix_text<float>("# only a comment\n\n").rows() == 0, "text without data gives an empty Matrix");
+
+    // integers written by numpy.savetxt, in floating-point notation
+    const Matrix<std::int64_t> n = parse_matrix_text<std::int64_t>(
+        "-9.223372036854775808e+18 1.000000000000000000e+00\n");
+    check(n.view()(0, 0) == std::numeric_limits<std::int64_t>::min() && n.view()(0, 1) == 1,
+          "integers in floating-point notation are read");
+}
+
+static void test_vector_files() {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string path = (directory / ("computer_brain_test_text_io_" + std::to_string(std::random_device()()) +
+                                           ".csv")).string();
+    Vector<double> column(std::vector<double>{1.5, -2, 1e300});
+    Vector<double> row = column;
+    row.is_transposed = true;
+    for (const Vector<double>* v : {&column, &row}) {
+        save_text(path, *v);
+        const Vector<double> back = load_vector_text<double>(path);
+        bool same = back.size() == v->size() && back.is_transposed == v->is_transposed;
+        for (size_t i = 0; same && i < v->size(); ++i) same = back[i] == (*v)[i];
+        check(same, std::string(v->is_transposed ? "a row" : "a column") + " Vector keeps its values and orientation");
+    }
+    std::filesystem::remove(path);
+    check(contains(error_of<std::runtime_error>([&] { load_vector_text<double>(path); }), "Cannot open " + path),
+          "a missing file is reported by name");
+}
+
+static void test_errors() {
+    const Matrix<double> m(2, 2);
+    std::ostringstream out;
+    check(contains(error_of<std::invalid_argument>([&] { write_text(out, m.view(), TextFormat::csv, 51); }),
+                   "precision of 51 digits"),
+          "a precision above 50 throws std::invalid_argument");
+    check(error_of<std::exception>([&] { write_text(out, m.view(), TextFormat::numpy, 50); }).empty(),
+          "a precision of 50 is accepted");
+
+    check(contains(error_of<std::runtime_error>([] { parse_matrix_text<double>("# header\n\nabc,1\n"); }),
+                   "text, line 3: cannot read a number at \"abc,1\""),
+          "a bad first data line is reported with its real line number");
+    check(contains(error_of<std::runtime_error>([] { parse_matrix_text<double>("1,2\n3,4\n\n5,6,7\n", "m.csv"); }),
+                   "m.csv, line 4: expected 2 elements, found 3"),
+          "a line with too many elements is reported");
+
+    // the error on line 100000, in the second chunk of the text, keeps the numbering of the first chunk
+    std::string text;
+    for (int i = 1; i < 100000; ++i) text += "1.25,2.5,3.75,-4,5\n";
+    text += "1,2,3,4,x\n";
+    check(contains(error_of<std::runtime_error>([&] { parse_matrix_text<float>(text); }), "text, line 100000:"),
+          "a line beyond the first chunk is reported with its line number");
+
+    check(!error_of<std::runtime_error>([] { parse_matrix_text<std::uint8_t>("255,256\n"); }).empty(),
+          "an integer too large for its type is rejected");
+    check(!error_of<std::runtime_error>([] { parse_matrix_text<std::int32_t>("1e10\n"); }).empty(),
+          "an integer in floating-point notation too large for its type is rejected");
+    check(!error_of<std::runtime_error>([] { parse_matrix_text<std::uint32_t>("-1.0e+00\n"); }).empty(),
+          "a negative integer in floating-point notation is rejected for an unsigned type");
+    check(!error_of<std::runtime_error>([] { parse_matrix_text<std::int64_t>("9.223372036854775808e+18\n"); }).empty(),
+          "2^63 in floating-point notation is rejected for int64_t");
+    check(!error_of<std::runtime_error>([] { parse_matrix_text<int>("1.5\n"); }).empty(),
+          "a fractional number is rejected for an integer type");
+}
+
+int main() {
+    test_floating_point_round_trip<float>("float");
+    test_floating_point_round_trip<double>("double");
+    test_integer_round_trip<std::int8_t>("int8_t");
+    test_integer_round_trip<std::uint16_t>("uint16_t");
+    test_integer_round_trip<std::int32_t>("int32_t");
+    test_integer_round_trip<std::int64_t>("int64_t");
+    test_integer_round_trip<std::uint64_t>("uint64_t");
+    test_parsing();
+    test_vector_files();
+    test_errors();
+
+    return tests_passed("text I/O");
+}
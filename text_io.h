@@ -0,0 +1,416 @@
+#ifndef COMPUTER_BRAIN_TEXT_IO_H
+#define COMPUTER_BRAIN_TEXT_IO_H
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "expression.h"
+#include "thread_pool.h"
+#include "view.h"
+
+/*
+ * Text import and export of Vector and Matrix.
+ *
+ * One line per row, with the elements of a row separated by the delimiter of the format:
+ *
+ *   TextFormat::csv     "1,0.5,-3"                          comma-separated
+ *   TextFormat::tsv     "1\t0.5\t-3"                        tab-separated
+ *   TextFormat::numpy   "1.000000000000000000e+00 5.0..."   the default output of numpy.savetxt (space-separated,
+ *                                                           "%.18e"), which numpy.loadtxt reads back
+ *
+ * Floating-point elements are written by std::to_chars: with the default precision (-1), as the shortest string that
+ * reads back to exactly the same value (numpy format: 18 digits after the point, as numpy does). Integers are written
+ * in full. Rows are formatted in blocks of about 64 KB, blocks in parallel on the thread pool, into buffers that are
+ * reused from one block to the next, and the blocks are then written in order with one write() each.
+ *
+ * The parser reads any of the three formats (and a mix of them): elements are separated by a comma or by spaces and
+ * tabs, blank lines and lines starting with '#' are skipped, and "\r\n" line ends are accepted. Numbers are read by
+ * std::from_chars, which accepts exactly what to_chars writes ("inf" and "nan" included) and never depends on the
+ * locale. The text is split into chunks at line boundaries; the rows of every chunk are counted, then the chunks are
+ * parsed in parallel straight into the rows of the result.
+ */
+
+/// Layout of a text file: the delimiter between elements and the style of the numbers.
+enum class TextFormat { csv, tsv, numpy };
+
+
+/* ------------------------------------------------- Text Formatting ------------------------------------------------ */
+
+
+namespace detail {
+
+/// Enough characters for any element written by text_format_number(), including a delimiter.
+inline constexpr size_t text_max_chars = 64;
+
+/// The largest precision whose numbers are sure to fit in text_max_chars: sign, point, exponent and leading zeros
+/// take at most 12 more characters.
+inline constexpr int text_max_precision = int(text_max_chars) - 14;
+
+/// Writes value at out and returns the character after it.
+template<typename U>
+char* text_format_number(char* out, U value, TextFormat format, int precision) {
+    char* const end = out + text_max_chars - 1;
+    std::to_chars_result result;
+    if constexpr (std::is_floating_point_v<U>) {
+        if (format == TextFormat::numpy) {
+            result = std::to_chars(out, end, value, std::chars_format::scientific, precision < 0 ? 18 : precision);
+        } else if (precision >= 0) {
+            result = std::to_chars(out, end, value, std::chars_format::general, precision);
+        } else {
+            result = std::to_chars(out, end, value);
+        }
+    } else {
+        result = std::to_chars(out, end, value);
+    }
+    if (result.ec != std::errc()) {
+        throw std::runtime_error("\nCannot format an element as text with precision " + std::to_string(precision) +
+                                 "\n");
+    }
+    return result.ptr;
+}
+
+/// Formats rows [first, last) of view into buffer, one line per row. buffer keeps its capacity between calls.
+template<typename U>
+void text_format_rows(const MatrixView<U>& view, size_t first, size_t last, TextFormat format, int precision,
+                      std::string& buffer) {
+    const char delimiter = format == TextFormat::csv ? ',' : format == TextFormat::tsv ? '\t' : ' ';
+    buffer.resize((last - first) * (view.columns() * text_max_chars + 1));
+    char* out = buffer.data();
+    for (size_t i = first; i < last; ++i) {
+        for (size_t j = 0; j < view.columns(); ++j) {
+            if (j != 0) *out++ = delimiter;
+            out = text_format_number(out, view(i, j), format, precision);
+        }
+        *out++ = '\n';
+    }
+    buffer.resize(out - buffer.data());
+}
+
+/// The formatting buffers of the calling thread, kept from one call to the next.
+inline std::vector<std::string>& text_buffers() {
+    thread_local std::vector<std::string> buffers;
+    return buffers;
+}
+
+}  // namespace detail
+
+
+/**
+ * @brief Writes the elements of a view to a stream as text, one line per row.
+ *
+ * @param precision significant digits of floating-point elements (digits after the point in numpy format); -1 writes
+ *        the shortest string that reads back exactly (18 digits after the point in numpy format). Precisions above
+ *        50 throw std::invalid_argument.
+ */
+template<typename U>
+void write_text(std::ostream& out, const MatrixView<U>& view, TextFormat format = TextFormat::csv,
+                int precision = -1) {
+    static_assert(std::is_arithmetic_v<std::remove_const_t<U>>, "Only arithmetic elements can be written as text");
+    if (precision > detail::text_max_precision) {
+        throw std::invalid_argument("\nA precision of " + std::to_string(precision) + " digits cannot be written as "
+                                    "text: the largest is " + std::to_string(detail::text_max_precision) + "\n");
+    }
+    const size_t rows = view.rows();
+    const size_t row_chars = view.columns() * detail::text_max_chars + 1;
+    const size_t block_rows = std::max<size_t>(1, (size_t(1) << 16) / row_chars);
+    const size_t blocks = (rows + block_rows - 1) / block_rows;
+    const size_t batch = std::max<size_t>(1, 4 * get_num_threads());  // blocks formatted before they are written
+    std::vector<std::string>& buffers = detail::text_buffers();
+    if (buffers.size() < batch) buffers.resize(batch);
+    for (size_t first_block = 0; first_block < blocks; first_block += batch) {
+        const size_t count = std::min(batch, blocks - first_block);
+        parallel_for(0, count, 1, [&](size_t lo, size_t hi) {
+            for (size_t b = lo; b < hi; ++b) {
+                const size_t first = (first_block + b) * block_rows;
+                detail::text_format_rows(view, first, std::min(rows, first + block_rows), format, precision,
+                                         buffers[b]);
+            }
+        });
+        for (size_t b = 0; b < count; ++b) out.write(buffers[b].data(), (std::streamsize)buffers[b].size());
+    }
+    if (!out) {
+        throw std::runtime_error("\nCannot write the text of a Matrix to the stream\n");
+    }
+}
+
+/// Writes a Vector to a stream as text: a column Vector one element per line, a row Vector on a single line.
+template<typename T>
+void write_text(std::ostream& out, const Vector<T>& vector, TextFormat format = TextFormat::csv, int precision = -1) {
+    const VectorView<const T> v = vector.view();
+    if (vector.is_transposed) {
+        write_text(out, MatrixView<const T>(v.data(), 1, v.size(), (ptrdiff_t)v.size(), 1), format, precision);
+    } else {
+        write_text(out, MatrixView<const T>(v.data(), v.size(), 1, 1, 1), format, precision);
+    }
+}
+
+/// Saves the elements of a view to a text file; see write_text().
+template<typename U>
+void save_text(const std::string& path, const MatrixView<U>& view, TextFormat format = TextFormat::csv,
+               int precision = -1) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("\nCannot open " + path + " for writing\n");
+    }
+    write_text(file, view, format, precision);
+}
+
+/// Saves a Matrix to a text file in its current orientation (a transposed Matrix is written transposed).
+template<typename U>
+void save_text(const std::string& path, const Matrix<U>& matrix, TextFormat format = TextFormat::csv,
+               int precision = -1) {
+    save_text(path, matrix.view(), format, precision);
+}
+
+/// Saves a Vector to a text file; see write_text().
+template<typename T>
+void save_text(const std::string& path, const Vector<T>& vector, TextFormat format = TextFormat::csv,
+               int precision = -1) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("\nCannot open " + path + " for writing\n");
+    }
+    write_text(file, vector, format, precision);
+}
+
+
+/* -------------------------------------------------- Text Parsing -------------------------------------------------- */
+
+
+namespace detail {
+
+inline const char* text_skip_blanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    return p;
+}
+
+/// A line holds data unless it is blank or a '#' comment.
+inline bool text_is_data(const char* line, const char* end) {
+    const char* p = text_skip_blanks(line, end);
+    return p < end && *p != '#';
+}
+
+/// Reads one number at p into value; returns the character after it, or nullptr if there is no number at p.
+template<typename U>
+const char* text_parse_number(const char* p, const char* end, U& value) {
+    if (p < end && *p == '+') ++p;  // from_chars does not take a leading '+'
+    auto [next, error] = std::from_chars(p, end, value);
+    if constexpr (std::is_integral_v<U>) {
+        if (error == std::errc() && next < end && (*next == '.' || *next == 'e' || *next == 'E')) {
+            double real;  // an integer written in floating-point notation, such as numpy.savetxt writes
+            auto [real_next, real_error] = std::from_chars(p, end, real);
+            // a whole number, in the range of U: [min, 2^digits), bounds that are exact as doubles
+            if (real_error != std::errc() || real != std::trunc(real) ||
+                real < double(std::numeric_limits<U>::min()) ||
+                real >= std::ldexp(1.0, std::numeric_limits<U>::digits)) {
+                return nullptr;
+            }
+            value = (U)real;
+            return real_next;
+        }
+    }
+    return error == std::errc() ? next : nullptr;
+}
+
+/**
+ * Reads the elements of the line [p, end) into out, which has room for capacity of them, and returns how many elements
+ * the line holds. Throws std::runtime_error if the line holds something that is not a number.
+ */
+template<typename U>
+size_t text_parse_line(const char* p, const char* end, U* out, size_t capacity, const std::string& source,
+                       size_t line) {
+    size_t count = 0;
+    p = text_skip_blanks(p, end);
+    while (p < end) {
+        U value;
+        const char* next = text_parse_number(p, end, value);
+        if (next == nullptr) {
+            const std::string found(p, std::min<const char*>(end, p + 20));
+            throw std::runtime_error("\n" + source + ", line " + std::to_string(line) + ": cannot read a number at \"" +
+                                     found + "\"\n");
+        }
+        if (count < capacity) out[count] = value;
+        ++count;
+        p = text_skip_blanks(next, end);
+        if (p < end && *p == ',') p = text_skip_blanks(p + 1, end);
+    }
+    return count;
+}
+
+/// The end of the line starting at p: the position of its '\n', or end.
+inline const char* text_line_end(const char* p, const char* end) {
+    const void* newline = std::memchr(p, '\n', end - p);
+    return newline == nullptr ? end : static_cast<const char*>(newline);
+}
+
+/// A range of whole lines of the text, with the number of lines and data rows before it.
+struct TextChunk {
+    const char* first;
+    const char* last;
+    size_t lines = 0;
+    size_t rows = 0;
+    size_t first_line = 0;
+    size_t first_row = 0;
+};
+
+/// Splits text into chunks of about 1 MB of whole lines, counts the lines and data rows of each, and numbers them.
+inline std::vector<TextChunk> text_chunks(std::string_view text) {
+    constexpr size_t chunk_bytes = size_t(1) << 20;
+    std::vector<TextChunk> chunks;
+    const char* p = text.data();
+    const char* const end = text.data() + text.size();
+    while (p < end) {
+        const char* last = p + std::min<size_t>(chunk_bytes, end - p);
+        if (last < end) last = std::min(end, text_line_end(last, end) + 1);
+        chunks.push_back(TextChunk{p, last});
+        p = last;
+    }
+    parallel_for(0, chunks.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t c = lo; c < hi; ++c) {
+            for (const char* line = chunks[c].first; line < chunks[c].last;) {
+                const char* eol = text_line_end(line, chunks[c].last);
+                ++chunks[c].lines;
+                chunks[c].rows += text_is_data(line, eol);
+                line = eol + 1;
+            }
+        }
+    });
+    for (size_t c = 1; c < chunks.size(); ++c) {
+        chunks[c].first_line = chunks[c - 1].first_line + chunks[c - 1].lines;
+        chunks[c].first_row = chunks[c - 1].first_row + chunks[c - 1].rows;
+    }
+    return chunks;
+}
+
+/// Reads a whole file into a string.
+inline std::string text_read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        throw std::runtime_error("\nCannot open " + path + " for reading\n");
+    }
+    std::string text((size_t)file.tellg(), '\0');
+    file.seekg(0);
+    if (!file.read(text.data(), (std::streamsize)text.size())) {
+        throw std::runtime_error("\nCannot read " + path + "\n");
+    }
+    return text;
+}
+
+}  // namespace detail
+
+
+/**
+ * @brief Parses text in any of the TextFormat layouts into a new Matrix, one row per data line.
+ *
+ * Every data line must hold the same number of elements; otherwise, or if an element is not a number of type U,
+ * std::runtime_error is thrown, naming source and the line. Text with no data lines gives a 0 x 0 Matrix.
+ */
+template<typename U>
+Matrix<U> parse_matrix_text(std::string_view text, const std::string& source = "text") {
+    static_assert(std::is_arithmetic_v<U>, "Only arithmetic elements can be read from text");
+    const std::vector<detail::TextChunk> chunks = detail::text_chunks(text);
+    const size_t rows = chunks.empty() ? 0 : chunks.back().first_row + chunks.back().rows;
+    if (rows == 0) {
+        return Matrix<U>(0, 0);
+    }
+    size_t columns = 0;  // the number of elements on the first data line
+    const char* const end = text.data() + text.size();
+    size_t line_number = 0;
+    for (const char* line = text.data(), *eol = line; line < end; line = eol + 1) {
+        eol = detail::text_line_end(line, end);
+        ++line_number;
+        if (detail::text_is_data(line, eol)) {
+            columns = detail::text_parse_line<U>(line, eol, nullptr, 0, source, line_number);
+            break;
+        }
+    }
+    Matrix<U> matrix(rows, columns);
+    parallel_for(0, chunks.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t c = lo; c < hi; ++c) {
+            size_t line_number = chunks[c].first_line;
+            size_t row = chunks[c].first_row;
+            for (const char* line = chunks[c].first; line < chunks[c].last;) {
+                const char* eol = detail::text_line_end(line, chunks[c].last);
+                ++line_number;
+                if (detail::text_is_data(line, eol)) {
+                    const size_t count = detail::text_parse_line(line, eol, matrix.data() + row * matrix.ld(),
+                                                                 columns, source, line_number);
+                    if (count != columns) {
+                        throw std::runtime_error("\n" + source + ", line " + std::to_string(line_number) +
+                                                 ": expected " + std::to_string(columns) + " elements, found " +
+                                                 std::to_string(count) + "\n");
+                    }
+                    ++row;
+                }
+                line = eol + 1;
+            }
+        }
+    });
+    return matrix;
+}
+
+/// Reads a Matrix from a text file written by save_text(), numpy.savetxt(), or as CSV or TSV by any other program.
+template<typename U>
+Matrix<U> load_matrix_text(const std::string& path) {
+    return parse_matrix_text<U>(detail::text_read_file(path), path);
+}
+
+/**
+ * @brief Reads a Vector from a text file: every element of the file, in order.
+ *
+ * A file with a single data line holding more than one element gives a row Vector (transposed), as save_text() writes
+ * a row Vector; any other file gives a column Vector.
+ */
+template<typename T>
+Vector<T> load_vector_text(const std::string& path) {
+    const std::string text = detail::text_read_file(path);
+    std::vector<detail::TextChunk> chunks = detail::text_chunks(text);
+    std::vector<size_t> counts(chunks.size(), 0);  // elements per chunk
+    parallel_for(0, chunks.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t c = lo; c < hi; ++c) {
+            size_t line_number = chunks[c].first_line;
+            for (const char* line = chunks[c].first; line < chunks[c].last;) {
+                const char* eol = detail::text_line_end(line, chunks[c].last);
+                ++line_number;
+                if (detail::text_is_data(line, eol)) {
+                    counts[c] += detail::text_parse_line<T>(line, eol, nullptr, 0, path, line_number);
+                }
+                line = eol + 1;
+            }
+        }
+    });
+    std::vector<size_t> offsets(chunks.size() + 1, 0);
+    for (size_t c = 0; c < chunks.size(); ++c) offsets[c + 1] = offsets[c] + counts[c];
+    Vector<T> vector((int)offsets.back(), T(0));
+    parallel_for(0, chunks.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t c = lo; c < hi; ++c) {
+            T* out = vector.data() + offsets[c];
+            size_t line_number = chunks[c].first_line;
+            for (const char* line = chunks[c].first; line < chunks[c].last;) {
+                const char* eol = detail::text_line_end(line, chunks[c].last);
+                ++line_number;
+                if (detail::text_is_data(line, eol)) {
+                    out += detail::text_parse_line(line, eol, out, (size_t)-1, path, line_number);
+                }
+                line = eol + 1;
+            }
+        }
+    });
+    const size_t rows = chunks.empty() ? 0 : chunks.back().first_row + chunks.back().rows;
+    vector.is_transposed = rows == 1 && vector.size() > 1;
+    return vector;
+}
+
+
+#endif //COMPUTER_BRAIN_TEXT_IO_H
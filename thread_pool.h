@@ -0,0 +1,333 @@
+#ifndef COMPUTER_BRAIN_THREAD_POOL_H
+#define COMPUTER_BRAIN_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/*
+ * A work-stealing thread pool shared by every parallel kernel in computer_brain.
+ *
+ * Each worker owns a deque of tasks. A worker pushes and pops tasks at the back of its own deque (newest first, which
+ * keeps the data it just touched in cache) and, when it runs dry, steals from the front of another worker's deque
+ * (oldest first, which tends to be the biggest piece of work). Threads that are not workers hand their tasks to a
+ * shared injection queue.
+ *
+ * A thread that waits for its tasks to finish does not block: it keeps running queued tasks until its own are done.
+ * This is what makes nested parallel_for calls safe; a parallel_for issued from inside a task only adds tasks to the
+ * queues of the existing threads and never starts new ones, so the machine is never oversubscribed.
+ */
+
+/* ---------------------------------------------- Thread Pool Class ------------------------------------------------- */
+
+
+class ThreadPool {
+public:
+    /* Constructors and Destructor */
+    explicit ThreadPool(size_t num_threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    /// The pool used by the library. Its size comes from COMPUTER_BRAIN_NUM_THREADS, or the number of hardware threads.
+    static ThreadPool& global();
+
+    /* Member Functions */
+    size_t num_threads() const;
+    void resize(size_t num_threads);
+    bool in_worker() const;
+
+    template<typename F> void parallel_for(size_t begin, size_t end, size_t grain, F&& body);
+
+private:
+    /// A type-erased piece of a parallel_for: run chunk `index` of the job pointed to by `context`.
+    struct Task {
+        void (*run)(void* context, size_t index);
+        void* context;
+        size_t index;
+    };
+
+    /// The deque owned by one worker; the owner uses the back, thieves use the front.
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    /// Bookkeeping shared by all the chunks of one parallel_for call.
+    template<typename F> struct Job {
+        F* body;
+        size_t begin;
+        size_t end;
+        size_t chunk_size;
+        std::atomic<size_t> remaining;
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues;  // one per worker
+    WorkQueue injection_queue;                       // tasks submitted by threads that are not workers
+    std::atomic<size_t> queued_tasks{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleep_mutex;
+    std::condition_variable wake_up;
+    size_t thread_count = 1;
+
+    static thread_local ThreadPool* current_pool;  // pool the calling thread works for, if any
+    static thread_local size_t current_worker;     // index of the calling worker in that pool
+
+    void start(size_t num_threads);
+    void stop();
+    void worker_loop(size_t index);
+    void push(const Task& task);
+    bool try_run_one();
+    bool pop_task(Task& task);
+};
+
+inline thread_local ThreadPool* ThreadPool::current_pool = nullptr;
+inline thread_local size_t ThreadPool::current_worker = 0;
+
+
+/* --------------------------------------------- Thread Pool Definitions -------------------------------------------- */
+
+
+/// Creates a pool in which num_threads threads (the caller plus num_threads - 1 workers) share the work.
+inline ThreadPool::ThreadPool(size_t num_threads) { start(num_threads); }
+
+/// Stops and joins every worker. Tasks still queued are not run.
+inline ThreadPool::~ThreadPool() { stop(); }
+
+inline ThreadPool& ThreadPool::global() {
+    static ThreadPool pool([] {
+        if (const char* env = std::getenv("COMPUTER_BRAIN_NUM_THREADS")) {
+            const long requested = std::strtol(env, nullptr, 10);
+            if (requested > 0) return (size_t)requested;
+        }
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }());
+    return pool;
+}
+
+/// ThreadPool.num_threads() returns the number of threads that take part in a parallel_for, the caller included.
+inline size_t ThreadPool::num_threads() const { return thread_count; }
+
+/**
+ * @brief Changes the number of threads in the pool.
+ *
+ * The workers are joined and new ones are started, so this must not be called while a parallel_for is running on the
+ * pool. A value of 0 is treated as 1, which makes every parallel_for run serially on the calling thread.
+ */
+inline void ThreadPool::resize(size_t num_threads) {
+    if (in_worker()) {
+        throw std::logic_error("ThreadPool.resize() cannot be called from inside a task running on the same pool\n");
+    }
+    stop();
+    start(num_threads);
+}
+
+/// ThreadPool.in_worker() is true when the calling thread is one of this pool's workers.
+inline bool ThreadPool::in_worker() const { return current_pool == this; }
+
+inline void ThreadPool::start(size_t num_threads) {
+    thread_count = std::max<size_t>(1, num_threads);
+    stopping = false;
+    queues.clear();
+    for (size_t i = 0; i + 1 < thread_count; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i + 1 < thread_count; ++i) {
+        workers.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+inline void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake_up.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    queues.clear();
+    std::lock_guard<std::mutex> lock(injection_queue.mutex);
+    injection_queue.tasks.clear();
+    queued_tasks = 0;
+}
+
+inline void ThreadPool::worker_loop(size_t index) {
+    current_pool = this;
+    current_worker = index;
+    while (true) {
+        if (try_run_one()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake_up.wait(lock, [this] { return stopping || queued_tasks.load() > 0; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+/// Queues a task on the calling worker's own deque, or on the injection queue when called from outside the pool.
+inline void ThreadPool::push(const Task& task) {
+    WorkQueue& queue = in_worker() ? *queues[current_worker] : injection_queue;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    queued_tasks.fetch_add(1);
+    { std::lock_guard<std::mutex> lock(sleep_mutex); }  // a worker about to sleep either sees the task or the notify
+    wake_up.notify_one();
+}
+
+/// Takes one task: from the back of our own deque first, then the injection queue, then the front of a victim's.
+inline bool ThreadPool::pop_task(Task& task) {
+    if (queued_tasks.load() == 0) {
+        return false;
+    }
+    const bool worker = in_worker();
+    if (worker) {
+        WorkQueue& own = *queues[current_worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(injection_queue.mutex);
+        if (!injection_queue.tasks.empty()) {
+            task = injection_queue.tasks.front();
+            injection_queue.tasks.pop_front();
+            return true;
+        }
+    }
+    thread_local std::minstd_rand victim_picker(std::random_device{}());
+    const size_t num_queues = queues.size();
+    const size_t first = num_queues ? victim_picker() % num_queues : 0;
+    for (size_t offset = 0; offset < num_queues; ++offset) {
+        const size_t victim = (first + offset) % num_queues;
+        if (worker && victim == current_worker) {
+            continue;
+        }
+        WorkQueue& queue = *queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool ThreadPool::try_run_one() {
+    Task task;
+    if (!pop_task(task)) {
+        return false;
+    }
+    queued_tasks.fetch_sub(1);
+    task.run(task.context, task.index);
+    return true;
+}
+
+/**
+ * @brief Runs body(lo, hi) over sub-ranges that together cover [begin, end).
+ *
+ * The range is cut into chunks of at least `grain` indices, with a few chunks per thread so that stealing can even out
+ * uneven chunks. When the range is no larger than one grain, or the pool has a single thread, body runs once on the
+ * calling thread with no synchronisation at all. The call returns once every chunk has finished; the first exception
+ * thrown by body is rethrown here.
+ *
+ * @param grain the smallest number of indices worth sending to another thread
+ * @param body a callable taking (size_t lo, size_t hi)
+ */
+template<typename F>
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, F&& body) {
+    if (end <= begin) {
+        return;
+    }
+    const size_t count = end - begin;
+    grain = std::max<size_t>(1, grain);
+    if (thread_count == 1 || count <= grain) {  // if: not worth splitting, run on the calling thread
+        body(begin, end);
+        return;
+    }
+    const size_t max_chunks = thread_count * 4;
+    const size_t num_chunks = std::min(max_chunks, (count + grain - 1) / grain);
+    const size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+
+    using Body = std::remove_reference_t<F>;
+    Job<Body> job;
+    job.body = &body;
+    job.begin = begin;
+    job.end = end;
+    job.chunk_size = chunk_size;
+    job.remaining = num_chunks;
+
+    auto run_chunk = [](void* context, size_t index) {
+        auto* job = static_cast<Job<Body>*>(context);
+        if (!job->failed.load()) {  // once a chunk has thrown, the remaining chunks are skipped
+            const size_t lo = job->begin + index * job->chunk_size;
+            const size_t hi = std::min(job->end, lo + job->chunk_size);
+            try {
+                if (lo < hi) (*job->body)(lo, hi);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(job->error_mutex);
+                if (!job->error) job->error = std::current_exception();
+                job->failed = true;
+            }
+        }
+        job->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    };
+
+    for (size_t index = num_chunks - 1; index > 0; --index) {  // queued last to first so the owner pops in order
+        push(Task{run_chunk, &job, index});
+    }
+    run_chunk(&job, 0);
+    while (job.remaining.load(std::memory_order_acquire) != 0) {  // help with queued work instead of blocking
+        if (!try_run_one()) {
+            std::this_thread::yield();
+        }
+    }
+    if (job.error) {
+        std::rethrow_exception(job.error);
+    }
+}
+
+
+/* --------------------------------------- Library Thread Count Controls -------------------------------------------- */
+
+
+/// Sets the number of threads the library's parallel kernels may use. 1 makes every operation serial.
+inline void set_num_threads(size_t num_threads) { ThreadPool::global().resize(num_threads); }
+
+/// Returns the number of threads the library's parallel kernels may use.
+inline size_t get_num_threads() { return ThreadPool::global().num_threads(); }
+
+/**
+ * Runs body(lo, hi) over [begin, end) on the library's thread pool. Ranges of at most `grain` indices run serially on
+ * the calling thread, so small operations pay nothing for the pool.
+ */
+template<typename F>
+void parallel_for(size_t begin, size_t end, size_t grain, F&& body) {
+    ThreadPool::global().parallel_for(begin, end, grain, std::forward<F>(body));
+}
+
+
+#endif //COMPUTER_BRAIN_THREAD_POOL_H
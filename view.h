@@ -0,0 +1,490 @@
+#ifndef COMPUTER_BRAIN_VIEW_H
+#define COMPUTER_BRAIN_VIEW_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "expression.h"
+#include "gemm.h"
+
+/*
+ * Non-owning, strided views over the elements of a Vector or Matrix.
+ *
+ * A view is a pointer plus a shape and a stride per dimension. Transposing a view swaps its strides, a row or a
+ * column of a MatrixView is a VectorView with the column or row stride, and a submatrix is an offset pointer with the
+ * same strides, so none of these operations touches or copies an element. Views take part in elementwise expressions
+ * (expression.h) and in gemm() like any Vector or Matrix; in fact, Vector and Matrix operands enter every kernel as
+ * views, which is where their is_transposed flag is turned into strides, once.
+ *
+ * A view with a non-const element type can be written through: assigning an expression (or another view) to it
+ * overwrites the elements it points at. Copying a view copies the pointer, not the elements. A view does not keep the
+ * Vector or Matrix it came from alive, and is invalidated when that object is resized, moved or destroyed.
+ */
+
+namespace detail {
+
+/// True when the byte ranges [lo_a, hi_a) and [lo_b, hi_b) have at least one byte in common.
+inline bool ranges_overlap(const void* lo_a, const void* hi_a, const void* lo_b, const void* hi_b) {
+    const auto a0 = reinterpret_cast<std::uintptr_t>(lo_a), a1 = reinterpret_cast<std::uintptr_t>(hi_a);
+    const auto b0 = reinterpret_cast<std::uintptr_t>(lo_b), b1 = reinterpret_cast<std::uintptr_t>(hi_b);
+    return a0 < b1 && b0 < a1;
+}
+
+}  // namespace detail
+
+
+/* ------------------------------------------------ Vector View Class ----------------------------------------------- */
+
+
+template<typename T>
+class VectorView : public VectorExpression<VectorView<T>> {
+private:
+    T* first;                  // first element of the view
+    size_t count;              // number of elements
+    ptrdiff_t step;            // distance, in elements, between consecutive elements
+    bool orientation;          // true for a row vector, false for a column vector
+public:
+    using value_type = std::remove_const_t<T>;
+
+    /* Constructors */
+    VectorView(T* data, size_t size, ptrdiff_t stride = 1, bool is_transposed = false);
+    template<typename W, typename = std::enable_if_t<std::is_convertible_v<W*, T*>>>
+    VectorView(const VectorView<W>& other);                                   // non-const view to const view
+    VectorView(const VectorView& other) = default;
+    VectorView& operator=(const VectorView& other);                           // writes the elements of other
+    template<typename E> VectorView& operator=(const VectorExpression<E>& expr);  // writes the expression
+    template<typename E> VectorView& operator+=(const VectorExpression<E>& expr);
+    template<typename E> VectorView& operator-=(const VectorExpression<E>& expr);
+    VectorView& operator*=(const value_type& scalar);
+    VectorView& operator/=(const value_type& scalar);
+
+    /* Member Functions */
+    size_t size() const { return count; }
+    ptrdiff_t stride() const { return step; }
+    T* data() const { return first; }
+    VectorView t() const;
+    VectorView subvector(size_t offset, size_t size) const;
+
+    /* Non-Mathematical Operations */
+    T& operator[](size_t i) const { return first[i * step]; }
+
+    /* Expression Interface (see expression.h) */
+    bool transposed() const { return orientation; }
+    bool contiguous() const { return step == 1; }
+    template<typename V> __attribute__((always_inline)) inline void load(size_t i, V& out) const {
+        std::memcpy(&out, first + i, sizeof(V));
+    }
+    bool aliases(const void* lo, const void* hi, const void* data, ptrdiff_t stride) const;
+};
+
+/// Creates a view of size elements starting at data, stride elements apart, with the given orientation.
+template<typename T>
+VectorView<T>::VectorView(T* data, size_t size, ptrdiff_t stride, bool is_transposed)
+    : first(data), count(size), step(stride), orientation(is_transposed) { }
+
+template<typename T>
+template<typename W, typename>
+VectorView<T>::VectorView(const VectorView<W>& other)
+    : first(other.data()), count(other.size()), step(other.stride()), orientation(other.transposed()) { }
+
+/// Copies the elements of other into the elements this view points at. Both views must have the same size.
+template<typename T>
+VectorView<T>& VectorView<T>::operator=(const VectorView& other) {
+    return *this = static_cast<const VectorExpression<VectorView>&>(other);
+}
+
+/**
+ * @brief Evaluates an elementwise expression into the elements this view points at.
+ *
+ * The expression must have the same size as the view; its orientation is not checked, since a view cannot change the
+ * orientation of the elements it points into. If the expression reads the memory of this view through a different
+ * layout, it is evaluated into a temporary first.
+ */
+template<typename T>
+template<typename E>
+VectorView<T>& VectorView<T>::operator=(const VectorExpression<E>& expr) {
+    static_assert(!std::is_const_v<T>, "Cannot assign through a view of const elements");
+    auto&& source = detail::as_operand(expr.self());
+    if (source.size() != count) {
+        throw std::invalid_argument("\nThe expression assigned to a VectorView has " + std::to_string(source.size()) +
+                                    " elements, but the view has " + std::to_string(count) + "\n");
+    }
+    if (count == 0) return *this;
+    if (source.aliases(first, first + (count - 1) * step + 1, first, step)) {
+        const Vector<value_type> temporary(expr);
+        detail::evaluate(temporary, first, step);
+    } else {
+        detail::evaluate(expr, first, step);
+    }
+    return *this;
+}
+
+/**
+ * @brief Compound assignment: the elements this view points at become view + expr, in one pass and without allocating.
+ *
+ * The view is an operand of the expression it is assigned, so the size and orientation rules of the expression
+ * operators apply (std::invalid_argument otherwise), and an expression that reads this view through another layout is
+ * evaluated into a temporary first, as with operator=.
+ */
+template<typename T>
+template<typename E>
+VectorView<T>& VectorView<T>::operator+=(const VectorExpression<E>& expr) { return *this = *this + expr.self(); }
+
+/// Compound assignment: the elements this view points at become view - expr. See operator+=.
+template<typename T>
+template<typename E>
+VectorView<T>& VectorView<T>::operator-=(const VectorExpression<E>& expr) { return *this = *this - expr.self(); }
+
+/// Multiplies the elements this view points at by a scalar, in place.
+template<typename T>
+VectorView<T>& VectorView<T>::operator*=(const value_type& scalar) { return *this = *this * scalar; }
+
+/// Divides the elements this view points at by a scalar, in place.
+template<typename T>
+VectorView<T>& VectorView<T>::operator/=(const value_type& scalar) { return *this = *this / scalar; }
+
+/// VectorView.t() returns a view of the same elements with the opposite orientation.
+template<typename T>
+VectorView<T> VectorView<T>::t() const { return VectorView(first, count, step, !orientation); }
+
+/// VectorView.subvector() returns a view of `size` consecutive elements starting at element `offset`.
+template<typename T>
+VectorView<T> VectorView<T>::subvector(size_t offset, size_t size) const {
+    if (offset + size > count) {
+        throw std::out_of_range("\nThe subvector [" + std::to_string(offset) + ", " + std::to_string(offset + size) +
+                                ") does not fit in a VectorView of " + std::to_string(count) + " elements\n");
+    }
+    return VectorView(first + offset * step, size, step, orientation);
+}
+
+/// True when this view reads memory in [lo, hi) in any layout other than (data, stride).
+template<typename T>
+bool VectorView<T>::aliases(const void* lo, const void* hi, const void* data, ptrdiff_t stride) const {
+    if (count == 0 || !detail::ranges_overlap(first, first + (count - 1) * step + 1, lo, hi)) return false;
+    return !(first == data && (step == stride || count == 1));
+}
+
+
+/* ------------------------------------------------ Matrix View Class ----------------------------------------------- */
+
+
+template<typename U>
+class MatrixView : public MatrixExpression<MatrixView<U>> {
+private:
+    U* first;                  // element (0, 0) of the view
+    size_t num_rows;
+    size_t num_cols;
+    ptrdiff_t rs;              // distance, in elements, between (i, j) and (i + 1, j)
+    ptrdiff_t cs;              // distance, in elements, between (i, j) and (i, j + 1)
+public:
+    using value_type = std::remove_const_t<U>;
+
+    /* Constructors */
+    MatrixView(U* data, size_t rows, size_t columns, ptrdiff_t row_stride, ptrdiff_t col_stride);
+    template<typename W, typename = std::enable_if_t<std::is_convertible_v<W*, U*>>>
+    MatrixView(const MatrixView<W>& other);                                   // non-const view to const view
+    MatrixView(const MatrixView& other) = default;
+    MatrixView& operator=(const MatrixView& other);                           // writes the elements of other
+    template<typename E> MatrixView& operator=(const MatrixExpression<E>& expr);  // writes the expression
+    template<typename E> MatrixView& operator+=(const MatrixExpression<E>& expr);
+    template<typename E> MatrixView& operator-=(const MatrixExpression<E>& expr);
+    MatrixView& operator*=(const value_type& scalar);
+    MatrixView& operator/=(const value_type& scalar);
+
+    /* Member Functions */
+    size_t rows() const { return num_rows; }
+    size_t columns() const { return num_cols; }
+    ptrdiff_t row_stride() const { return rs; }
+    ptrdiff_t col_stride() const { return cs; }
+    U* data() const { return first; }
+    MatrixView t() const;
+    VectorView<U> row(size_t i) const;
+    VectorView<U> col(size_t j) const;
+    MatrixView submatrix(size_t first_row, size_t first_col, size_t rows, size_t columns) const;
+
+    /* Non-Mathematical Operations */
+    U& operator()(size_t i, size_t j) const { return first[i * rs + j * cs]; }
+
+    /* Expression Interface (see expression.h) */
+    size_t logical_rows() const { return num_rows; }
+    size_t logical_columns() const { return num_cols; }
+    const U& logical_at(size_t i, size_t j) const { return first[i * rs + j * cs]; }
+    bool contiguous() const { return cs == 1; }
+    template<typename V> __attribute__((always_inline)) inline void load(size_t i, size_t j, V& out) const {
+        std::memcpy(&out, first + i * rs + j, sizeof(V));
+    }
+    bool aliases(const void* lo, const void* hi, const void* data, ptrdiff_t row_stride, ptrdiff_t col_stride) const;
+
+private:
+    U* past_last() const { return first + (num_rows - 1) * rs + (num_cols - 1) * cs + 1; }
+};
+
+/// Creates a rows x columns view starting at data, with the given distances between rows and between columns.
+template<typename U>
+MatrixView<U>::MatrixView(U* data, size_t rows, size_t columns, ptrdiff_t row_stride, ptrdiff_t col_stride)
+    : first(data), num_rows(rows), num_cols(columns), rs(row_stride), cs(col_stride) { }
+
+template<typename U>
+template<typename W, typename>
+MatrixView<U>::MatrixView(const MatrixView<W>& other)
+    : first(other.data()), num_rows(other.rows()), num_cols(other.columns()), rs(other.row_stride()),
+      cs(other.col_stride()) { }
+
+/// Copies the elements of other into the elements this view points at. Both views must have the same shape.
+template<typename U>
+MatrixView<U>& MatrixView<U>::operator=(const MatrixView& other) {
+    return *this = static_cast<const MatrixExpression<MatrixView>&>(other);
+}
+
+/**
+ * @brief Evaluates an elementwise expression into the elements this view points at.
+ *
+ * The expression must have the shape of the view. If the expression reads the memory of this view through a
+ * different layout (for example, A.view() = A.view().t()), it is evaluated into a temporary first.
+ */
+template<typename U>
+template<typename E>
+MatrixView<U>& MatrixView<U>::operator=(const MatrixExpression<E>& expr) {
+    static_assert(!std::is_const_v<U>, "Cannot assign through a view of const elements");
+    auto&& source = detail::as_operand(expr.self());
+    if (source.logical_rows() != num_rows || source.logical_columns() != num_cols) {
+        throw std::invalid_argument("\nThe expression assigned to a MatrixView is " +
+                                    std::to_string(source.logical_rows()) + "x" +
+                                    std::to_string(source.logical_columns()) + ", but the view is " +
+                                    std::to_string(num_rows) + "x" + std::to_string(num_cols) + "\n");
+    }
+    if (num_rows == 0 || num_cols == 0) return *this;
+    if (source.aliases(first, past_last(), first, rs, cs)) {
+        const Matrix<value_type> temporary(expr);
+        detail::evaluate(temporary, first, rs, cs);
+    } else {
+        detail::evaluate(expr, first, rs, cs);
+    }
+    return *this;
+}
+
+/**
+ * @brief Compound assignment: the elements this view points at become view + expr, in one pass and without allocating.
+ *
+ * The shape rules of the expression operators apply. An expression that reads this view through another layout (for
+ * example, A += A.t()) is evaluated into a temporary first, as with operator=.
+ */
+template<typename U>
+template<typename E>
+MatrixView<U>& MatrixView<U>::operator+=(const MatrixExpression<E>& expr) { return *this = *this + expr.self(); }
+
+/// Compound assignment: the elements this view points at become view - expr. See operator+=.
+template<typename U>
+template<typename E>
+MatrixView<U>& MatrixView<U>::operator-=(const MatrixExpression<E>& expr) { return *this = *this - expr.self(); }
+
+/// Multiplies the elements this view points at by a scalar, in place.
+template<typename U>
+MatrixView<U>& MatrixView<U>::operator*=(const value_type& scalar) { return *this = *this * scalar; }
+
+/// Divides the elements this view points at by a scalar, in place.
+template<typename U>
+MatrixView<U>& MatrixView<U>::operator/=(const value_type& scalar) { return *this = *this / scalar; }
+
+/// MatrixView.t() returns the transpose of the view by swapping its shape and strides.
+template<typename U>
+MatrixView<U> MatrixView<U>::t() const { return MatrixView(first, num_cols, num_rows, cs, rs); }
+
+/// MatrixView.row(i) returns row i as a row vector (a transposed VectorView).
+template<typename U>
+VectorView<U> MatrixView<U>::row(size_t i) const {
+    if (i >= num_rows) {
+        throw std::out_of_range("\nRow " + std::to_string(i) + " does not exist in a view with " +
+                                std::to_string(num_rows) + " rows\n");
+    }
+    return VectorView<U>(first + i * rs, num_cols, cs, true);
+}
+
+/// MatrixView.col(j) returns column j as a column vector (a VectorView that is not transposed).
+template<typename U>
+VectorView<U> MatrixView<U>::col(size_t j) const {
+    if (j >= num_cols) {
+        throw std::out_of_range("\nColumn " + std::to_string(j) + " does not exist in a view with " +
+                                std::to_string(num_cols) + " columns\n");
+    }
+    return VectorView<U>(first + j * cs, num_rows, rs, false);
+}
+
+/// MatrixView.submatrix() returns the rows x columns block whose top-left element is (first_row, first_col).
+template<typename U>
+MatrixView<U> MatrixView<U>::submatrix(size_t first_row, size_t first_col, size_t rows, size_t columns) const {
+    if (first_row + rows > num_rows || first_col + columns > num_cols) {
+        throw std::out_of_range("\nThe " + std::to_string(rows) + "x" + std::to_string(columns) +
+                                " submatrix at (" + std::to_string(first_row) + ", " + std::to_string(first_col) +
+                                ") does not fit in a " + std::to_string(num_rows) + "x" + std::to_string(num_cols) +
+                                " view\n");
+    }
+    return MatrixView(first + first_row * rs + first_col * cs, rows, columns, rs, cs);
+}
+
+/// True when this view reads memory in [lo, hi) in any layout other than (data, row_stride, col_stride).
+template<typename U>
+bool MatrixView<U>::aliases(const void* lo, const void* hi, const void* data, ptrdiff_t row_stride,
+                            ptrdiff_t col_stride) const {
+    if (num_rows == 0 || num_cols == 0 || !detail::ranges_overlap(first, past_last(), lo, hi)) return false;
+    const bool same_rows = rs == row_stride || num_rows == 1;
+    const bool same_cols = cs == col_stride || num_cols == 1;
+    return !(first == data && same_rows && same_cols);
+}
+
+
+/* ------------------------------------------------ GEMM on Views --------------------------------------------------- */
+
+
+/**
+ * @brief C = alpha * A * B + beta * C on views.
+ *
+ * Any view can be used, including transposed views, submatrices and views of a Matrix with is_transposed set; the
+ * strides of each view go straight to gemm(). C must not overlap A or B.
+ */
+template<typename U>
+void gemm(U alpha, const std::type_identity_t<MatrixView<const U>>& a,
+          const std::type_identity_t<MatrixView<const U>>& b, U beta, const std::type_identity_t<MatrixView<U>>& c) {
+    if (a.columns() != b.rows() || c.rows() != a.rows() || c.columns() != b.columns()) {
+        throw std::invalid_argument("The Matrix product cannot be computed due to incompatible Matrix Dimensions\n");
+    }
+    gemm<U>(a.rows(), b.columns(), a.columns(), alpha, a.data(), a.row_stride(), a.col_stride(), b.data(),
+            b.row_stride(), b.col_stride(), beta, c.data(), c.row_stride(), c.col_stride());
+}
+
+
+/**
+ * @brief Batched GEMM on views: C[i] = alpha * A[i] * B[i] + beta * C[i] for every i.
+ *
+ * The views may all have different shapes and layouts. See gemm_batched_strided() in gemm.h for a batch of
+ * same-shaped operands stored at regular intervals, which needs no array of views. No C[i] may overlap another
+ * operand of the batch.
+ */
+template<typename U>
+void gemm_batched(U alpha, std::span<const std::type_identity_t<MatrixView<const U>>> a,
+                  std::span<const std::type_identity_t<MatrixView<const U>>> b, U beta,
+                  std::span<const std::type_identity_t<MatrixView<U>>> c) {
+    if (a.size() != b.size() || a.size() != c.size()) {
+        throw std::invalid_argument("\nA batch of " + std::to_string(a.size()) + " left operands, " +
+                                    std::to_string(b.size()) + " right operands and " + std::to_string(c.size()) +
+                                    " results cannot be multiplied\n");
+    }
+    size_t total_work = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].columns() != b[i].rows() || c[i].rows() != a[i].rows() || c[i].columns() != b[i].columns()) {
+            throw std::invalid_argument("The Matrix product cannot be computed due to incompatible "
+                                        "Matrix Dimensions\n");
+        }
+        total_work += c[i].rows() * c[i].columns() * std::max<size_t>(a[i].columns(), 1);
+    }
+    detail::gemm_batch_for(a.size(), total_work, [&](size_t i) {
+        gemm<U>(c[i].rows(), c[i].columns(), a[i].columns(), alpha, a[i].data(), a[i].row_stride(),
+                a[i].col_stride(), b[i].data(), b[i].row_stride(), b[i].col_stride(), beta, c[i].data(),
+                c[i].row_stride(), c[i].col_stride());
+    });
+}
+
+
+/**
+ * @brief y = alpha * A * x + beta * y on views; see gemv() in gemm.h.
+ *
+ * The strides of the views go straight to gemv(), so a transposed view of A gives A^T * x without a copy. The
+ * orientation flags of x and y are not looked at. y must not overlap A or x.
+ */
+template<typename U>
+void gemv(U alpha, const std::type_identity_t<MatrixView<const U>>& a,
+          const std::type_identity_t<VectorView<const U>>& x, U beta, const std::type_identity_t<VectorView<U>>& y) {
+    if (a.columns() != x.size() || a.rows() != y.size()) {
+        throw std::invalid_argument("The Matrix-Vector product cannot be computed due to incompatible dimensions\n");
+    }
+    gemv<U>(a.rows(), a.columns(), alpha, a.data(), a.row_stride(), a.col_stride(), x.data(), x.stride(), beta,
+            y.data(), y.stride());
+}
+
+/* ------------------------------------------------- BLAS-1 on Views ----------------------------------------------- */
+
+
+/*
+ * scal, axpy and axpby are fused elementwise expressions written back into their last operand: one pass over memory,
+ * vectorised and split over the thread pool by expression.h, and no allocation unless an operand reads the output
+ * through another layout. Operands follow the shape and orientation rules of the expression operators.
+ */
+
+/// x = alpha * x
+template<typename T>
+void scal(T alpha, std::type_identity_t<VectorView<T>> x) { x = x * alpha; }
+
+/// y = alpha * x + y
+template<typename T>
+void axpy(T alpha, const std::type_identity_t<VectorView<const T>>& x, std::type_identity_t<VectorView<T>> y) {
+    y = x * alpha + y;
+}
+
+/// y = alpha * x + beta * y
+template<typename T>
+void axpby(T alpha, const std::type_identity_t<VectorView<const T>>& x, T beta,
+           std::type_identity_t<VectorView<T>> y) {
+    y = x * alpha + y * beta;
+}
+
+/// X = alpha * X
+template<typename U>
+void scal(U alpha, std::type_identity_t<MatrixView<U>> x) { x = x * alpha; }
+
+/// Y = alpha * X + Y, for example a weight update W = -rate * G + W.
+template<typename U>
+void axpy(U alpha, const std::type_identity_t<MatrixView<const U>>& x, std::type_identity_t<MatrixView<U>> y) {
+    y = x * alpha + y;
+}
+
+/// Y = alpha * X + beta * Y
+template<typename U>
+void axpby(U alpha, const std::type_identity_t<MatrixView<const U>>& x, U beta,
+           std::type_identity_t<MatrixView<U>> y) {
+    y = x * alpha + y * beta;
+}
+
+
+/* ----------------------------------------- Half-Precision Products on Views --------------------------------------- */
+
+
+/// C = alpha * A * B + beta * C with A and B views of float16 or bfloat16 and C a view of float; see gemm.h.
+template<typename H> requires is_half_type<std::remove_const_t<H>>
+void gemm(float alpha, const MatrixView<H>& a, const MatrixView<H>& b, float beta, const MatrixView<float>& c) {
+    if (a.columns() != b.rows() || c.rows() != a.rows() || c.columns() != b.columns()) {
+        throw std::invalid_argument("The Matrix product cannot be computed due to incompatible Matrix Dimensions\n");
+    }
+    gemm<std::remove_const_t<H>>(a.rows(), b.columns(), a.columns(), alpha, a.data(), a.row_stride(),
+                                 a.col_stride(), b.data(), b.row_stride(), b.col_stride(), beta, c.data(),
+                                 c.row_stride(), c.col_stride());
+}
+
+/// y = alpha * A * x + beta * y with A and x views of float16 or bfloat16 and y a view of float; see half_gemv().
+template<typename H> requires is_half_type<std::remove_const_t<H>>
+void half_gemv(float alpha, const MatrixView<H>& a, const VectorView<H>& x, float beta, const VectorView<float>& y) {
+    if (a.columns() != x.size() || a.rows() != y.size()) {
+        throw std::invalid_argument("\nThe Matrix-Vector product cannot be computed due to incompatible dimensions\n");
+    }
+    half_gemv<std::remove_const_t<H>>(a.rows(), a.columns(), alpha, a.data(), a.row_stride(), a.col_stride(),
+                                      x.data(), x.stride(), beta, y.data(), y.stride());
+}
+
+/// The dot product of two views of float16 or bfloat16, accumulated in float.
+template<typename H> requires is_half_type<std::remove_const_t<H>>
+float half_dot(const VectorView<H>& a, const VectorView<H>& b) {
+    if (a.size() != b.size()) {
+        throw std::invalid_argument("\nThe dot product cannot be computed due to incompatible vector length\n");
+    }
+    if (a.stride() == 1 && b.stride() == 1) return half_dot(a.data(), b.data(), a.size());
+    float sum = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) sum += (float)a[i] * (float)b[i];
+    return sum;
+}
+
+#endif //COMPUTER_BRAIN_VIEW_H
@@ -0,0 +1,242 @@
+#ifndef COMPUTER_BRAIN_WORKSPACE_H
+#define COMPUTER_BRAIN_WORKSPACE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "aligned.h"
+
+/*
+ * Workspace arenas for the storage of Vector and Matrix.
+ *
+ * A Workspace is a bump allocator: it hands out memory from large blocks by moving an offset forward, and never frees
+ * anything on its own. A WorkspaceScope makes a Workspace the current one for the calling thread; every Vector and
+ * Matrix created while the scope is alive takes its elements from the Workspace instead of the heap, and when the scope
+ * ends the Workspace is rewound to where it was when the scope began. The blocks are kept, so a loop that opens a scope
+ * on every iteration reuses the same memory over and over and does not call the heap allocator at all once the first
+ * iteration has sized the blocks:
+ *
+ *     Workspace workspace;
+ *     for (...) {
+ *         WorkspaceScope scope(workspace);
+ *         Matrix<float> h = (w * x + b) * 0.5f;   // h and every temporary come from workspace
+ *         ...
+ *     }                                            // all of them are released here, at once
+ *
+ * A Vector or Matrix created inside a scope must not outlive it. To keep a result, assign it to a Vector or Matrix
+ * that was created outside the scope (result = h, or result = A * B): assignment always keeps the storage of the
+ * destination, so the elements are copied out of the Workspace. Constructing a new object from a moved one
+ * (Matrix<float> kept = std::move(h)) takes h's storage along with it, and must not be done across a scope.
+ *
+ * A Workspace is used by one thread at a time. Scopes nest, and a scope on one thread does not affect other threads, so
+ * the workers of the thread pool keep using the heap.
+ */
+
+
+/* ------------------------------------------------ Workspace Class ------------------------------------------------- */
+
+
+class Workspace {
+public:
+    static constexpr size_t default_block_bytes = size_t(1) << 20;
+
+    /// A position in the Workspace, as returned by mark() and restored by rewind().
+    struct Mark {
+        size_t block;
+        size_t offset;
+    };
+
+    /* Constructors and Destructor */
+    explicit Workspace(size_t block_bytes = default_block_bytes);
+    ~Workspace();
+    Workspace(const Workspace& other) = delete;
+    Workspace& operator=(const Workspace& other) = delete;
+
+    /// The Workspace of the innermost WorkspaceScope alive on the calling thread, or nullptr.
+    static Workspace* current();
+
+    /* Member Functions */
+    void* allocate(size_t bytes, size_t alignment);
+    void deallocate(void* pointer, size_t bytes);
+    Mark mark() const;
+    void rewind(const Mark& position);
+    void release();
+    size_t bytes_in_use() const;
+    size_t capacity() const;
+
+private:
+    struct Block {
+        std::byte* data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t active = 0;         // index of the block allocations are currently taken from
+    size_t offset = 0;         // bytes of blocks[active] already handed out
+    size_t block_bytes;
+
+    static inline thread_local Workspace* current_workspace = nullptr;
+    friend class WorkspaceScope;
+};
+
+/// Creates an empty Workspace. Blocks of block_bytes bytes (or larger, for larger requests) are added as needed.
+inline Workspace::Workspace(size_t block_bytes) : block_bytes(std::max<size_t>(block_bytes, 4096)) { }
+
+/// Frees every block. No Vector or Matrix allocated from this Workspace may still be alive.
+inline Workspace::~Workspace() {
+    for (const Block& block : blocks) {
+        detail::aligned_deallocate(block.data);
+    }
+}
+
+inline Workspace* Workspace::current() { return current_workspace; }
+
+/**
+ * @brief Returns bytes bytes aligned to alignment (a power of two no larger than storage_alignment).
+ *
+ * The memory comes from the current block when it fits, then from the next block that was kept by an earlier rewind(),
+ * and only then from a new block, which is the only case that calls the heap allocator.
+ */
+inline void* Workspace::allocate(size_t bytes, size_t alignment) {
+    bytes = std::max<size_t>(bytes, 1);
+    for (size_t b = blocks.empty() ? 0 : active; b < blocks.size(); ++b) {
+        const size_t start = b == active ? offset : 0;
+        const auto base = reinterpret_cast<std::uintptr_t>(blocks[b].data);
+        const size_t aligned = ((base + start + alignment - 1) & ~(std::uintptr_t)(alignment - 1)) - base;
+        if (aligned + bytes <= blocks[b].size) {
+            active = b;
+            offset = aligned + bytes;
+            return blocks[b].data + aligned;
+        }
+    }
+    const size_t size = std::max(block_bytes, bytes);
+    auto* data = static_cast<std::byte*>(detail::aligned_allocate(size));
+    blocks.push_back(Block{data, size});
+    active = blocks.size() - 1;
+    offset = bytes;
+    return data;
+}
+
+/**
+ * Memory is normally given back all at once by rewind(); a deallocation is a no-op, except that freeing the most recent
+ * allocation gives its bytes back straight away, which suits temporaries that die in the order they were created.
+ */
+inline void Workspace::deallocate(void* pointer, size_t bytes) {
+    if (blocks.empty()) return;
+    std::byte* top = blocks[active].data + offset;
+    if (static_cast<std::byte*>(pointer) + std::max<size_t>(bytes, 1) == top) {
+        offset = static_cast<size_t>(static_cast<std::byte*>(pointer) - blocks[active].data);
+    }
+}
+
+/// Workspace.mark() returns the current position, so that everything allocated after it can be released by rewind().
+inline Workspace::Mark Workspace::mark() const { return Mark{active, offset}; }
+
+/// Workspace.rewind() releases every allocation made since position was marked. The blocks are kept for reuse.
+inline void Workspace::rewind(const Mark& position) {
+    active = position.block;
+    offset = position.offset;
+}
+
+/// Workspace.release() releases every allocation. The blocks are kept for reuse.
+inline void Workspace::release() { rewind(Mark{0, 0}); }
+
+/// Number of bytes handed out and not yet released (alignment padding and skipped block tails included).
+inline size_t Workspace::bytes_in_use() const {
+    size_t bytes = offset;
+    for (size_t b = 0; b < active && b < blocks.size(); ++b) bytes += blocks[b].size;
+    return bytes;
+}
+
+/// Total size of the blocks owned by the Workspace.
+inline size_t Workspace::capacity() const {
+    size_t bytes = 0;
+    for (const Block& block : blocks) bytes += block.size;
+    return bytes;
+}
+
+
+/* --------------------------------------------- Workspace Scope Class ---------------------------------------------- */
+
+
+/**
+ * @brief Makes a Workspace the current one for the calling thread until the end of the enclosing block.
+ *
+ * When the scope ends, the Workspace is rewound to where it was when the scope began, which releases every Vector and
+ * Matrix allocated inside the scope at once, and the previous current Workspace (if any) becomes current again.
+ */
+class WorkspaceScope {
+public:
+    explicit WorkspaceScope(Workspace& workspace)
+        : workspace(workspace), start(workspace.mark()), previous(Workspace::current_workspace) {
+        Workspace::current_workspace = &workspace;
+    }
+    ~WorkspaceScope() {
+        workspace.rewind(start);
+        Workspace::current_workspace = previous;
+    }
+    WorkspaceScope(const WorkspaceScope& other) = delete;
+    WorkspaceScope& operator=(const WorkspaceScope& other) = delete;
+
+private:
+    Workspace& workspace;
+    Workspace::Mark start;
+    Workspace* previous;
+};
+
+
+/* -------------------------------------------- Storage Allocator --------------------------------------------------- */
+
+
+namespace detail {
+
+/**
+ * @brief The allocator of Vector and Matrix storage.
+ *
+ * It remembers the Workspace that was current when it was created and takes memory from it, or from the heap when no
+ * Workspace was current. Either way the memory is aligned to storage_alignment (aligned.h). A copy of a container
+ * gets a fresh allocator (select_on_container_copy_construction), and both copy and move assignment keep the
+ * allocator of the destination: a move assignment between storage of two different origins copies the elements, so
+ * that no object created outside a scope ends up pointing into it.
+ */
+template<typename T>
+class WorkspaceAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::false_type;
+    using propagate_on_container_swap = std::true_type;
+
+    WorkspaceAllocator() noexcept : workspace(Workspace::current()) { }
+    template<typename W>
+    WorkspaceAllocator(const WorkspaceAllocator<W>& other) noexcept : workspace(other.workspace) { }
+
+    T* allocate(size_t n) {
+        if (workspace) return static_cast<T*>(workspace->allocate(n * sizeof(T), storage_alignment));
+        return static_cast<T*>(aligned_allocate(n * sizeof(T)));
+    }
+    void deallocate(T* pointer, size_t n) noexcept {
+        if (workspace) {
+            workspace->deallocate(pointer, n * sizeof(T));
+        } else {
+            aligned_deallocate(pointer);
+        }
+    }
+    WorkspaceAllocator select_on_container_copy_construction() const { return WorkspaceAllocator(); }
+
+    template<typename W> bool operator==(const WorkspaceAllocator<W>& other) const {
+        return workspace == other.workspace;
+    }
+
+    Workspace* workspace;
+};
+
+}  // namespace detail
+
+
+#endif //COMPUTER_BRAIN_WORKSPACE_H